@@ -1,6 +1,10 @@
 package com.registadb;
 
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.List;
 import java.util.Map;
+import java.util.concurrent.atomic.AtomicLong;
 
 import org.zeromq.SocketType;
 import org.zeromq.ZContext;
@@ -9,11 +13,15 @@ import org.zeromq.ZMQ;
 import com.registadb.builders.EntryBuilder;
 
 import java.io.IOException;
+import com.google.protobuf.ByteString;
 import registadb.Playbook.Entry;
 import registadb.Playbook.EntryValue;
+import registadb.Playbook.MetadataFilter;
 import registadb.Playbook.OperationType;
 import registadb.Playbook.Request;
 import registadb.Playbook.Response;
+import registadb.Playbook.ScanRequest;
+import registadb.Playbook.UpdateMode;
 
 
 /**
@@ -23,11 +31,17 @@ import registadb.Playbook.Response;
  * The client uses ZeroMQ for communication:
  * - Port 5555 for push (fire-and-forget)
  * - Port 5556 for request-reply interactions (store with verification, fetch, delete)
+ *
+ * The smart lane uses a DEALER socket and tags every request with a correlation id, so several
+ * requests can be in flight at once (see {@link #pipeline(List)}) and replies may arrive out of order.
  */
 public class RegistaClient implements AutoCloseable {
     private final ZContext context;
     private final ZMQ.Socket pushSocket;  // Port 5555
     private final ZMQ.Socket reqSocket;   // Port 5556
+    private final AtomicLong nextCorrelationId = new AtomicLong(1);
+    // replies that arrived while waiting for a different correlation id
+    private final Map<Long, Response> unclaimedReplies = new HashMap<>();
 
     /**
      * Constructor to initialize the RegistaClient with the server's host address.
@@ -40,8 +54,8 @@ public class RegistaClient implements AutoCloseable {
         this.pushSocket = context.createSocket(SocketType.PUSH);
         this.pushSocket.connect("tcp://" + host + ":5555");
 
-        // Smart Lane: Req (Bidirectional)
-        this.reqSocket = context.createSocket(SocketType.REQ);
+        // Smart Lane: Dealer (Bidirectional, pipelined)
+        this.reqSocket = context.createSocket(SocketType.DEALER);
         this.reqSocket.connect("tcp://" + host + ":5556");
     }
 
@@ -104,15 +118,74 @@ public class RegistaClient implements AutoCloseable {
      * @throws IOException if there is an error sending the request or receiving the response.
      */
     private Response sendWithReply(Request req) throws IOException {
-        reqSocket.send(req.toByteArray(), 0);
+        long correlationId = send(req);
+        return receive(correlationId);
+    }
+
+    /**
+     * Sends several requests without waiting in between, then collects all of their responses.
+     * The server may answer out of order; the returned list is in the same order as the requests.
+     * @param requests The Request protobufs to send to the server.
+     * @return The Responses, one per request, in request order.
+     * @throws IOException if there is an error sending the requests or receiving the responses.
+     */
+    public List<Response> pipeline(List<Request> requests) throws IOException {
+        List<Long> correlationIds = new ArrayList<>(requests.size());
+        for (Request req : requests) {
+            correlationIds.add(send(req));
+        }
+
+        List<Response> responses = new ArrayList<>(requests.size());
+        for (long correlationId : correlationIds) {
+            responses.add(receive(correlationId));
+        }
+        return responses;
+    }
+
+    /**
+     * Tags a request with a fresh correlation id and sends it on the smart lane.
+     * An empty delimiter frame is sent first so the server sees the same envelope as from a REQ socket.
+     * @param req The Request protobuf to send to the server.
+     * @return The correlation id the response will carry.
+     */
+    private long send(Request req) {
+        long correlationId = nextCorrelationId.getAndIncrement();
+        Request tagged = req.toBuilder().setCorrelationId(correlationId).build();
+
+        reqSocket.sendMore(new byte[0]);
+        reqSocket.send(tagged.toByteArray(), 0);
+        return correlationId;
+    }
 
-        byte[] replyBytes = reqSocket.recv(0);
-        if (replyBytes == null) {
-            throw new IOException("No reply received");
+    /**
+     * Waits for the response carrying the given correlation id, parking any other replies that arrive first.
+     * @param correlationId The correlation id of the request to wait for.
+     * @return The Response protobuf for that request.
+     * @throws IOException if there is an error receiving the response.
+     */
+    private Response receive(long correlationId) throws IOException {
+        Response parked = unclaimedReplies.remove(correlationId);
+        if (parked != null) {
+            return parked;
         }
 
-        Response resp = Response.parseFrom(replyBytes);
-        return resp;
+        while (true) {
+            // skip the empty delimiter frame
+            byte[] delimiter = reqSocket.recv(0);
+            if (delimiter == null) {
+                throw new IOException("No reply received");
+            }
+            byte[] replyBytes = delimiter.length == 0 ? reqSocket.recv(0) : delimiter;
+            if (replyBytes == null) {
+                throw new IOException("No reply received");
+            }
+
+            Response resp = Response.parseFrom(replyBytes);
+            if (resp.getCorrelationId() == correlationId) {
+                return resp;
+            }
+            unclaimedReplies.put(resp.getCorrelationId(), resp);
+        }
     }
 
    /**
@@ -172,6 +245,38 @@ public class RegistaClient implements AutoCloseable {
         return sendWithReply(req);
     }
 
+    /**
+     * Fetches many entries from RegistaDB in one round trip. The server resolves all ids with batched lookups.
+     * @param ids The IDs of the entries to fetch.
+     * @return Response from the server whose results list holds one EntryResult per id, in the same order as ids.
+     * @throws IOException if there is an error sending the request or receiving the response.
+     */
+    public Response readMany(List<Long> ids) throws IOException {
+        Request req = Request.newBuilder()
+                .setOp(OperationType.OP_MULTI_READ)
+                .addAllIds(ids)
+                .build();
+        return sendWithReply(req);
+    }
+
+    /**
+     * Fetches the newest entries whose metadata[key] equals value. The key must be one of the server's indexed metadata keys.
+     * @param key The indexed metadata key.
+     * @param value The metadata value to match.
+     * @param limit Maximum number of entries to return, 0 for the server default.
+     * @param cursor The next cursor of the previous page, or an empty ByteString for the first page.
+     * @return Response from the server whose entries list holds one page, newest first, and whose next cursor is empty when there are no more matches.
+     * @throws IOException if there is an error sending the request or receiving the response.
+     */
+    public Response queryByMetadata(String key, String value, int limit, ByteString cursor) throws IOException {
+        Request req = Request.newBuilder()
+                .setOp(OperationType.OP_QUERY_METADATA)
+                .setMetadata(MetadataFilter.newBuilder().setKey(key).setValue(value))
+                .setScan(ScanRequest.newBuilder().setLimit(limit).setCursor(cursor))
+                .build();
+        return sendWithReply(req);
+    }
+
     /**
      * Updates an entry from RegistaDB by its ID, returning the server's response which includes the entry data if found.
      * @param id The ID of the entry to update.
@@ -186,6 +291,21 @@ public class RegistaClient implements AutoCloseable {
         return sendWithReply(req);
     }
 
+    /**
+     * Partially updates an entry: metadata keys in the patch are merged into the stored metadata, and data / ttlSeconds are replaced only when set.
+     * @param patch Entry with the ID to update and the fields to change.
+     * @return Response from the server indicating the result of the update operation, including the merged entry if successful.
+     * @throws IOException if there is an error sending the request or receiving the response.
+     */
+    public Response patch(Entry patch) throws IOException {
+        Request req = Request.newBuilder()
+                .setOp(OperationType.OP_UPDATE)
+                .setEntry(patch)
+                .setUpdateMode(UpdateMode.UPDATE_MERGE)
+                .build();
+        return sendWithReply(req);
+    }
+
     /**
      * Deletes an entry from RegistaDB by its ID, returning the server's response indicating the result of the delete operation.
      * @param id The ID of the entry to delete.
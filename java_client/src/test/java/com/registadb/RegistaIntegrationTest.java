@@ -10,6 +10,8 @@ import com.registadb.readers.EntryValueReader;
 import registadb.Playbook.Entry;
 import registadb.Playbook.EntryValue;
 import registadb.Playbook.OperationStatus;
+import registadb.Playbook.OperationType;
+import registadb.Playbook.Request;
 import registadb.Playbook.Response;
 
 import static org.junit.jupiter.api.Assertions.*;
@@ -368,6 +370,32 @@ public class RegistaIntegrationTest {
             assertNotEquals(old_content, EntryValueReader.read(newStoredValue), "Old Content should not match");
             assertEquals(new_content, EntryValueReader.read(newStoredValue), "New content should match.");
         }
+
+        @Test
+        @Order(10)
+        @DisplayName("Test pipelined requests")
+        void testPipelinedRequests() throws Exception {
+            List<Request> requests = new ArrayList<>();
+            for (int i = 0; i < 10; i++) {
+                Entry entry = new EntryBuilder()
+                        .setId(3000 + i)
+                        .setValue(EntryValueBuilder.ofString("pipelined " + i))
+                        .build();
+                requests.add(Request.newBuilder()
+                        .setOp(OperationType.OP_CREATE)
+                        .setEntry(entry)
+                        .build());
+            }
+
+            List<Response> responses = client.pipeline(requests);
+
+            assertEquals(requests.size(), responses.size(), "Every request should get a response");
+            for (int i = 0; i < responses.size(); i++) {
+                Response resp = responses.get(i);
+                assertEquals(OperationStatus.STATUS_OK, resp.getStatus(), "Pipelined create should succeed");
+                assertEquals(3000 + i, resp.getEntry().getId(), "Responses should be returned in request order");
+            }
+        }
     }
 
     @Nested
@@ -0,0 +1,108 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <google/protobuf/util/time_util.h>
+#include "StorageManager.h"
+
+/**
+ * @brief Opens a StorageManager on a fresh temporary directory and removes it again when done.
+ * 
+ */
+class TempStorage {
+public:
+    explicit TempStorage(const std::string& name, StorageConfig config = StorageConfig(), bool enable_stats = false)
+        : path_((std::filesystem::temp_directory_path() / ("regista_bench_" + name)).string()) {
+        std::filesystem::remove_all(path_);
+        storage_ = new StorageManager(path_, enable_stats, std::move(config));
+    }
+    ~TempStorage() {
+        delete storage_;
+        std::filesystem::remove_all(path_);
+    }
+    StorageManager& get() { return *storage_; }
+
+private:
+    std::string path_;
+    StorageManager* storage_;
+};
+
+/**
+ * @brief Builds a typical sensor reading, similar to what the Java Producer sends.
+ * 
+ */
+inline registadb::Entry MakeReading(uint64_t id) {
+    registadb::Entry entry;
+    entry.set_id(id);
+    (*entry.mutable_metadata())["source"] = "thermal_sensor";
+    (*entry.mutable_metadata())["location"] = "rack_4";
+    entry.mutable_data()->set_double_value(45.1 + static_cast<double>(id % 100));
+    entry.mutable_created_at()->CopyFrom(google::protobuf::util::TimeUtil::GetCurrentTime());
+    entry.mutable_updated_at()->CopyFrom(entry.created_at());
+    return entry;
+}
+
+/**
+ * @brief Fills entry.data with a value of the given type, sized to roughly size bytes for the variable-length types. Shared by the microbenchmarks and regista_loadgen.
+ * 
+ * @param entry The entry to fill.
+ * @param type One of double, int, string, bytes, string_list, json, double_list, int_list.
+ * @param size Payload size in bytes for string, bytes, string_list, json and the lists (ignored for double and int).
+ * @param rng Source of the generated values.
+ * @return true if the type is known.
+ */
+inline bool FillValue(registadb::Entry* entry, const std::string& type, size_t size, std::mt19937_64& rng) {
+    auto random_text = [&rng](size_t length) {
+        static const char kAlphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+        std::string text(length, ' ');
+        for (char& c : text) c = kAlphabet[rng() % (sizeof(kAlphabet) - 1)];
+        return text;
+    };
+    registadb::EntryValue* value = entry->mutable_data();
+    if (type == "double") {
+        value->set_double_value(static_cast<double>(rng() % 100000) / 100.0);
+    } else if (type == "int") {
+        value->set_int_value(static_cast<int64_t>(rng() % 1000000));
+    } else if (type == "string") {
+        value->set_string_value(random_text(size));
+    } else if (type == "bytes") {
+        std::string bytes(size, '\0');
+        for (char& b : bytes) b = static_cast<char>(rng());
+        value->set_bytes_value(std::move(bytes));
+    } else if (type == "string_list") {
+        // 16-byte items
+        auto* list = value->mutable_string_list();
+        for (size_t filled = 0; filled < std::max<size_t>(size, 1); filled += 16) list->add_value(random_text(16));
+    } else if (type == "json") {
+        // flat object of 16-byte string fields
+        auto* fields = value->mutable_json_value()->mutable_fields();
+        for (size_t i = 0; i * 24 < std::max<size_t>(size, 1); ++i) {
+            (*fields)["field_" + std::to_string(i)].set_string_value(random_text(16));
+        }
+    } else if (type == "double_list") {
+        // 8-byte items, a sensor series moving in 0.01 steps
+        auto* list = value->mutable_double_list();
+        int64_t hundredths = static_cast<int64_t>(rng() % 10000);
+        for (size_t filled = 0; filled < std::max<size_t>(size, 1); filled += 8) {
+            hundredths += static_cast<int64_t>(rng() % 5) - 2;
+            list->add_value(static_cast<double>(hundredths) / 100.0);
+        }
+    } else if (type == "int_list") {
+        // 8-byte items, millisecond timestamps about a second apart
+        auto* list = value->mutable_int_list();
+        int64_t ms = 1700000000000LL + static_cast<int64_t>(rng() % 1000000);
+        for (size_t filled = 0; filled < std::max<size_t>(size, 1); filled += 8) {
+            ms += 1000 + static_cast<int64_t>(rng() % 7) - 3;
+            list->add_value(ms);
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#endif
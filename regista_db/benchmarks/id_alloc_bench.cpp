@@ -0,0 +1,32 @@
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdint>
+#include "IdAllocator.h"
+
+// The previous allocator: every id is a fetch_add on one shared counter
+static void BM_NextIdGlobalAtomic(benchmark::State& state) {
+    static std::atomic<uint64_t> counter{0};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(++counter);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_NextIdGlobalAtomic)->ThreadRange(1, 16)->UseRealTime();
+
+// Block leasing: threads touch shared state once per state.range(0) ids
+static void BM_NextIdBlockLeasing(benchmark::State& state) {
+    static IdAllocator* allocator = nullptr;
+    if (state.thread_index() == 0) {
+        allocator = new IdAllocator(static_cast<uint64_t>(state.range(0)));
+        allocator->Reset(0);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(allocator->Next());
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        delete allocator;
+        allocator = nullptr;
+    }
+}
+BENCHMARK(BM_NextIdBlockLeasing)->Arg(64)->Arg(1024)->ThreadRange(1, 16)->UseRealTime();
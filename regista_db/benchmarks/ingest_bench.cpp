@@ -0,0 +1,178 @@
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zmq.hpp>
+#include "RegistaServer.h"
+#include "ShardedStorage.h"
+#include "bench_common.h"
+
+// globals main.cpp owns in the engine: the server loops run while keep_running is set, the REST controller is unused here
+std::atomic<bool> keep_running(true);
+RegistaServer* g_regista_server = nullptr;
+
+// Today's ingest path: one WriteBatch commit per message
+static void BM_StoreEntryPerMessage(benchmark::State& state) {
+    TempStorage db("per_message");
+    uint64_t id = 1;
+    for (auto _ : state) {
+        registadb::Entry entry = MakeReading(id++);
+        benchmark::DoNotOptimize(db.get().StoreEntry(entry));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StoreEntryPerMessage);
+
+// Group commit: state.range(0) entries per WriteBatch
+static void BM_StoreEntriesBatched(benchmark::State& state) {
+    TempStorage db("batched_" + std::to_string(state.range(0)));
+    const size_t batch_size = static_cast<size_t>(state.range(0));
+    std::vector<registadb::Entry> batch(batch_size);
+    uint64_t id = 1;
+    for (auto _ : state) {
+        for (auto& entry : batch) {
+            entry = MakeReading(id++);
+        }
+        benchmark::DoNotOptimize(db.get().StoreEntries(batch));
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_StoreEntriesBatched)->Arg(16)->Arg(64)->Arg(256)->Arg(512)->Arg(2048);
+
+// Group commit from several writer threads, like the ingest worker pool
+static void BM_StoreEntriesParallel(benchmark::State& state) {
+    static TempStorage* db = nullptr;
+    if (state.thread_index() == 0) {
+        db = new TempStorage("parallel");
+    }
+    const size_t batch_size = 256;
+    std::vector<registadb::Entry> batch(batch_size);
+    // disjoint id ranges per thread
+    uint64_t id = (static_cast<uint64_t>(state.thread_index()) << 40) + 1;
+    for (auto _ : state) {
+        for (auto& entry : batch) {
+            entry = MakeReading(id++);
+        }
+        benchmark::DoNotOptimize(db->get().StoreEntries(batch));
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size);
+    if (state.thread_index() == 0) {
+        delete db;
+        db = nullptr;
+    }
+}
+BENCHMARK(BM_StoreEntriesParallel)->ThreadRange(1, 8)->UseRealTime();
+
+// One verified write per iteration from several threads, range 0 = registadb::Durability (1 none, 2 async, 3 sync).
+// With sync, concurrent writers share WAL fsyncs, so throughput should grow with the thread count
+static void BM_StoreEntryDurability(benchmark::State& state) {
+    static TempStorage* db = nullptr;
+    const auto durability = static_cast<registadb::Durability>(state.range(0));
+    if (state.thread_index() == 0) {
+        db = new TempStorage("durability_" + std::to_string(state.range(0)));
+    }
+    uint64_t id = (static_cast<uint64_t>(state.thread_index()) << 40) + 1;
+    for (auto _ : state) {
+        registadb::Entry entry = MakeReading(id++);
+        benchmark::DoNotOptimize(db->get().StoreEntry(entry, durability));
+    }
+    state.SetLabel(registadb::Durability_Name(durability));
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        delete db;
+        db = nullptr;
+    }
+}
+BENCHMARK(BM_StoreEntryDurability)
+    ->Arg(registadb::DURABILITY_NONE)
+    ->Arg(registadb::DURABILITY_ASYNC)
+    ->Arg(registadb::DURABILITY_SYNC)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+// The same verified writes through a running server: each thread is a REQ client sending smart tunnel CREATEs and
+// checking every reply. range 0 = query durability, range 1 = query workers (0 = executed on the main poll loop)
+static void BM_ServerCreateDurability(benchmark::State& state) {
+    static TempStorage* db = nullptr;
+    static RegistaServer* server = nullptr;
+    static std::thread server_thread;
+    const auto durability = static_cast<registadb::Durability>(state.range(0));
+    // one port pair per argument combination; a later run rebinds it after the previous server closed
+    const int port = 15700 + 4 * static_cast<int>(state.range(0)) + (state.range(1) > 0 ? 2 : 0);
+    if (state.thread_index() == 0) {
+        db = new TempStorage("server_durability_" + std::to_string(state.range(0)) + "_" + std::to_string(state.range(1)));
+        ServerConfig config;
+        config.query_durability = durability;
+        config.query_workers = static_cast<size_t>(state.range(1));
+        server = new RegistaServer(db->get(), port, port + 1, config);
+        server_thread = std::thread([]() { server->Run(); });
+    }
+
+    zmq::context_t ctx(1);
+    zmq::socket_t req(ctx, zmq::socket_type::req);
+    req.set(zmq::sockopt::rcvtimeo, 5000);
+    req.set(zmq::sockopt::linger, 0);
+    req.connect("tcp://localhost:" + std::to_string(port + 1));
+
+    registadb::Request request;
+    request.set_op(registadb::OP_CREATE);
+    registadb::Response response;
+    std::string body;
+    uint64_t id = (static_cast<uint64_t>(state.thread_index()) << 40) + 1;
+    for (auto _ : state) {
+        *request.mutable_entry() = MakeReading(id++);
+        request.SerializeToString(&body);
+        req.send(zmq::buffer(body), zmq::send_flags::none);
+        zmq::message_t reply;
+        if (!req.recv(reply) || !response.ParseFromArray(reply.data(), static_cast<int>(reply.size())) ||
+            response.status() != registadb::STATUS_OK) {
+            state.SkipWithError("CREATE failed or timed out");
+            break;
+        }
+    }
+    state.SetLabel(registadb::Durability_Name(durability) + (state.range(1) > 0 ? " workers" : " inline"));
+    state.SetItemsProcessed(state.iterations());
+    req.close();
+    if (state.thread_index() == 0) {
+        server->Stop();
+        server_thread.join();
+        delete server;
+        server = nullptr;
+        delete db;
+        db = nullptr;
+    }
+}
+BENCHMARK(BM_ServerCreateDurability)
+    ->ArgsProduct({{registadb::DURABILITY_ASYNC, registadb::DURABILITY_SYNC}, {0, ServerConfig::kDefaultQueryWorkers}})
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+// Group commit from 8 writer threads over range(0) RocksDB shards, each with its own WAL and write queue
+static void BM_ShardedIngest(benchmark::State& state) {
+    static ShardedStorage* db = nullptr;
+    static std::string path;
+    if (state.thread_index() == 0) {
+        path = (std::filesystem::temp_directory_path() / ("regista_bench_shards_" + std::to_string(state.range(0)))).string();
+        std::filesystem::remove_all(path);
+        StorageConfig config;
+        config.shards = static_cast<size_t>(state.range(0));
+        db = new ShardedStorage(path, false, config);
+    }
+    const size_t batch_size = 256;
+    std::vector<registadb::Entry> batch(batch_size);
+    uint64_t id = (static_cast<uint64_t>(state.thread_index()) << 40) + 1;
+    for (auto _ : state) {
+        for (auto& entry : batch) {
+            entry = MakeReading(id++);
+        }
+        benchmark::DoNotOptimize(db->StoreEntries(batch));
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size);
+    if (state.thread_index() == 0) {
+        delete db;
+        db = nullptr;
+        std::filesystem::remove_all(path);
+    }
+}
+BENCHMARK(BM_ShardedIngest)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Threads(8)->UseRealTime();
@@ -0,0 +1,440 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cpr/cpr.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zmq.hpp>
+#include "bench_common.h"
+#include "playbook.pb.h"
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// Command line options, see print_usage
+struct LoadOptions {
+    std::string target = "req";         // push, req or rest
+    std::string op = "create";          // create or read
+    std::string mode = "closed";        // closed or open loop
+    std::string host = "127.0.0.1";
+    int push_port = 5555;
+    int req_port = 5556;
+    int rest_port = 8081;
+    size_t concurrency = 4;
+    double rate = 1000;                 // open loop: total requests per second
+    double duration_s = 10;
+    double warmup_s = 1;
+    size_t preload = 10000;             // entries created before a read run
+    std::string value_type = "double";
+    size_t value_size = 64;
+    std::string output;                 // JSON report, empty = stdout
+    std::string engine = "./registadb_engine";
+    bool spawn_engine = true;           // start the engine on a temp DB directory
+};
+
+// What one worker measured after warmup
+struct WorkerResult {
+    std::vector<uint64_t> latencies_ns;
+    uint64_t errors = 0;
+};
+
+/**
+ * @brief Prints the command line usage.
+ */
+void print_usage() {
+    std::cerr << "Usage: regista_loadgen [options]\n"
+              << "  --target push|req|rest   tunnel to drive (default req)\n"
+              << "  --op create|read         read preloads --preload entries first (not with push)\n"
+              << "  --mode closed|open       closed: each worker sends as soon as its last request finished\n"
+              << "                           open: --rate requests/s in total, latency counted from the scheduled send time\n"
+              << "  --concurrency N --rate R --duration-s S --warmup-s S --preload N\n"
+              << "  --value-type double|int|string|bytes|string_list|json|double_list|int_list --value-size BYTES\n"
+              << "  --host H --push-port P --req-port P --rest-port P\n"
+              << "  --engine PATH            engine binary started on a temp DB directory (default ./registadb_engine)\n"
+              << "  --external               use an engine that is already running instead\n"
+              << "  --output FILE            JSON report (default stdout)" << std::endl;
+}
+
+/**
+ * @brief Fills the options from the command line.
+ *
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @param opts Output options.
+ * @return true if the arguments are valid.
+ * @return false otherwise.
+ */
+bool parse_options(int argc, char* argv[], LoadOptions* opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--target" && has_value) opts->target = argv[++i];
+        else if (arg == "--op" && has_value) opts->op = argv[++i];
+        else if (arg == "--mode" && has_value) opts->mode = argv[++i];
+        else if (arg == "--host" && has_value) opts->host = argv[++i];
+        else if (arg == "--push-port" && has_value) opts->push_port = std::stoi(argv[++i]);
+        else if (arg == "--req-port" && has_value) opts->req_port = std::stoi(argv[++i]);
+        else if (arg == "--rest-port" && has_value) opts->rest_port = std::stoi(argv[++i]);
+        else if (arg == "--concurrency" && has_value) opts->concurrency = std::max<size_t>(std::stoul(argv[++i]), 1);
+        else if (arg == "--rate" && has_value) opts->rate = std::stod(argv[++i]);
+        else if (arg == "--duration-s" && has_value) opts->duration_s = std::stod(argv[++i]);
+        else if (arg == "--warmup-s" && has_value) opts->warmup_s = std::stod(argv[++i]);
+        else if (arg == "--preload" && has_value) opts->preload = std::max<size_t>(std::stoul(argv[++i]), 1);
+        else if (arg == "--value-type" && has_value) opts->value_type = argv[++i];
+        else if (arg == "--value-size" && has_value) opts->value_size = std::stoul(argv[++i]);
+        else if (arg == "--output" && has_value) opts->output = argv[++i];
+        else if (arg == "--engine" && has_value) opts->engine = argv[++i];
+        else if (arg == "--external") opts->spawn_engine = false;
+        else {
+            std::cerr << "Unknown argument '" << arg << "'" << std::endl;
+            return false;
+        }
+    }
+    registadb::Entry probe;
+    std::mt19937_64 rng(0);
+    if (!FillValue(&probe, opts->value_type, 1, rng)) {
+        std::cerr << "Unknown value type '" << opts->value_type << "'" << std::endl;
+        return false;
+    }
+    return (opts->target == "push" || opts->target == "req" || opts->target == "rest")
+        && (opts->op == "create" || (opts->op == "read" && opts->target != "push"))
+        && (opts->mode == "closed" || (opts->mode == "open" && opts->rate > 0));
+}
+
+/**
+ * @brief Starts the engine on a fresh temp DB directory and stops it (and removes the directory) when destroyed, like the REST integration tests do.
+ *
+ */
+class EngineProcess {
+public:
+    EngineProcess(const LoadOptions& opts)
+        : path_((fs::temp_directory_path() / ("regista_loadgen_" + std::to_string(getpid()))).string()) {
+        fs::remove_all(path_);
+        pid_ = fork();
+        if (pid_ == 0) {
+            int fd = open((path_ + ".log").c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd != -1) {
+                dup2(fd, STDOUT_FILENO);
+                dup2(fd, STDERR_FILENO);
+                close(fd);
+            }
+            execl(opts.engine.c_str(), opts.engine.c_str(), "--path", path_.c_str(), static_cast<char*>(nullptr));
+            perror("execl failed");
+            _exit(1);
+        }
+        // the REST listener is the last thing the engine starts
+        std::string url = "http://" + opts.host + ":" + std::to_string(opts.rest_port) + "/entries?limit=1";
+        for (int i = 0; i < 40 && !ready_; ++i) {
+            ready_ = cpr::Get(cpr::Url{url}).status_code > 0;
+            if (!ready_) std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        }
+    }
+    ~EngineProcess() {
+        if (pid_ > 0) {
+            // graceful shutdown first, killed if it takes longer than 10 s
+            kill(pid_, SIGINT);
+            int status;
+            for (int i = 0; i < 100 && waitpid(pid_, &status, WNOHANG) == 0; ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            if (waitpid(pid_, &status, WNOHANG) == 0) {
+                kill(pid_, SIGKILL);
+                waitpid(pid_, &status, 0);
+            }
+        }
+        fs::remove_all(path_);
+        // the log is kept when the engine never came up
+        if (ready_) fs::remove(path_ + ".log");
+    }
+    bool ready() const { return ready_; }
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    pid_t pid_ = -1;
+    bool ready_ = false;
+};
+
+/**
+ * @brief One client connection on the chosen tunnel. Each worker thread owns one.
+ *
+ */
+class Client {
+public:
+    Client(const LoadOptions& opts, zmq::context_t& context) : opts_(opts) {
+        if (opts.target == "push") {
+            socket_ = zmq::socket_t(context, zmq::socket_type::push);
+            socket_.connect("tcp://" + opts.host + ":" + std::to_string(opts.push_port));
+        } else if (opts.target == "req") {
+            socket_ = zmq::socket_t(context, zmq::socket_type::req);
+            socket_.connect("tcp://" + opts.host + ":" + std::to_string(opts.req_port));
+        } else {
+            rest_base_ = "http://" + opts.host + ":" + std::to_string(opts.rest_port) + "/entries";
+            session_.SetHeader(cpr::Header{{"Content-Type", "application/x-protobuf"}, {"Accept", "application/x-protobuf"}});
+        }
+    }
+
+    /**
+     * @brief Creates an entry. PUSH has no reply, so it only measures the send.
+     *
+     * @param entry The entry to send, id 0 lets the server assign one.
+     * @param out_id Output for the created id (REQ and REST), may be nullptr.
+     * @return true if the request succeeded.
+     */
+    bool Create(const registadb::Entry& entry, uint64_t* out_id) {
+        if (opts_.target == "push") {
+            entry.SerializeToString(&buffer_);
+            return socket_.send(zmq::buffer(buffer_), zmq::send_flags::none).has_value();
+        }
+        if (opts_.target == "req") {
+            registadb::Request req;
+            req.set_op(registadb::OP_CREATE);
+            *req.mutable_entry() = entry;
+            registadb::Response resp;
+            if (!Call(req, &resp)) return false;
+            if (out_id) *out_id = resp.entry().id();
+            return true;
+        }
+        entry.SerializeToString(&buffer_);
+        session_.SetUrl(cpr::Url{rest_base_});
+        session_.SetBody(cpr::Body{buffer_});
+        cpr::Response r = session_.Post();
+        if (r.status_code != 201) return false;
+        registadb::Entry created;
+        if (out_id && created.ParseFromString(r.text)) *out_id = created.id();
+        return true;
+    }
+
+    /**
+     * @brief Reads an entry by id.
+     *
+     * @param id The id to read.
+     * @return true if the entry was found.
+     */
+    bool Read(uint64_t id) {
+        if (opts_.target == "req") {
+            registadb::Request req;
+            req.set_op(registadb::OP_READ);
+            req.set_id(id);
+            registadb::Response resp;
+            return Call(req, &resp);
+        }
+        session_.SetUrl(cpr::Url{rest_base_ + "/" + std::to_string(id)});
+        return session_.Get().status_code == 200;
+    }
+
+private:
+    /**
+     * @brief Sends one Request over REQ and waits for its Response.
+     *
+     * @param req The request.
+     * @param resp Output for the response.
+     * @return true if a reply arrived with STATUS_OK.
+     */
+    bool Call(const registadb::Request& req, registadb::Response* resp) {
+        req.SerializeToString(&buffer_);
+        if (!socket_.send(zmq::buffer(buffer_), zmq::send_flags::none)) return false;
+        zmq::message_t reply;
+        if (!socket_.recv(reply, zmq::recv_flags::none)) return false;
+        return resp->ParseFromArray(reply.data(), static_cast<int>(reply.size()))
+            && resp->status() == registadb::STATUS_OK;
+    }
+
+    const LoadOptions& opts_;
+    zmq::socket_t socket_;
+    cpr::Session session_;
+    std::string rest_base_;
+    std::string buffer_;
+};
+
+/**
+ * @brief Creates the entries a read run picks from, split across the workers' tunnel.
+ *
+ * @param opts The load options.
+ * @param context The ZMQ context.
+ * @return std::vector<uint64_t> The created ids.
+ */
+std::vector<uint64_t> preload_entries(const LoadOptions& opts, zmq::context_t& context) {
+    std::vector<uint64_t> ids;
+    std::mutex ids_mutex;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < opts.concurrency; ++t) {
+        threads.emplace_back([&, t]() {
+            Client client(opts, context);
+            std::mt19937_64 rng(1000 + t);
+            std::vector<uint64_t> local;
+            for (size_t i = t; i < opts.preload; i += opts.concurrency) {
+                registadb::Entry entry = MakeReading(0);
+                FillValue(&entry, opts.value_type, opts.value_size, rng);
+                uint64_t id = 0;
+                if (client.Create(entry, &id) && id != 0) local.push_back(id);
+            }
+            std::lock_guard<std::mutex> lock(ids_mutex);
+            ids.insert(ids.end(), local.begin(), local.end());
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    return ids;
+}
+
+/**
+ * @brief Runs one worker until the end of the run. Closed loop sends back to back; open loop sends on a fixed schedule and measures from the scheduled time, so a slow server shows up as latency instead of a lower send rate.
+ *
+ * @param opts The load options.
+ * @param context The ZMQ context.
+ * @param index The worker index.
+ * @param ids Ids to read (read runs only).
+ * @param measure_from Start of the measured window (end of warmup).
+ * @param end End of the run.
+ * @return WorkerResult The measured latencies and error count.
+ */
+WorkerResult run_worker(const LoadOptions& opts, zmq::context_t& context, size_t index, const std::vector<uint64_t>& ids,
+                        Clock::time_point measure_from, Clock::time_point end) {
+    WorkerResult result;
+    Client client(opts, context);
+    std::mt19937_64 rng(index + 1);
+    registadb::Entry entry = MakeReading(0);
+    FillValue(&entry, opts.value_type, opts.value_size, rng);
+
+    const bool open_loop = opts.mode == "open";
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(opts.concurrency) / opts.rate));
+    // stagger the workers' schedules across one interval
+    Clock::time_point next_send = Clock::now() + interval * index / opts.concurrency;
+
+    while (true) {
+        Clock::time_point start;
+        if (open_loop) {
+            if (next_send >= end) break;
+            std::this_thread::sleep_until(next_send);
+            start = next_send;
+            next_send += interval;
+        } else {
+            start = Clock::now();
+            if (start >= end) break;
+        }
+
+        bool ok = opts.op == "read" ? client.Read(ids[rng() % ids.size()]) : client.Create(entry, nullptr);
+        Clock::time_point done = Clock::now();
+        if (start < measure_from) continue;
+        if (ok) {
+            result.latencies_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(done - start).count());
+        } else {
+            result.errors++;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Returns a quantile of sorted latencies.
+ *
+ * @param sorted Latencies in nanoseconds, ascending.
+ * @param q The quantile, 0 to 1.
+ * @return double The latency at q in microseconds, 0 when there are none.
+ */
+double percentile_us(const std::vector<uint64_t>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(q * static_cast<double>(sorted.size())));
+    return static_cast<double>(sorted[index]) / 1000.0;
+}
+
+}
+
+/**
+ * @brief Entry point for regista_loadgen: drives the PUSH, REQ or REST endpoint and reports throughput and latency percentiles as JSON.
+ *
+ * @return int Exit status code.
+ */
+int main(int argc, char* argv[]) {
+    LoadOptions opts;
+    if (!parse_options(argc, argv, &opts)) {
+        print_usage();
+        return 2;
+    }
+
+    std::unique_ptr<EngineProcess> engine;
+    if (opts.spawn_engine) {
+        engine.reset(new EngineProcess(opts));
+        if (!engine->ready()) {
+            std::cerr << "Engine did not start, see " << engine->path() << ".log" << std::endl;
+            return 1;
+        }
+    }
+
+    zmq::context_t context(1);
+    std::vector<uint64_t> ids;
+    if (opts.op == "read") {
+        ids = preload_entries(opts, context);
+        if (ids.empty()) {
+            std::cerr << "Preload created no entries" << std::endl;
+            return 1;
+        }
+    }
+
+    const auto start = Clock::now();
+    const auto measure_from = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opts.warmup_s));
+    const auto end = measure_from + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opts.duration_s));
+
+    std::vector<WorkerResult> results(opts.concurrency);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < opts.concurrency; ++i) {
+        workers.emplace_back([&, i]() { results[i] = run_worker(opts, context, i, ids, measure_from, end); });
+    }
+    for (auto& worker : workers) worker.join();
+
+    std::vector<uint64_t> latencies;
+    uint64_t errors = 0;
+    for (auto& result : results) {
+        latencies.insert(latencies.end(), result.latencies_ns.begin(), result.latencies_ns.end());
+        errors += result.errors;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double mean_us = 0;
+    for (uint64_t ns : latencies) mean_us += static_cast<double>(ns) / 1000.0;
+    if (!latencies.empty()) mean_us /= static_cast<double>(latencies.size());
+
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"target\": \"" << opts.target << "\",\n"
+         << "  \"op\": \"" << opts.op << "\",\n"
+         << "  \"mode\": \"" << opts.mode << "\",\n"
+         << "  \"concurrency\": " << opts.concurrency << ",\n"
+         << "  \"rate\": " << (opts.mode == "open" ? opts.rate : 0) << ",\n"
+         << "  \"value_type\": \"" << opts.value_type << "\",\n"
+         << "  \"value_size\": " << opts.value_size << ",\n"
+         << "  \"duration_s\": " << opts.duration_s << ",\n"
+         << "  \"requests\": " << latencies.size() << ",\n"
+         << "  \"errors\": " << errors << ",\n"
+         << "  \"throughput_rps\": " << static_cast<double>(latencies.size()) / opts.duration_s << ",\n"
+         << "  \"latency_measures\": \"" << (opts.target == "push" ? "send" : "round_trip") << "\",\n"
+         << "  \"latency_us\": {"
+         << "\"mean\": " << mean_us
+         << ", \"p50\": " << percentile_us(latencies, 0.50)
+         << ", \"p99\": " << percentile_us(latencies, 0.99)
+         << ", \"p999\": " << percentile_us(latencies, 0.999)
+         << ", \"max\": " << (latencies.empty() ? 0 : static_cast<double>(latencies.back()) / 1000.0) << "}\n"
+         << "}\n";
+
+    if (opts.output.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream(opts.output) << json.str();
+        std::cerr << "Report written to " << opts.output << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <google/protobuf/util/time_util.h>
+#include "RequestArena.h"
+#include "playbook.pb.h"
+
+// Counts heap allocations made by the calling thread, so a benchmark can report allocations per request.
+// Replacing operator new applies to the whole regista_bench binary; the per-thread counter costs next to nothing
+namespace {
+thread_local uint64_t tl_allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    tl_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+/**
+ * @brief Serialized CREATE request shaped like what the Java Producer sends.
+ * 
+ */
+static std::string MakeCreateRequest() {
+    registadb::Request req;
+    req.set_op(registadb::OP_CREATE);
+    req.set_correlation_id(42);
+    registadb::Entry* entry = req.mutable_entry();
+    (*entry->mutable_metadata())["source"] = "thermal_sensor_with_a_longer_name";
+    (*entry->mutable_metadata())["location"] = "datacenter_1_rack_4_slot_12";
+    entry->mutable_data()->set_string_value(std::string(200, 'x'));
+    return req.SerializeAsString();
+}
+
+/**
+ * @brief Stamps an entry the way PrepareEntry does.
+ * 
+ */
+static void Stamp(registadb::Entry* entry, uint64_t id) {
+    google::protobuf::Timestamp now = google::protobuf::util::TimeUtil::GetCurrentTime();
+    entry->mutable_created_at()->CopyFrom(now);
+    entry->mutable_updated_at()->CopyFrom(now);
+    entry->set_id(id);
+}
+
+// Previous request path: body copied into a string, heap messages, entry deep-copied twice, reply built in a string
+static void BM_CreateRequestHeapCopy(benchmark::State& state) {
+    const std::string body = MakeCreateRequest();
+    uint64_t id = 1;
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        uint64_t before = tl_allocations;
+        registadb::Request req;
+        req.ParseFromString(std::string(body));
+        registadb::Entry entry = req.entry();
+        Stamp(&entry, id++);
+        registadb::Response resp;
+        resp.set_correlation_id(req.correlation_id());
+        resp.set_status(registadb::STATUS_OK);
+        resp.mutable_entry()->CopyFrom(entry);
+        std::string reply = resp.SerializeAsString();
+        benchmark::DoNotOptimize(reply.data());
+        allocations += tl_allocations - before;
+    }
+    state.counters["allocs_per_request"] = benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_CreateRequestHeapCopy);
+
+// Current request path: messages on the thread's RequestArena, entry prepared in place and swapped into the reply,
+// reply serialized straight into a reused frame buffer
+static void BM_CreateRequestArena(benchmark::State& state) {
+    const std::string body = MakeCreateRequest();
+    std::string frame(4096, '\0');
+    uint64_t id = 1;
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        uint64_t before = tl_allocations;
+        {
+            RequestArena arena;
+            registadb::Request* req = arena.Create<registadb::Request>();
+            req->ParseFromArray(body.data(), static_cast<int>(body.size()));
+            Stamp(req->mutable_entry(), id++);
+            registadb::Response* resp = arena.Create<registadb::Response>();
+            resp->set_correlation_id(req->correlation_id());
+            resp->set_status(registadb::STATUS_OK);
+            resp->mutable_entry()->Swap(req->mutable_entry());
+            size_t size = resp->ByteSizeLong();
+            if (size > frame.size()) frame.resize(size);
+            resp->SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(&frame[0]));
+            benchmark::DoNotOptimize(frame.data());
+        }
+        allocations += tl_allocations - before;
+    }
+    state.counters["allocs_per_request"] = benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_CreateRequestArena);
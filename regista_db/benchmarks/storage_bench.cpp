@@ -0,0 +1,266 @@
+#include <benchmark/benchmark.h>
+#include <rocksdb/statistics.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "EntryCodec.h"
+#include "ShardedStorage.h"
+#include "bench_common.h"
+
+// value types by benchmark argument index
+static const char* const kValueTypes[] = {"double", "int", "string", "bytes", "string_list", "json"};
+
+static void ValueArgs(benchmark::internal::Benchmark* b) {
+    b->Args({0, 0})->Args({1, 0});
+    for (int type = 2; type < 6; ++type) {
+        for (int size : {64, 1024, 16384}) b->Args({type, size});
+    }
+}
+
+// Key encoding on the write path
+static void BM_EncodeCompositeKey(benchmark::State& state) {
+    TempStorage db("encode_composite");
+    uint64_t id = 1;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.get().EncodeCompositeKey(1700000000000000ULL + id, id));
+        ++id;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EncodeCompositeKey);
+
+static void BM_DecodeCompositeKey(benchmark::State& state) {
+    TempStorage db("decode_composite");
+    std::string key = db.get().EncodeCompositeKey(1700000000000000ULL, 42);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.get().DecodeCompositeKey(key.data()));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodeCompositeKey);
+
+static void BM_EncodeIndexKey(benchmark::State& state) {
+    TempStorage db("encode_index");
+    uint64_t id = 1;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.get().EncodeIndexKey(id++));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EncodeIndexKey);
+
+static void BM_DecodeIndexKey(benchmark::State& state) {
+    TempStorage db("decode_index");
+    std::string key = db.get().EncodeIndexKey(42);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.get().DecodeIndexKey(key.data()));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodeIndexKey);
+
+// One StoreEntry per iteration, by value type (range 0) and payload size (range 1)
+static void BM_StoreEntryValue(benchmark::State& state) {
+    const std::string type = kValueTypes[state.range(0)];
+    TempStorage db("store_" + type);
+    std::mt19937_64 rng(42);
+    registadb::Entry entry = MakeReading(1);
+    FillValue(&entry, type, static_cast<size_t>(state.range(1)), rng);
+    const size_t bytes = entry.ByteSizeLong();
+
+    uint64_t id = 1;
+    for (auto _ : state) {
+        entry.set_id(id++);
+        benchmark::DoNotOptimize(db.get().StoreEntry(entry));
+    }
+    state.SetLabel(type);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_StoreEntryValue)->Apply(ValueArgs);
+
+// Random point reads over a prefilled store, range 0 = entry cache size in MiB (0 = off)
+static void BM_GetEntryById(benchmark::State& state) {
+    StorageConfig config;
+    config.entry_cache_bytes = static_cast<size_t>(state.range(0)) * 1024 * 1024;
+    TempStorage db("get_" + std::to_string(state.range(0)), config);
+
+    const uint64_t count = 100000;
+    std::vector<registadb::Entry> batch;
+    for (uint64_t id = 1; id <= count; ++id) {
+        batch.push_back(MakeReading(id));
+        if (batch.size() == 1000) {
+            db.get().StoreEntries(batch);
+            batch.clear();
+        }
+    }
+
+    std::mt19937_64 rng(7);
+    registadb::Entry out;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.get().GetEntryById(static_cast<int64_t>(rng() % count + 1), &out));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetEntryById)->Arg(0)->Arg(64);
+
+// Serialize + parse of one Entry, by value type and payload size
+static void BM_EntryRoundTrip(benchmark::State& state) {
+    const std::string type = kValueTypes[state.range(0)];
+    std::mt19937_64 rng(42);
+    registadb::Entry entry = MakeReading(1);
+    FillValue(&entry, type, static_cast<size_t>(state.range(1)), rng);
+
+    std::string wire;
+    registadb::Entry parsed;
+    for (auto _ : state) {
+        entry.SerializeToString(&wire);
+        benchmark::DoNotOptimize(parsed.ParseFromString(wire));
+    }
+    state.SetLabel(type);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * wire.size());
+}
+BENCHMARK(BM_EntryRoundTrip)->Apply(ValueArgs);
+
+// Decode of one stored numeric list, range 0 = double_list / int_list, range 1 = protobuf (0) or columnar (1), range 2 = list bytes (128 = 16 values, 1024 = 128 values)
+static void BM_DecodeStoredList(benchmark::State& state) {
+    const std::string type = state.range(0) == 0 ? "double_list" : "int_list";
+    std::mt19937_64 rng(42);
+    registadb::Entry entry = MakeReading(1);
+    FillValue(&entry, type, static_cast<size_t>(state.range(2)), rng);
+    const size_t values = type == "double_list" ? entry.data().double_list().value_size() : entry.data().int_list().value_size();
+
+    std::string stored;
+    EncodeStoredEntry(entry, state.range(1) == 1, &stored);
+    registadb::Entry decoded;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(DecodeStoredEntry(stored, &decoded));
+    }
+    state.SetLabel(type + (state.range(1) == 1 ? " columnar" : " protobuf"));
+    state.counters["bytes_per_value"] = static_cast<double>(stored.size()) / static_cast<double>(values);
+    state.SetItemsProcessed(state.iterations() * values);
+    state.SetBytesProcessed(state.iterations() * values * 8);
+}
+BENCHMARK(BM_DecodeStoredList)->ArgsProduct({{0, 1}, {0, 1}, {128, 512, 1024, 65536}});
+
+// Encode of the same lists for data_cf
+static void BM_EncodeStoredList(benchmark::State& state) {
+    const std::string type = state.range(0) == 0 ? "double_list" : "int_list";
+    std::mt19937_64 rng(42);
+    registadb::Entry entry = MakeReading(1);
+    FillValue(&entry, type, static_cast<size_t>(state.range(2)), rng);
+    const size_t values = type == "double_list" ? entry.data().double_list().value_size() : entry.data().int_list().value_size();
+
+    std::string stored;
+    for (auto _ : state) {
+        EncodeStoredEntry(entry, state.range(1) == 1, &stored);
+        benchmark::DoNotOptimize(stored.data());
+    }
+    state.SetLabel(type + (state.range(1) == 1 ? " columnar" : " protobuf"));
+    state.counters["bytes_per_value"] = static_cast<double>(stored.size()) / static_cast<double>(values);
+    state.SetItemsProcessed(state.iterations() * values);
+    state.SetBytesProcessed(state.iterations() * values * 8);
+}
+BENCHMARK(BM_EncodeStoredList)->ArgsProduct({{0, 1}, {0, 1}, {128, 512, 1024, 65536}});
+
+// One 100-entry scan page over a prefilled store split into range(0) shards (k-way merge cost)
+static void BM_ShardedScanPage(benchmark::State& state) {
+    const std::string path = (std::filesystem::temp_directory_path() / ("regista_bench_scan_" + std::to_string(state.range(0)))).string();
+    std::filesystem::remove_all(path);
+    {
+        StorageConfig config;
+        config.shards = static_cast<size_t>(state.range(0));
+        ShardedStorage db(path, false, config);
+
+        std::vector<registadb::Entry> batch;
+        for (uint64_t id = 1; id <= 100000; ++id) {
+            batch.push_back(MakeReading(id));
+            if (batch.size() == 1000) {
+                db.StoreEntries(batch);
+                batch.clear();
+            }
+        }
+
+        std::vector<registadb::Entry> page;
+        std::string next_cursor;
+        for (auto _ : state) {
+            page.clear();
+            benchmark::DoNotOptimize(db.ScanRange(0, UINT64_MAX, 100, "", &page, &next_cursor));
+        }
+        state.SetItemsProcessed(state.iterations() * 100);
+    }
+    std::filesystem::remove_all(path);
+}
+BENCHMARK(BM_ShardedScanPage)->Arg(1)->Arg(4)->Arg(8);
+
+// Mixed payloads (9 small readings per 16 KiB bytes value), written twice and then fully compacted, with value
+// separation off (range 0 = 0) or on for values >= 4 KiB (1). Reports write amplification and blob GC relocation
+static void BM_MixedPayloadWriteAmp(benchmark::State& state) {
+    for (auto _ : state) {
+        StorageConfig config;
+        config.blob_min_bytes = state.range(0) == 1 ? 4096 : 0;
+        config.blob_gc_age_cutoff = 1.0; // the final compaction relocates every live blob
+        TempStorage db("write_amp_" + std::to_string(state.range(0)), config, true);
+        std::mt19937_64 rng(42);
+
+        std::vector<registadb::Entry> batch;
+        for (int pass = 0; pass < 2; ++pass) {
+            for (uint64_t id = 1; id <= 20000; ++id) {
+                registadb::Entry entry = MakeReading(id);
+                if (id % 10 == 0) FillValue(&entry, "bytes", 16384, rng);
+                batch.push_back(std::move(entry));
+                if (batch.size() == 500) {
+                    db.get().StoreEntries(batch);
+                    batch.clear();
+                }
+            }
+        }
+        db.get().CompactDataCF();
+
+        auto stats = db.get().GetStats();
+        const double user = static_cast<double>(stats->getTickerCount(rocksdb::Tickers::BYTES_WRITTEN));
+        const double background = static_cast<double>(stats->getTickerCount(rocksdb::Tickers::FLUSH_WRITE_BYTES)
+                                                      + stats->getTickerCount(rocksdb::Tickers::COMPACT_WRITE_BYTES));
+        state.counters["write_amp"] = background / user;
+        state.counters["compact_write_mib"] = stats->getTickerCount(rocksdb::Tickers::COMPACT_WRITE_BYTES) / 1048576.0;
+        state.counters["blob_gc_relocated_mib"] = stats->getTickerCount(rocksdb::Tickers::BLOB_DB_GC_BYTES_RELOCATED) / 1048576.0;
+        state.counters["blob_mib"] = db.get().GetBlobUsage().bytes / 1048576.0;
+    }
+    state.SetLabel(state.range(0) == 1 ? "blob files" : "inline");
+}
+BENCHMARK(BM_MixedPayloadWriteAmp)->Arg(0)->Arg(1)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+// Per-minute buckets over a 100k-entry range computed in the engine (range 0 = 1), against reading the same range out page by page (0)
+static void BM_Aggregate(benchmark::State& state) {
+    TempStorage db("aggregate_" + std::to_string(state.range(0)));
+    const uint64_t count = 100000;
+    std::vector<registadb::Entry> batch;
+    for (uint64_t id = 1; id <= count; ++id) {
+        batch.push_back(MakeReading(id));
+        if (batch.size() == 1000) {
+            db.get().StoreEntries(batch);
+            batch.clear();
+        }
+    }
+
+    for (auto _ : state) {
+        if (state.range(0) == 1) {
+            SeriesAggregator aggregator(0, 60 * 1000000ULL, 100000);
+            benchmark::DoNotOptimize(db.get().Aggregate(0, UINT64_MAX, "", "", &aggregator));
+        } else {
+            std::vector<registadb::Entry> page;
+            std::string cursor;
+            std::string next_cursor;
+            do {
+                page.clear();
+                db.get().ScanRange(0, UINT64_MAX, 1000, cursor, &page, &next_cursor);
+                benchmark::DoNotOptimize(page.data());
+                cursor = next_cursor;
+            } while (!cursor.empty());
+        }
+    }
+    state.SetLabel(state.range(0) == 1 ? "aggregate" : "scan");
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_Aggregate)->Arg(0)->Arg(1);
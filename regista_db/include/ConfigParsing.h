@@ -0,0 +1,22 @@
+#ifndef CONFIG_PARSING_H
+#define CONFIG_PARSING_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Parsers for env vars and CLI flags, shared by registadb_engine and registadb_tool. The numeric ones take the whole
+// text as the number: on anything else they print a [Config] error naming the option and return false
+std::vector<std::string> parse_string_list(const std::string& list);
+bool parse_ttl_map(const std::string& name, const std::string& list, std::map<std::string, uint64_t>* out);
+bool parse_core_list(const std::string& name, const std::string& list, std::vector<int>* out);
+
+// scale multiplies the value (e.g. MB to bytes), a product past the type's range is an error too
+bool parse_option(const std::string& name, const std::string& text, uint64_t* out, uint64_t scale = 1);
+bool parse_option(const std::string& name, const std::string& text, unsigned* out);
+bool parse_option(const std::string& name, const std::string& text, double* out);
+bool parse_option(const std::string& name, const std::string& text, std::chrono::microseconds* out);
+
+#endif
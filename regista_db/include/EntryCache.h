@@ -0,0 +1,69 @@
+#ifndef ENTRY_CACHE_H
+#define ENTRY_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * @brief Totals across every shard of an EntryCache.
+ * 
+ */
+struct EntryCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+};
+
+/**
+ * @brief Size-bounded LRU cache of serialized entries keyed by id. Ids are spread over independently locked shards so concurrent readers rarely contend.
+ * 
+ * A miss registers the id as pending; the caller must then call Fill (with the value, or nullptr when the id was not found). Invalidate marks pending ids so a fill that read the store before a concurrent write never caches the stale value.
+ */
+class EntryCache {
+public:
+    EntryCache(size_t capacity_bytes, size_t shard_count = 16);
+
+    // true and copies the value on a hit, on a miss the id is pending until Fill is called
+    bool Get(uint64_t id, std::string* out_value);
+
+    // completes a miss, caches value unless the id was invalidated in the meantime
+    void Fill(uint64_t id, const std::string* value);
+
+    // drops the id, call after every write or delete of that id has committed
+    void Invalidate(uint64_t id);
+
+    EntryCacheStats GetStats() const;
+
+private:
+    struct Pending {
+        int readers = 0;
+        bool invalidated = false;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<std::pair<uint64_t, std::string>> lru; // front = most recently used
+        std::unordered_map<uint64_t, std::list<std::pair<uint64_t, std::string>>::iterator> map;
+        std::unordered_map<uint64_t, Pending> pending;
+        size_t bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    Shard& ShardFor(uint64_t id);
+    static size_t Charge(const std::string& value);
+
+    std::unique_ptr<Shard[]> shards_;
+    size_t shard_mask_;
+    size_t shard_capacity_;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef ENTRY_CODEC_H
+#define ENTRY_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "playbook.pb.h"
+
+// data_cf values are a serialized Entry, or with columnar lists on, for a double_list / int_list of at least
+// kColumnarMinValues values: [0x00][kind][varint size][Entry without data][varint count][packed values].
+// A serialized Entry never starts with 0x00 (field number 0 is invalid), so both read back without a flag
+static constexpr char kColumnarMarker = '\0';
+static constexpr char kColumnarDoubles = 1; // Gorilla XOR of consecutive values
+static constexpr char kColumnarInts = 2;    // first value and delta as varints, then zigzag delta-of-delta bit-packed in blocks of kColumnarIntBlock
+static constexpr char kColumnarDecimals = 3; // doubles with at most kColumnarMaxScale decimals, as scaled ints
+static constexpr int kColumnarMaxScale = 4;
+static constexpr size_t kColumnarMinValues = 16;
+static constexpr size_t kColumnarIntBlock = 128;
+
+// Encodes an entry for data_cf, columnar only when asked to and smaller than the plain serialization
+void EncodeStoredEntry(const registadb::Entry& entry, bool columnar, std::string* out);
+// Decodes either format. Without with_data a columnar value is read without its list (for TTL checks)
+bool DecodeStoredEntry(const char* data, size_t size, registadb::Entry* out, bool with_data = true);
+inline bool DecodeStoredEntry(const std::string& data, registadb::Entry* out) {
+    return DecodeStoredEntry(data.data(), data.size(), out);
+}
+
+// Column codecs, appended to / read from a packed payload
+void EncodeDoubleColumn(const double* values, size_t n, std::string* out);
+bool DecodeDoubleColumn(const char* data, size_t size, size_t n, double* values);
+void EncodeIntColumn(const int64_t* values, size_t n, std::string* out);
+bool DecodeIntColumn(const char* data, size_t size, size_t n, int64_t* values);
+// Smallest scale that turns every value into an exact integer (value = int / 10^scale), -1 if there is none
+int FindDecimalScale(const double* values, size_t n);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef ID_ALLOCATOR_H
+#define ID_ALLOCATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// Allocator counters since start
+struct IdAllocatorStats {
+    uint64_t leases = 0;      // blocks handed to threads
+    uint64_t collisions = 0;  // client ids that landed in the part of a lease not yet handed out
+    uint64_t high_water = 0;  // persisted mark, every id below it may have been handed out
+};
+
+
+/**
+ * @brief Hands out entry ids from contiguous blocks leased to each thread, so the hot path touches only the thread's own lease. A high-water mark is persisted ahead of the leased range through a callback, and client-supplied ids are observed so auto-assigned ids never walk over them.
+ *
+ */
+class IdAllocator {
+public:
+    using PersistFn = std::function<bool(uint64_t high_water)>;
+
+    static constexpr uint64_t kDefaultBlockSize = 1024;
+    // the mark is persisted this many blocks ahead so a write is needed only every few leases
+    static constexpr uint64_t kPersistAheadBlocks = 64;
+    // threads with a lease Observe can see; further threads take their ids one at a time
+    static constexpr size_t kMaxLeaseSlots = 256;
+
+    explicit IdAllocator(uint64_t block_size = kDefaultBlockSize);
+
+    // Setup, before the first Next(): block size and where the high-water mark is written
+    void Configure(uint64_t block_size, PersistFn persist);
+
+    // Restarts allocation after last_id; persisted_high_water is the mark read back on startup
+    void Reset(uint64_t last_id, uint64_t persisted_high_water = 0);
+
+    uint64_t Next();
+
+    // Raises the allocator past a client-supplied id, returns true when the id was still to be handed out by a lease
+    bool Observe(uint64_t id);
+
+    IdAllocatorStats GetStats() const;
+
+private:
+    // one thread's current block [start, end), ids below next are handed out. Only the owning thread moves next
+    // and leases a new block; Observe may lower end to cut a client id out of the part not yet handed out
+    struct alignas(64) LeaseSlot {
+        std::atomic<uint64_t> start{0};
+        std::atomic<uint64_t> next{0};
+        std::atomic<uint64_t> end{0};
+    };
+
+    LeaseSlot* SlotForThread();
+    uint64_t LeaseBlock(LeaseSlot* slot);
+    void PersistHighWater(uint64_t block_end);
+
+    const uint64_t instance_;
+    uint64_t block_size_;
+    PersistFn persist_;
+
+    // floor_ is the last id known at Reset; ids above it belong to this allocator
+    std::atomic<uint64_t> floor_{0};
+    alignas(64) std::atomic<uint64_t> next_block_start_{1};
+    alignas(64) std::atomic<uint64_t> persisted_high_water_{0};
+    std::mutex persist_mutex_;
+
+    // slots are handed out once per thread and never reused, so Observe can scan the first slot_count_ without a lock
+    std::unique_ptr<LeaseSlot[]> slots_;
+    std::atomic<size_t> slot_count_{0};
+    std::mutex slots_mutex_;
+    std::unordered_map<std::thread::id, LeaseSlot*> thread_slots_;
+
+    std::atomic<uint64_t> leases_{0};
+    std::atomic<uint64_t> collisions_{0};
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef MEMORY_STORAGE_H
+#define MEMORY_STORAGE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "StorageBackend.h"
+#include "StorageConfig.h"
+
+
+/**
+ * @brief RAM-only storage engine. Ids resolve through a sharded hash map and time order is kept in an ordered map on the same 16-byte composite keys RocksDB uses, so scans and cursors behave identically. Optionally persisted with periodic snapshots for restart; anything written since the last snapshot is lost on a crash.
+ * 
+ */
+class MemoryStorage : public StorageBackend {
+public:
+    explicit MemoryStorage(StorageConfig config = StorageConfig());
+    ~MemoryStorage() override;
+
+    // durability is ignored, nothing reaches disk before the next snapshot
+    bool StoreEntry(const registadb::Entry& entry, registadb::Durability durability = registadb::DURABILITY_DEFAULT,
+                    bool new_id = false) override;
+    bool StoreEntries(const registadb::Entry* entries, size_t count, registadb::Durability durability = registadb::DURABILITY_DEFAULT,
+                      bool new_ids = false) override;
+    using StorageBackend::StoreEntries;
+
+    bool GetEntryById(int64_t id, registadb::Entry* out_entry) override;
+    void GetEntriesByIds(const std::vector<uint64_t>& ids, std::vector<registadb::Entry>* out_entries,
+                         std::vector<bool>* out_found) override;
+    registadb::OperationStatus UpdateEntry(const registadb::Entry& patch, registadb::UpdateMode mode,
+                                           registadb::Entry* out_entry, registadb::Durability durability = registadb::DURABILITY_DEFAULT) override;
+    bool DeleteEntryById(int64_t id, registadb::Durability durability = registadb::DURABILITY_DEFAULT) override;
+
+    bool ScanRange(uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                   std::vector<registadb::Entry>* out_entries, std::string* next_cursor) override;
+    bool QueryByMetadata(const std::string& key, const std::string& value,
+                         uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                         std::vector<registadb::Entry>* out_entries, std::string* next_cursor) override;
+    bool IsMetadataIndexed(const std::string& key) const override {
+        return metadata_indexes_.count(key) > 0;
+    }
+
+    // Writes every entry to config.memory_snapshot_path (temp file + rename)
+    bool SaveSnapshot();
+
+private:
+    // immutable once published, readers hold it past the lock
+    struct Record {
+        std::string primary_key;
+        std::string data;
+    };
+    using RecordPtr = std::shared_ptr<const Record>;
+
+    struct IdShard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<uint64_t, RecordPtr> records;
+    };
+
+    static constexpr size_t kIdShards = 64;
+
+    StorageConfig config_;
+    IdShard id_shards_[kIdShards];
+
+    // guards time_order_ and metadata_indexes_ contents, writers take it exclusively so a group is atomic to scans
+    std::shared_mutex order_mutex_;
+    std::map<std::string, RecordPtr> time_order_;
+    std::map<std::string, std::set<std::string>> metadata_indexes_; // metadata key -> {value + '\0' + composite key}
+
+    std::thread snapshot_thread_;
+    std::mutex snapshot_mutex_;
+    std::condition_variable snapshot_cv_;
+    bool stopping_ = false;
+    std::atomic<bool> dirty_{false};
+
+    IdShard& ShardFor(uint64_t id);
+    void ApplyEntryLocked(const registadb::Entry& entry);
+    void IndexMetadataLocked(const registadb::Entry& entry, const std::string& primary_key, bool remove);
+    void ParseRecords(const std::vector<RecordPtr>& records, std::vector<registadb::Entry>* out_entries);
+    bool LoadSnapshot();
+    void SnapshotLoop();
+};
+
+#endif
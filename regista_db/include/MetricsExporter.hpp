@@ -1,10 +1,76 @@
 #ifndef METRICS_EXPORTER_HPP
 #define METRICS_EXPORTER_HPP
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
+#include <string>
 #include <rocksdb/statistics.h>
+#include "playbook.pb.h"
 
+// Starts the exporter and its polling thread, rocks_stats may be null (memory engine)
 void StartMetricsBridge(std::shared_ptr<rocksdb::Statistics> rocks_stats);
+// Stops and joins the polling thread
 void StopMetricsBridge();
 
-#endif
\ No newline at end of file
+// Ingest batching: size, payload bytes and commit latency of one group-committed batch
+void RecordIngestBatch(size_t entries, size_t bytes, double commit_seconds);
+// Ingest batching: one batch whose commit failed
+void RecordIngestBatchFailure();
+
+// Extra gauge refreshed by the polling thread from read(), register before StartMetricsBridge
+void RegisterPolledGauge(const std::string& name, const std::string& help,
+                         const std::map<std::string, std::string>& labels, std::function<double()> read);
+
+// Where a request came in
+enum class RequestTunnel { ZmqIngest, ZmqQuery, Rest };
+constexpr size_t kRequestTunnels = 3;
+
+// Parts of a request timed separately
+enum class RequestStage { Parse, Storage, Serialize };
+constexpr size_t kRequestStages = 3;
+
+// Requests handed to a worker pool and not yet picked up
+void AddQueueDepth(RequestTunnel tunnel, int64_t delta);
+
+
+/**
+ * @brief Times one request. It counts as in flight while alive, and its stage durations plus their sum are recorded per tunnel and operation when it is destroyed. Does nothing when the metrics bridge is not running.
+ *
+ */
+class RequestTimer {
+public:
+    explicit RequestTimer(RequestTunnel tunnel, registadb::OperationType op = registadb::OP_UNKNOWN);
+    ~RequestTimer();
+    RequestTimer(const RequestTimer&) = delete;
+    RequestTimer& operator=(const RequestTimer&) = delete;
+
+    // the operation is often known only after parsing
+    void SetOp(registadb::OperationType op) {
+        op_ = op;
+    }
+
+    // Adds the time since the previous mark (or construction) to stage
+    void Mark(RequestStage stage);
+
+    // Drops the time since the previous mark, for waits that belong to no stage
+    void Skip();
+
+    // Nothing is recorded for this request (e.g. an ingest poll that received nothing)
+    void Discard() {
+        record_ = false;
+    }
+
+private:
+    bool active_;
+    bool record_ = true;
+    RequestTunnel tunnel_;
+    registadb::OperationType op_;
+    unsigned marked_stages_ = 0;
+    double stage_seconds_[kRequestStages] = {};
+    std::chrono::steady_clock::time_point last_mark_;
+};
+
+#endif
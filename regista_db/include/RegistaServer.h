@@ -1,9 +1,13 @@
 #ifndef REGISTA_SERVER_H
 #define REGISTA_SERVER_H
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include <zmq.hpp>
 #include <zmq_addon.hpp>
-#include "StorageManager.h"
+#include "StorageBackend.h"
 #include "playbook.pb.h"
 
 namespace api {
@@ -11,30 +15,121 @@ namespace api {
 }
 
 /**
- * @brief Manages the main server loop, handling both ingest and query sockets, and orchestrating interactions with StorageManager.
+ * @brief Tunable server behaviour, filled from env/CLI in main.cpp.
+ * 
+ */
+struct ServerConfig {
+    // group-commit batching for the PUSH/PULL ingest tunnel
+    bool ingest_batching = false;
+    size_t ingest_batch_max_entries = 512;
+    size_t ingest_batch_max_bytes = 4 * 1024 * 1024;
+    std::chrono::microseconds ingest_batch_linger{1000};
+
+    // ingest worker pool, 0 = ingest is handled on the main poll loop
+    size_t ingest_workers = 0;
+    // core to pin each ingest worker to (by worker index), -1 or missing = any core the process may use
+    std::vector<int> ingest_worker_cores;
+
+    // query worker pool behind the ROUTER socket, 0 = queries are executed on the main poll loop.
+    // On by default because query writes default to sync: inline, every WAL fsync would stall the loop and ingest with it
+    static constexpr size_t kDefaultQueryWorkers = 4;
+    size_t query_workers = kDefaultQueryWorkers;
+
+    // write durability per tunnel, used when a request leaves durability at DURABILITY_DEFAULT
+    registadb::Durability ingest_durability = registadb::DURABILITY_ASYNC;
+    registadb::Durability query_durability = registadb::DURABILITY_SYNC;
+    registadb::Durability rest_durability = registadb::DURABILITY_SYNC;
+
+    // change data capture PUB socket, 0 = no publisher. Needs a storage backend with a change log
+    int change_port = 0;
+};
+
+/**
+ * @brief Manages the main server loop, handling both ingest and query sockets, and orchestrating interactions with the storage backend.
  * 
  */
 class RegistaServer {
     friend class api::EntryController;
 public:
-    RegistaServer(StorageManager& storage, int ingest_port, int query_port);
+    RegistaServer(StorageBackend& storage, int ingest_port, int query_port, ServerConfig config = ServerConfig());
     void Run();
     void Stop();
 
+    // page size for SCAN when the request leaves limit at 0, and the hard cap per page
+    static constexpr uint32_t kDefaultScanLimit = 100;
+    static constexpr uint32_t kMaxScanLimit = 10000;
+    // most ids accepted by one MULTI_READ
+    static constexpr int kMaxMultiReadIds = 10000;
+    // most entries accepted by one REST batch create
+    static constexpr size_t kMaxBatchEntries = 10000;
+    // events per CHANGES read when the request leaves limit at 0, and the hard cap
+    static constexpr uint32_t kDefaultChangesLimit = 1000;
+    static constexpr uint32_t kMaxChangesLimit = 10000;
+    // most non-empty buckets one AGGREGATE may return
+    static constexpr size_t kMaxAggregateBuckets = 100000;
+
+    // Parses none|async|sync
+    static bool ParseDurability(const std::string& text, registadb::Durability* out);
+
+    const ServerConfig& GetConfig() const {
+        return config_;
+    }
+
 private:
-    StorageManager& storage_;
+    StorageBackend& storage_;
     zmq::context_t context_;
     zmq::socket_t ingest_socket_;
     zmq::socket_t query_socket_;
-    bool running_;
+    std::atomic<bool> running_;
+    ServerConfig config_;
+
+    // reused across ingest batches so parsed entries keep their allocations
+    std::vector<registadb::Entry> ingest_batch_;
+
+    // ingest worker pool: proxy fans the ingest socket out to workers over inproc PUSH/PULL
+    zmq::socket_t ingest_backend_;
+    zmq::socket_t ingest_control_;
+    zmq::socket_t ingest_control_sender_;
+    std::thread ingest_proxy_thread_;
+    std::vector<std::thread> ingest_workers_;
+    // set once the proxy has stopped, workers then drain what it already forwarded and exit
+    std::atomic<bool> ingest_workers_stopping_{false};
+
+    // query worker pool: requests go out over inproc PUSH/PULL, replies come back the same way
+    zmq::socket_t query_dispatch_;
+    zmq::socket_t query_replies_;
+    std::vector<std::thread> query_workers_;
+    // set by StopQueryWorkers, workers then execute what was already dispatched to them and exit
+    std::atomic<bool> query_workers_stopping_{false};
+    // workers still running, StopQueryWorkers forwards their replies until it drops to 0
+    std::atomic<size_t> query_workers_active_{0};
+
+    // change publisher: tails every shard's change log and publishes each event under its source
+    zmq::socket_t change_socket_;
+    std::thread change_publisher_;
+
+    void StartIngestWorkers();
+    void StopIngestWorkers();
+    void IngestWorkerLoop(size_t index);
+
+    void StartQueryWorkers();
+    void StopQueryWorkers();
+    void QueryWorkerLoop(size_t index);
+
+    void StartChangePublisher();
+    void StopChangePublisher();
+    void ChangePublisherLoop();
 
-    void HandleIngest();
+    void HandleIngest(zmq::socket_t& socket);
+    void HandleIngestBatch(zmq::socket_t& socket, std::vector<registadb::Entry>& batch);
     void HandleQuery();
 
 protected:
-    bool PrepareEntry(registadb::Entry& entry);
-    void SendResponse(const registadb::Response& resp);
-    registadb::Response ExecuteRequest(const registadb::Request& req); 
+    bool PrepareEntry(registadb::Entry& entry, bool* generated_id = nullptr);
+    void ProcessQuery(std::vector<zmq::message_t>& frames);
+    // Executes req into resp, which may live on a different arena. The request entry is consumed (moved into resp)
+    void ExecuteRequest(registadb::Request& req, registadb::Response* resp);
+    registadb::Response ExecuteRequest(const registadb::Request& req);
 };
 
 #endif
\ No newline at end of file
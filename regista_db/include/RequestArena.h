@@ -0,0 +1,35 @@
+#ifndef REQUEST_ARENA_H
+#define REQUEST_ARENA_H
+
+#include <cstddef>
+#include <google/protobuf/arena.h>
+
+
+/**
+ * @brief Scope for protobuf messages that live for one request, allocated on a per-thread arena. The arena starts on a reusable thread-local block, so a typical request parses and builds its messages without touching the heap. The outermost scope on a thread resets the arena when it ends; nested scopes share it.
+ * 
+ */
+class RequestArena {
+public:
+    // first block of every thread's arena, reused after each reset
+    static constexpr size_t kInitialBlockSize = 64 * 1024;
+
+    RequestArena();
+    ~RequestArena();
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    template <typename T>
+    T* Create() {
+        return google::protobuf::Arena::Create<T>(arena_);
+    }
+
+    google::protobuf::Arena* get() const {
+        return arena_;
+    }
+
+private:
+    google::protobuf::Arena* arena_;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef ROLLUPS_H
+#define ROLLUPS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include <rocksdb/compaction_filter.h>
+#include <rocksdb/merge_operator.h>
+#include "SeriesAggregator.h"
+#include "TtlPolicy.h"
+
+// rollup key: [level][source length, 4-byte big-endian][source][bucket start, 8-byte big-endian micros], value: a
+// fixed-size accumulator. The length prefix keeps any byte (NUL included) usable in a source. Levels are the resolutions
+// below, coarsest first
+static constexpr uint64_t kRollupResolutions[] = {60ULL * 60 * 1000000, 60ULL * 1000000, 1000000};
+static constexpr size_t kRollupLevels = sizeof(kRollupResolutions) / sizeof(kRollupResolutions[0]);
+static constexpr size_t kRollupValueSize = 72;
+
+// One rollup bucket: the reduction of its entries plus what decides whether it can be served as is
+struct RollupBucket {
+    AggregateAccumulator acc;
+    uint64_t first_expiry = TtlPolicy::kNever; // earliest TTL expiry of a value added to or retracted from the bucket
+    uint64_t last_expiry = 0;                  // latest one, the bucket holds nothing live once it has passed
+    // range of the values retracted since the bucket was last computed exactly, empty (min > max) when none were
+    double retracted_min = std::numeric_limits<double>::infinity();
+    double retracted_max = -std::numeric_limits<double>::infinity();
+
+    // count and sum wrap around when a retraction is merged before the values it takes back
+    void Merge(const RollupBucket& other) {
+        acc.Merge(other.acc);
+        if (other.first_expiry < first_expiry) first_expiry = other.first_expiry;
+        if (other.last_expiry > last_expiry) last_expiry = other.last_expiry;
+        if (other.retracted_min < retracted_min) retracted_min = other.retracted_min;
+        if (other.retracted_max > retracted_max) retracted_max = other.retracted_max;
+    }
+    // turns the bucket into the operand that takes its values back out again
+    void Retract();
+    // true when a retracted value may be the one min or max still holds
+    bool Stale() const {
+        return retracted_min <= retracted_max && (retracted_min <= acc.min || retracted_max >= acc.max);
+    }
+    // true when the bucket matches its live entries exactly
+    bool Servable(uint64_t now_us) const {
+        return !Stale() && first_expiry > now_us;
+    }
+};
+
+std::string EncodeRollupKey(size_t level, const std::string& source, uint64_t bucket_start);
+// a key past every bucket of source in level, where the next source's buckets begin
+std::string RollupSourceEnd(size_t level, const std::string& source);
+// splits a key into source and bucket start, false if it is malformed
+bool DecodeRollupKey(const rocksdb::Slice& key, rocksdb::Slice* source, uint64_t* bucket_start);
+
+void EncodeRollupValue(const RollupBucket& bucket, std::string* out);
+bool DecodeRollupValue(const rocksdb::Slice& value, RollupBucket* bucket);
+
+
+/**
+ * @brief Merge operator of rollup_cf. Every write merges the accumulator of its entries into the bucket's current one, so ingest never reads a rollup back, and compaction folds the operands into one value per bucket.
+ *
+ */
+class RollupMergeOperator : public rocksdb::AssociativeMergeOperator {
+public:
+    bool Merge(const rocksdb::Slice& key, const rocksdb::Slice* existing_value, const rocksdb::Slice& value,
+               std::string* new_value, rocksdb::Logger* logger) const override;
+    const char* Name() const override { return "RegistaRollupMergeOperator"; }
+};
+
+/**
+ * @brief Drops rollup buckets (and single merge operands) that hold nothing live: buckets of a level older than its retention, and values whose latest TTL expiry has passed.
+ *
+ */
+class RollupRetentionFilter : public rocksdb::CompactionFilter {
+public:
+    // retention_us by level, 0 keeps the level's buckets until their entries expire
+    explicit RollupRetentionFilter(std::vector<uint64_t> retention_us) : retention_us_(std::move(retention_us)) {}
+
+    Decision FilterV2(int level, const rocksdb::Slice& key, ValueType value_type, const rocksdb::Slice& existing_value,
+                      std::string* new_value, std::string* skip_until) const override;
+    const char* Name() const override { return "RegistaRollupRetentionFilter"; }
+
+private:
+    std::vector<uint64_t> retention_us_;
+};
+
+#endif
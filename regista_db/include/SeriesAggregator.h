@@ -0,0 +1,81 @@
+#ifndef SERIES_AGGREGATOR_H
+#define SERIES_AGGREGATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+#include "playbook.pb.h"
+
+// Running reduction of the numeric values in one bucket
+struct AggregateAccumulator {
+    uint64_t count = 0;   // values reduced, a list contributes every element
+    uint64_t entries = 0; // entries that contributed at least one value
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double sum = 0;
+
+    void Add(double value) {
+        count++;
+        if (value < min) min = value;
+        if (value > max) max = value;
+        sum += value;
+    }
+    void AddAll(const double* values, size_t n);
+    void AddAll(const int64_t* values, size_t n);
+    // Adds the numeric values of one entry, false (and nothing added) when it has none
+    bool AddValue(const registadb::EntryValue& value);
+
+    void Merge(const AggregateAccumulator& other) {
+        count += other.count;
+        entries += other.entries;
+        if (other.min < min) min = other.min;
+        if (other.max > max) max = other.max;
+        sum += other.sum;
+    }
+};
+
+
+/**
+ * @brief Downsamples numeric entries into fixed-width time buckets aligned to the epoch (min, max, sum, count). double_value, int_value, double_list and int_list values are reduced, every other kind is skipped. Entries can be added in any time order, so one aggregator can be filled by several shards in turn.
+ *
+ */
+class SeriesAggregator {
+public:
+    // bucket_width_us 0 = a single bucket starting at from_ts
+    SeriesAggregator(uint64_t from_ts, uint64_t bucket_width_us, size_t max_buckets);
+
+    // Adds one entry created at created_us. Returns false once a new bucket would exceed max_buckets
+    bool Add(uint64_t created_us, const registadb::EntryValue& value);
+    // Adds values already reduced over a span starting at start_us, which must not cross a bucket boundary
+    bool AddAccumulated(uint64_t start_us, const AggregateAccumulator& acc);
+
+    uint64_t BucketWidth() const {
+        return bucket_width_us_;
+    }
+
+    bool Overflowed() const {
+        return overflowed_;
+    }
+    size_t BucketCount() const {
+        return buckets_.size();
+    }
+
+    // Non-empty buckets, oldest first
+    void Finish(std::vector<registadb::AggregateBucket>* out) const;
+
+private:
+    uint64_t from_ts_;
+    uint64_t bucket_width_us_;
+    size_t max_buckets_;
+    bool overflowed_ = false;
+
+    // by bucket start (micros); entries arrive mostly in time order, so the last bucket is kept at hand
+    std::map<uint64_t, AggregateAccumulator> buckets_;
+    std::map<uint64_t, AggregateAccumulator>::iterator last_ = buckets_.end();
+
+    AggregateAccumulator* BucketFor(uint64_t created_us);
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef SHARDED_STORAGE_H
+#define SHARDED_STORAGE_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "StorageBackend.h"
+#include "StorageConfig.h"
+#include "StorageManager.h"
+
+
+/**
+ * @brief RocksDB engine hash-partitioned by id over config.shards independent StorageManager instances. Every shard has its own WAL, writer thread, memtables and compaction budget, so ingest spreads over shards and a shard stalled on compaction only slows the writes routed to it: a group spanning shards is written by every shard's writer at once and waits for its slowest part, while the other shards keep committing. Point operations go to the id's shard; scans and metadata queries k-way merge the shards' pages on the composite key, so pages and cursors look exactly like a single store's. With one shard it opens db_path directly and adds nothing but the call.
+ *
+ */
+class ShardedStorage : public StorageBackend {
+public:
+    ShardedStorage(const std::string& db_path, bool enable_stats, StorageConfig config = StorageConfig());
+    ~ShardedStorage() override;
+
+    // file in db_path recording the shard count of a sharded store
+    static constexpr const char* kShardsFile = "SHARDS";
+    // shard count recorded in db_path, 1 for an unsharded or new store
+    static size_t ReadShardCount(const std::string& db_path);
+
+    // Write: routed to the id's shard. A group is split by shard, written by the shards' writers concurrently and is atomic per shard only
+    bool StoreEntry(const registadb::Entry& entry, registadb::Durability durability = registadb::DURABILITY_DEFAULT,
+                    bool new_id = false) override;
+    bool StoreEntries(const registadb::Entry* entries, size_t count, registadb::Durability durability = registadb::DURABILITY_DEFAULT,
+                      bool new_ids = false) override;
+    using StorageBackend::StoreEntries;
+
+    bool GetEntryById(int64_t id, registadb::Entry* out_entry) override;
+    // one batched lookup per shard, results in request order
+    void GetEntriesByIds(const std::vector<uint64_t>& ids, std::vector<registadb::Entry>* out_entries,
+                         std::vector<bool>* out_found) override;
+    registadb::OperationStatus UpdateEntry(const registadb::Entry& patch, registadb::UpdateMode mode,
+                                           registadb::Entry* out_entry, registadb::Durability durability = registadb::DURABILITY_DEFAULT) override;
+    bool DeleteEntryById(int64_t id, registadb::Durability durability = registadb::DURABILITY_DEFAULT) override;
+
+    // Scan/Query: every shard read from the cursor in small pages, merged newest first
+    bool ScanRange(uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                   std::vector<registadb::Entry>* out_entries, std::string* next_cursor) override;
+    bool QueryByMetadata(const std::string& key, const std::string& value,
+                         uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                         std::vector<registadb::Entry>* out_entries, std::string* next_cursor) override;
+    bool IsMetadataIndexed(const std::string& key) const override {
+        return shards_.front()->IsMetadataIndexed(key);
+    }
+    // every shard adds into the same aggregator
+    bool Aggregate(uint64_t from_ts, uint64_t to_ts, const std::string& key, const std::string& value,
+                   SeriesAggregator* out) override;
+
+    // Changes: every shard has its own log and sequence numbers, events are tagged with their shard
+    size_t ChangeLogShards() const override {
+        return shards_.front()->ChangeLogShards() > 0 ? shards_.size() : 0;
+    }
+    uint64_t LatestChangeSequence(uint32_t shard) const override {
+        return shard < shards_.size() ? shards_[shard]->LatestChangeSequence(0) : 0;
+    }
+    bool GetChangesSince(uint32_t shard, uint64_t since_sequence, size_t limit,
+                         std::vector<registadb::ChangeEvent>* out_events, uint64_t* next_sequence,
+                         bool* truncated) override;
+
+    // Bulk load: entries are split by shard and each part is ingested into its shard (work_dir/shard_<i>)
+    bool BulkLoad(std::vector<registadb::Entry>& entries, const std::string& work_dir, BulkLoadStats* stats);
+
+    size_t ShardCount() const {
+        return shards_.size();
+    }
+    StorageManager& Shard(size_t index) {
+        return *shards_[index];
+    }
+    size_t ShardFor(uint64_t id) const {
+        if (shards_.size() == 1) return 0;
+        // a different multiplier than the id lock stripes, so a shard still uses all of its stripes
+        return static_cast<size_t>(((id * 0xD6E8FEB86659FD93ULL) >> 32) % shards_.size());
+    }
+
+    // shared by every shard
+    std::shared_ptr<rocksdb::Statistics> GetStats() const {
+        return shards_.front()->GetStats();
+    }
+
+private:
+    std::vector<std::unique_ptr<StorageManager>> shards_;
+
+    // a caller's StoreEntries, done once every shard part has been written
+    struct WriteGroup {
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t pending = 0;
+        bool ok = true;
+    };
+    // one shard's part of a group
+    struct ShardWrite {
+        const registadb::Entry* const* entries;
+        size_t count;
+        registadb::Durability durability;
+        bool new_ids;
+        WriteGroup* group;
+    };
+    // per shard (when there is more than one): parts queued by concurrent callers are written together
+    struct ShardWriter {
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::deque<ShardWrite> queue;
+        bool stopping = false;
+        std::thread thread;
+    };
+    std::vector<std::unique_ptr<ShardWriter>> writers_;
+    void WriterLoop(size_t shard);
+
+    using PageFetch = std::function<bool(StorageManager& shard, const std::string& cursor, size_t limit,
+                                         std::vector<registadb::Entry>* page, std::string* next)>;
+    bool MergePages(const std::string& cursor, size_t limit, const PageFetch& fetch,
+                    std::vector<registadb::Entry>* out_entries, std::string* next_cursor);
+};
+
+#endif
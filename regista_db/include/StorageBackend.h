@@ -0,0 +1,116 @@
+#ifndef STORAGE_BACKEND_H
+#define STORAGE_BACKEND_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "IdAllocator.h"
+#include "SeriesAggregator.h"
+#include "playbook.pb.h"
+
+
+/**
+ * @brief Interface every storage engine implements (RocksDB on disk, or in memory). RegistaServer and the REST controllers only talk to this. Engines share the 16-byte composite key (reversed timestamp + id) so time order and scan cursors mean the same thing everywhere.
+ * 
+ */
+class StorageBackend {
+public:
+    virtual ~StorageBackend() = default;
+
+    // Every write returns once it is durable under durability (DEFAULT = the engine's own default).
+    // new_ids: every id was just handed out by GetNextId, so nothing is stored under it yet and the engine
+    // can write blind instead of looking for a version to replace
+
+    // Write: Saves data and makes it reachable by ID
+    virtual bool StoreEntry(const registadb::Entry& entry, registadb::Durability durability = registadb::DURABILITY_DEFAULT,
+                            bool new_id = false) = 0;
+
+    // Write: Saves a group of entries atomically (group commit)
+    virtual bool StoreEntries(const registadb::Entry* entries, size_t count, registadb::Durability durability = registadb::DURABILITY_DEFAULT,
+                              bool new_ids = false) = 0;
+    bool StoreEntries(const std::vector<registadb::Entry>& entries, registadb::Durability durability = registadb::DURABILITY_DEFAULT,
+                      bool new_ids = false) {
+        return StoreEntries(entries.data(), entries.size(), durability, new_ids);
+    }
+
+    // Read: Finds data by ID
+    virtual bool GetEntryById(int64_t id, registadb::Entry* out_entry) = 0;
+
+    // Read: Finds many entries by ID, results in request order
+    virtual void GetEntriesByIds(const std::vector<uint64_t>& ids, std::vector<registadb::Entry>* out_entries,
+                                 std::vector<bool>* out_found) = 0;
+
+    // Update: Applies patch to the stored entry with patch.id() as one atomic read-modify-write.
+    // Returns STATUS_OK with the stored result in out_entry, or STATUS_NOT_FOUND / STATUS_INTERNAL_ERROR
+    virtual registadb::OperationStatus UpdateEntry(const registadb::Entry& patch, registadb::UpdateMode mode,
+                                                   registadb::Entry* out_entry, registadb::Durability durability = registadb::DURABILITY_DEFAULT) = 0;
+
+    // Delete: Removes data by ID
+    virtual bool DeleteEntryById(int64_t id, registadb::Durability durability = registadb::DURABILITY_DEFAULT) = 0;
+
+    // Scan: Reads one page of entries created in [from_ts, to_ts] (micros), newest first
+    virtual bool ScanRange(uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                           std::vector<registadb::Entry>* out_entries, std::string* next_cursor) = 0;
+
+    // Query: Reads one page of entries whose metadata[key] == value, created in [from_ts, to_ts], newest first
+    virtual bool QueryByMetadata(const std::string& key, const std::string& value,
+                                 uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                                 std::vector<registadb::Entry>* out_entries, std::string* next_cursor) = 0;
+    virtual bool IsMetadataIndexed(const std::string& key) const = 0;
+
+    // Aggregate: reduces the numeric values of entries created in [from_ts, to_ts] into out's time buckets,
+    // only entries whose metadata[key] == value when key is set (indexed or not).
+    // Returns false if a read failed or out ran out of buckets (out->Overflowed()).
+    // The default pages through QueryByMetadata for indexed keys, ScanRange otherwise
+    virtual bool Aggregate(uint64_t from_ts, uint64_t to_ts, const std::string& key, const std::string& value,
+                           SeriesAggregator* out);
+
+    // Changes: committed puts and deletes of entries in sequence order, one log per shard.
+    // Engines without a change log report no shards and fail every read
+    virtual size_t ChangeLogShards() const {
+        return 0;
+    }
+    // sequence of the last committed write in shard, 0 before the first
+    virtual uint64_t LatestChangeSequence(uint32_t shard) const {
+        return 0;
+    }
+    // Reads events from since_sequence on, whole write batches at a time until at least limit events.
+    // truncated is set when the log no longer reaches back to since_sequence
+    virtual bool GetChangesSince(uint32_t shard, uint64_t since_sequence, size_t limit,
+                                 std::vector<registadb::ChangeEvent>* out_events, uint64_t* next_sequence,
+                                 bool* truncated) {
+        return false;
+    }
+
+    std::string EncodeCompositeKey(uint64_t timestamp, uint64_t id);
+    std::string EncodeMetadataIndexKey(const std::string& value, const std::string& primary_key);
+    std::pair<uint64_t, uint64_t> DecodeCompositeKey(const char* key);
+    uint64_t ToEpochMicros(const google::protobuf::Timestamp& ts);
+    static void ApplyUpdate(const registadb::Entry& patch, registadb::UpdateMode mode, registadb::Entry* stored);
+
+    // Ids: leased per thread in blocks, see IdAllocator
+    uint64_t GetNextId() {
+        return id_allocator_.Next();
+    }
+    void SetStartingId(uint64_t id) {
+        id_allocator_.Reset(id);
+    }
+    // Client-supplied ids, returns true when the id collides with one a lease had yet to hand out
+    bool ObserveId(uint64_t id) {
+        return id_allocator_.Observe(id);
+    }
+    IdAllocatorStats GetIdAllocatorStats() const {
+        return id_allocator_.GetStats();
+    }
+
+protected:
+    IdAllocator& GetIdAllocator() {
+        return id_allocator_;
+    }
+
+private:
+    IdAllocator id_allocator_;
+};
+
+#endif
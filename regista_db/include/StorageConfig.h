@@ -0,0 +1,80 @@
+#ifndef STORAGE_CONFIG_H
+#define STORAGE_CONFIG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Tunable storage behaviour, filled from env/CLI in main.cpp and passed to the storage backend.
+ * 
+ */
+struct StorageConfig {
+    // metadata keys with a secondary index (one column family each)
+    std::vector<std::string> indexed_metadata_keys;
+
+    // RocksDB tuning profile: "balanced", "write-heavy", "read-heavy" or "small-entries"
+    std::string profile = "balanced";
+
+    // optional RocksDB OPTIONS file, overrides the profile for every column family it lists
+    std::string options_file;
+
+    // shared block cache size in bytes, 0 = profile default
+    size_t block_cache_bytes = 0;
+
+    // HyperClockCache instead of LRU for the shared block cache (less mutex contention)
+    bool hyper_clock_cache = false;
+
+    // hot-entry cache in front of GetEntryById, 0 = disabled
+    size_t entry_cache_bytes = 0;
+    size_t entry_cache_shards = 16;
+
+    // RocksDB instances the store is hash-partitioned over by id, each in its own subdirectory when > 1
+    size_t shards = 1;
+
+    // ids leased to each thread at a time by the id allocator
+    uint64_t id_block_size = 1024;
+
+    // TTL: entries expire at created_at + (entry ttl_seconds, else TTL of metadata["source"], else default), 0 = forever
+    uint64_t default_ttl_seconds = 0;
+    std::map<std::string, uint64_t> source_ttl_seconds;
+    bool entry_ttl = false; // honour Entry.ttl_seconds even without default/source TTLs
+
+    // cold tier: data_cf SST files beyond hot_tier_bytes are placed under cold_path, empty = single tier
+    std::string cold_path;
+    uint64_t hot_tier_bytes = 64ULL * 1024 * 1024 * 1024;
+
+    // value separation (integrated BlobDB) for data_cf: values of at least blob_min_bytes go to blob files, so
+    // compactions move only keys and blob references, 0 = off. Compaction relocates live values out of the oldest
+    // blob_gc_age_cutoff fraction of blob files (0 = no blob GC), and files whose garbage ratio passes
+    // blob_gc_force_threshold are compacted even when nothing else would be (1.0 = never forced)
+    size_t blob_min_bytes = 0;
+    uint64_t blob_file_bytes = 256ULL * 1024 * 1024;
+    double blob_gc_age_cutoff = 0.25;
+    double blob_gc_force_threshold = 1.0;
+
+    // store double_list / int_list values of 16+ values as compressed columns in data_cf (see EntryCodec.h).
+    // Clients see no difference and either format reads back, so this can be switched at any time
+    bool columnar_lists = false;
+
+    // pre-aggregated series (1 s / 1 min / 1 h buckets per metadata["source"]) of numeric entries in rollup_cf,
+    // maintained on every store and used by Aggregate for the bucket-aligned part of a range
+    bool rollups = false;
+    // how long 1 s and 1 min buckets are kept, 0 = as long as their entries; older ranges use coarser buckets or the entries.
+    // 1 h buckets are always kept as long as their entries
+    uint64_t rollup_second_retention_seconds = 7 * 24 * 3600;
+    uint64_t rollup_minute_retention_seconds = 90 * 24 * 3600;
+
+    // change data capture: keep the WAL for change_log_retention_seconds so committed writes can be read back in
+    // sequence order (GetChangesSince). DURABILITY_NONE writes still go through the WAL while it is on
+    bool change_log = false;
+    uint64_t change_log_retention_seconds = 3600;
+
+    // memory engine: snapshot file loaded on start and rewritten periodically, empty = no persistence
+    std::string memory_snapshot_path;
+    unsigned memory_snapshot_interval_seconds = 60;
+};
+
+#endif
@@ -2,48 +2,190 @@
 #define STORAGE_MANAGER_H
 
 #include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <rocksdb/db.h>
+#include "EntryCache.h"
+#include "Rollups.h"
+#include "StorageBackend.h"
+#include "StorageConfig.h"
+#include "TtlPolicy.h"
+#include "WalGroupSync.h"
 #include "playbook.pb.h"
 
+// Entries and index records dropped by the TTL compaction filters since start
+struct ExpiryStats {
+    uint64_t data_expired = 0;
+    uint64_t data_expired_bytes = 0;
+    uint64_t index_expired = 0;
+    uint64_t metadata_index_expired = 0;
+};
+
+// data_cf SST files per tier
+struct TierUsage {
+    uint64_t hot_files = 0;
+    uint64_t hot_bytes = 0;
+    uint64_t cold_files = 0;
+    uint64_t cold_bytes = 0;
+};
+
+// data_cf blob files (value separation), from the DB properties
+struct BlobUsage {
+    uint64_t files = 0;
+    uint64_t bytes = 0;         // every blob file, including ones only kept for old versions
+    uint64_t live_bytes = 0;    // blob files of the current version
+    uint64_t garbage_bytes = 0; // bytes in live blob files no longer referenced, reclaimed by blob GC
+};
+
+// data_cf SST sizes from the table properties, blob files not included
+struct DataCompression {
+    uint64_t files = 0;
+    uint64_t dict_files = 0;  // files compressed with a ZSTD dictionary
+    uint64_t entries = 0;
+    uint64_t raw_bytes = 0;   // keys and values as written
+    uint64_t data_bytes = 0;  // data blocks on disk, after compression
+};
+
+// Result of one BulkLoad call
+struct BulkLoadStats {
+    uint64_t ingested = 0;   // new ids written through SST ingestion
+    uint64_t rewritten = 0;  // ids that already existed, written through the normal write path
+    uint64_t sst_files = 0;
+    uint64_t sst_bytes = 0;
+};
+
 
 /**
  * @brief Manages all interactions with RocksDB, including storing, retrieving, and deleting entries. Implements a composite key structure for efficient time-based retrieval and an index for ID-based lookups.
  * 
  */
-class StorageManager {
+class StorageManager : public StorageBackend {
 public:
-    StorageManager(const std::string& db_path, bool enable_stats);
-    ~StorageManager();
+    // shared_stats: statistics object shared with other instances (shards), created here when null and enable_stats is set
+    StorageManager(const std::string& db_path, bool enable_stats, StorageConfig config = StorageConfig(),
+                   std::shared_ptr<rocksdb::Statistics> shared_stats = nullptr);
+    ~StorageManager() override;
 
     static constexpr const char* kIndexCF = "index_cf";
     static constexpr const char* kDataCF = "data_cf";
+    // secondary index column families are named kMetadataIndexCFPrefix + metadata key
+    static constexpr const char* kMetadataIndexCFPrefix = "meta_idx_";
+    // pre-aggregated series, only while config.rollups is set (dropped when it is turned off)
+    static constexpr const char* kRollupCF = "rollup_cf";
+    // default CF key holding the id allocator high-water mark (8-byte big-endian)
+    static constexpr const char* kIdHighWaterKey = "id_high_water";
 
     // Write: Saves data and creates the ID index
-    bool StoreEntry(const registadb::Entry& entry);
+    bool StoreEntry(const registadb::Entry& entry, registadb::Durability durability = registadb::DURABILITY_DEFAULT,
+                    bool new_id = false) override;
+
+    // Write: Saves a group of entries and their ID indexes in a single WriteBatch (group commit)
+    bool StoreEntries(const registadb::Entry* entries, size_t count, registadb::Durability durability = registadb::DURABILITY_DEFAULT,
+                      bool new_ids = false) override;
+    using StorageBackend::StoreEntries;
+    // Same group commit over entries that are not contiguous (a shard's part of a batch)
+    bool StoreEntryRefs(const registadb::Entry* const* entries, size_t count,
+                        registadb::Durability durability = registadb::DURABILITY_DEFAULT, bool new_ids = false);
 
     // Read: Finds data by ID using the index
-    bool GetEntryById(int64_t id, registadb::Entry* out_entry);
+    bool GetEntryById(int64_t id, registadb::Entry* out_entry) override;
+
+    // Read: Finds many entries by ID with two batched MultiGets (index, then data), results in request order
+    void GetEntriesByIds(const std::vector<uint64_t>& ids, std::vector<registadb::Entry>* out_entries,
+                         std::vector<bool>* out_found) override;
+
+    // Update: Reads, patches and rewrites the entry in one WriteBatch while holding the id's stripe lock
+    registadb::OperationStatus UpdateEntry(const registadb::Entry& patch, registadb::UpdateMode mode,
+                                           registadb::Entry* out_entry, registadb::Durability durability = registadb::DURABILITY_DEFAULT) override;
 
     // Delete: Finds data by ID using the index and deletes
-    bool DeleteEntryById(int64_t id);
+    bool DeleteEntryById(int64_t id, registadb::Durability durability = registadb::DURABILITY_DEFAULT) override;
 
-    std::string EncodeCompositeKey(uint64_t timestamp, uint64_t id);
-    std::string EncodeIndexKey(uint64_t id);
-    uint64_t DecodeIndexKey(const char* key);
-    std::pair<uint64_t, uint64_t> DecodeCompositeKey(const char* key);
-    uint64_t ToEpochMicros(const google::protobuf::Timestamp& ts);
+    // Scan: Reads one page of entries created in [from_ts, to_ts] (micros), newest first
+    bool ScanRange(uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                   std::vector<registadb::Entry>* out_entries, std::string* next_cursor) override;
+
+    // Query: Reads one page of entries whose metadata[key] == value, created in [from_ts, to_ts], newest first
+    bool QueryByMetadata(const std::string& key, const std::string& value,
+                         uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                         std::vector<registadb::Entry>* out_entries, std::string* next_cursor) override;
+    bool IsMetadataIndexed(const std::string& key) const override {
+        return metadata_index_handles_.count(key) > 0;
+    }
+
+    // Aggregate: bucket-aligned parts of the range come from rollup_cf when rollups are on (no filter or a source filter),
+    // the rest streams data_cf in one pass, or goes through the secondary index for an indexed filter
+    bool Aggregate(uint64_t from_ts, uint64_t to_ts, const std::string& key, const std::string& value,
+                   SeriesAggregator* out) override;
 
-    uint64_t GetNextId() {
-        return ++global_id_counter_;
+    // Changes: read back from the WAL, only when config.change_log is set
+    // WAL log record in front of a delete carrying the entry's source, so the change log can tag the delete
+    static constexpr const char* kChangeSourceTag = "src:";
+    size_t ChangeLogShards() const override {
+        return config_.change_log ? 1 : 0;
     }
-    void SetStartingId(uint64_t id) {
-        global_id_counter_.store(id);
+    uint64_t LatestChangeSequence(uint32_t shard) const override {
+        return db->GetLatestSequenceNumber();
     }
+    bool GetChangesSince(uint32_t shard, uint64_t since_sequence, size_t limit,
+                         std::vector<registadb::ChangeEvent>* out_events, uint64_t* next_sequence,
+                         bool* truncated) override;
+
+    // Bulk load: writes sorted SST files for new ids into work_dir and ingests them into every column family at once
+    bool BulkLoad(std::vector<registadb::Entry>& entries, const std::string& work_dir, BulkLoadStats* stats);
+
+    std::string EncodeIndexKey(uint64_t id);
+    uint64_t DecodeIndexKey(const char* key);
 
     std::shared_ptr<rocksdb::Statistics> GetStats() const {
         return rocks_stats;
     }
+
+    bool HasRollups() const {
+        return rollup_handle_ != nullptr;
+    }
+
+    bool IsTtlEnabled() const {
+        return ttl_policy_ != nullptr;
+    }
+    ExpiryStats GetExpiryStats() const;
+    TierUsage GetTierUsage();
+    BlobUsage GetBlobUsage();
+    DataCompression GetDataCompression();
+
+    // Appends up to limit stored data_cf values, spread evenly over the CF, e.g. to estimate compression offline
+    bool SampleStoredValues(size_t limit, std::vector<std::string>* out);
+
+    // Flushes data_cf and compacts all of it, e.g. to measure compaction cost or reclaim blob garbage offline
+    bool CompactDataCF();
+
+    // Id state read back on open, for an allocator that spans several stores (ShardedStorage)
+    uint64_t GetRecoveredLastId() const {
+        return recovered_last_id_;
+    }
+    uint64_t GetRecoveredHighWater() const {
+        return recovered_high_water_;
+    }
+    bool PersistIdHighWater(uint64_t mark);
+
+    int GetMaxBackgroundJobs() const {
+        return options.max_background_jobs;
+    }
+
+    // DURABILITY_SYNC writes and the WAL fsyncs they shared
+    WalSyncStats GetWalSyncStats() const {
+        return wal_sync_.GetStats();
+    }
+
+    // nullptr when the hot-entry cache is disabled
+    const EntryCache* GetEntryCache() const {
+        return entry_cache_.get();
+    }
 private:
     rocksdb::DB* db;
     rocksdb::Options options;
@@ -51,8 +193,89 @@ private:
     rocksdb::ColumnFamilyHandle* index_handle_ = nullptr;
     rocksdb::ColumnFamilyHandle* data_handle_ = nullptr;
     rocksdb::ColumnFamilyHandle* default_handle_ = nullptr;
+    rocksdb::ColumnFamilyHandle* rollup_handle_ = nullptr;
+    std::shared_ptr<RollupMergeOperator> rollup_merge_;
+    std::unique_ptr<RollupRetentionFilter> rollup_retention_filter_;
+    std::vector<uint64_t> rollup_retention_us_; // by rollup level, 0 = kept as long as the entries
+    StorageConfig config_;
+
+    // maintained secondary indexes by metadata key, plus every other handle opened beyond the core three
+    std::map<std::string, rocksdb::ColumnFamilyHandle*> metadata_index_handles_;
+
+    std::vector<rocksdb::ColumnFamilyHandle*> extra_handles_;
+
+    // TTL enforcement, all null when no TTL is configured. Must outlive db
+    std::unique_ptr<TtlPolicy> ttl_policy_;
+    std::unique_ptr<IndexExpiryFilter> index_expiry_filter_;
+    std::unique_ptr<IndexExpiryFilter> metadata_expiry_filter_;
+    std::unique_ptr<DataExpiryFilter> data_expiry_filter_;
+
+    // serialized entries by id in front of GetEntryById, invalidated after every committed write
+    std::unique_ptr<EntryCache> entry_cache_;
+
+    uint64_t recovered_last_id_ = 0;
+    uint64_t recovered_high_water_ = 0;
+
+    // DURABILITY_SYNC writers wait here, outside their stripe locks, so one WAL fsync covers all of them
+    WalGroupSync wal_sync_;
+    rocksdb::WriteOptions WriteOptionsFor(registadb::Durability durability) const;
+    bool AwaitDurable(registadb::Durability durability);
+
+    // writes to one id are serialized on its stripe, so an update cannot lose a concurrent write or bring back a delete
+    static constexpr size_t kIdLockStripes = 256;
+    std::mutex id_locks_[kIdLockStripes];
+    size_t IdLockStripe(uint64_t id) const {
+        return (id * 0x9E3779B97F4A7C15ULL) >> 56;
+    }
+
+    // rollup buckets by key hash: writers hold the stripes of the buckets they merge into shared until their batch is
+    // written, a recomputed bucket is only written back if its stripe can be taken exclusively at once
+    static constexpr size_t kRollupLockStripes = 256;
+    std::shared_mutex rollup_locks_[kRollupLockStripes];
+    size_t RollupLockStripe(std::string_view key) const {
+        return std::hash<std::string_view>{}(key) % kRollupLockStripes;
+    }
+    using RollupLocks = std::vector<std::shared_lock<std::shared_mutex>>;
+
+    // what an id held before a write: its data_cf key (empty for a new id) and, when has_entry, the stored entry
+    struct StoredVersion {
+        std::string primary_key;
+        registadb::Entry entry;
+        bool has_entry = false;
+    };
+    // the stored versions of a group of entries about to be written, read under their stripe locks. The entry itself is
+    // only read when metadata indexes or rollups need it; an id repeated in the group is replaced by its earlier copy.
+    // With new_ids nothing is read, only repeats within the group are resolved
+    void ReadStoredVersions(const registadb::Entry* const* entries, size_t count, bool new_ids, std::vector<StoredVersion>* out);
 
-    std::atomic<uint64_t> global_id_counter_{1};
+    void AppendEntry(rocksdb::WriteBatch& batch, const registadb::Entry& entry, std::string& scratch,
+                     const StoredVersion& previous);
+    void AppendMetadataIndexes(rocksdb::WriteBatch& batch, const registadb::Entry& entry,
+                               const std::string& primary_key, bool remove);
+    void BuildMetadataIndex(const std::string& key);
+    // retracted are the versions being replaced or deleted, taken back out of their buckets. locks receives the
+    // stripes of the buckets merged into, to be held until the batch is written (nullptr while nothing reads rollups)
+    void AppendRollups(rocksdb::WriteBatch& batch, RollupLocks* locks, const registadb::Entry* const* added,
+                       size_t added_count, const registadb::Entry* const* retracted = nullptr, size_t retracted_count = 0);
+    void AppendRollupsReplacing(rocksdb::WriteBatch& batch, RollupLocks* locks, const registadb::Entry* const* entries,
+                                size_t count, const std::vector<StoredVersion>& previous);
+    // earliest bucket start a rollup level is sure to still hold, 0 when the level is kept as long as its entries
+    uint64_t RollupHorizon(size_t level) const;
+    void BuildRollups();
+    bool AggregateSpan(uint64_t begin, uint64_t end, size_t level, const std::string& key, const std::string& value,
+                       SeriesAggregator* out);
+    bool AggregateRollups(size_t level, uint64_t begin, uint64_t end, const std::string& key, const std::string& value,
+                          SeriesAggregator* out);
+    // the exact bucket of one source from the live entries of its span, as of snapshot
+    bool RecomputeRollupBucket(size_t level, const std::string& source, uint64_t start, const rocksdb::Snapshot* snapshot,
+                               RollupBucket* out);
+    // replaces a bucket read as read_value with its recomputed value, unless a write has merged into it since
+    void WriteBackRollupBucket(const rocksdb::Slice& key, const rocksdb::Slice& read_value, const RollupBucket& bucket);
+    bool AggregateEntries(uint64_t from_ts, uint64_t to_ts, const std::string& key, const std::string& value,
+                          SeriesAggregator* out);
+    void RecoverIdAllocator();
+    uint64_t ExpiresAt(const registadb::Entry& entry) const;
+    bool IsExpired(const registadb::Entry& entry) const;
 
 protected:
     rocksdb::Iterator* GetRawIndexIterator() {
@@ -0,0 +1,42 @@
+#ifndef STORAGE_PROFILES_H
+#define STORAGE_PROFILES_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <rocksdb/options.h>
+#include "StorageConfig.h"
+
+/**
+ * @brief Per column family options produced by a tuning profile. All table factories share one block cache.
+ * 
+ */
+struct StorageTuning {
+    rocksdb::ColumnFamilyOptions default_cf;
+    rocksdb::ColumnFamilyOptions index_cf;
+    rocksdb::ColumnFamilyOptions data_cf;
+    rocksdb::ColumnFamilyOptions metadata_index_cf;
+    rocksdb::ColumnFamilyOptions rollup_cf; // the merge operator is set by StorageManager
+    std::shared_ptr<rocksdb::Cache> block_cache;
+
+    // column families listed in the options file, by name
+    std::map<std::string, rocksdb::ColumnFamilyOptions> overrides;
+};
+
+// ZSTD dictionary size and training sample size per data_cf SST file in the small-entries profile
+constexpr uint32_t kZstdDictBytes = 16 * 1024;
+constexpr uint32_t kZstdDictTrainBytes = 100 * kZstdDictBytes;
+
+bool IsKnownStorageProfile(const std::string& profile);
+
+// block cache size the profile uses when block_cache_bytes is 0, 0 for an unknown profile
+size_t ProfileBlockCacheBytes(const std::string& profile);
+
+// fills db_options and tuning from config.profile, then applies config.options_file on top
+bool BuildStorageTuning(const StorageConfig& config, rocksdb::DBOptions* db_options, StorageTuning* tuning);
+
+// options for the named column family: options file first, then the profile's options for that CF
+rocksdb::ColumnFamilyOptions OptionsForColumnFamily(const StorageTuning& tuning, const std::string& name);
+
+#endif
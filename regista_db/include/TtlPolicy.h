@@ -0,0 +1,77 @@
+#ifndef TTL_POLICY_H
+#define TTL_POLICY_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <rocksdb/compaction_filter.h>
+#include "playbook.pb.h"
+
+
+/**
+ * @brief Decides when an entry expires: created_at plus the entry's own ttl_seconds, else the TTL of its metadata "source", else the default TTL. A TTL of 0 keeps the entry forever.
+ * 
+ */
+class TtlPolicy {
+public:
+    static constexpr uint64_t kNever = UINT64_MAX;
+
+    TtlPolicy(uint64_t default_ttl_seconds, std::map<std::string, uint64_t> source_ttl_seconds);
+
+    // expiry time in micros since epoch, kNever when the entry does not expire
+    uint64_t ExpiresAtMicros(const registadb::Entry& entry) const;
+
+    static uint64_t NowMicros();
+
+    // index values carry the expiry as an 8-byte big-endian suffix after their fixed part
+    static void AppendExpiry(std::string* value, uint64_t expires_at);
+    static uint64_t ReadExpiry(const char* value, size_t size, size_t fixed_size);
+
+private:
+    uint64_t default_ttl_seconds_;
+    std::map<std::string, uint64_t> source_ttl_seconds_;
+};
+
+/**
+ * @brief Drops index records (index_cf or a metadata index) whose expiry suffix is in the past. Records written without a suffix are kept.
+ * 
+ */
+class IndexExpiryFilter : public rocksdb::CompactionFilter {
+public:
+    IndexExpiryFilter(const char* name, size_t fixed_value_size) : name_(name), fixed_value_size_(fixed_value_size) {}
+
+    bool Filter(int level, const rocksdb::Slice& key, const rocksdb::Slice& existing_value,
+                std::string* new_value, bool* value_changed) const override;
+    const char* Name() const override { return name_; }
+
+    uint64_t expired() const { return expired_.load(std::memory_order_relaxed); }
+
+private:
+    const char* name_;
+    size_t fixed_value_size_;
+    mutable std::atomic<uint64_t> expired_{0};
+};
+
+/**
+ * @brief Drops data_cf entries whose TTL has passed. The entry has to be parsed to apply the policy, so this is only installed when TTLs are configured.
+ * 
+ */
+class DataExpiryFilter : public rocksdb::CompactionFilter {
+public:
+    explicit DataExpiryFilter(const TtlPolicy& policy) : policy_(policy) {}
+
+    bool Filter(int level, const rocksdb::Slice& key, const rocksdb::Slice& existing_value,
+                std::string* new_value, bool* value_changed) const override;
+    const char* Name() const override { return "RegistaDataExpiryFilter"; }
+
+    uint64_t expired() const { return expired_.load(std::memory_order_relaxed); }
+    uint64_t expired_bytes() const { return expired_bytes_.load(std::memory_order_relaxed); }
+
+private:
+    const TtlPolicy& policy_;
+    mutable std::atomic<uint64_t> expired_{0};
+    mutable std::atomic<uint64_t> expired_bytes_{0};
+};
+
+#endif
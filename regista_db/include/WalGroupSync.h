@@ -0,0 +1,46 @@
+#ifndef WAL_GROUP_SYNC_H
+#define WAL_GROUP_SYNC_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// Group sync counters since start
+struct WalSyncStats {
+    uint64_t syncs = 0;          // fsyncs issued
+    uint64_t synced_writes = 0;  // writes acknowledged as durable, syncs / synced_writes is the fsync share per write
+};
+
+
+/**
+ * @brief Makes already committed (unsynced) writes durable with as few WAL fsyncs as possible. A writer that needs durability calls WaitDurable after its write returns; the first waiter becomes the leader and runs one sync, which covers every write completed before it started. Writers arriving during that sync are covered together by the next one.
+ *
+ */
+class WalGroupSync {
+public:
+    using SyncFn = std::function<bool()>;
+
+    explicit WalGroupSync(SyncFn sync = SyncFn());
+
+    // Setup, before the first WaitDurable: the call that fsyncs the WAL
+    void SetSyncFunction(SyncFn sync);
+
+    // Blocks until a sync that started after the caller's write has finished, returns false if it failed
+    bool WaitDurable();
+
+    WalSyncStats GetStats() const;
+
+private:
+    SyncFn sync_;
+    mutable std::mutex mutex_;
+    std::condition_variable synced_;
+    uint64_t written_ = 0;     // tickets handed to writers
+    uint64_t synced_upto_ = 0; // every ticket up to here is durable
+    bool sync_running_ = false;
+    bool failed_ = false;      // a WAL sync failed, nothing is acknowledged as durable afterwards
+    uint64_t syncs_ = 0;
+    uint64_t synced_writes_ = 0;
+};
+
+#endif
@@ -13,14 +13,36 @@ namespace api {
     public:
         METHOD_LIST_BEGIN
             ADD_METHOD_TO(EntryController::handleCreate, "/entries", Post);
+            ADD_METHOD_TO(EntryController::handleScan, "/entries", Get);
+            ADD_METHOD_TO(EntryController::handleBatchCreate, "/entries:batch", Post);
+            ADD_METHOD_TO(EntryController::handleBatchGet, "/entries:batchGet", Post);
+            ADD_METHOD_TO(EntryController::handleAggregate, "/entries:aggregate", Get);
+            ADD_METHOD_TO(EntryController::handleQueryByMetadata, "/entries/by/{key}/{value}", Get);
             ADD_METHOD_TO(EntryController::handleRead, "/entries/{id}", Get);
-            ADD_METHOD_TO(EntryController::handleUpdate, "/entries/{id}", Put);
+            ADD_METHOD_TO(EntryController::handleUpdate, "/entries/{id}", Put, Patch);
             ADD_METHOD_TO(EntryController::handleDelete, "/entries/{id}", Delete); 
         METHOD_LIST_END
 
         void handleCreate(const HttpRequestPtr& req, 
                         std::function<void(const HttpResponsePtr&)>&& callback);
 
+        void handleScan(const HttpRequestPtr& req, 
+                        std::function<void(const HttpResponsePtr&)>&& callback);
+
+        void handleBatchCreate(const HttpRequestPtr& req, 
+                        std::function<void(const HttpResponsePtr&)>&& callback);
+
+        void handleBatchGet(const HttpRequestPtr& req, 
+                        std::function<void(const HttpResponsePtr&)>&& callback);
+
+        void handleAggregate(const HttpRequestPtr& req, 
+                        std::function<void(const HttpResponsePtr&)>&& callback);
+
+        void handleQueryByMetadata(const HttpRequestPtr& req, 
+                        std::function<void(const HttpResponsePtr&)>&& callback, 
+                        const std::string& key, 
+                        const std::string& value);
+
         void handleRead(const HttpRequestPtr& req, 
                         std::function<void(const HttpResponsePtr&)>&& callback, 
                         uint64_t id);
@@ -0,0 +1,154 @@
+#include "ConfigParsing.h"
+#include <charconv>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+
+/**
+ * @brief Parses text as a number of type T, with nothing before or after it.
+ * 
+ * @param text The text to parse.
+ * @param out Output for the value.
+ * @return true if the whole text is a number in T's range.
+ * @return false otherwise.
+ */
+template <typename T>
+static bool parse_number(const std::string& text, T* out) {
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, *out);
+    return ec == std::errc() && ptr == end && !text.empty();
+}
+
+/**
+ * @brief Prints the error for an option whose value could not be parsed.
+ * 
+ * @param name The env var or flag.
+ * @param text The rejected value.
+ * @param expected What the value has to be.
+ * @return false always, so callers can return it.
+ */
+static bool invalid_option(const std::string& name, const std::string& text, const char* expected) {
+    std::cerr << "[Config] Invalid " << name << " '" << text << "' (expected " << expected << ")" << std::endl;
+    return false;
+}
+
+/**
+ * @brief Splits a comma separated list (e.g. "source,location"), dropping empty items.
+ * 
+ * @param list The comma separated list.
+ * @return std::vector<std::string> The list items.
+ */
+std::vector<std::string> parse_string_list(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+/**
+ * @brief Parses a comma separated list of name=seconds pairs (e.g. "thermal=86400,humidity=3600").
+ * 
+ * @param name The env var or flag, for the error.
+ * @param list The comma separated list.
+ * @param out Output for the seconds by name.
+ * @return true if every item is a name=seconds pair.
+ * @return false otherwise.
+ */
+bool parse_ttl_map(const std::string& name, const std::string& list, std::map<std::string, uint64_t>* out) {
+    out->clear();
+    for (const auto& item : parse_string_list(list)) {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos || !parse_number(item.substr(eq + 1), &(*out)[item.substr(0, eq)])) {
+            return invalid_option(name, list, "name=seconds pairs separated by commas");
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Parses a comma separated list of core ids (e.g. "2,3,4"), -1 leaving a worker unpinned.
+ * 
+ * @param name The env var or flag, for the error.
+ * @param list The comma separated list.
+ * @param out Output for the core ids.
+ * @return true if every item is a core id.
+ * @return false otherwise.
+ */
+bool parse_core_list(const std::string& name, const std::string& list, std::vector<int>* out) {
+    out->clear();
+    for (const auto& item : parse_string_list(list)) {
+        int core = 0;
+        if (!parse_number(item, &core) || core < -1) {
+            return invalid_option(name, list, "core ids separated by commas");
+        }
+        out->push_back(core);
+    }
+    return true;
+}
+
+/**
+ * @brief Parses a non-negative integer option.
+ * 
+ * @param name The env var or flag, for the error.
+ * @param text The value.
+ * @param out Output for the value times scale.
+ * @param scale Unit of the value, e.g. 1024 * 1024 for an option given in MB.
+ * @return true if the value was parsed.
+ * @return false if it is not a non-negative integer or overflows once scaled.
+ */
+bool parse_option(const std::string& name, const std::string& text, uint64_t* out, uint64_t scale) {
+    uint64_t value = 0;
+    if (!parse_number(text, &value) || value > std::numeric_limits<uint64_t>::max() / scale) {
+        return invalid_option(name, text, "a non-negative integer");
+    }
+    *out = value * scale;
+    return true;
+}
+
+/**
+ * @brief Parses a non-negative integer option that has to fit in an unsigned.
+ * 
+ * @param name The env var or flag, for the error.
+ * @param text The value.
+ * @param out Output for the value.
+ * @return true if the value was parsed.
+ * @return false otherwise.
+ */
+bool parse_option(const std::string& name, const std::string& text, unsigned* out) {
+    return parse_number(text, out) || invalid_option(name, text, "a non-negative integer");
+}
+
+/**
+ * @brief Parses a decimal option (e.g. "0.25").
+ * 
+ * @param name The env var or flag, for the error.
+ * @param text The value.
+ * @param out Output for the value.
+ * @return true if the value was parsed.
+ * @return false otherwise.
+ */
+bool parse_option(const std::string& name, const std::string& text, double* out) {
+    return parse_number(text, out) || invalid_option(name, text, "a number");
+}
+
+/**
+ * @brief Parses a duration option given in microseconds.
+ * 
+ * @param name The env var or flag, for the error.
+ * @param text The value.
+ * @param out Output for the duration.
+ * @return true if the value was parsed.
+ * @return false otherwise.
+ */
+bool parse_option(const std::string& name, const std::string& text, std::chrono::microseconds* out) {
+    uint64_t micros = 0;
+    if (!parse_number(text, &micros) || micros > static_cast<uint64_t>(std::chrono::microseconds::max().count())) {
+        return invalid_option(name, text, "a non-negative number of microseconds");
+    }
+    *out = std::chrono::microseconds(micros);
+    return true;
+}
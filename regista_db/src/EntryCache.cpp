@@ -0,0 +1,132 @@
+#include "EntryCache.h"
+
+/**
+ * @brief Construct a new Entry Cache object.
+ * 
+ * @param capacity_bytes Total size bound across all shards, counting value bytes plus per-entry overhead.
+ * @param shard_count Number of independently locked shards, rounded up to a power of two.
+ */
+EntryCache::EntryCache(size_t capacity_bytes, size_t shard_count) {
+    size_t shards = 1;
+    while (shards < shard_count) shards <<= 1;
+    shards_.reset(new Shard[shards]);
+    shard_mask_ = shards - 1;
+    shard_capacity_ = capacity_bytes / shards;
+}
+
+/**
+ * @brief Picks the shard for an id. Ids are mostly sequential, so they are mixed first to spread neighbours across shards.
+ * 
+ * @param id The entry id.
+ * @return Shard& The shard that owns the id.
+ */
+EntryCache::Shard& EntryCache::ShardFor(uint64_t id) {
+    uint64_t h = id * 0x9E3779B97F4A7C15ULL;
+    return shards_[(h >> 32) & shard_mask_];
+}
+
+/**
+ * @brief Bytes charged against the capacity for one cached value: the value itself plus list and map node overhead.
+ * 
+ * @param value The cached value.
+ * @return size_t The charge in bytes.
+ */
+size_t EntryCache::Charge(const std::string& value) {
+    return value.size() + 64;
+}
+
+/**
+ * @brief Looks up an id. A hit moves the entry to the front of its shard's LRU list.
+ * 
+ * @param id The entry id.
+ * @param out_value Output for the serialized entry on a hit.
+ * @return true on a hit.
+ * @return false on a miss, the caller must call Fill for this id.
+ */
+bool EntryCache::Get(uint64_t id, std::string* out_value) {
+    Shard& shard = ShardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.map.find(id);
+    if (it == shard.map.end()) {
+        shard.misses++;
+        shard.pending[id].readers++;
+        return false;
+    }
+    shard.hits++;
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    *out_value = it->second->second;
+    return true;
+}
+
+/**
+ * @brief Completes a miss. The value is cached only if no write to the id committed since the miss, then least recently used entries are evicted until the shard is back under capacity.
+ * 
+ * @param id The entry id passed to the missing Get.
+ * @param value The serialized entry read from the store, or nullptr if it was not found.
+ */
+void EntryCache::Fill(uint64_t id, const std::string* value) {
+    Shard& shard = ShardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    bool invalidated = false;
+    auto pending = shard.pending.find(id);
+    if (pending != shard.pending.end()) {
+        invalidated = pending->second.invalidated;
+        if (--pending->second.readers == 0) shard.pending.erase(pending);
+    }
+    if (invalidated || !value || Charge(*value) > shard_capacity_) return;
+    if (shard.map.count(id)) return; // another reader filled it first
+
+    shard.lru.emplace_front(id, *value);
+    shard.map[id] = shard.lru.begin();
+    shard.bytes += Charge(*value);
+
+    while (shard.bytes > shard_capacity_) {
+        auto& victim = shard.lru.back();
+        shard.bytes -= Charge(victim.second);
+        shard.map.erase(victim.first);
+        shard.lru.pop_back();
+        shard.evictions++;
+    }
+}
+
+/**
+ * @brief Drops a cached id and flags any in-flight miss for it, so that miss does not cache what it read.
+ * 
+ * @param id The entry id that was written or deleted.
+ */
+void EntryCache::Invalidate(uint64_t id) {
+    Shard& shard = ShardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.map.find(id);
+    if (it != shard.map.end()) {
+        shard.bytes -= Charge(it->second->second);
+        shard.lru.erase(it->second);
+        shard.map.erase(it);
+    }
+    auto pending = shard.pending.find(id);
+    if (pending != shard.pending.end()) {
+        pending->second.invalidated = true;
+    }
+}
+
+/**
+ * @brief Sums the counters of every shard.
+ * 
+ * @return EntryCacheStats The totals.
+ */
+EntryCacheStats EntryCache::GetStats() const {
+    EntryCacheStats stats;
+    for (size_t i = 0; i <= shard_mask_; ++i) {
+        const Shard& shard = shards_[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.entries += shard.map.size();
+        stats.bytes += shard.bytes;
+    }
+    return stats;
+}
@@ -0,0 +1,435 @@
+#include "EntryCodec.h"
+#include <algorithm>
+#include <cstring>
+#include <endian.h>
+#include <vector>
+
+namespace {
+
+// Appends bits least significant first, a little-endian word at a time
+class BitWriter {
+public:
+    explicit BitWriter(std::string* out) : out_(out) {}
+
+    // value must not have bits set above bits (0..64)
+    void Write(uint64_t value, unsigned bits) {
+        if (bits == 0) return;
+        acc_ |= value << filled_;
+        if (filled_ + bits < 64) {
+            filled_ += bits;
+            return;
+        }
+        uint64_t word = htole64(acc_);
+        out_->append(reinterpret_cast<const char*>(&word), 8);
+        unsigned used = 64 - filled_;
+        acc_ = used == 64 ? 0 : value >> used;
+        filled_ = filled_ + bits - 64;
+    }
+
+    void Finish() {
+        uint64_t word = htole64(acc_);
+        out_->append(reinterpret_cast<const char*>(&word), (filled_ + 7) / 8);
+        acc_ = 0;
+        filled_ = 0;
+    }
+
+private:
+    std::string* out_;
+    uint64_t acc_ = 0;
+    unsigned filled_ = 0;
+};
+
+// Reads what BitWriter wrote, failing instead of reading past the end
+class BitReader {
+public:
+    BitReader(const char* data, size_t size) : data_(data), end_(data + size) {}
+
+    bool Read(unsigned bits, uint64_t* value) {
+        if (bits <= avail_) {
+            *value = bits == 64 ? acc_ : acc_ & ((uint64_t(1) << bits) - 1);
+            acc_ = bits == 64 ? 0 : acc_ >> bits;
+            avail_ -= bits;
+            return true;
+        }
+        size_t bytes = std::min<size_t>(8, end_ - data_);
+        unsigned need = bits - avail_;
+        if (bytes * 8 < need) return false;
+        uint64_t word = 0;
+        std::memcpy(&word, data_, bytes);
+        word = le64toh(word);
+        data_ += bytes;
+
+        uint64_t result = acc_ | (word << avail_);
+        *value = bits == 64 ? result : result & ((uint64_t(1) << bits) - 1);
+        acc_ = need == 64 ? 0 : word >> need;
+        avail_ = static_cast<unsigned>(bytes * 8) - need;
+        return true;
+    }
+
+private:
+    const char* data_;
+    const char* end_;
+    uint64_t acc_ = 0;
+    unsigned avail_ = 0;
+};
+
+void PutVarint(std::string* out, uint64_t value) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+bool GetVarint(const char** p, const char* end, uint64_t* value) {
+    *value = 0;
+    for (unsigned shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*(*p)++);
+        *value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+inline uint64_t ZigZag(uint64_t value) {
+    return (value << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(value) >> 63);
+}
+
+inline uint64_t UnZigZag(uint64_t value) {
+    return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+const double kPowersOf10[] = {1, 10, 100, 1000, 10000};
+static_assert(sizeof(kPowersOf10) / sizeof(kPowersOf10[0]) == kColumnarMaxScale + 1, "one power per scale");
+
+// a decimal's scaled integer has to round-trip exactly, and stay well inside the range a double holds exactly
+bool ScalesExactly(double value, double power, int64_t* scaled) {
+    double product = value * power;
+    if (!(product > -9.0e15 && product < 9.0e15)) return false;
+    int64_t n = static_cast<int64_t>(product < 0 ? product - 0.5 : product + 0.5);
+    double back = static_cast<double>(n) / power;
+    if (std::memcmp(&back, &value, 8) != 0) return false;
+    *scaled = n;
+    return true;
+}
+
+} // namespace
+
+/**
+ * @brief Gorilla XOR encoding: the first value is stored whole, every later one as the XOR with its predecessor. An unchanged value costs one bit; a change whose significant bits fit inside the previous window costs two bits plus those bits; anything else also stores a new window (5 bits of leading zeros, 6 bits of length). Slowly moving sensor readings share sign, exponent and high mantissa bits, so they pack well below 8 bytes.
+ *
+ * @param values The values.
+ * @param n Number of values.
+ * @param out Output the packed bits are appended to.
+ */
+void EncodeDoubleColumn(const double* values, size_t n, std::string* out) {
+    if (n == 0) return;
+    BitWriter writer(out);
+    uint64_t prev;
+    std::memcpy(&prev, &values[0], 8);
+    writer.Write(prev, 64);
+
+    unsigned window_leading = 0;
+    unsigned window_trailing = 0;
+    bool has_window = false;
+    for (size_t i = 1; i < n; ++i) {
+        uint64_t bits;
+        std::memcpy(&bits, &values[i], 8);
+        uint64_t x = bits ^ prev;
+        prev = bits;
+        if (x == 0) {
+            writer.Write(0, 1);
+            continue;
+        }
+        writer.Write(1, 1);
+        unsigned leading = std::min<unsigned>(__builtin_clzll(x), 31);
+        unsigned trailing = __builtin_ctzll(x);
+        if (has_window && leading >= window_leading && trailing >= window_trailing) {
+            writer.Write(0, 1);
+            writer.Write(x >> window_trailing, 64 - window_leading - window_trailing);
+            continue;
+        }
+        unsigned significant = 64 - leading - trailing;
+        writer.Write(1, 1);
+        writer.Write(leading, 5);
+        writer.Write(significant - 1, 6);
+        writer.Write(x >> trailing, significant);
+        window_leading = leading;
+        window_trailing = trailing;
+        has_window = true;
+    }
+    writer.Finish();
+}
+
+/**
+ * @brief Decodes n values written by EncodeDoubleColumn.
+ *
+ * @param data The packed bits.
+ * @param size Size of data in bytes.
+ * @param n Number of values to decode.
+ * @param values Output for n values.
+ * @return true if all n values were decoded.
+ * @return false if data is truncated or malformed.
+ */
+bool DecodeDoubleColumn(const char* data, size_t size, size_t n, double* values) {
+    if (n == 0) return true;
+    BitReader reader(data, size);
+    uint64_t prev;
+    if (!reader.Read(64, &prev)) return false;
+    std::memcpy(&values[0], &prev, 8);
+
+    unsigned window_leading = 0;
+    unsigned window_trailing = 0;
+    for (size_t i = 1; i < n; ++i) {
+        uint64_t flag;
+        if (!reader.Read(1, &flag)) return false;
+        if (flag) {
+            uint64_t new_window;
+            if (!reader.Read(1, &new_window)) return false;
+            if (new_window) {
+                uint64_t leading, significant;
+                if (!reader.Read(5, &leading) || !reader.Read(6, &significant)) return false;
+                significant += 1;
+                if (leading + significant > 64) return false;
+                window_leading = static_cast<unsigned>(leading);
+                window_trailing = static_cast<unsigned>(64 - leading - significant);
+            }
+            uint64_t x;
+            if (!reader.Read(64 - window_leading - window_trailing, &x)) return false;
+            prev ^= x << window_trailing;
+        }
+        std::memcpy(&values[i], &prev, 8);
+    }
+    return true;
+}
+
+/**
+ * @brief Delta-of-delta encoding for integers: counters, timestamps and slowly moving readings have near-constant steps, so the second difference is mostly 0 or tiny. The first value and the first delta are written as zigzag varints, so the packed blocks only hold real second differences and the first block is not widened by a value measured against zero. Every block of kColumnarIntBlock zigzagged second differences is bit-packed at the width of its largest one: a width byte, then the values, padded to a whole byte. The difference and width passes are plain loops over the block with no carried state, which the compiler vectorizes.
+ *
+ * @param values The values.
+ * @param n Number of values.
+ * @param out Output the varints and packed blocks are appended to.
+ */
+void EncodeIntColumn(const int64_t* values, size_t n, std::string* out) {
+    // unsigned, so the differences wrap instead of overflowing
+    const uint64_t* v = reinterpret_cast<const uint64_t*>(values);
+    if (n == 0) return;
+    PutVarint(out, ZigZag(v[0]));
+    if (n == 1) return;
+    PutVarint(out, ZigZag(v[1] - v[0]));
+
+    uint64_t block[kColumnarIntBlock];
+    for (size_t begin = 2; begin < n; begin += kColumnarIntBlock) {
+        const size_t len = std::min(kColumnarIntBlock, n - begin);
+        const uint64_t* cur = v + begin;
+        size_t i;
+        for (i = 0; i < len; ++i) block[i] = ZigZag(cur[i] - 2 * cur[i - 1] + cur[i - 2]);
+
+        uint64_t any = 0;
+        for (i = 0; i < len; ++i) any |= block[i];
+        unsigned width = any == 0 ? 0 : 64 - __builtin_clzll(any);
+        out->push_back(static_cast<char>(width));
+        BitWriter writer(out);
+        for (i = 0; i < len; ++i) writer.Write(block[i], width);
+        writer.Finish();
+    }
+}
+
+/**
+ * @brief Decodes n values written by EncodeIntColumn. After the two leading varints, a block is unpacked with one unaligned 8-byte load and a shift per value (while 8 bytes remain and the width is at most 56 bits), unzigzagged in its own pass, and then two running sums rebuild the deltas and the values. The running sums carry a dependency from value to value and cannot be vectorized; the whole decode runs at about 1.4 ns per value (BM_DecodeStoredList), well below parsing the rest of a short entry, so there is no hand-written SIMD path.
+ *
+ * @param data The varints and packed blocks.
+ * @param size Size of data in bytes.
+ * @param n Number of values to decode.
+ * @param values Output for n values.
+ * @return true if all n values were decoded.
+ * @return false if data is truncated or malformed.
+ */
+bool DecodeIntColumn(const char* data, size_t size, size_t n, int64_t* values) {
+    const char* p = data;
+    const char* end = data + size;
+    if (n == 0) return true;
+    uint64_t prev, prev_delta;
+    if (!GetVarint(&p, end, &prev)) return false;
+    prev = UnZigZag(prev);
+    values[0] = static_cast<int64_t>(prev);
+    if (n == 1) return true;
+    if (!GetVarint(&p, end, &prev_delta)) return false;
+    prev_delta = UnZigZag(prev_delta);
+    prev += prev_delta;
+    values[1] = static_cast<int64_t>(prev);
+
+    uint64_t block[kColumnarIntBlock];
+    for (size_t begin = 2; begin < n; begin += kColumnarIntBlock) {
+        const size_t len = std::min(kColumnarIntBlock, n - begin);
+        if (p == end) return false;
+        const unsigned width = static_cast<uint8_t>(*p++);
+        const size_t bytes = (len * width + 7) / 8;
+        if (width > 64 || bytes > static_cast<size_t>(end - p)) return false;
+
+        size_t i = 0;
+        if (width <= 56) {
+            // the load may run into the next block, the mask drops those bits
+            const uint64_t mask = (uint64_t(1) << width) - 1;
+            const size_t avail = end - p;
+            for (; i < len && (i * width) / 8 + 8 <= avail; ++i) {
+                uint64_t word;
+                std::memcpy(&word, p + (i * width) / 8, 8);
+                block[i] = (le64toh(word) >> ((i * width) % 8)) & mask;
+            }
+        }
+        if (i < len) {
+            // the tail of the block, or every value of a wider one
+            const size_t offset = (i * width) / 8;
+            BitReader reader(p + offset, bytes - offset);
+            uint64_t skipped;
+            reader.Read(static_cast<unsigned>((i * width) % 8), &skipped);
+            for (; i < len; ++i) {
+                if (!reader.Read(width, &block[i])) return false;
+            }
+        }
+        p += bytes;
+
+        for (i = 0; i < len; ++i) block[i] = UnZigZag(block[i]);
+        for (i = 0; i < len; ++i) {
+            prev_delta += block[i];
+            prev += prev_delta;
+            values[begin + i] = static_cast<int64_t>(prev);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Finds the fewest decimals every value has, so a series of readings like 21.37 can be stored as integers 2137 and go through the delta-of-delta codec, which packs it far tighter than XOR of the doubles. A value is only accepted if dividing its integer by the power of 10 gives back the same bits, so decoding is exact (NaN, infinities and -0.0 never are). A larger scale can push an earlier value out of int64 range, so every value is checked again whenever the scale grows.
+ *
+ * @param values The values.
+ * @param n Number of values.
+ * @return int Scale 0..kColumnarMaxScale, or -1 if some value needs more decimals.
+ */
+int FindDecimalScale(const double* values, size_t n) {
+    int scale = 0;
+    int64_t scaled;
+    for (size_t i = 0; i < n; ++i) {
+        if (ScalesExactly(values[i], kPowersOf10[scale], &scaled)) continue;
+        if (++scale > kColumnarMaxScale) return -1;
+        // start over at the new scale, the next pass checks values[0] again
+        i = static_cast<size_t>(-1);
+    }
+    return scale;
+}
+
+/**
+ * @brief Encodes an entry for data_cf. With columnar set, a double or int list of at least kColumnarMinValues values is stored as a column after the rest of the entry, unless that turns out larger than the plain serialization (e.g. random doubles).
+ *
+ * @param entry The entry to encode.
+ * @param columnar Whether numeric lists may be stored as columns.
+ * @param out Output for the encoded value, replaced.
+ */
+void EncodeStoredEntry(const registadb::Entry& entry, bool columnar, std::string* out) {
+    const auto& data = entry.data();
+    const bool doubles = data.has_double_list() && data.double_list().value_size() >= static_cast<int>(kColumnarMinValues);
+    const bool ints = data.has_int_list() && data.int_list().value_size() >= static_cast<int>(kColumnarMinValues);
+    if (!columnar || (!doubles && !ints)) {
+        entry.SerializeToString(out);
+        return;
+    }
+
+    // every Entry field but data
+    registadb::Entry header;
+    header.set_id(entry.id());
+    *header.mutable_metadata() = entry.metadata();
+    if (entry.has_created_at()) *header.mutable_created_at() = entry.created_at();
+    if (entry.has_updated_at()) *header.mutable_updated_at() = entry.updated_at();
+    header.set_ttl_seconds(entry.ttl_seconds());
+    const size_t header_size = header.ByteSizeLong();
+
+    out->clear();
+    out->push_back(kColumnarMarker);
+    out->push_back(doubles ? kColumnarDoubles : kColumnarInts);
+    PutVarint(out, header_size);
+    size_t offset = out->size();
+    out->resize(offset + header_size);
+    header.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(&(*out)[offset]));
+    const int scale = doubles ? FindDecimalScale(data.double_list().value().data(), data.double_list().value_size()) : -1;
+    std::vector<int64_t> scaled;
+    bool decimals = scale >= 0;
+    if (decimals) {
+        const auto& values = data.double_list().value();
+        scaled.resize(values.size());
+        for (int i = 0; decimals && i < values.size(); ++i) {
+            decimals = ScalesExactly(values[i], kPowersOf10[scale], &scaled[i]);
+        }
+    }
+    if (decimals) {
+        (*out)[1] = kColumnarDecimals;
+        const auto& values = data.double_list().value();
+        PutVarint(out, values.size());
+        out->push_back(static_cast<char>(scale));
+        EncodeIntColumn(scaled.data(), scaled.size(), out);
+    } else if (doubles) {
+        PutVarint(out, data.double_list().value_size());
+        EncodeDoubleColumn(data.double_list().value().data(), data.double_list().value_size(), out);
+    } else {
+        PutVarint(out, data.int_list().value_size());
+        EncodeIntColumn(data.int_list().value().data(), data.int_list().value_size(), out);
+    }
+
+    if (out->size() >= entry.ByteSizeLong()) entry.SerializeToString(out);
+}
+
+/**
+ * @brief Decodes a data_cf value written by EncodeStoredEntry, in either format.
+ *
+ * @param data The stored value.
+ * @param size Size of the value in bytes.
+ * @param out Output entry, replaced.
+ * @param with_data Whether to decode a column, false leaves out the list of a columnar value.
+ * @return true if the value was decoded.
+ * @return false if it is malformed.
+ */
+bool DecodeStoredEntry(const char* data, size_t size, registadb::Entry* out, bool with_data) {
+    if (size == 0 || data[0] != kColumnarMarker) {
+        return out->ParseFromArray(data, static_cast<int>(size));
+    }
+
+    if (size < 2) return false;
+    const char* p = data + 2;
+    const char* end = data + size;
+    uint64_t header_size;
+    if (!GetVarint(&p, end, &header_size) || header_size > static_cast<uint64_t>(end - p)) return false;
+    if (!out->ParseFromArray(p, static_cast<int>(header_size))) return false;
+    p += header_size;
+    if (!with_data) return true;
+
+    uint64_t count;
+    if (!GetVarint(&p, end, &count)) return false;
+    const uint64_t bits = static_cast<uint64_t>(end - p) * 8;
+    if (data[1] == kColumnarDoubles) {
+        // every value after the first takes at least one bit
+        if (count > bits + 1) return false;
+        auto* values = out->mutable_data()->mutable_double_list()->mutable_value();
+        values->Resize(static_cast<int>(count), 0.0);
+        return DecodeDoubleColumn(p, end - p, count, values->mutable_data());
+    }
+    if (data[1] == kColumnarDecimals) {
+        if (p == end || static_cast<uint8_t>(*p) > kColumnarMaxScale) return false;
+        const double power = kPowersOf10[static_cast<uint8_t>(*p++)];
+        if (count > static_cast<uint64_t>(end - p) * kColumnarIntBlock) return false;
+        std::vector<int64_t> scaled(count);
+        if (!DecodeIntColumn(p, end - p, count, scaled.data())) return false;
+        auto* values = out->mutable_data()->mutable_double_list()->mutable_value();
+        values->Resize(static_cast<int>(count), 0.0);
+        double* dst = values->mutable_data();
+        for (size_t i = 0; i < count; ++i) dst[i] = static_cast<double>(scaled[i]) / power;
+        return true;
+    }
+    if (data[1] == kColumnarInts) {
+        // every block takes at least its width byte
+        if (count > static_cast<uint64_t>(end - p) * kColumnarIntBlock) return false;
+        auto* values = out->mutable_data()->mutable_int_list()->mutable_value();
+        values->Resize(static_cast<int>(count), 0);
+        return DecodeIntColumn(p, end - p, count, values->mutable_data());
+    }
+    return false;
+}
@@ -0,0 +1,195 @@
+#include "IdAllocator.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// The slot this thread last used, and the allocator instance it belongs to,
+// so a thread that talks to another allocator (tests, benchmarks) looks its slot up again.
+struct SlotCache {
+    uint64_t owner = 0;
+    void* slot = nullptr;
+};
+
+thread_local SlotCache tl_slot;
+std::atomic<uint64_t> next_instance{1};
+
+}
+
+
+/**
+ * @brief Construct a new Id Allocator:: Id Allocator object. Allocation starts at 1 until Reset is called.
+ *
+ * @param block_size Number of contiguous ids leased to a thread at a time.
+ */
+IdAllocator::IdAllocator(uint64_t block_size)
+    : instance_(next_instance.fetch_add(1)), block_size_(std::max<uint64_t>(block_size, 1)),
+      slots_(new LeaseSlot[kMaxLeaseSlots]) {}
+
+/**
+ * @brief Sets the block size and the callback that persists the high-water mark. Must be called before the first Next().
+ *
+ * @param block_size Number of contiguous ids leased to a thread at a time.
+ * @param persist Writes the high-water mark durably, returns false on failure. May be empty (no persistence).
+ */
+void IdAllocator::Configure(uint64_t block_size, PersistFn persist) {
+    block_size_ = std::max<uint64_t>(block_size, 1);
+    persist_ = std::move(persist);
+}
+
+/**
+ * @brief Restarts allocation after every id that is already in use and drops all outstanding leases. Setup only, it must not run concurrently with Next.
+ *
+ * @param last_id Highest id known to exist.
+ * @param persisted_high_water Mark read back from storage; ids below it may have been handed out before a restart.
+ */
+void IdAllocator::Reset(uint64_t last_id, uint64_t persisted_high_water) {
+    uint64_t start = std::max(last_id + 1, persisted_high_water);
+    floor_.store(start - 1, std::memory_order_relaxed);
+    next_block_start_.store(start, std::memory_order_relaxed);
+    persisted_high_water_.store(persisted_high_water, std::memory_order_relaxed);
+
+    size_t count = slot_count_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+        slots_[i].end.store(0, std::memory_order_release);
+    }
+}
+
+/**
+ * @brief Returns the calling thread's lease slot, taking a free one on its first call.
+ *
+ * @return LeaseSlot* The slot, nullptr once kMaxLeaseSlots threads have one.
+ */
+IdAllocator::LeaseSlot* IdAllocator::SlotForThread() {
+    if (tl_slot.owner == instance_) {
+        return static_cast<LeaseSlot*>(tl_slot.slot);
+    }
+
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    LeaseSlot*& slot = thread_slots_[std::this_thread::get_id()];
+    if (!slot) {
+        size_t count = slot_count_.load(std::memory_order_relaxed);
+        if (count < kMaxLeaseSlots) {
+            slot = &slots_[count];
+            slot_count_.store(count + 1, std::memory_order_release);
+        }
+    }
+    tl_slot.owner = instance_;
+    tl_slot.slot = slot;
+    return slot;
+}
+
+/**
+ * @brief Returns the next id. Ids are unique but only increase within a thread, not across threads.
+ *
+ * @return uint64_t The allocated id.
+ */
+uint64_t IdAllocator::Next() {
+    LeaseSlot* slot = SlotForThread();
+    if (slot) {
+        uint64_t id = slot->next.load(std::memory_order_relaxed);
+        if (id < slot->end.load(std::memory_order_acquire)) {
+            slot->next.store(id + 1, std::memory_order_seq_cst);
+            // checked again once next is published: an Observe that cut the lease at or below id before
+            // seeing next move claimed it for a client, otherwise Observe sees the id as handed out
+            if (id < slot->end.load(std::memory_order_seq_cst)) {
+                return id;
+            }
+        }
+    }
+    return LeaseBlock(slot);
+}
+
+/**
+ * @brief Takes a new block for the calling thread, persisting the high-water mark first when the block reaches it. Without a slot the block is a single id, which needs no lease.
+ *
+ * @param slot The calling thread's slot, or nullptr.
+ * @return uint64_t The first id of the new block.
+ */
+uint64_t IdAllocator::LeaseBlock(LeaseSlot* slot) {
+    const uint64_t size = slot ? block_size_ : 1;
+    uint64_t start = next_block_start_.fetch_add(size, std::memory_order_acq_rel);
+    uint64_t end = start + size;
+    if (end > persisted_high_water_.load(std::memory_order_acquire)) {
+        PersistHighWater(end);
+    }
+    leases_.fetch_add(1, std::memory_order_relaxed);
+    if (!slot) return start;
+
+    // closed while it is rewritten, blocks only grow so a reader mixing old and new bounds sees an empty range
+    slot->end.store(0, std::memory_order_seq_cst);
+    slot->start.store(start, std::memory_order_relaxed);
+    slot->next.store(start + 1, std::memory_order_seq_cst);
+    slot->end.store(end, std::memory_order_seq_cst);
+    return start;
+}
+
+/**
+ * @brief Moves the persisted mark kPersistAheadBlocks past block_end. Only one thread writes at a time; others that need a mark already covered skip the write.
+ *
+ * @param block_end End (exclusive) of the block that needs to be covered.
+ */
+void IdAllocator::PersistHighWater(uint64_t block_end) {
+    std::lock_guard<std::mutex> lock(persist_mutex_);
+    if (block_end <= persisted_high_water_.load(std::memory_order_acquire)) {
+        return;
+    }
+    uint64_t mark = block_end + kPersistAheadBlocks * block_size_;
+    if (persist_ && !persist_(mark)) {
+        std::cerr << "[IdAllocator] Failed to persist high-water mark " << mark << std::endl;
+    }
+    persisted_high_water_.store(mark, std::memory_order_release);
+}
+
+/**
+ * @brief Records a client-supplied id. Ids past everything leased move the next block beyond them. An id a lease has already handed out (an upsert of a generated id) or that no lease holds any more needs nothing. Only an id in the part of a lease not yet handed out is a collision: that one lease is cut short before it, and its thread leases a new block when it gets there.
+ *
+ * An Observe racing the lease of the block that holds its id can miss it, the same as a client id written before the block was leased.
+ *
+ * @param id The client-supplied id.
+ * @return true The id was still to be handed out by a lease, which no longer will.
+ * @return false The id is new territory, predates this allocator or was already handed out.
+ */
+bool IdAllocator::Observe(uint64_t id) {
+    if (id <= floor_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    uint64_t current = next_block_start_.load(std::memory_order_acquire);
+    while (current <= id) {
+        if (next_block_start_.compare_exchange_weak(current, id + 1, std::memory_order_acq_rel)) {
+            return false;
+        }
+    }
+
+    size_t count = slot_count_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+        LeaseSlot& slot = slots_[i];
+        uint64_t end = slot.end.load(std::memory_order_seq_cst);
+        if (id >= end || id < slot.start.load(std::memory_order_relaxed)) continue;
+
+        // an upsert of an id this lease already handed out
+        if (id < slot.next.load(std::memory_order_seq_cst)) return false;
+
+        // Next publishes next before checking end again, so either it sees the cut and skips the id, or the id
+        // went out concurrently with the client's; both are reported
+        while (id < end && !slot.end.compare_exchange_weak(end, id, std::memory_order_seq_cst)) {
+        }
+        collisions_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Returns the allocator counters.
+ *
+ * @return IdAllocatorStats Leases, collisions and the persisted high-water mark.
+ */
+IdAllocatorStats IdAllocator::GetStats() const {
+    IdAllocatorStats stats;
+    stats.leases = leases_.load(std::memory_order_relaxed);
+    stats.collisions = collisions_.load(std::memory_order_relaxed);
+    stats.high_water = persisted_high_water_.load(std::memory_order_relaxed);
+    return stats;
+}
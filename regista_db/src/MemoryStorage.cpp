@@ -0,0 +1,471 @@
+#include "MemoryStorage.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // snapshot file: magic, then one (uint32 length, serialized Entry) record per entry
+    constexpr char kSnapshotMagic[8] = {'R', 'G', 'S', 'N', 'A', 'P', '0', '1'};
+
+    // fsyncs a file or directory, so its contents (or, for a directory, its entries) survive a crash
+    bool SyncPath(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        bool ok = ::fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+    }
+}
+
+/**
+ * @brief Construct a new Memory Storage object. Loads the snapshot when one is configured and starts the background snapshot thread.
+ * 
+ * @param config Storage options; indexed_metadata_keys and the memory_snapshot_* fields apply to this engine.
+ */
+MemoryStorage::MemoryStorage(StorageConfig config) : config_(std::move(config)) {
+    for (const auto& key : config_.indexed_metadata_keys) {
+        metadata_indexes_[key];
+    }
+
+    GetIdAllocator().Configure(config_.id_block_size, nullptr);
+    SetStartingId(0);
+    if (!config_.memory_snapshot_path.empty()) {
+        LoadSnapshot();
+        if (config_.memory_snapshot_interval_seconds > 0) {
+            snapshot_thread_ = std::thread(&MemoryStorage::SnapshotLoop, this);
+        }
+    }
+}
+
+/**
+ * @brief Destroy the Memory Storage object, writing a final snapshot when persistence is configured.
+ * 
+ */
+MemoryStorage::~MemoryStorage() {
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex_);
+        stopping_ = true;
+    }
+    snapshot_cv_.notify_all();
+    if (snapshot_thread_.joinable()) {
+        snapshot_thread_.join();
+    }
+    if (!config_.memory_snapshot_path.empty() && dirty_) {
+        SaveSnapshot();
+    }
+}
+
+/**
+ * @brief Picks the id shard for an id. Ids are mostly sequential, so they are mixed first to spread neighbours across shards.
+ * 
+ * @param id The entry id.
+ * @return IdShard& The shard that owns the id.
+ */
+MemoryStorage::IdShard& MemoryStorage::ShardFor(uint64_t id) {
+    uint64_t h = id * 0x9E3779B97F4A7C15ULL;
+    return id_shards_[(h >> 32) % kIdShards];
+}
+
+/**
+ * @brief Adds or removes an entry's keys in every declared metadata index. Caller holds order_mutex_ exclusively.
+ * 
+ * @param entry The entry whose metadata is indexed.
+ * @param primary_key The entry's composite key.
+ * @param remove true to remove the index keys, false to add them.
+ */
+void MemoryStorage::IndexMetadataLocked(const registadb::Entry& entry, const std::string& primary_key, bool remove) {
+    for (auto& [key, index] : metadata_indexes_) {
+        auto it = entry.metadata().find(key);
+        if (it == entry.metadata().end()) continue;
+
+        std::string index_key = EncodeMetadataIndexKey(it->second, primary_key);
+        if (remove) {
+            index.erase(index_key);
+        } else {
+            index.insert(std::move(index_key));
+        }
+    }
+}
+
+/**
+ * @brief Inserts or replaces one entry in the id map, the time order and the metadata indexes. Caller holds order_mutex_ exclusively.
+ * 
+ * @param entry The entry to store.
+ */
+void MemoryStorage::ApplyEntryLocked(const registadb::Entry& entry) {
+    auto record = std::make_shared<Record>();
+    record->primary_key = EncodeCompositeKey(ToEpochMicros(entry.created_at()), entry.id());
+    entry.SerializeToString(&record->data);
+
+    RecordPtr old;
+    IdShard& shard = ShardFor(entry.id());
+    {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        RecordPtr& slot = shard.records[entry.id()];
+        old = std::move(slot);
+        slot = record;
+    }
+
+    if (old) {
+        time_order_.erase(old->primary_key);
+        if (!metadata_indexes_.empty()) {
+            registadb::Entry old_entry;
+            if (old_entry.ParseFromString(old->data)) {
+                IndexMetadataLocked(old_entry, old->primary_key, true);
+            }
+        }
+    }
+    time_order_[record->primary_key] = record;
+    IndexMetadataLocked(entry, record->primary_key, false);
+}
+
+/**
+ * @brief Stores an entry in memory.
+ * 
+ * @param entry The entry to store.
+ * @param durability Ignored, entries are only persisted by snapshots.
+ * @param new_id Ignored, replacing a record costs nothing extra in memory.
+ * @return true always, the in-memory engine cannot fail a write.
+ */
+bool MemoryStorage::StoreEntry(const registadb::Entry& entry, registadb::Durability durability, bool new_id) {
+    std::unique_lock<std::shared_mutex> lock(order_mutex_);
+    ApplyEntryLocked(entry);
+    dirty_ = true;
+    return true;
+}
+
+/**
+ * @brief Stores a group of entries under one exclusive lock, so scans see all of the group or none of it.
+ * 
+ * @param entries Pointer to the first entry to store.
+ * @param count Number of entries to store.
+ * @param durability Ignored, entries are only persisted by snapshots.
+ * @param new_ids Ignored, replacing a record costs nothing extra in memory.
+ * @return true always, the in-memory engine cannot fail a write.
+ */
+bool MemoryStorage::StoreEntries(const registadb::Entry* entries, size_t count, registadb::Durability durability, bool new_ids) {
+    if (count == 0) return true;
+
+    std::unique_lock<std::shared_mutex> lock(order_mutex_);
+    for (size_t i = 0; i < count; ++i) {
+        ApplyEntryLocked(entries[i]);
+    }
+    dirty_ = true;
+    return true;
+}
+
+/**
+ * @brief Retrieves an entry by ID. Only the id's shard is locked (shared), and only long enough to copy the record pointer.
+ * 
+ * @param id The ID of the entry to retrieve.
+ * @param out_entry The output entry to populate.
+ * @return true if the entry was found.
+ * @return false otherwise.
+ */
+bool MemoryStorage::GetEntryById(int64_t id, registadb::Entry* out_entry) {
+    uint64_t entry_id = static_cast<uint64_t>(id);
+    RecordPtr record;
+    {
+        IdShard& shard = ShardFor(entry_id);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.records.find(entry_id);
+        if (it == shard.records.end()) return false;
+        record = it->second;
+    }
+    return out_entry->ParseFromString(record->data);
+}
+
+/**
+ * @brief Retrieves many entries by ID.
+ * 
+ * @param ids The IDs to retrieve.
+ * @param out_entries Output vector resized to ids.size(), entry i holds the result for ids[i].
+ * @param out_found Output vector resized to ids.size(), true where the entry was found.
+ */
+void MemoryStorage::GetEntriesByIds(const std::vector<uint64_t>& ids, std::vector<registadb::Entry>* out_entries,
+                                    std::vector<bool>* out_found) {
+    const size_t n = ids.size();
+    out_entries->clear();
+    out_entries->resize(n);
+    out_found->assign(n, false);
+    for (size_t i = 0; i < n; ++i) {
+        (*out_found)[i] = GetEntryById(static_cast<int64_t>(ids[i]), &(*out_entries)[i]);
+    }
+}
+
+/**
+ * @brief Updates an entry under the exclusive order lock, which already serializes every write, so the read and the replace cannot interleave with another write.
+ * 
+ * @param patch The update; patch.id() selects the entry and patch.updated_at() becomes its updated_at.
+ * @param mode How the patch is applied, see StorageBackend::ApplyUpdate.
+ * @param out_entry The entry as stored after the update.
+ * @param durability Ignored, entries are only persisted by snapshots.
+ * @return registadb::OperationStatus STATUS_OK or STATUS_NOT_FOUND.
+ */
+registadb::OperationStatus MemoryStorage::UpdateEntry(const registadb::Entry& patch, registadb::UpdateMode mode,
+                                                      registadb::Entry* out_entry, registadb::Durability durability) {
+    std::unique_lock<std::shared_mutex> order_lock(order_mutex_);
+    if (!GetEntryById(static_cast<int64_t>(patch.id()), out_entry)) {
+        return registadb::STATUS_NOT_FOUND;
+    }
+    ApplyUpdate(patch, mode, out_entry);
+    ApplyEntryLocked(*out_entry);
+    dirty_ = true;
+    return registadb::STATUS_OK;
+}
+
+/**
+ * @brief Deletes an entry by ID from the id map, the time order and the metadata indexes.
+ * 
+ * @param id The ID of the entry to delete.
+ * @param durability Ignored, entries are only persisted by snapshots.
+ * @return true: The entry was deleted.
+ * @return false: No entry had that ID.
+ */
+bool MemoryStorage::DeleteEntryById(int64_t id, registadb::Durability durability) {
+    uint64_t entry_id = static_cast<uint64_t>(id);
+    std::unique_lock<std::shared_mutex> order_lock(order_mutex_);
+
+    RecordPtr old;
+    {
+        IdShard& shard = ShardFor(entry_id);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.records.find(entry_id);
+        if (it == shard.records.end()) return false;
+        old = std::move(it->second);
+        shard.records.erase(it);
+    }
+
+    time_order_.erase(old->primary_key);
+    if (!metadata_indexes_.empty()) {
+        registadb::Entry old_entry;
+        if (old_entry.ParseFromString(old->data)) {
+            IndexMetadataLocked(old_entry, old->primary_key, true);
+        }
+    }
+    dirty_ = true;
+    return true;
+}
+
+/**
+ * @brief Parses collected records into entries, outside of any lock.
+ * 
+ * @param records The records to parse.
+ * @param out_entries Output vector the entries are appended to.
+ */
+void MemoryStorage::ParseRecords(const std::vector<RecordPtr>& records, std::vector<registadb::Entry>* out_entries) {
+    out_entries->reserve(out_entries->size() + records.size());
+    for (const auto& record : records) {
+        out_entries->emplace_back();
+        if (!out_entries->back().ParseFromString(record->data)) {
+            out_entries->pop_back();
+        }
+    }
+}
+
+/**
+ * @brief Reads one page of entries whose creation time falls in [from_ts, to_ts], newest first, with the same bounds and cursor semantics as the RocksDB engine.
+ * 
+ * @param from_ts Oldest creation time to include, in microseconds since epoch.
+ * @param to_ts Newest creation time to include, in microseconds since epoch.
+ * @param limit Maximum number of entries to return.
+ * @param cursor Composite key to resume from (next_cursor of the previous page), empty to start at to_ts.
+ * @param out_entries Output vector the page of entries is appended to.
+ * @param next_cursor Set to the composite key of the next entry, or cleared when the range is exhausted.
+ * @return true if the scan succeeded.
+ * @return false if the cursor is malformed.
+ */
+bool MemoryStorage::ScanRange(uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                              std::vector<registadb::Entry>* out_entries, std::string* next_cursor) {
+    next_cursor->clear();
+    if (!cursor.empty() && cursor.size() != 16) return false;
+    if (from_ts > to_ts || limit == 0) return true;
+
+    std::string lower_key = EncodeCompositeKey(to_ts, 0);
+    std::string upper_key = from_ts > 0 ? EncodeCompositeKey(from_ts - 1, 0) : std::string();
+    std::string seek_key = cursor.empty() ? lower_key : std::max(lower_key, cursor);
+
+    std::vector<RecordPtr> records;
+    {
+        std::shared_lock<std::shared_mutex> lock(order_mutex_);
+        for (auto it = time_order_.lower_bound(seek_key); it != time_order_.end(); ++it) {
+            if (!upper_key.empty() && it->first >= upper_key) break;
+            if (records.size() == limit) {
+                *next_cursor = it->first;
+                break;
+            }
+            records.push_back(it->second);
+        }
+    }
+    ParseRecords(records, out_entries);
+    return true;
+}
+
+/**
+ * @brief Reads one page of entries whose metadata[key] equals value and whose creation time falls in [from_ts, to_ts], newest first.
+ * 
+ * @param key The indexed metadata key.
+ * @param value The metadata value to match.
+ * @param from_ts Oldest creation time to include, in microseconds since epoch.
+ * @param to_ts Newest creation time to include, in microseconds since epoch.
+ * @param limit Maximum number of entries to return.
+ * @param cursor Composite key to resume from (next_cursor of the previous page), empty to start at to_ts.
+ * @param out_entries Output vector the page of entries is appended to.
+ * @param next_cursor Set to the composite key of the next match, or cleared when there are no more.
+ * @return true if the query succeeded.
+ * @return false if the key is not indexed or the cursor is malformed.
+ */
+bool MemoryStorage::QueryByMetadata(const std::string& key, const std::string& value,
+                                    uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                                    std::vector<registadb::Entry>* out_entries, std::string* next_cursor) {
+    next_cursor->clear();
+    auto index_it = metadata_indexes_.find(key);
+    if (index_it == metadata_indexes_.end()) return false;
+    if (!cursor.empty() && cursor.size() != 16) return false;
+    if (from_ts > to_ts || limit == 0) return true;
+
+    const std::string prefix = value + std::string(1, '\0');
+    std::string lower_key = prefix + EncodeCompositeKey(to_ts, 0);
+    std::string upper_key = from_ts > 0 ? prefix + EncodeCompositeKey(from_ts - 1, 0)
+                                        : value + std::string(1, '\1');
+    std::string seek_key = cursor.empty() ? lower_key : std::max(lower_key, prefix + cursor);
+
+    std::vector<RecordPtr> records;
+    {
+        std::shared_lock<std::shared_mutex> lock(order_mutex_);
+        const std::set<std::string>& index = index_it->second;
+        for (auto it = index.lower_bound(seek_key); it != index.end() && *it < upper_key; ++it) {
+            if (it->size() != prefix.size() + 16) continue;
+
+            std::string primary_key = it->substr(prefix.size());
+            if (records.size() == limit) {
+                *next_cursor = primary_key;
+                break;
+            }
+            auto record = time_order_.find(primary_key);
+            if (record != time_order_.end()) records.push_back(record->second);
+        }
+    }
+    ParseRecords(records, out_entries);
+    return true;
+}
+
+/**
+ * @brief Writes every entry to the snapshot file. Record pointers are copied under a shared lock and written out after it is released, so writers only wait for the copy. The file is written next to the target, fsynced and renamed over it, and the directory is fsynced after the rename, so a crash at any point leaves either the previous snapshot or the complete new one.
+ * 
+ * @return true if the snapshot was written.
+ * @return false if no snapshot path is configured or the file could not be written.
+ */
+bool MemoryStorage::SaveSnapshot() {
+    if (config_.memory_snapshot_path.empty()) return false;
+
+    std::vector<RecordPtr> records;
+    {
+        std::shared_lock<std::shared_mutex> lock(order_mutex_);
+        dirty_ = false;
+        records.reserve(time_order_.size());
+        for (const auto& [primary_key, record] : time_order_) {
+            records.push_back(record);
+        }
+    }
+
+    const std::string tmp_path = config_.memory_snapshot_path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[Memory] Failed to open snapshot file " << tmp_path << std::endl;
+            dirty_ = true;
+            return false;
+        }
+        out.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+        for (const auto& record : records) {
+            uint32_t length = static_cast<uint32_t>(record->data.size());
+            out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            out.write(record->data.data(), length);
+        }
+        if (!out.flush()) {
+            std::cerr << "[Memory] Failed to write snapshot file " << tmp_path << std::endl;
+            dirty_ = true;
+            return false;
+        }
+    }
+    // without the sync the rename can reach the disk before the data, leaving an empty or torn snapshot
+    if (!SyncPath(tmp_path)) {
+        std::cerr << "[Memory] Failed to sync snapshot file " << tmp_path << std::endl;
+        dirty_ = true;
+        return false;
+    }
+    if (std::rename(tmp_path.c_str(), config_.memory_snapshot_path.c_str()) != 0) {
+        std::cerr << "[Memory] Failed to replace snapshot " << config_.memory_snapshot_path << std::endl;
+        dirty_ = true;
+        return false;
+    }
+    fs::path dir = fs::path(config_.memory_snapshot_path).parent_path();
+    if (!SyncPath(dir.empty() ? "." : dir.string())) {
+        std::cerr << "[Memory] Failed to sync snapshot directory " << dir << std::endl;
+        dirty_ = true;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Loads the snapshot file, if there is one, and resumes id allocation after the highest stored id.
+ * 
+ * @return true if a snapshot was loaded.
+ * @return false if there was none or it was unreadable.
+ */
+bool MemoryStorage::LoadSnapshot() {
+    std::ifstream in(config_.memory_snapshot_path, std::ios::binary);
+    if (!in) return false;
+
+    char magic[sizeof(kSnapshotMagic)];
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), kSnapshotMagic)) {
+        std::cerr << "[Memory] " << config_.memory_snapshot_path << " is not a snapshot file" << std::endl;
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(order_mutex_);
+    uint64_t max_id = 0;
+    size_t loaded = 0;
+    uint32_t length;
+    std::string data;
+    registadb::Entry entry;
+    while (in.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+        data.resize(length);
+        if (!in.read(&data[0], length) || !entry.ParseFromString(data)) {
+            std::cerr << "[Memory] Snapshot truncated after " << loaded << " entries" << std::endl;
+            break;
+        }
+        ApplyEntryLocked(entry);
+        max_id = std::max<uint64_t>(max_id, entry.id());
+        loaded++;
+    }
+    SetStartingId(max_id);
+    std::cout << "[Memory] Loaded " << loaded << " entries from " << config_.memory_snapshot_path << std::endl;
+    return true;
+}
+
+/**
+ * @brief Background loop writing a snapshot every memory_snapshot_interval_seconds when something changed.
+ * 
+ */
+void MemoryStorage::SnapshotLoop() {
+    std::unique_lock<std::mutex> lock(snapshot_mutex_);
+    while (!stopping_) {
+        snapshot_cv_.wait_for(lock, std::chrono::seconds(config_.memory_snapshot_interval_seconds),
+                              [this] { return stopping_; });
+        if (stopping_) break;
+        if (dirty_) {
+            lock.unlock();
+            SaveSnapshot();
+            lock.lock();
+        }
+    }
+}
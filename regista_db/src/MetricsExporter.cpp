@@ -1,22 +1,69 @@
 #include "MetricsExporter.hpp"
 #include <prometheus/exposer.h>
 #include <prometheus/registry.h>
+#include <prometheus/counter.h>
 #include <prometheus/gauge.h>
+#include <prometheus/histogram.h>
 #include <rocksdb/statistics.h>
 #include <thread>
 #include <chrono>
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
 
 static std::atomic<bool> keep_running{true};
 static std::unique_ptr<std::thread> worker_thread;
+// wakes the polling thread early on stop
+static std::mutex worker_mutex;
+static std::condition_variable worker_wakeup;
+
+// set once the bridge is started, recording is a no-op before that
+static std::atomic<prometheus::Histogram*> ingest_batch_entries{nullptr};
+static std::atomic<prometheus::Histogram*> ingest_batch_bytes{nullptr};
+static std::atomic<prometheus::Histogram*> ingest_batch_seconds{nullptr};
+static std::atomic<prometheus::Counter*> ingest_batch_failures{nullptr};
+
+// request metrics, filled once before request_metrics_enabled is published
+static constexpr size_t kOps = registadb::OperationType_ARRAYSIZE;
+static std::atomic<bool> request_metrics_enabled{false};
+static prometheus::Histogram* request_seconds[kRequestTunnels][kOps];
+static prometheus::Histogram* request_stage_seconds[kRequestTunnels][kOps][kRequestStages];
+static prometheus::Gauge* requests_in_flight[kRequestTunnels];
+static prometheus::Gauge* queue_depth[kRequestTunnels];
+
+static const char* const kTunnelNames[kRequestTunnels] = {"zmq_ingest", "zmq_query", "rest"};
+static const char* const kStageNames[kRequestStages] = {"parse", "storage", "serialize"};
+
+// RocksDB histograms mirrored as percentile gauges
+static const std::pair<const char*, rocksdb::Histograms> kRocksHistograms[] = {
+    {"db_get", rocksdb::Histograms::DB_GET},
+    {"db_write", rocksdb::Histograms::DB_WRITE},
+    {"db_multiget", rocksdb::Histograms::DB_MULTIGET},
+    {"db_seek", rocksdb::Histograms::DB_SEEK},
+    {"wal_file_sync", rocksdb::Histograms::WAL_FILE_SYNC_MICROS},
+    {"compaction_time", rocksdb::Histograms::COMPACTION_TIME},
+};
+
+struct PolledGauge {
+    std::string name;
+    std::string help;
+    std::map<std::string, std::string> labels;
+    std::function<double()> read;
+    prometheus::Gauge* gauge = nullptr;
+};
+
+// registered before the bridge starts, only the polling thread touches them afterwards
+static std::vector<PolledGauge> polled_gauges;
 
 /**
  * @brief Starts a metrics bridge from RocksDB statistics to Prometheus exposer.
  * 
- * @param rocks_stats  The RocksDB statistics object to bridge.
+ * @param rocks_stats  The RocksDB statistics object to bridge, nullptr when the engine has none (request metrics are still exported).
  */
 void StartMetricsBridge(std::shared_ptr<rocksdb::Statistics> rocks_stats) {
-    if (!rocks_stats) return; // Safety check if stats are disabled
+    if (worker_thread) return; // already running
 
     // HTTP Exposer (Port 8080 is standard for metrics)
     static prometheus::Exposer exposer{"0.0.0.0:8080"};
@@ -38,12 +85,137 @@ void StartMetricsBridge(std::shared_ptr<rocksdb::Statistics> rocks_stats) {
     auto& memtable_hit_gauge = rocksdb_family.Add({{"ticker", "memtable_hit"}});
     auto& compaction_keys_gauge = rocksdb_family.Add({{"ticker", "compaction_keys_dropped"}});
 
+    // background write volume and blob GC, for write amplification with and without value separation
+    const std::pair<rocksdb::Tickers, const char*> io_tickers[] = {
+        {rocksdb::Tickers::FLUSH_WRITE_BYTES, "flush_write_bytes"},
+        {rocksdb::Tickers::COMPACT_READ_BYTES, "compact_read_bytes"},
+        {rocksdb::Tickers::COMPACT_WRITE_BYTES, "compact_write_bytes"},
+        {rocksdb::Tickers::BLOB_DB_BLOB_FILE_BYTES_WRITTEN, "blob_file_bytes_written"},
+        {rocksdb::Tickers::BLOB_DB_BLOB_FILE_BYTES_READ, "blob_file_bytes_read"},
+        {rocksdb::Tickers::BLOB_DB_GC_NUM_KEYS_RELOCATED, "blob_gc_keys_relocated"},
+        {rocksdb::Tickers::BLOB_DB_GC_BYTES_RELOCATED, "blob_gc_bytes_relocated"},
+    };
+    std::vector<std::pair<rocksdb::Tickers, prometheus::Gauge*>> io_gauges;
+    for (const auto& [ticker, name] : io_tickers) {
+        io_gauges.emplace_back(ticker, &rocksdb_family.Add({{"ticker", name}}));
+    }
+    static auto& write_amp_family = prometheus::BuildGauge()
+        .Name("registadb_write_amplification")
+        .Help("Bytes written by flushes and compactions (SST and blob files) per byte written by clients, since start")
+        .Register(*registry);
+    auto& write_amp_gauge = write_amp_family.Add({});
+
+    // ingest batching histograms
+    static auto& batch_entries_family = prometheus::BuildHistogram()
+        .Name("registadb_ingest_batch_entries")
+        .Help("Number of entries committed per ingest WriteBatch")
+        .Register(*registry);
+    static auto& batch_bytes_family = prometheus::BuildHistogram()
+        .Name("registadb_ingest_batch_bytes")
+        .Help("Payload bytes committed per ingest WriteBatch")
+        .Register(*registry);
+    static auto& batch_seconds_family = prometheus::BuildHistogram()
+        .Name("registadb_ingest_batch_commit_seconds")
+        .Help("Time spent committing one ingest WriteBatch")
+        .Register(*registry);
+
+    static auto& batch_failures_family = prometheus::BuildCounter()
+        .Name("registadb_ingest_batch_failures")
+        .Help("Ingest WriteBatches whose commit failed, their entries were dropped")
+        .Register(*registry);
+
+    ingest_batch_failures = &batch_failures_family.Add({});
+    ingest_batch_bytes = &batch_bytes_family.Add({}, prometheus::Histogram::BucketBoundaries{
+        256, 1024, 4096, 16384, 65536, 262144, 1048576, 4194304, 16777216});
+    ingest_batch_seconds = &batch_seconds_family.Add({}, prometheus::Histogram::BucketBoundaries{
+        0.00001, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.05, 0.1});
+    // published last, RecordIngestBatch only checks this one
+    ingest_batch_entries = &batch_entries_family.Add({}, prometheus::Histogram::BucketBoundaries{
+        1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096});
+
+    // request latency per tunnel and operation, in total and per stage
+    static auto& request_seconds_family = prometheus::BuildHistogram()
+        .Name("registadb_request_seconds")
+        .Help("Request latency (sum of the parse, storage and serialize stages) by tunnel and operation")
+        .Register(*registry);
+    static auto& request_stage_family = prometheus::BuildHistogram()
+        .Name("registadb_request_stage_seconds")
+        .Help("Request latency by tunnel, operation and stage")
+        .Register(*registry);
+    static auto& in_flight_family = prometheus::BuildGauge()
+        .Name("registadb_requests_in_flight")
+        .Help("Requests (or ingest batches) currently being handled, by tunnel")
+        .Register(*registry);
+    static auto& queue_depth_family = prometheus::BuildGauge()
+        .Name("registadb_queue_depth")
+        .Help("Requests handed to a worker pool and not yet picked up, by tunnel")
+        .Register(*registry);
+
+    const prometheus::Histogram::BucketBoundaries latency_buckets{
+        0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1};
+    for (size_t t = 0; t < kRequestTunnels; ++t) {
+        requests_in_flight[t] = &in_flight_family.Add({{"tunnel", kTunnelNames[t]}});
+        queue_depth[t] = &queue_depth_family.Add({{"tunnel", kTunnelNames[t]}});
+        for (size_t op = 0; op < kOps; ++op) {
+            // OP_CREATE -> "create"
+            std::string op_name = registadb::OperationType_Name(static_cast<registadb::OperationType>(op));
+            if (op_name.empty()) continue;
+            op_name = op_name.substr(3);
+            std::transform(op_name.begin(), op_name.end(), op_name.begin(), ::tolower);
+
+            request_seconds[t][op] = &request_seconds_family.Add(
+                {{"tunnel", kTunnelNames[t]}, {"op", op_name}}, latency_buckets);
+            for (size_t stage = 0; stage < kRequestStages; ++stage) {
+                request_stage_seconds[t][op][stage] = &request_stage_family.Add(
+                    {{"tunnel", kTunnelNames[t]}, {"op", op_name}, {"stage", kStageNames[stage]}}, latency_buckets);
+            }
+        }
+    }
+    request_metrics_enabled.store(true, std::memory_order_release);
+
+    // RocksDB histogram percentiles (microseconds), refreshed by the polling thread
+    struct RocksHistogramGauges {
+        rocksdb::Histograms histogram;
+        prometheus::Gauge* p50;
+        prometheus::Gauge* p95;
+        prometheus::Gauge* p99;
+        prometheus::Gauge* max;
+    };
+    std::vector<RocksHistogramGauges> rocks_histograms;
+    if (rocks_stats) {
+        static auto& rocks_histogram_family = prometheus::BuildGauge()
+            .Name("rocksdb_histogram_micros")
+            .Help("RocksDB histogram percentiles in microseconds")
+            .Register(*registry);
+        for (const auto& [name, histogram] : kRocksHistograms) {
+            rocks_histograms.push_back({histogram,
+                &rocks_histogram_family.Add({{"histogram", name}, {"quantile", "0.5"}}),
+                &rocks_histogram_family.Add({{"histogram", name}, {"quantile", "0.95"}}),
+                &rocks_histogram_family.Add({{"histogram", name}, {"quantile", "0.99"}}),
+                &rocks_histogram_family.Add({{"histogram", name}, {"quantile", "1"}})});
+        }
+    }
+
+    // polled gauges, one family per name
+    std::map<std::string, prometheus::Family<prometheus::Gauge>*> polled_families;
+    for (auto& polled : polled_gauges) {
+        auto& family = polled_families[polled.name];
+        if (!family) {
+            family = &prometheus::BuildGauge().Name(polled.name).Help(polled.help).Register(*registry);
+        }
+        polled.gauge = &family->Add(polled.labels);
+    }
+
     // register the registry with the HTTP server
     exposer.RegisterCollectable(registry);
 
-    // polling thread
-    std::thread([rocks_stats, &read_bytes_gauge, &write_bytes_gauge, &stall_gauge, &cache_hit_gauge, &cache_miss_gauge, &memtable_hit_gauge, &compaction_keys_gauge]() {
-        while (true) {
+    // polling thread, joined by StopMetricsBridge
+    keep_running = true;
+    worker_thread.reset(new std::thread([rocks_stats, rocks_histograms, &read_bytes_gauge, &write_bytes_gauge, &stall_gauge, &cache_hit_gauge, &cache_miss_gauge, &memtable_hit_gauge, &compaction_keys_gauge, io_gauges, &write_amp_gauge]() {
+        while (keep_running) {
+            for (auto& polled : polled_gauges) {
+                polled.gauge->Set(polled.read());
+            }
             if (rocks_stats) {
                 read_bytes_gauge.Set(static_cast<double>(
                     rocks_stats->getTickerCount(rocksdb::Tickers::BYTES_READ)));
@@ -65,10 +237,29 @@ void StartMetricsBridge(std::shared_ptr<rocksdb::Statistics> rocks_stats) {
 
                 compaction_keys_gauge.Set(static_cast<double>(
                     rocks_stats->getTickerCount(rocksdb::Tickers::COMPACTION_KEY_DROP_OBSOLETE)));
+
+                for (const auto& [ticker, gauge] : io_gauges) {
+                    gauge->Set(static_cast<double>(rocks_stats->getTickerCount(ticker)));
+                }
+                // blob files written during flush and compaction are already counted in the flush/compaction bytes
+                uint64_t user_bytes = rocks_stats->getTickerCount(rocksdb::Tickers::BYTES_WRITTEN);
+                uint64_t background_bytes = rocks_stats->getTickerCount(rocksdb::Tickers::FLUSH_WRITE_BYTES)
+                                            + rocks_stats->getTickerCount(rocksdb::Tickers::COMPACT_WRITE_BYTES);
+                write_amp_gauge.Set(user_bytes > 0 ? static_cast<double>(background_bytes) / static_cast<double>(user_bytes) : 0);
+
+                for (const auto& gauges : rocks_histograms) {
+                    rocksdb::HistogramData data;
+                    rocks_stats->histogramData(gauges.histogram, &data);
+                    gauges.p50->Set(data.median);
+                    gauges.p95->Set(data.percentile95);
+                    gauges.p99->Set(data.percentile99);
+                    gauges.max->Set(data.max);
+                }
             }
-            std::this_thread::sleep_for(std::chrono::seconds(5));
+            std::unique_lock<std::mutex> lock(worker_mutex);
+            worker_wakeup.wait_for(lock, std::chrono::seconds(5), []() { return !keep_running; });
         }
-    }).detach(); // run in background
+    }));
 }
 
 /**
@@ -76,8 +267,118 @@ void StartMetricsBridge(std::shared_ptr<rocksdb::Statistics> rocks_stats) {
  * 
  */
 void StopMetricsBridge() {
-    keep_running = false; 
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        keep_running = false;
+    }
+    worker_wakeup.notify_all();
     if (worker_thread && worker_thread->joinable()) {
         worker_thread->join();
     }
-}
\ No newline at end of file
+    worker_thread.reset();
+}
+
+/**
+ * @brief Records one group-committed ingest batch. No-op when the metrics bridge is not running.
+ * 
+ * @param entries Number of entries in the batch.
+ * @param bytes Total payload bytes received for the batch.
+ * @param commit_seconds Time taken by the WriteBatch commit.
+ */
+void RecordIngestBatch(size_t entries, size_t bytes, double commit_seconds) {
+    prometheus::Histogram* entries_hist = ingest_batch_entries.load(std::memory_order_acquire);
+    if (!entries_hist) return;
+
+    entries_hist->Observe(static_cast<double>(entries));
+    ingest_batch_bytes.load(std::memory_order_acquire)->Observe(static_cast<double>(bytes));
+    ingest_batch_seconds.load(std::memory_order_acquire)->Observe(commit_seconds);
+}
+
+/**
+ * @brief Counts one ingest batch whose commit failed. No-op when the metrics bridge is not running.
+ * 
+ */
+void RecordIngestBatchFailure() {
+    if (!ingest_batch_entries.load(std::memory_order_acquire)) return;
+    ingest_batch_failures.load(std::memory_order_acquire)->Increment();
+}
+
+/**
+ * @brief Registers a gauge that the polling thread refreshes from a callback every cycle. Gauges sharing a name become one family told apart by labels. Must be called before StartMetricsBridge.
+ * 
+ * @param name The metric name.
+ * @param help The metric help text (taken from the first registration of the name).
+ * @param labels Labels identifying this gauge within its family.
+ * @param read Callback returning the current value, called from the polling thread.
+ */
+void RegisterPolledGauge(const std::string& name, const std::string& help,
+                         const std::map<std::string, std::string>& labels, std::function<double()> read) {
+    polled_gauges.push_back({name, help, labels, std::move(read), nullptr});
+}
+
+/**
+ * @brief Adjusts the queue depth gauge of a tunnel. No-op when the metrics bridge is not running.
+ * 
+ * @param tunnel The tunnel whose worker pool queue changed.
+ * @param delta +1 when a request is handed to the pool, -1 when a worker picks it up.
+ */
+void AddQueueDepth(RequestTunnel tunnel, int64_t delta) {
+    if (!request_metrics_enabled.load(std::memory_order_acquire)) return;
+    queue_depth[static_cast<size_t>(tunnel)]->Increment(static_cast<double>(delta));
+}
+
+/**
+ * @brief Construct a new Request Timer:: Request Timer object and counts the request as in flight.
+ * 
+ * @param tunnel The tunnel the request came in on.
+ * @param op The operation, when already known.
+ */
+RequestTimer::RequestTimer(RequestTunnel tunnel, registadb::OperationType op)
+    : active_(request_metrics_enabled.load(std::memory_order_acquire)), tunnel_(tunnel), op_(op) {
+    if (!active_) return;
+    requests_in_flight[static_cast<size_t>(tunnel_)]->Increment();
+    last_mark_ = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief Destroy the Request Timer:: Request Timer object. Records every marked stage and their sum, and takes the request out of flight.
+ * 
+ */
+RequestTimer::~RequestTimer() {
+    if (!active_) return;
+    const size_t t = static_cast<size_t>(tunnel_);
+    requests_in_flight[t]->Decrement();
+    if (!record_ || marked_stages_ == 0) return;
+
+    const size_t op = (op_ >= 0 && static_cast<size_t>(op_) < kOps && request_seconds[t][op_]) ? op_ : registadb::OP_UNKNOWN;
+    double total = 0;
+    for (size_t stage = 0; stage < kRequestStages; ++stage) {
+        if (!(marked_stages_ & (1u << stage))) continue;
+        request_stage_seconds[t][op][stage]->Observe(stage_seconds_[stage]);
+        total += stage_seconds_[stage];
+    }
+    request_seconds[t][op]->Observe(total);
+}
+
+/**
+ * @brief Adds the time since the previous mark to a stage. A stage may be marked several times (batches, streamed pages); its times add up.
+ * 
+ * @param stage The stage that just finished.
+ */
+void RequestTimer::Mark(RequestStage stage) {
+    if (!active_) return;
+    auto now = std::chrono::steady_clock::now();
+    const size_t index = static_cast<size_t>(stage);
+    stage_seconds_[index] += std::chrono::duration<double>(now - last_mark_).count();
+    marked_stages_ |= 1u << index;
+    last_mark_ = now;
+}
+
+/**
+ * @brief Restarts the clock without attributing the elapsed time to any stage.
+ * 
+ */
+void RequestTimer::Skip() {
+    if (!active_) return;
+    last_mark_ = std::chrono::steady_clock::now();
+}
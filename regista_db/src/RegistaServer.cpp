@@ -1,26 +1,105 @@
+#include <algorithm>
 #include <atomic>
+#include <iterator>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
 
 #include "RegistaServer.h"
+#include "RequestArena.h"
+#include "MetricsExporter.hpp"
 #include <google/protobuf/util/time_util.h>
 
 extern std::atomic<bool> keep_running;
 
+static const char* kIngestWorkersEndpoint = "inproc://ingest_workers";
+static const char* kIngestControlEndpoint = "inproc://ingest_control";
+static const char* kQueryWorkersEndpoint = "inproc://query_workers";
+static const char* kQueryRepliesEndpoint = "inproc://query_replies";
+
+// queued events per subscriber before the PUB socket drops, and how often an idle publisher looks for new writes
+static constexpr int kChangeSendHwm = 100000;
+static constexpr std::chrono::milliseconds kChangePollInterval{1};
+
+// CPUs the process may run on, read during static initialisation on the main thread, before any thread pins itself
+static const cpu_set_t kProcessCpus = []() {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpuset) != 0) {
+        for (int core = 0; core < CPU_SETSIZE; ++core) CPU_SET(core, &cpuset);
+    }
+    return cpuset;
+}();
+
+/**
+ * @brief Sets the affinity of the calling pool worker and names the thread after it. A configured core pins the worker to it, otherwise the worker may run on every CPU of the process: workers are started from the poll loop thread, which main.cpp pins to core 0, and would inherit that single-core mask.
+ * 
+ * @param pool The pool name, used for the thread name and logging.
+ * @param index The worker index within the pool.
+ * @param core The core to pin to, negative values spread the worker over every CPU of the process.
+ */
+static void SetWorkerAffinity(const char* pool, size_t index, int core) {
+    // e.g. "rdb-ingest-0", thread names are capped at 15 characters
+    std::string name = std::string("rdb-") + pool + "-" + std::to_string(index);
+    name.resize(std::min<size_t>(name.size(), 15));
+    pthread_setname_np(pthread_self(), name.c_str());
+
+    if (core >= 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(core, &cpuset);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+        std::cout << "[Affinity] " << name << " pinned to Core " << core << std::endl;
+    } else {
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &kProcessCpus);
+        std::cout << "[Affinity] " << name << " unpinned, runs on any of " << CPU_COUNT(&kProcessCpus) << " cores" << std::endl;
+    }
+}
+
+/**
+ * @brief Parses a durability name as used by the env vars, CLI flags and the REST durability parameter.
+ * 
+ * @param text none, async or sync.
+ * @param out Set to the matching durability.
+ * @return true if text names a durability.
+ * @return false otherwise, out is left unchanged.
+ */
+bool RegistaServer::ParseDurability(const std::string& text, registadb::Durability* out) {
+    if (text == "none") {
+        *out = registadb::DURABILITY_NONE;
+    } else if (text == "async") {
+        *out = registadb::DURABILITY_ASYNC;
+    } else if (text == "sync") {
+        *out = registadb::DURABILITY_SYNC;
+    } else {
+        return false;
+    }
+    return true;
+}
+
 /**
  * @brief Construct a new Regista Server:: Regista Server object
  * 
- * @param storage StorageManager instance to use for data operations
+ * @param storage Storage backend (RocksDB or in-memory) to use for data operations
  * @param ingest_p Ingest port number for receiving data
  * @param query_p Query port number for handling requests
+ * @param config Server tuning options (ingest batching, worker pools, durability per tunnel, change publisher)
  */
-RegistaServer::RegistaServer(StorageManager& storage, int ingest_p, int query_p)
+RegistaServer::RegistaServer(StorageBackend& storage, int ingest_p, int query_p, ServerConfig config)
     : storage_(storage), 
       context_(1),
       ingest_socket_(context_, zmq::socket_type::pull),
-      query_socket_(context_, zmq::socket_type::rep),
-      running_(true) 
+      query_socket_(context_, zmq::socket_type::router),
+      running_(true),
+      config_(config)
 {
     ingest_socket_.bind("tcp://*:" + std::to_string(ingest_p));
     query_socket_.bind("tcp://*:" + std::to_string(query_p));
+    if (config_.change_port > 0) {
+        change_socket_ = zmq::socket_t(context_, zmq::socket_type::pub);
+        change_socket_.set(zmq::sockopt::sndhwm, kChangeSendHwm);
+        change_socket_.bind("tcp://*:" + std::to_string(config_.change_port));
+    }
 }
 
 /**
@@ -28,27 +107,59 @@ RegistaServer::RegistaServer(StorageManager& storage, int ingest_p, int query_p)
  * 
  */
 void RegistaServer::Run() {
+    if (config_.ingest_workers > 0) {
+        StartIngestWorkers();
+    }
+    if (config_.query_workers > 0) {
+        StartQueryWorkers();
+    }
+    if (config_.change_port > 0) {
+        StartChangePublisher();
+    }
+    const bool inline_ingest = ingest_workers_.empty();
+    const bool inline_query = query_workers_.empty();
+    if (inline_query && config_.query_durability == registadb::DURABILITY_SYNC) {
+        std::cerr << "Query workers are off: sync query writes wait for their WAL fsync on the main poll loop" << std::endl;
+    }
+
     // setup polling items
     zmq::pollitem_t items[] = {
         { static_cast<void*>(ingest_socket_), 0, ZMQ_POLLIN, 0 },
-        { static_cast<void*>(query_socket_),  0, ZMQ_POLLIN, 0 }
+        { static_cast<void*>(query_socket_),  0, ZMQ_POLLIN, 0 },
+        { static_cast<void*>(query_replies_), 0, ZMQ_POLLIN, 0 }
     };
+    // with an ingest pool the proxy owns the ingest socket, without a query pool there are no replies to forward
+    zmq::pollitem_t* poll_items = inline_ingest ? &items[0] : &items[1];
+    size_t poll_count = (inline_ingest ? 2 : 1) + (inline_query ? 0 : 1);
     try {
         while (keep_running && running_) {
             // poll for 100ms
-            int rc = zmq::poll(&items[0], 2, std::chrono::milliseconds(100));
+            int rc = zmq::poll(poll_items, poll_count, std::chrono::milliseconds(100));
 
             if (rc == 0) continue;
 
             // handle Ingest (PUSH/PULL)
             if (items[0].revents & ZMQ_POLLIN) {
-                HandleIngest();
+                if (config_.ingest_batching) {
+                    HandleIngestBatch(ingest_socket_, ingest_batch_);
+                } else {
+                    HandleIngest(ingest_socket_);
+                }
             }
 
-            // handle Query (REQ/REP)
+            // handle Query (ROUTER, REQ and DEALER clients)
             if (items[1].revents & ZMQ_POLLIN) {
                 HandleQuery();
             }
+
+            // forward finished replies from the query workers, in completion order
+            if (items[2].revents & ZMQ_POLLIN) {
+                std::vector<zmq::message_t> frames;
+                while (zmq::recv_multipart(query_replies_, std::back_inserter(frames), zmq::recv_flags::dontwait)) {
+                    zmq::send_multipart(query_socket_, frames);
+                    frames.clear();
+                }
+            }
         }
     } catch (const zmq::error_t& e) {
         // ignore error if "Interrupted"
@@ -58,11 +169,181 @@ void RegistaServer::Run() {
     }
     
     std::cout << "Server loop stopped. Cleaning up sockets..." << std::endl;
+    StopIngestWorkers();
+    StopQueryWorkers();
+    StopChangePublisher();
     ingest_socket_.close();
     query_socket_.close();
     std::cout << "Engine sockets closed cleanly." << std::endl;
 }
 
+/**
+ * @brief Starts the ingest worker pool: a steerable proxy thread forwards the ingest socket to an inproc PUSH socket, and each worker pulls from it with its own parse buffers and write batches.
+ * 
+ */
+void RegistaServer::StartIngestWorkers() {
+    ingest_backend_ = zmq::socket_t(context_, zmq::socket_type::push);
+    ingest_backend_.bind(kIngestWorkersEndpoint);
+
+    ingest_control_ = zmq::socket_t(context_, zmq::socket_type::pair);
+    ingest_control_.bind(kIngestControlEndpoint);
+    ingest_control_sender_ = zmq::socket_t(context_, zmq::socket_type::pair);
+    ingest_control_sender_.connect(kIngestControlEndpoint);
+
+    for (size_t i = 0; i < config_.ingest_workers; ++i) {
+        ingest_workers_.emplace_back(&RegistaServer::IngestWorkerLoop, this, i);
+    }
+
+    ingest_proxy_thread_ = std::thread([this]() {
+        try {
+            // returns once TERMINATE is sent on the control socket
+            zmq::proxy_steerable(ingest_socket_, ingest_backend_, zmq::socket_ref(), ingest_control_);
+        } catch (const zmq::error_t& e) {
+            if (e.num() != EINTR && e.num() != ETERM) {
+                std::cerr << "ZMQ Ingest Proxy Error: " << e.what() << std::endl;
+            }
+        }
+    });
+
+    std::cout << "Ingest workers started: " << config_.ingest_workers << std::endl;
+}
+
+/**
+ * @brief Stops the ingest proxy, then lets every ingest worker drain and commit the messages already forwarded to it before joining it. No-op if the pool was never started.
+ * 
+ */
+void RegistaServer::StopIngestWorkers() {
+    if (!ingest_proxy_thread_.joinable()) return;
+
+    running_ = false;
+    ingest_control_sender_.send(zmq::str_buffer("TERMINATE"), zmq::send_flags::none);
+    ingest_proxy_thread_.join();
+
+    ingest_workers_stopping_ = true;
+    for (auto& worker : ingest_workers_) {
+        if (worker.joinable()) worker.join();
+    }
+    ingest_workers_.clear();
+
+    ingest_backend_.close();
+    ingest_control_.close();
+    ingest_control_sender_.close();
+}
+
+/**
+ * @brief Ingest worker loop: pulls messages fanned out by the proxy and stores them until the pool is stopped, then commits whatever is still queued for it.
+ * 
+ * @param index The worker index, used to look up its core affinity.
+ */
+void RegistaServer::IngestWorkerLoop(size_t index) {
+    SetWorkerAffinity("ingest", index, index < config_.ingest_worker_cores.size() ? config_.ingest_worker_cores[index] : -1);
+
+    // per-worker socket and parse buffers, nothing here is shared with other workers
+    zmq::socket_t socket(context_, zmq::socket_type::pull);
+    socket.connect(kIngestWorkersEndpoint);
+    std::vector<registadb::Entry> batch;
+
+    zmq::pollitem_t item = { static_cast<void*>(socket), 0, ZMQ_POLLIN, 0 };
+    auto handle = [&]() {
+        if (config_.ingest_batching) {
+            HandleIngestBatch(socket, batch);
+        } else {
+            HandleIngest(socket);
+        }
+    };
+    try {
+        // runs until StopIngestWorkers, which stops the proxy first, so nothing arrives after the drain below
+        while (!ingest_workers_stopping_) {
+            int rc = zmq::poll(&item, 1, std::chrono::milliseconds(100));
+            if (rc == 0) continue;
+            handle();
+        }
+        // the messages already forwarded to this worker were accepted by the server, commit them before exiting
+        while (zmq::poll(&item, 1, std::chrono::milliseconds(0)) > 0) {
+            handle();
+        }
+    } catch (const zmq::error_t& e) {
+        if (e.num() != EINTR && e.num() != ETERM) {
+            std::cerr << "ZMQ Ingest Worker " << index << " Error: " << e.what() << std::endl;
+        }
+    }
+    socket.close();
+}
+
+/**
+ * @brief Starts the change publisher thread. Without a change log in the storage backend the socket stays bound but publishes nothing.
+ * 
+ */
+void RegistaServer::StartChangePublisher() {
+    if (storage_.ChangeLogShards() == 0) {
+        std::cerr << "[CDC] Storage backend has no change log, nothing will be published" << std::endl;
+        return;
+    }
+    change_publisher_ = std::thread(&RegistaServer::ChangePublisherLoop, this);
+    std::cout << "Change publisher started on port " << config_.change_port << std::endl;
+}
+
+/**
+ * @brief Joins the change publisher and closes its socket. No-op if it was never started.
+ * 
+ */
+void RegistaServer::StopChangePublisher() {
+    if (change_publisher_.joinable()) {
+        running_ = false;
+        change_publisher_.join();
+    }
+    if (config_.change_port > 0) change_socket_.close();
+}
+
+/**
+ * @brief Change publisher loop: tails every shard's change log from the writes committed after start and publishes each event as [source + '\0', serialized ChangeEvent], so subscribers filter by source with an exact topic prefix (or "" for everything).
+ * PUB drops events for a subscriber that falls kChangeSendHwm behind; subscribers detect the jump in sequence and catch up with OP_CHANGES.
+ * 
+ */
+void RegistaServer::ChangePublisherLoop() {
+    const uint32_t shards = static_cast<uint32_t>(storage_.ChangeLogShards());
+    std::vector<uint64_t> next_sequence(shards);
+    for (uint32_t shard = 0; shard < shards; ++shard) {
+        next_sequence[shard] = storage_.LatestChangeSequence(shard) + 1;
+    }
+
+    std::vector<registadb::ChangeEvent> events;
+    std::string topic;
+    std::string payload;
+    try {
+        while (keep_running && running_) {
+            bool published = false;
+            for (uint32_t shard = 0; shard < shards; ++shard) {
+                if (storage_.LatestChangeSequence(shard) < next_sequence[shard]) continue;
+
+                events.clear();
+                bool truncated = false;
+                if (!storage_.GetChangesSince(shard, next_sequence[shard], kDefaultChangesLimit, &events,
+                                              &next_sequence[shard], &truncated)) {
+                    continue;
+                }
+                if (truncated) {
+                    std::cerr << "[CDC] Shard " << shard << " change log skipped ahead, events were not published" << std::endl;
+                }
+
+                for (const auto& event : events) {
+                    topic = event.source();
+                    topic.push_back('\0');
+                    event.SerializeToString(&payload);
+                    change_socket_.send(zmq::buffer(topic), zmq::send_flags::sndmore);
+                    change_socket_.send(zmq::buffer(payload), zmq::send_flags::none);
+                }
+                published = published || !events.empty();
+            }
+            if (!published) std::this_thread::sleep_for(kChangePollInterval);
+        }
+    } catch (const zmq::error_t& e) {
+        if (e.num() != EINTR && e.num() != ETERM) {
+            std::cerr << "ZMQ Change Publisher Error: " << e.what() << std::endl;
+        }
+    }
+}
+
 /**
  * @brief Stops the running loop of the registaDB Server
  * 
@@ -75,10 +356,11 @@ void RegistaServer::Stop() {
  * @brief Prepares an entry for storage by setting server-side timestamps and generating an ID if not provided.
  * 
  * @param entry The entry to prepare.
+ * @param generated_id Optional output, set to whether the id was generated here. Such an id has nothing stored under it yet, so the write can skip looking for a version to replace.
  * @return true if the entry was successfully prepared.
  * @return false if there was an error preparing the entry.
  */
-bool RegistaServer::PrepareEntry(registadb::Entry& entry) {
+bool RegistaServer::PrepareEntry(registadb::Entry& entry, bool* generated_id) {
     // server-side timestamping
     uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
         std::chrono::system_clock::now().time_since_epoch()
@@ -91,76 +373,295 @@ bool RegistaServer::PrepareEntry(registadb::Entry& entry) {
     entry.mutable_updated_at()->CopyFrom(now);
 
     
-    // id generation
+    // id generation; client-supplied ids are reported so generated ids skip past them
+    if (generated_id) *generated_id = entry.id() == 0;
     if (entry.id() == 0) {
         entry.set_id(storage_.GetNextId());
+    } else {
+        storage_.ObserveId(entry.id());
     }
 
     return true;
 }
 
 /**
- * @brief Handles incoming data on the ingest socket, prepares it, and stores it using StorageManager.
+ * @brief Handles incoming data on the ingest socket, prepares it, and stores it using the storage backend.
  * 
+ * @param socket The ingest socket (or worker PULL socket) to receive from.
  */
-void RegistaServer::HandleIngest() {
+void RegistaServer::HandleIngest(zmq::socket_t& socket) {
     zmq::message_t msg;
-    if (ingest_socket_.recv(msg, zmq::recv_flags::none)) {
-        registadb::Entry entry;
-        if (entry.ParseFromArray(msg.data(), msg.size())) {
-            if (PrepareEntry(entry)) {
-                storage_.StoreEntry(entry);
+    if (socket.recv(msg, zmq::recv_flags::none)) {
+        RequestTimer timer(RequestTunnel::ZmqIngest, registadb::OP_CREATE);
+        RequestArena arena;
+        registadb::Entry* entry = arena.Create<registadb::Entry>();
+        if (entry->ParseFromArray(msg.data(), msg.size())) {
+            bool generated_id = false;
+            if (PrepareEntry(*entry, &generated_id)) {
+                timer.Mark(RequestStage::Parse);
+                storage_.StoreEntry(*entry, config_.ingest_durability, generated_id);
+                timer.Mark(RequestStage::Storage);
             }
         }
     }
 }
 
 /**
- * @brief Sends a Response protobuf back to the client over the query socket.
+ * @brief Drains pending messages from the ingest socket and commits them as one WriteBatch. Collection stops at the configured entry count, byte limit or linger time, whichever comes first.
  * 
- * @param resp The Response protobuf to send.
+ * @param socket The ingest socket (or worker PULL socket) to drain.
+ * @param batch Reusable parse buffer owned by the calling thread.
  */
-void RegistaServer::SendResponse(const registadb::Response& resp) {
-    std::string bytes = resp.SerializeAsString();
-    query_socket_.send(zmq::buffer(bytes), zmq::send_flags::none);
-}
+void RegistaServer::HandleIngestBatch(zmq::socket_t& socket, std::vector<registadb::Entry>& batch) {
+    const auto deadline = std::chrono::steady_clock::now() + config_.ingest_batch_linger;
+    size_t count = 0;
+    size_t bytes = 0;
+    // stays true while every id in the batch was generated, the commit then writes blind
+    bool new_ids = true;
+    zmq::message_t msg;
+    // one timed request per batch, linger waits excluded
+    RequestTimer timer(RequestTunnel::ZmqIngest, registadb::OP_CREATE);
+
+    while (count < config_.ingest_batch_max_entries && bytes < config_.ingest_batch_max_bytes) {
+        if (!socket.recv(msg, zmq::recv_flags::dontwait)) {
+            // nothing pending, wait for more until the linger time runs out
+            auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) break;
+
+            zmq::pollitem_t item = { static_cast<void*>(socket), 0, ZMQ_POLLIN, 0 };
+            // rounded up, a sub-millisecond remainder must not turn into a zero timeout that returns at once
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now);
+            zmq::poll(&item, 1, remaining);
+            timer.Skip();
+            if (!(item.revents & ZMQ_POLLIN)) break;
+            continue;
+        }
+
+        bytes += msg.size();
+        if (count == batch.size()) {
+            batch.emplace_back();
+        }
+        registadb::Entry& entry = batch[count];
+        entry.Clear();
+        bool generated_id = false;
+        if (entry.ParseFromArray(msg.data(), msg.size()) && PrepareEntry(entry, &generated_id)) {
+            new_ids = new_ids && generated_id;
+            count++;
+        }
+        timer.Mark(RequestStage::Parse);
+    }
 
+    if (count == 0) {
+        timer.Discard();
+        return;
+    }
+
+    auto commit_start = std::chrono::steady_clock::now();
+    const bool stored = storage_.StoreEntries(batch.data(), count, config_.ingest_durability, new_ids);
+    std::chrono::duration<double> commit_time = std::chrono::steady_clock::now() - commit_start;
+    timer.Mark(RequestStage::Storage);
+
+    if (!stored) {
+        // PUSH/PULL has no reply, so the log and the failure counter are all the producer side gets
+        std::cerr << "Ingest batch of " << count << " entries failed to commit, entries dropped" << std::endl;
+        RecordIngestBatchFailure();
+        return;
+    }
+    RecordIngestBatch(count, bytes, commit_time.count());
+}
 
 /**
- * @brief Handles incoming requests on the query socket, processes them, and sends appropriate responses back to the client.
+ * @brief Handles incoming requests on the ROUTER query socket. Requests are executed inline, or handed to the query worker pool, whose replies are forwarded back out of order by the main loop.
  * 
  */
 void RegistaServer::HandleQuery() {
-    zmq::message_t msg;
+    std::vector<zmq::message_t> frames;
 
-    if (!query_socket_.recv(msg, zmq::recv_flags::none)) {
+    if (!zmq::recv_multipart(query_socket_, std::back_inserter(frames))) {
         return; // no message
     }
+    // ROUTER prepends the client identity, so a valid request has at least an identity and a body
+    if (frames.size() < 2) return;
 
-    registadb::Request req;
-    if (!req.ParseFromArray(msg.data(), msg.size())) {
-        registadb::Response resp;
-        resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
-        resp.set_message("Failed to parse Request protobuf");
-        SendResponse(resp);
+    if (!query_workers_.empty()) {
+        AddQueueDepth(RequestTunnel::ZmqQuery, 1);
+        zmq::send_multipart(query_dispatch_, frames);
         return;
+    }
+
+    ProcessQuery(frames);
+    zmq::send_multipart(query_socket_, frames);
+}
+
+/**
+ * @brief Executes the request in the last frame of a routed message and replaces that frame with the serialized Response. The routing envelope (identity and optional empty delimiter) is left untouched so the reply can be sent straight back.
+ * 
+ * @param frames The routed message frames: envelope followed by the Request body.
+ */
+void RegistaServer::ProcessQuery(std::vector<zmq::message_t>& frames) {
+    zmq::message_t& body = frames.back();
+    RequestTimer timer(RequestTunnel::ZmqQuery);
+
+    RequestArena arena;
+    registadb::Request* req = arena.Create<registadb::Request>();
+    registadb::Response* resp = arena.Create<registadb::Response>();
+    if (!req->ParseFromArray(body.data(), body.size())) {
+        resp->set_status(registadb::STATUS_INVALID_ARGUMENT);
+        resp->set_message("Failed to parse Request protobuf");
+        timer.Mark(RequestStage::Parse);
     } else {
-        registadb::Response resp = ExecuteRequest(req);
-        SendResponse(resp);
-        return;
+        timer.SetOp(req->op());
+        if (req->durability() == registadb::DURABILITY_DEFAULT) {
+            req->set_durability(config_.query_durability);
+        }
+        timer.Mark(RequestStage::Parse);
+        ExecuteRequest(*req, resp);
+        timer.Mark(RequestStage::Storage);
+    }
+
+    // serialize straight into the reply frame
+    size_t size = resp->ByteSizeLong();
+    body.rebuild(size);
+    resp->SerializeWithCachedSizesToArray(static_cast<uint8_t*>(body.data()));
+    timer.Mark(RequestStage::Serialize);
+}
+
+/**
+ * @brief Starts the query worker pool. Workers pull routed requests over inproc PUSH/PULL and push their replies back to the main loop, which owns the ROUTER socket.
+ * 
+ */
+void RegistaServer::StartQueryWorkers() {
+    query_dispatch_ = zmq::socket_t(context_, zmq::socket_type::push);
+    query_dispatch_.bind(kQueryWorkersEndpoint);
+    query_replies_ = zmq::socket_t(context_, zmq::socket_type::pull);
+    query_replies_.bind(kQueryRepliesEndpoint);
+
+    query_workers_active_ = config_.query_workers;
+    for (size_t i = 0; i < config_.query_workers; ++i) {
+        query_workers_.emplace_back(&RegistaServer::QueryWorkerLoop, this, i);
+    }
+
+    std::cout << "Query workers started: " << config_.query_workers << std::endl;
+}
+
+/**
+ * @brief Stops the query workers once they have executed every request already dispatched to them, forwarding their replies to the ROUTER socket meanwhile so no client is left without one. No-op if the pool was never started.
+ * 
+ */
+void RegistaServer::StopQueryWorkers() {
+    if (query_workers_.empty()) return;
+
+    running_ = false;
+    query_workers_stopping_ = true;
+    std::vector<zmq::message_t> frames;
+    zmq::pollitem_t item = { static_cast<void*>(query_replies_), 0, ZMQ_POLLIN, 0 };
+    try {
+        // keep reading while the workers drain, a full reply pipe would block them. Checked before the last
+        // read, every reply a worker sent is already queued once it counts itself out
+        bool done = false;
+        while (!done) {
+            done = query_workers_active_ == 0;
+            zmq::poll(&item, 1, std::chrono::milliseconds(done ? 0 : 10));
+            while (zmq::recv_multipart(query_replies_, std::back_inserter(frames), zmq::recv_flags::dontwait)) {
+                zmq::send_multipart(query_socket_, frames);
+                frames.clear();
+            }
+        }
+    } catch (const zmq::error_t& e) {
+        if (e.num() != EINTR && e.num() != ETERM) {
+            std::cerr << "ZMQ Query Reply Error: " << e.what() << std::endl;
+        }
+    }
+
+    for (auto& worker : query_workers_) {
+        if (worker.joinable()) worker.join();
+    }
+    query_workers_.clear();
+
+    query_dispatch_.close();
+    query_replies_.close();
+}
+
+/**
+ * @brief Query worker loop: executes routed requests and pushes the replies back to the main loop until the pool is stopped, then executes whatever is still queued for it.
+ * 
+ * @param index The worker index, used for the thread name and logging.
+ */
+void RegistaServer::QueryWorkerLoop(size_t index) {
+    // query execution, sync WAL fsyncs included, must not compete with the poll loop for its core
+    SetWorkerAffinity("query", index, -1);
+
+    zmq::socket_t requests(context_, zmq::socket_type::pull);
+    requests.connect(kQueryWorkersEndpoint);
+    zmq::socket_t replies(context_, zmq::socket_type::push);
+    replies.connect(kQueryRepliesEndpoint);
+
+    std::vector<zmq::message_t> frames;
+    zmq::pollitem_t item = { static_cast<void*>(requests), 0, ZMQ_POLLIN, 0 };
+    auto handle = [&]() {
+        frames.clear();
+        if (!zmq::recv_multipart(requests, std::back_inserter(frames))) return;
+        AddQueueDepth(RequestTunnel::ZmqQuery, -1);
+
+        ProcessQuery(frames);
+        zmq::send_multipart(replies, frames);
+    };
+    try {
+        // runs until StopQueryWorkers, the main loop has stopped dispatching by then
+        while (!query_workers_stopping_) {
+            int rc = zmq::poll(&item, 1, std::chrono::milliseconds(100));
+            if (rc == 0) continue;
+            handle();
+        }
+        // every request dispatched to this worker is counted in the queue depth and awaited by a client, answer it
+        while (zmq::poll(&item, 1, std::chrono::milliseconds(0)) > 0) {
+            handle();
+        }
+    } catch (const zmq::error_t& e) {
+        if (e.num() != EINTR && e.num() != ETERM) {
+            std::cerr << "ZMQ Query Worker " << index << " Error: " << e.what() << std::endl;
+        }
     }
-  
+    requests.close();
+    replies.close();
+    query_workers_active_--;
 }
 
 
 /**
- * @brief Executes RegistaDB query requests, executing logic according to request operation code.
+ * @brief Executes RegistaDB query requests, executing logic according to request operation code. Convenience overload that copies the request and returns the response by value.
  * 
  * @param req The request to fulfill
  * @return registadb::Response 
  */
 registadb::Response RegistaServer::ExecuteRequest(const registadb::Request& req) {
+    registadb::Request copy(req);
     registadb::Response resp;
+    ExecuteRequest(copy, &resp);
+    return resp;
+}
+
+/**
+ * @brief Moves a heap-allocated entry into a fresh heap object, so it can be handed to a message that may live on an arena (the arena adopts it instead of copying).
+ * 
+ * @param entry The entry to move from, left empty.
+ * @return registadb::Entry* The new heap entry.
+ */
+static registadb::Entry* ReleaseEntry(registadb::Entry& entry) {
+    registadb::Entry* released = new registadb::Entry();
+    released->Swap(&entry);
+    return released;
+}
+
+/**
+ * @brief Executes RegistaDB query requests, executing logic according to request operation code. Entries are moved, never deep-copied: the request entry is prepared in place and swapped into the response, and reads parse straight into the response.
+ * 
+ * @param req The request to fulfill, its entry is consumed.
+ * @param resp The response to fill, usually on the same arena as req.
+ */
+void RegistaServer::ExecuteRequest(registadb::Request& req, registadb::Response* resp_ptr) {
+    registadb::Response& resp = *resp_ptr;
+    resp.set_correlation_id(req.correlation_id());
 
     switch (req.op()) {
 
@@ -171,22 +672,24 @@ registadb::Response RegistaServer::ExecuteRequest(const registadb::Request& req)
                 break;
             }
 
-            registadb::Entry entry = req.entry();
+            registadb::Entry& entry = *req.mutable_entry();
 
-            if (!PrepareEntry(entry)) {
+            bool generated_id = false;
+            if (!PrepareEntry(entry, &generated_id)) {
                 resp.set_status(registadb::STATUS_INTERNAL_ERROR);
                 resp.set_message("Unable to prepare entry for CREATE");
                 break;
             }
 
-            bool ok = storage_.StoreEntry(entry);
+            // the reply is the acknowledgement, so it waits until the write is durable under req.durability()
+            bool ok = storage_.StoreEntry(entry, req.durability(), generated_id);
 
             if (!ok) {
                 resp.set_status(registadb::STATUS_INTERNAL_ERROR);
                 resp.set_message("Failed to store entry");
             } else {
                 resp.set_status(registadb::STATUS_OK);
-                resp.mutable_entry()->CopyFrom(entry);
+                resp.mutable_entry()->Swap(&entry);
             }
             break;
         }
@@ -194,18 +697,43 @@ registadb::Response RegistaServer::ExecuteRequest(const registadb::Request& req)
         case registadb::OP_READ: {
             uint64_t id = req.id();
 
-            registadb::Entry entry;
-
-            if (storage_.GetEntryById(id, &entry)) {
+            if (storage_.GetEntryById(id, resp.mutable_entry())) {
                 resp.set_status(registadb::STATUS_OK);
-                resp.mutable_entry()->CopyFrom(entry);
             } else {
+                resp.clear_entry();
                 resp.set_status(registadb::STATUS_NOT_FOUND);
                 resp.set_message("Entry not found");
             }
             break;
         }
 
+        case registadb::OP_MULTI_READ: {
+            if (req.ids_size() > kMaxMultiReadIds) {
+                resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
+                resp.set_message("Too many ids for MULTI_READ");
+                break;
+            }
+
+            std::vector<uint64_t> ids(req.ids().begin(), req.ids().end());
+            std::vector<registadb::Entry> entries;
+            std::vector<bool> found;
+            storage_.GetEntriesByIds(ids, &entries, &found);
+
+            resp.set_status(registadb::STATUS_OK);
+            resp.mutable_results()->Reserve(static_cast<int>(ids.size()));
+            for (size_t i = 0; i < ids.size(); ++i) {
+                registadb::EntryResult* result = resp.add_results();
+                result->set_id(ids[i]);
+                if (found[i]) {
+                    result->set_status(registadb::STATUS_OK);
+                    result->set_allocated_entry(ReleaseEntry(entries[i]));
+                } else {
+                    result->set_status(registadb::STATUS_NOT_FOUND);
+                }
+            }
+            break;
+        }
+
         case registadb::OP_UPDATE: {
             if (!req.has_entry()) {
                 resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
@@ -213,7 +741,7 @@ registadb::Response RegistaServer::ExecuteRequest(const registadb::Request& req)
                 break;
             }
 
-            registadb::Entry entry = req.entry();
+            registadb::Entry& entry = *req.mutable_entry();
 
             if (entry.id() == 0) {
                 resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
@@ -221,13 +749,6 @@ registadb::Response RegistaServer::ExecuteRequest(const registadb::Request& req)
                 break;
             }
 
-            registadb::Entry old_entry;
-            if (!storage_.GetEntryById(entry.id(), &old_entry)) {
-                resp.set_status(registadb::STATUS_NOT_FOUND);
-                resp.set_message("Entry not found");
-                break;
-            }
-
             // Update timestamp
             uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
                 std::chrono::system_clock::now().time_since_epoch()
@@ -236,16 +757,17 @@ registadb::Response RegistaServer::ExecuteRequest(const registadb::Request& req)
             now.set_seconds(micros / 1'000'000);
             now.set_nanos((micros % 1'000'000) * 1000);
             entry.mutable_updated_at()->CopyFrom(now);
-            entry.mutable_created_at()->CopyFrom(old_entry.created_at());
 
-            bool ok = storage_.StoreEntry(entry);
-
-            if (!ok) {
-                resp.set_status(registadb::STATUS_INTERNAL_ERROR);
+            // read-modify-write happens inside the engine, atomically per id
+            registadb::OperationStatus status = storage_.UpdateEntry(entry, req.update_mode(), resp.mutable_entry(),
+                                                                        req.durability());
+            resp.set_status(status);
+            if (status == registadb::STATUS_NOT_FOUND) {
+                resp.set_message("Entry not found");
+                resp.clear_entry();
+            } else if (status != registadb::STATUS_OK) {
                 resp.set_message("Failed to update entry");
-            } else {
-                resp.set_status(registadb::STATUS_OK);
-                resp.mutable_entry()->CopyFrom(entry);
+                resp.clear_entry();
             }
 
             break;
@@ -254,7 +776,7 @@ registadb::Response RegistaServer::ExecuteRequest(const registadb::Request& req)
         case registadb::OP_DELETE: {
             uint64_t id = req.id();
 
-            if (storage_.DeleteEntryById(id)) {
+            if (storage_.DeleteEntryById(id, req.durability())) {
                 resp.set_status(registadb::STATUS_OK);
             } else {
                 resp.set_status(registadb::STATUS_NOT_FOUND);
@@ -263,11 +785,137 @@ registadb::Response RegistaServer::ExecuteRequest(const registadb::Request& req)
             break;
         }
 
+        case registadb::OP_SCAN: {
+            const registadb::ScanRequest& scan = req.scan();
+            uint64_t from_ts = scan.has_from() ? storage_.ToEpochMicros(scan.from()) : 0;
+            uint64_t to_ts = scan.has_to() ? storage_.ToEpochMicros(scan.to()) : UINT64_MAX;
+            uint32_t limit = scan.limit() == 0 ? kDefaultScanLimit : std::min(scan.limit(), kMaxScanLimit);
+
+            std::vector<registadb::Entry> entries;
+            std::string next_cursor;
+            if (!storage_.ScanRange(from_ts, to_ts, limit, scan.cursor(), &entries, &next_cursor)) {
+                resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
+                resp.set_message("Invalid scan cursor or range");
+                break;
+            }
+
+            resp.set_status(registadb::STATUS_OK);
+            resp.mutable_entries()->Reserve(entries.size());
+            for (auto& entry : entries) {
+                resp.mutable_entries()->AddAllocated(ReleaseEntry(entry));
+            }
+            resp.set_next_cursor(next_cursor);
+            break;
+        }
+
+        case registadb::OP_QUERY_METADATA: {
+            const registadb::MetadataFilter& filter = req.metadata();
+            if (!storage_.IsMetadataIndexed(filter.key())) {
+                resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
+                resp.set_message("Metadata key is not indexed");
+                break;
+            }
+
+            const registadb::ScanRequest& scan = req.scan();
+            uint64_t from_ts = scan.has_from() ? storage_.ToEpochMicros(scan.from()) : 0;
+            uint64_t to_ts = scan.has_to() ? storage_.ToEpochMicros(scan.to()) : UINT64_MAX;
+            uint32_t limit = scan.limit() == 0 ? kDefaultScanLimit : std::min(scan.limit(), kMaxScanLimit);
+
+            std::vector<registadb::Entry> entries;
+            std::string next_cursor;
+            if (!storage_.QueryByMetadata(filter.key(), filter.value(), from_ts, to_ts, limit, scan.cursor(),
+                                          &entries, &next_cursor)) {
+                resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
+                resp.set_message("Invalid query cursor or range");
+                break;
+            }
+
+            resp.set_status(registadb::STATUS_OK);
+            resp.mutable_entries()->Reserve(entries.size());
+            for (auto& entry : entries) {
+                resp.mutable_entries()->AddAllocated(ReleaseEntry(entry));
+            }
+            resp.set_next_cursor(next_cursor);
+            break;
+        }
+
+        case registadb::OP_AGGREGATE: {
+            const registadb::ScanRequest& scan = req.scan();
+            const registadb::MetadataFilter& filter = req.metadata();
+            uint64_t from_ts = scan.has_from() ? storage_.ToEpochMicros(scan.from()) : 0;
+            uint64_t to_ts = scan.has_to() ? storage_.ToEpochMicros(scan.to()) : UINT64_MAX;
+            uint64_t width_ms = req.aggregate().bucket_width_ms();
+            if (width_ms > UINT64_MAX / 1000) {
+                resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
+                resp.set_message("Bucket width out of range");
+                break;
+            }
+
+            SeriesAggregator aggregator(from_ts, width_ms * 1000, kMaxAggregateBuckets);
+            if (!storage_.Aggregate(from_ts, to_ts, filter.key(), filter.value(), &aggregator)) {
+                if (aggregator.Overflowed()) {
+                    resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
+                    resp.set_message("More than " + std::to_string(kMaxAggregateBuckets)
+                                     + " buckets, use a wider bucket or a shorter range");
+                } else {
+                    resp.set_status(registadb::STATUS_INTERNAL_ERROR);
+                    resp.set_message("Aggregation failed");
+                }
+                break;
+            }
+
+            std::vector<registadb::AggregateBucket> buckets;
+            aggregator.Finish(&buckets);
+            resp.set_status(registadb::STATUS_OK);
+            resp.mutable_buckets()->Reserve(static_cast<int>(buckets.size()));
+            for (auto& bucket : buckets) {
+                registadb::AggregateBucket* released = new registadb::AggregateBucket();
+                released->Swap(&bucket);
+                resp.mutable_buckets()->AddAllocated(released);
+            }
+            break;
+        }
+
+        case registadb::OP_CHANGES: {
+            const registadb::ChangesRequest& changes = req.changes();
+            if (storage_.ChangeLogShards() == 0) {
+                resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
+                resp.set_message("Change log is disabled");
+                break;
+            }
+            if (changes.shard() >= storage_.ChangeLogShards()) {
+                resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
+                resp.set_message("Unknown change log shard");
+                break;
+            }
+            uint32_t limit = changes.limit() == 0 ? kDefaultChangesLimit : std::min(changes.limit(), kMaxChangesLimit);
+
+            std::vector<registadb::ChangeEvent> events;
+            uint64_t next_sequence = 0;
+            bool truncated = false;
+            if (!storage_.GetChangesSince(changes.shard(), changes.since_sequence(), limit, &events, &next_sequence,
+                                          &truncated)) {
+                resp.set_status(registadb::STATUS_INTERNAL_ERROR);
+                resp.set_message("Change log could not be read");
+                break;
+            }
+
+            resp.set_status(registadb::STATUS_OK);
+            resp.mutable_changes()->Reserve(static_cast<int>(events.size()));
+            for (auto& event : events) {
+                registadb::ChangeEvent* released = new registadb::ChangeEvent();
+                released->Swap(&event);
+                resp.mutable_changes()->AddAllocated(released);
+            }
+            resp.set_next_sequence(next_sequence);
+            resp.set_changes_truncated(truncated);
+            break;
+        }
+
         default: {
             resp.set_status(registadb::STATUS_INVALID_ARGUMENT);
             resp.set_message("Unknown operation");
             break;
         }
     }
-    return resp;
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "RequestArena.h"
+#include <memory>
+
+namespace {
+
+struct ThreadArena {
+    std::unique_ptr<char[]> initial_block;
+    std::unique_ptr<google::protobuf::Arena> arena;
+    int depth = 0;
+
+    ThreadArena() : initial_block(new char[RequestArena::kInitialBlockSize]) {
+        google::protobuf::ArenaOptions options;
+        options.initial_block = initial_block.get();
+        options.initial_block_size = RequestArena::kInitialBlockSize;
+        arena.reset(new google::protobuf::Arena(options));
+    }
+};
+
+thread_local ThreadArena tl_arena;
+
+}
+
+
+/**
+ * @brief Construct a new Request Arena:: Request Arena object, entering the calling thread's arena.
+ * 
+ */
+RequestArena::RequestArena() : arena_(tl_arena.arena.get()) {
+    tl_arena.depth++;
+}
+
+/**
+ * @brief Destroy the Request Arena:: Request Arena object. Leaving the outermost scope frees every message created on the arena and keeps the initial block for the next request.
+ * 
+ */
+RequestArena::~RequestArena() {
+    if (--tl_arena.depth == 0) {
+        arena_->Reset();
+    }
+}
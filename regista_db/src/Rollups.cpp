@@ -0,0 +1,165 @@
+#include "Rollups.h"
+#include <cstring>
+#include <limits>
+#include <endian.h>
+
+/**
+ * @brief Encodes a rollup key. Buckets of one level and source are contiguous and in time order.
+ *
+ * @param level Index into kRollupResolutions.
+ * @param source The entries' metadata["source"], empty for entries without one.
+ * @param bucket_start Start of the bucket in microseconds, a multiple of the level's resolution.
+ * @return std::string The encoded key.
+ */
+std::string EncodeRollupKey(size_t level, const std::string& source, uint64_t bucket_start) {
+    std::string key;
+    key.reserve(1 + 4 + source.size() + 8);
+    key.push_back(static_cast<char>(level));
+    uint32_t be_size = htobe32(static_cast<uint32_t>(source.size()));
+    key.append(reinterpret_cast<const char*>(&be_size), 4);
+    key.append(source);
+    uint64_t be_start = htobe64(bucket_start);
+    key.append(reinterpret_cast<const char*>(&be_start), 8);
+    return key;
+}
+
+/**
+ * @brief Key to seek to for the first bucket after source's. No bucket starts at UINT64_MAX (starts are multiples of a resolution), so the key sorts after every bucket of source and before any other source's.
+ *
+ * @param level Index into kRollupResolutions.
+ * @param source The source whose buckets to skip.
+ * @return std::string The seek key.
+ */
+std::string RollupSourceEnd(size_t level, const std::string& source) {
+    return EncodeRollupKey(level, source, UINT64_MAX);
+}
+
+/**
+ * @brief Splits a rollup key into its source and bucket start.
+ *
+ * @param key The encoded key.
+ * @param source Output for the source, pointing into key.
+ * @param bucket_start Output for the bucket start in microseconds.
+ * @return true if the key is well formed.
+ * @return false otherwise.
+ */
+bool DecodeRollupKey(const rocksdb::Slice& key, rocksdb::Slice* source, uint64_t* bucket_start) {
+    if (key.size() < 1 + 4 + 8) return false;
+    uint32_t be_size;
+    std::memcpy(&be_size, key.data() + 1, 4);
+    const size_t source_size = be32toh(be_size);
+    if (key.size() != 1 + 4 + source_size + 8) return false;
+    *source = rocksdb::Slice(key.data() + 5, source_size);
+    uint64_t be_start;
+    std::memcpy(&be_start, key.data() + key.size() - 8, 8);
+    *bucket_start = be64toh(be_start);
+    return true;
+}
+
+/**
+ * @brief Encodes a bucket as count, entries, min, max, sum, first and last expiry, retracted min and max (8 bytes each).
+ *
+ * @param bucket The bucket.
+ * @param out Output for the kRollupValueSize bytes.
+ */
+void EncodeRollupValue(const RollupBucket& bucket, std::string* out) {
+    out->resize(kRollupValueSize);
+    char* p = &(*out)[0];
+    std::memcpy(p, &bucket.acc.count, 8);
+    std::memcpy(p + 8, &bucket.acc.entries, 8);
+    std::memcpy(p + 16, &bucket.acc.min, 8);
+    std::memcpy(p + 24, &bucket.acc.max, 8);
+    std::memcpy(p + 32, &bucket.acc.sum, 8);
+    std::memcpy(p + 40, &bucket.first_expiry, 8);
+    std::memcpy(p + 48, &bucket.last_expiry, 8);
+    std::memcpy(p + 56, &bucket.retracted_min, 8);
+    std::memcpy(p + 64, &bucket.retracted_max, 8);
+}
+
+/**
+ * @brief Decodes a bucket written by EncodeRollupValue.
+ *
+ * @param value The encoded value.
+ * @param bucket Output for the bucket.
+ * @return true if the value has the expected size.
+ * @return false otherwise.
+ */
+bool DecodeRollupValue(const rocksdb::Slice& value, RollupBucket* bucket) {
+    if (value.size() != kRollupValueSize) return false;
+    const char* p = value.data();
+    std::memcpy(&bucket->acc.count, p, 8);
+    std::memcpy(&bucket->acc.entries, p + 8, 8);
+    std::memcpy(&bucket->acc.min, p + 16, 8);
+    std::memcpy(&bucket->acc.max, p + 24, 8);
+    std::memcpy(&bucket->acc.sum, p + 32, 8);
+    std::memcpy(&bucket->first_expiry, p + 40, 8);
+    std::memcpy(&bucket->last_expiry, p + 48, 8);
+    std::memcpy(&bucket->retracted_min, p + 56, 8);
+    std::memcpy(&bucket->retracted_max, p + 64, 8);
+    return true;
+}
+
+/**
+ * @brief Negates count, entries and sum, so merging the result takes the bucket's values back out. min and max cannot be taken back, so the operand carries the range of the retracted values instead; the bucket only turns stale (and is recomputed from the entries when read) if that range reaches its min or max.
+ *
+ */
+void RollupBucket::Retract() {
+    acc.count = 0 - acc.count;
+    acc.entries = 0 - acc.entries;
+    acc.sum = -acc.sum;
+    retracted_min = acc.min;
+    retracted_max = acc.max;
+    acc.min = std::numeric_limits<double>::infinity();
+    acc.max = -std::numeric_limits<double>::infinity();
+}
+
+/**
+ * @brief Combines a bucket's current accumulator with one more operand.
+ *
+ * @param key The rollup key.
+ * @param existing_value The current accumulator, nullptr for the first operand.
+ * @param value The operand to add.
+ * @param new_value Output for the combined accumulator.
+ * @param logger Unused.
+ * @return true if both values were well formed.
+ * @return false otherwise (RocksDB reports corruption).
+ */
+bool RollupMergeOperator::Merge(const rocksdb::Slice& key, const rocksdb::Slice* existing_value,
+                                const rocksdb::Slice& value, std::string* new_value, rocksdb::Logger* logger) const {
+    RollupBucket bucket;
+    RollupBucket operand;
+    if (existing_value && !DecodeRollupValue(*existing_value, &bucket)) return false;
+    if (!DecodeRollupValue(value, &operand)) return false;
+    bucket.Merge(operand);
+    EncodeRollupValue(bucket, new_value);
+    return true;
+}
+
+/**
+ * @brief Decides whether a rollup record is still needed. A merge operand is judged on its own values: one whose entries all expired can go, and the operand that retracted them carries the same expiry, so both go together.
+ *
+ * @param level Unused, the LSM level.
+ * @param key The rollup key.
+ * @param value_type Value or merge operand, anything else is kept.
+ * @param existing_value The encoded bucket or operand.
+ * @param new_value Unused.
+ * @param skip_until Unused.
+ * @return Decision kRemove when the record holds nothing live, kKeep otherwise.
+ */
+rocksdb::CompactionFilter::Decision RollupRetentionFilter::FilterV2(int level, const rocksdb::Slice& key, ValueType value_type,
+                                                                   const rocksdb::Slice& existing_value,
+                                                                   std::string* new_value, std::string* skip_until) const {
+    if (value_type != ValueType::kValue && value_type != ValueType::kMergeOperand) return Decision::kKeep;
+    rocksdb::Slice source;
+    uint64_t start = 0;
+    RollupBucket bucket;
+    if (!DecodeRollupKey(key, &source, &start) || !DecodeRollupValue(existing_value, &bucket)) return Decision::kKeep;
+
+    const uint64_t now = TtlPolicy::NowMicros();
+    const size_t rollup_level = static_cast<uint8_t>(key[0]);
+    if (rollup_level < kRollupLevels && rollup_level < retention_us_.size() && retention_us_[rollup_level] > 0
+        && start + kRollupResolutions[rollup_level] + retention_us_[rollup_level] <= now) {
+        return Decision::kRemove;
+    }
+    return bucket.last_expiry <= now ? Decision::kRemove : Decision::kKeep;
+}
@@ -0,0 +1,199 @@
+#include "SeriesAggregator.h"
+#include <algorithm>
+#include <google/protobuf/util/time_util.h>
+
+// independent partial reductions per pass, so the loop has no serial dependency and compiles to SIMD min/max/add
+static constexpr size_t kLanes = 4;
+
+/**
+ * @brief Reduces a contiguous run of values into the bucket. Each lane keeps its own min, max and sum and the lanes are combined at the end, which lets the compiler vectorize the loop without reordering floating point sums itself.
+ *
+ * @tparam T double or int64_t.
+ * @param values The values to reduce.
+ * @param n Number of values.
+ * @param acc The bucket to reduce into.
+ */
+template <typename T>
+static void ReduceInto(const T* values, size_t n, AggregateAccumulator* acc) {
+    double lane_min[kLanes];
+    double lane_max[kLanes];
+    double lane_sum[kLanes];
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+        lane_min[lane] = acc->min;
+        lane_max[lane] = acc->max;
+        lane_sum[lane] = 0;
+    }
+
+    size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        for (size_t lane = 0; lane < kLanes; ++lane) {
+            double value = static_cast<double>(values[i + lane]);
+            lane_min[lane] = value < lane_min[lane] ? value : lane_min[lane];
+            lane_max[lane] = value > lane_max[lane] ? value : lane_max[lane];
+            lane_sum[lane] += value;
+        }
+    }
+
+    double sum = 0;
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+        acc->min = std::min(acc->min, lane_min[lane]);
+        acc->max = std::max(acc->max, lane_max[lane]);
+        sum += lane_sum[lane];
+    }
+    acc->sum += sum;
+    acc->count += i;
+    for (; i < n; ++i) {
+        acc->Add(static_cast<double>(values[i]));
+    }
+}
+
+/**
+ * @brief Reduces a list of doubles into the bucket.
+ *
+ * @param values The values.
+ * @param n Number of values.
+ */
+void AggregateAccumulator::AddAll(const double* values, size_t n) {
+    ReduceInto(values, n, this);
+}
+
+/**
+ * @brief Reduces a list of integers into the bucket, as doubles.
+ *
+ * @param values The values.
+ * @param n Number of values.
+ */
+void AggregateAccumulator::AddAll(const int64_t* values, size_t n) {
+    ReduceInto(values, n, this);
+}
+
+/**
+ * @brief Construct a new Series Aggregator:: Series Aggregator object
+ *
+ * @param from_ts Start of the aggregated range in microseconds, the bucket start when bucket_width_us is 0.
+ * @param bucket_width_us Bucket width in microseconds, 0 for one bucket over the whole range.
+ * @param max_buckets Most non-empty buckets the result may have.
+ */
+SeriesAggregator::SeriesAggregator(uint64_t from_ts, uint64_t bucket_width_us, size_t max_buckets)
+    : from_ts_(from_ts), bucket_width_us_(bucket_width_us), max_buckets_(max_buckets) {}
+
+/**
+ * @brief Finds or creates the bucket an entry falls in.
+ *
+ * @param created_us Creation time of the entry in microseconds.
+ * @return AggregateAccumulator* The bucket, nullptr when creating it would exceed max_buckets.
+ */
+AggregateAccumulator* SeriesAggregator::BucketFor(uint64_t created_us) {
+    uint64_t start = bucket_width_us_ == 0 ? from_ts_ : created_us - created_us % bucket_width_us_;
+    if (last_ != buckets_.end() && last_->first == start) return &last_->second;
+
+    auto it = buckets_.find(start);
+    if (it == buckets_.end()) {
+        if (buckets_.size() == max_buckets_) {
+            overflowed_ = true;
+            return nullptr;
+        }
+        it = buckets_.emplace(start, AggregateAccumulator()).first;
+    }
+    last_ = it;
+    return &it->second;
+}
+
+/**
+ * @brief Checks whether a value has anything to reduce: a double or int, or a non-empty double or int list.
+ *
+ * @param value The entry's value.
+ * @return true if the value is numeric.
+ */
+static bool HasNumericValue(const registadb::EntryValue& value) {
+    switch (value.kind_case()) {
+        case registadb::EntryValue::kDoubleValue:
+        case registadb::EntryValue::kIntValue:
+            return true;
+        case registadb::EntryValue::kDoubleList:
+            return value.double_list().value_size() > 0;
+        case registadb::EntryValue::kIntList:
+            return value.int_list().value_size() > 0;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Reduces the numeric values of one entry into the bucket and counts the entry.
+ *
+ * @param value The entry's value.
+ * @return true if the value was numeric.
+ * @return false otherwise, nothing is added.
+ */
+bool AggregateAccumulator::AddValue(const registadb::EntryValue& value) {
+    if (!HasNumericValue(value)) return false;
+    entries++;
+    switch (value.kind_case()) {
+        case registadb::EntryValue::kDoubleValue:
+            Add(value.double_value());
+            break;
+        case registadb::EntryValue::kIntValue:
+            Add(static_cast<double>(value.int_value()));
+            break;
+        case registadb::EntryValue::kDoubleList:
+            AddAll(value.double_list().value().data(), value.double_list().value_size());
+            break;
+        default:
+            AddAll(value.int_list().value().data(), value.int_list().value_size());
+            break;
+    }
+    return true;
+}
+
+/**
+ * @brief Adds the numeric values of one entry to its bucket. Entries without a numeric value (or with an empty list) create no bucket.
+ *
+ * @param created_us Creation time of the entry in microseconds.
+ * @param value The entry's value.
+ * @return true if the entry was reduced or skipped.
+ * @return false if its bucket would exceed max_buckets.
+ */
+bool SeriesAggregator::Add(uint64_t created_us, const registadb::EntryValue& value) {
+    if (!HasNumericValue(value)) return true;
+    AggregateAccumulator* acc = BucketFor(created_us);
+    if (!acc) return false;
+    acc->AddValue(value);
+    return true;
+}
+
+/**
+ * @brief Merges a pre-reduced span (a rollup bucket) into the bucket containing it.
+ *
+ * @param start_us Start of the span in microseconds.
+ * @param acc The reduced values of the span.
+ * @return true if the span was merged or was empty.
+ * @return false if its bucket would exceed max_buckets.
+ */
+bool SeriesAggregator::AddAccumulated(uint64_t start_us, const AggregateAccumulator& acc) {
+    if (acc.count == 0) return true;
+    AggregateAccumulator* bucket = BucketFor(start_us);
+    if (!bucket) return false;
+    bucket->Merge(acc);
+    return true;
+}
+
+/**
+ * @brief Writes out the non-empty buckets, oldest first.
+ *
+ * @param out Output vector the buckets are appended to.
+ */
+void SeriesAggregator::Finish(std::vector<registadb::AggregateBucket>* out) const {
+    out->reserve(out->size() + buckets_.size());
+    for (const auto& [start, acc] : buckets_) {
+        registadb::AggregateBucket bucket;
+        *bucket.mutable_start() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(static_cast<int64_t>(start));
+        bucket.set_count(acc.count);
+        bucket.set_entries(acc.entries);
+        bucket.set_min(acc.min);
+        bucket.set_max(acc.max);
+        bucket.set_sum(acc.sum);
+        bucket.set_avg(acc.sum / static_cast<double>(acc.count));
+        out->push_back(std::move(bucket));
+    }
+}
@@ -0,0 +1,523 @@
+#include "ShardedStorage.h"
+#include "StorageProfiles.h"
+#include <rocksdb/env.h>
+#include <rocksdb/statistics.h>
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <queue>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Makes sure db_path is laid out for the requested shard count: an unsharded store keeps its files in db_path itself, a sharded one has shard_<i> subdirectories and records the count in kShardsFile. A store is never reopened with a different count, since every id would route to the wrong shard.
+ *
+ * @param db_path The store directory.
+ * @param shards The requested shard count.
+ * @return true if the store is new or matches the shard count.
+ * @return false otherwise.
+ */
+static bool CheckShardLayout(const std::string& db_path, size_t shards) {
+    size_t existing = ShardedStorage::ReadShardCount(db_path);
+    if (existing != shards) {
+        std::cerr << "[Storage] " << db_path << " holds " << existing << " shard(s), not " << shards << std::endl;
+        return false;
+    }
+    if (shards == 1) return true;
+
+    std::error_code ec;
+    if (fs::exists(fs::path(db_path) / "CURRENT", ec)) {
+        std::cerr << "[Storage] " << db_path << " holds an unsharded store, it cannot be opened with " << shards << " shards" << std::endl;
+        return false;
+    }
+    fs::create_directories(db_path, ec);
+    std::ofstream marker(fs::path(db_path) / ShardedStorage::kShardsFile, std::ios::trunc);
+    marker << shards << "\n";
+    if (!marker) {
+        std::cerr << "[Storage] Unable to write " << ShardedStorage::kShardsFile << " in " << db_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the shard count recorded in a store directory.
+ *
+ * @param db_path The store directory.
+ * @return size_t The recorded count, 1 when the store is unsharded or does not exist yet.
+ */
+size_t ShardedStorage::ReadShardCount(const std::string& db_path) {
+    std::ifstream marker(fs::path(db_path) / kShardsFile);
+    size_t shards = 0;
+    if (!(marker >> shards) || shards == 0) return 1;
+    return shards;
+}
+
+/**
+ * @brief Construct a new Sharded Storage:: Sharded Storage object. Opens config.shards StorageManager instances, splitting the block cache, entry cache and hot tier budgets evenly between them, sharing one statistics object, and sizing the background thread pools so every shard gets its full flush and compaction budget.
+ *
+ * @param db_path The store directory, shards live in db_path/shard_<i> when there is more than one.
+ * @param enable_stats Whether to enable RocksDB statistics (shared by all shards).
+ * @param config Storage tuning options, see StorageManager; cache and tier sizes are totals across shards.
+ */
+ShardedStorage::ShardedStorage(const std::string& db_path, bool enable_stats, StorageConfig config) {
+    const size_t count = std::max<size_t>(config.shards, 1);
+    if (!CheckShardLayout(db_path, count)) {
+        std::exit(EXIT_FAILURE);
+    }
+
+    StorageConfig shard_config = config;
+    if (count > 1) {
+        size_t cache_bytes = config.block_cache_bytes > 0 ? config.block_cache_bytes : ProfileBlockCacheBytes(config.profile);
+        shard_config.block_cache_bytes = std::max<size_t>(cache_bytes / count, 1);
+        shard_config.entry_cache_bytes = config.entry_cache_bytes / count;
+        shard_config.hot_tier_bytes = config.hot_tier_bytes / count;
+    }
+
+    std::shared_ptr<rocksdb::Statistics> stats = enable_stats ? rocksdb::CreateDBStatistics() : nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        std::string path = db_path;
+        if (count > 1) {
+            const std::string dir = "shard_" + std::to_string(i);
+            path = (fs::path(db_path) / dir).string();
+            if (!config.cold_path.empty()) {
+                shard_config.cold_path = (fs::path(config.cold_path) / dir).string();
+            }
+        }
+        shards_.emplace_back(new StorageManager(path, enable_stats, shard_config, stats));
+    }
+
+    if (count > 1) {
+        // the background pools are shared by every DB in the process; RocksDB runs max(1, jobs / 4) flushes, the rest compactions
+        int flush_threads = 0;
+        int compaction_threads = 0;
+        for (const auto& shard : shards_) {
+            int jobs = shard->GetMaxBackgroundJobs();
+            int flushes = std::max(1, jobs / 4);
+            flush_threads += flushes;
+            compaction_threads += std::max(1, jobs - flushes);
+        }
+        rocksdb::Env::Default()->SetBackgroundThreads(flush_threads, rocksdb::Env::HIGH);
+        rocksdb::Env::Default()->SetBackgroundThreads(compaction_threads, rocksdb::Env::LOW);
+        std::cout << "[Storage] " << count << " shards, " << compaction_threads << " compaction / "
+                  << flush_threads << " flush threads" << std::endl;
+    }
+
+    // one allocator for the whole store, its high-water mark is kept in shard 0
+    uint64_t last_id = 0;
+    uint64_t high_water = 0;
+    for (const auto& shard : shards_) {
+        last_id = std::max(last_id, shard->GetRecoveredLastId());
+        high_water = std::max(high_water, shard->GetRecoveredHighWater());
+    }
+    StorageManager* first = shards_.front().get();
+    GetIdAllocator().Configure(config.id_block_size, [first](uint64_t mark) {
+        return first->PersistIdHighWater(mark);
+    });
+    GetIdAllocator().Reset(last_id, high_water);
+
+    if (count > 1) {
+        for (size_t i = 0; i < count; ++i) {
+            writers_.emplace_back(new ShardWriter());
+        }
+        for (size_t i = 0; i < count; ++i) {
+            writers_[i]->thread = std::thread(&ShardedStorage::WriterLoop, this, i);
+        }
+    }
+}
+
+/**
+ * @brief Destroy the Sharded Storage:: Sharded Storage object. Every shard writer finishes the parts already queued to it before the shards close.
+ *
+ */
+ShardedStorage::~ShardedStorage() {
+    for (auto& writer : writers_) {
+        {
+            std::lock_guard<std::mutex> lock(writer->mutex);
+            writer->stopping = true;
+        }
+        writer->wakeup.notify_one();
+    }
+    for (auto& writer : writers_) {
+        if (writer->thread.joinable()) writer->thread.join();
+    }
+}
+
+/**
+ * @brief Stores an entry in its shard.
+ *
+ * @param entry The entry to store.
+ * @param durability When to return, see registadb::Durability.
+ * @param new_id The id was just handed out by GetNextId, see StorageBackend.
+ * @return true if the entry was successfully stored.
+ * @return false otherwise.
+ */
+bool ShardedStorage::StoreEntry(const registadb::Entry& entry, registadb::Durability durability, bool new_id) {
+    return shards_[ShardFor(entry.id())]->StoreEntry(entry, durability, new_id);
+}
+
+/**
+ * @brief Stores a group of entries with one WriteBatch per shard touched. A group within one shard is written on the caller's thread; otherwise every part is queued to its shard's writer and the parts are written concurrently, so the group takes as long as its slowest part rather than the sum of all of them. Each shard's part is atomic, the group as a whole is not: a failing shard leaves the other parts stored.
+ *
+ * @param entries Pointer to the first entry to store.
+ * @param count Number of entries to store.
+ * @param durability When to return, see registadb::Durability.
+ * @param new_ids Every id was just handed out by GetNextId, see StorageBackend.
+ * @return true if every part was stored.
+ * @return false if any shard failed.
+ */
+bool ShardedStorage::StoreEntries(const registadb::Entry* entries, size_t count, registadb::Durability durability,
+                                  bool new_ids) {
+    if (shards_.size() == 1) return shards_.front()->StoreEntries(entries, count, durability, new_ids);
+
+    std::vector<std::vector<const registadb::Entry*>> parts(shards_.size());
+    for (size_t i = 0; i < count; ++i) {
+        parts[ShardFor(entries[i].id())].push_back(&entries[i]);
+    }
+    size_t touched = 0;
+    size_t last = 0;
+    for (size_t s = 0; s < parts.size(); ++s) {
+        if (parts[s].empty()) continue;
+        touched++;
+        last = s;
+    }
+    if (touched == 0) return true;
+    if (touched == 1) return shards_[last]->StoreEntryRefs(parts[last].data(), parts[last].size(), durability, new_ids);
+
+    // the parts point into entries, which outlive them since the caller waits for every part
+    WriteGroup group;
+    group.pending = touched;
+    for (size_t s = 0; s < parts.size(); ++s) {
+        if (parts[s].empty()) continue;
+        ShardWriter& writer = *writers_[s];
+        {
+            std::lock_guard<std::mutex> lock(writer.mutex);
+            writer.queue.push_back({parts[s].data(), parts[s].size(), durability, new_ids, &group});
+        }
+        writer.wakeup.notify_one();
+    }
+    std::unique_lock<std::mutex> lock(group.mutex);
+    group.done.wait(lock, [&group]() { return group.pending == 0; });
+    return group.ok;
+}
+
+/**
+ * @brief Shard writer loop: takes every part queued for the shard and writes them with one StoreEntryRefs per durability and new_ids, so parts of concurrent groups share a WriteBatch, until the storage is destroyed.
+ *
+ * @param shard The shard this writer owns.
+ */
+void ShardedStorage::WriterLoop(size_t shard) {
+    ShardWriter& writer = *writers_[shard];
+    std::vector<ShardWrite> taken;
+    std::vector<const registadb::Entry*> merged;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(writer.mutex);
+            writer.wakeup.wait(lock, [&writer]() { return writer.stopping || !writer.queue.empty(); });
+            if (writer.queue.empty()) return;
+            taken.assign(writer.queue.begin(), writer.queue.end());
+            writer.queue.clear();
+        }
+
+        auto same_write = [](const ShardWrite& a, const ShardWrite& b) {
+            return a.durability == b.durability && a.new_ids == b.new_ids;
+        };
+        std::stable_sort(taken.begin(), taken.end(), [](const ShardWrite& a, const ShardWrite& b) {
+            return a.durability != b.durability ? a.durability < b.durability : a.new_ids < b.new_ids;
+        });
+        for (size_t begin = 0, end = 0; begin < taken.size(); begin = end) {
+            merged.clear();
+            for (end = begin; end < taken.size() && same_write(taken[end], taken[begin]); ++end) {
+                merged.insert(merged.end(), taken[end].entries, taken[end].entries + taken[end].count);
+            }
+            const bool ok = shards_[shard]->StoreEntryRefs(merged.data(), merged.size(), taken[begin].durability,
+                                                           taken[begin].new_ids);
+            for (size_t i = begin; i < end; ++i) {
+                // notified under the lock: the group lives on its caller's stack and is gone once the caller wakes
+                WriteGroup& group = *taken[i].group;
+                std::lock_guard<std::mutex> lock(group.mutex);
+                group.ok = group.ok && ok;
+                if (--group.pending == 0) group.done.notify_one();
+            }
+        }
+    }
+}
+
+/**
+ * @brief Retrieves an entry from its shard.
+ *
+ * @param id The ID of the entry to retrieve.
+ * @param out_entry The output entry to populate.
+ * @return true if the entry was found.
+ * @return false otherwise.
+ */
+bool ShardedStorage::GetEntryById(int64_t id, registadb::Entry* out_entry) {
+    return shards_[ShardFor(static_cast<uint64_t>(id))]->GetEntryById(id, out_entry);
+}
+
+/**
+ * @brief Retrieves many entries by ID, with one batched lookup per shard touched.
+ *
+ * @param ids The IDs to retrieve.
+ * @param out_entries Output vector resized to ids.size(), entry i holds the result for ids[i].
+ * @param out_found Output vector resized to ids.size(), true where the entry was found.
+ */
+void ShardedStorage::GetEntriesByIds(const std::vector<uint64_t>& ids, std::vector<registadb::Entry>* out_entries,
+                                     std::vector<bool>* out_found) {
+    if (shards_.size() == 1) {
+        shards_.front()->GetEntriesByIds(ids, out_entries, out_found);
+        return;
+    }
+
+    const size_t n = ids.size();
+    std::vector<std::vector<uint64_t>> shard_ids(shards_.size());
+    std::vector<std::vector<size_t>> positions(shards_.size());
+    for (size_t i = 0; i < n; ++i) {
+        size_t s = ShardFor(ids[i]);
+        shard_ids[s].push_back(ids[i]);
+        positions[s].push_back(i);
+    }
+
+    out_entries->clear();
+    out_entries->resize(n);
+    out_found->assign(n, false);
+    std::vector<registadb::Entry> entries;
+    std::vector<bool> found;
+    for (size_t s = 0; s < shards_.size(); ++s) {
+        if (shard_ids[s].empty()) continue;
+        shards_[s]->GetEntriesByIds(shard_ids[s], &entries, &found);
+        for (size_t j = 0; j < positions[s].size(); ++j) {
+            if (!found[j]) continue;
+            (*out_entries)[positions[s][j]].Swap(&entries[j]);
+            (*out_found)[positions[s][j]] = true;
+        }
+    }
+}
+
+/**
+ * @brief Updates an entry in its shard, see StorageManager::UpdateEntry.
+ *
+ * @param patch The update; patch.id() selects the entry.
+ * @param mode How the patch is applied.
+ * @param out_entry The entry as stored after the update.
+ * @param durability When to return, see registadb::Durability.
+ * @return registadb::OperationStatus STATUS_OK, STATUS_NOT_FOUND or STATUS_INTERNAL_ERROR.
+ */
+registadb::OperationStatus ShardedStorage::UpdateEntry(const registadb::Entry& patch, registadb::UpdateMode mode,
+                                                       registadb::Entry* out_entry, registadb::Durability durability) {
+    return shards_[ShardFor(patch.id())]->UpdateEntry(patch, mode, out_entry, durability);
+}
+
+/**
+ * @brief Deletes an entry from its shard.
+ *
+ * @param id The ID of the entry to delete.
+ * @param durability When to return, see registadb::Durability.
+ * @return true: The entry was deleted.
+ * @return false: No entry had that ID, or the delete failed.
+ */
+bool ShardedStorage::DeleteEntryById(int64_t id, registadb::Durability durability) {
+    return shards_[ShardFor(static_cast<uint64_t>(id))]->DeleteEntryById(id, durability);
+}
+
+/**
+ * @brief Merges the shards into a single page, newest first. Every shard is read from the cursor in pages of about limit / shards entries, and a shard's next page is only read once the merge has taken all of its current one, so a page costs about limit entries from the shards instead of limit from each. Composite keys are unique across shards, so the merged cursor is simply the smallest key not returned, and every shard resumes from it on the next page.
+ *
+ * @param cursor Composite key to resume from, empty to start at the newest entry.
+ * @param limit Maximum number of entries to return.
+ * @param fetch Reads up to a given number of entries from one shard, resuming at the given cursor.
+ * @param out_entries Output vector the merged page is appended to.
+ * @param next_cursor Set to the composite key of the next entry of any shard, or cleared when every shard is exhausted.
+ * @return true if every shard read succeeded.
+ * @return false otherwise.
+ */
+bool ShardedStorage::MergePages(const std::string& cursor, size_t limit, const PageFetch& fetch,
+                                std::vector<registadb::Entry>* out_entries, std::string* next_cursor) {
+    next_cursor->clear();
+    const size_t n = shards_.size();
+    const size_t shard_limit = std::max<size_t>(1, (limit + n - 1) / n);
+
+    std::vector<std::vector<registadb::Entry>> pages(n);
+    std::vector<std::string> cursors(n);
+    // reads the shard's next page, skipping empty pages a shard may return before its end
+    auto read_page = [&](size_t shard, const std::string& from) {
+        pages[shard].clear();
+        std::string resume = from;
+        do {
+            cursors[shard].clear();
+            if (!fetch(*shards_[shard], resume, shard_limit, &pages[shard], &cursors[shard])) return false;
+            resume = cursors[shard];
+        } while (pages[shard].empty() && !cursors[shard].empty());
+        return true;
+    };
+
+    struct Head {
+        std::string key;
+        size_t shard;
+        size_t index;
+    };
+    auto newer_first = [](const Head& a, const Head& b) { return a.key > b.key; };
+    std::priority_queue<Head, std::vector<Head>, decltype(newer_first)> heads(newer_first);
+    auto push = [&](size_t shard, size_t index) {
+        if (index >= pages[shard].size()) return;
+        const registadb::Entry& entry = pages[shard][index];
+        heads.push({EncodeCompositeKey(ToEpochMicros(entry.created_at()), entry.id()), shard, index});
+    };
+    for (size_t s = 0; s < n; ++s) {
+        if (!read_page(s, cursor)) return false;
+        push(s, 0);
+    }
+
+    // a shard whose page is used up reads its next one right away, so its next entry is always among the heads,
+    // except for the last shard taken from once the page is full
+    size_t unread = n;
+    while (!heads.empty() && out_entries->size() < limit) {
+        Head head = heads.top();
+        heads.pop();
+        out_entries->push_back(std::move(pages[head.shard][head.index]));
+        size_t next = head.index + 1;
+        if (next == pages[head.shard].size() && !cursors[head.shard].empty()) {
+            if (out_entries->size() == limit) {
+                unread = head.shard;
+                break;
+            }
+            if (!read_page(head.shard, cursors[head.shard])) return false;
+            next = 0;
+        }
+        push(head.shard, next);
+    }
+
+    // the next merged entry, or the start of that shard's next page, whichever is newer
+    if (!heads.empty()) *next_cursor = heads.top().key;
+    if (unread < n && (next_cursor->empty() || cursors[unread] < *next_cursor)) *next_cursor = cursors[unread];
+    return true;
+}
+
+/**
+ * @brief Reads one page of entries created in [from_ts, to_ts], newest first, merged across shards.
+ *
+ * @param from_ts Oldest creation time to include, in microseconds since epoch.
+ * @param to_ts Newest creation time to include, in microseconds since epoch.
+ * @param limit Maximum number of entries to return.
+ * @param cursor Composite key to resume from (next_cursor of the previous page), empty to start at to_ts.
+ * @param out_entries Output vector the page of entries is appended to.
+ * @param next_cursor Set to the composite key of the next entry, or cleared when the range is exhausted.
+ * @return true if the scan succeeded.
+ * @return false if the cursor is malformed or a shard's iterator failed.
+ */
+bool ShardedStorage::ScanRange(uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                               std::vector<registadb::Entry>* out_entries, std::string* next_cursor) {
+    if (shards_.size() == 1) {
+        return shards_.front()->ScanRange(from_ts, to_ts, limit, cursor, out_entries, next_cursor);
+    }
+    return MergePages(cursor, limit, [&](StorageManager& shard, const std::string& shard_cursor, size_t shard_limit,
+                                         std::vector<registadb::Entry>* page, std::string* next) {
+        return shard.ScanRange(from_ts, to_ts, shard_limit, shard_cursor, page, next);
+    }, out_entries, next_cursor);
+}
+
+/**
+ * @brief Reads one page of entries whose metadata[key] == value, created in [from_ts, to_ts], newest first, merged across shards.
+ *
+ * @param key The indexed metadata key.
+ * @param value The value to match.
+ * @param from_ts Oldest creation time to include, in microseconds since epoch.
+ * @param to_ts Newest creation time to include, in microseconds since epoch.
+ * @param limit Maximum number of entries to return.
+ * @param cursor Composite key to resume from (next_cursor of the previous page), empty to start at to_ts.
+ * @param out_entries Output vector the page of entries is appended to.
+ * @param next_cursor Set to the composite key of the next match, or cleared when there are no more.
+ * @return true if the query succeeded.
+ * @return false if the key is not indexed, the cursor is malformed or a shard's iterator failed.
+ */
+bool ShardedStorage::QueryByMetadata(const std::string& key, const std::string& value,
+                                     uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                                     std::vector<registadb::Entry>* out_entries, std::string* next_cursor) {
+    if (shards_.size() == 1) {
+        return shards_.front()->QueryByMetadata(key, value, from_ts, to_ts, limit, cursor, out_entries, next_cursor);
+    }
+    return MergePages(cursor, limit, [&](StorageManager& shard, const std::string& shard_cursor, size_t shard_limit,
+                                         std::vector<registadb::Entry>* page, std::string* next) {
+        return shard.QueryByMetadata(key, value, from_ts, to_ts, shard_limit, shard_cursor, page, next);
+    }, out_entries, next_cursor);
+}
+
+/**
+ * @brief Aggregates every shard into one set of buckets. Buckets are keyed by time, not by order of arrival, so shards can simply add to the same aggregator one after another.
+ *
+ * @param from_ts Oldest creation time to include, in microseconds since epoch.
+ * @param to_ts Newest creation time to include, in microseconds since epoch.
+ * @param key Metadata key to filter on, empty for every entry.
+ * @param value Metadata value the key has to match.
+ * @param out Aggregator the matching entries of every shard are added to.
+ * @return true if every shard was read.
+ * @return false if a shard's read failed or out ran out of buckets.
+ */
+bool ShardedStorage::Aggregate(uint64_t from_ts, uint64_t to_ts, const std::string& key, const std::string& value,
+                               SeriesAggregator* out) {
+    for (auto& shard : shards_) {
+        if (!shard->Aggregate(from_ts, to_ts, key, value, out)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads one shard's change log, see StorageManager::GetChangesSince.
+ *
+ * @param shard Shard to read, sequence numbers are only comparable within one shard.
+ * @param since_sequence First sequence number to return.
+ * @param limit Minimum number of events to stop after.
+ * @param out_events Output vector the events are appended to, tagged with shard.
+ * @param next_sequence Set to the sequence to resume this shard from.
+ * @param truncated Set when the shard's log no longer reaches back to since_sequence.
+ * @return true if the log was read.
+ * @return false if shard is out of range, the change log is disabled or the WAL could not be read.
+ */
+bool ShardedStorage::GetChangesSince(uint32_t shard, uint64_t since_sequence, size_t limit,
+                                     std::vector<registadb::ChangeEvent>* out_events, uint64_t* next_sequence,
+                                     bool* truncated) {
+    if (shard >= shards_.size()) return false;
+    size_t first = out_events->size();
+    if (!shards_[shard]->GetChangesSince(0, since_sequence, limit, out_events, next_sequence, truncated)) return false;
+    for (size_t i = first; i < out_events->size(); ++i) {
+        (*out_events)[i].set_shard(shard);
+    }
+    return true;
+}
+
+/**
+ * @brief Splits a bulk load by shard and runs StorageManager::BulkLoad on every part, each with its own work directory.
+ *
+ * @param entries Prepared entries, moved out by the load.
+ * @param work_dir Directory for the temporary SST files, on the same filesystem as the store.
+ * @param stats Output for the totals across shards.
+ * @return true if every shard loaded its part.
+ * @return false otherwise (parts already loaded stay loaded).
+ */
+bool ShardedStorage::BulkLoad(std::vector<registadb::Entry>& entries, const std::string& work_dir, BulkLoadStats* stats) {
+    if (shards_.size() == 1) return shards_.front()->BulkLoad(entries, work_dir, stats);
+
+    std::vector<std::vector<registadb::Entry>> parts(shards_.size());
+    for (auto& entry : entries) {
+        parts[ShardFor(entry.id())].push_back(std::move(entry));
+    }
+    entries.clear();
+
+    *stats = BulkLoadStats();
+    for (size_t s = 0; s < parts.size(); ++s) {
+        if (parts[s].empty()) continue;
+        const std::string shard_dir = (fs::path(work_dir) / ("shard_" + std::to_string(s))).string();
+        std::error_code ec;
+        fs::create_directories(shard_dir, ec);
+
+        BulkLoadStats part;
+        if (!shards_[s]->BulkLoad(parts[s], shard_dir, &part)) return false;
+        stats->ingested += part.ingested;
+        stats->rewritten += part.rewritten;
+        stats->sst_files += part.sst_files;
+        stats->sst_bytes += part.sst_bytes;
+    }
+    return true;
+}
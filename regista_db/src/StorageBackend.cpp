@@ -0,0 +1,135 @@
+#include "StorageBackend.h"
+#include <cstring>
+#include <endian.h>
+
+
+/**
+ * @brief Encodes a composite key using timestamp and ID, with reversed timestamp so newer entries sort first in every engine.
+ * 
+ * @param timestamp The timestamp to encode in the key.
+ * @param id The ID to encode in the key.
+ * @return std::string The encoded composite key.
+ */
+std::string StorageBackend::EncodeCompositeKey(uint64_t timestamp, uint64_t id) {
+    uint64_t reversed_timestamp = UINT64_MAX - timestamp; // subtract from max to appear at beginning
+
+    // convert to big-endian
+    uint64_t big_endian_ts = htobe64(reversed_timestamp);
+    uint64_t big_endian_id = htobe64(id);
+
+    // return 16 raw bytes as string
+    char buf[16];
+    std::memcpy(buf, &big_endian_ts, 8); // first 8 bytes: time
+    std::memcpy(buf + 8, &big_endian_id, 8); // last 8 bytes: id
+    return std::string(buf, 16);
+}
+
+/**
+ * @brief Encodes a secondary index key: the metadata value, a zero separator, then the entry's 16-byte composite key. Entries sharing a value are therefore contiguous and ordered newest first.
+ * 
+ * @param value The metadata value being indexed.
+ * @param primary_key The entry's composite key in data_cf.
+ * @return std::string The encoded secondary index key.
+ */
+std::string StorageBackend::EncodeMetadataIndexKey(const std::string& value, const std::string& primary_key) {
+    std::string key;
+    key.reserve(value.size() + 1 + primary_key.size());
+    key.append(value);
+    key.push_back('\0');
+    key.append(primary_key);
+    return key;
+}
+
+/**
+ * @brief Decodes a composite key back into its original timestamp and ID components.
+ * 
+ * @param key The composite key to decode, expected to be 16 bytes long.
+ * @return std::pair<uint64_t, uint64_t> The decoded timestamp and ID as a pair.
+ */
+std::pair<uint64_t, uint64_t> StorageBackend::DecodeCompositeKey(const char* key) {
+    uint64_t be_ts, be_id;
+    std::memcpy(&be_ts, key, 8);
+    std::memcpy(&be_id, key + 8, 8);
+
+    return {
+        UINT64_MAX - be64toh(be_ts),
+        be64toh(be_id)
+    };
+}
+
+/**
+ * @brief Converts a google::protobuf::Timestamp to microseconds since epoch.
+ * 
+ * @param ts The timestamp to convert.
+ * @return uint64_t The timestamp in microseconds since epoch.
+ */
+uint64_t StorageBackend::ToEpochMicros(const google::protobuf::Timestamp& ts) {
+    return ts.seconds() * 1000000ULL + ts.nanos() / 1000ULL;
+}
+
+/**
+ * @brief Applies an update to a stored entry. The id and created_at of the stored entry are always kept and updated_at is taken from the patch.
+ * 
+ * @param patch The update request entry.
+ * @param mode UPDATE_REPLACE swaps metadata, data and ttl_seconds; UPDATE_MERGE merges metadata keys and replaces data and ttl_seconds only when the patch sets them.
+ * @param stored The stored entry, modified in place.
+ */
+void StorageBackend::ApplyUpdate(const registadb::Entry& patch, registadb::UpdateMode mode, registadb::Entry* stored) {
+    if (mode == registadb::UPDATE_MERGE) {
+        for (const auto& [key, value] : patch.metadata()) {
+            (*stored->mutable_metadata())[key] = value;
+        }
+        if (patch.has_data() && patch.data().kind_case() != registadb::EntryValue::KIND_NOT_SET) {
+            stored->mutable_data()->CopyFrom(patch.data());
+        }
+        if (patch.ttl_seconds() != 0) {
+            stored->set_ttl_seconds(patch.ttl_seconds());
+        }
+    } else {
+        *stored->mutable_metadata() = patch.metadata();
+        if (patch.has_data()) {
+            stored->mutable_data()->CopyFrom(patch.data());
+        } else {
+            stored->clear_data();
+        }
+        stored->set_ttl_seconds(patch.ttl_seconds());
+    }
+    stored->mutable_updated_at()->CopyFrom(patch.updated_at());
+}
+
+/**
+ * @brief Aggregates through the paged read API, so every engine supports it. Entries are read a page at a time and reduced as they arrive, never held all at once.
+ * 
+ * @param from_ts Oldest creation time to include, in microseconds since epoch.
+ * @param to_ts Newest creation time to include, in microseconds since epoch.
+ * @param key Metadata key to filter on, empty for every entry.
+ * @param value Metadata value the key has to match.
+ * @param out Aggregator the matching entries are added to.
+ * @return true if the whole range was read.
+ * @return false if a page read failed or out ran out of buckets.
+ */
+bool StorageBackend::Aggregate(uint64_t from_ts, uint64_t to_ts, const std::string& key, const std::string& value,
+                               SeriesAggregator* out) {
+    static constexpr size_t kPageSize = 1024;
+    const bool indexed = !key.empty() && IsMetadataIndexed(key);
+
+    std::vector<registadb::Entry> page;
+    std::string cursor;
+    std::string next_cursor;
+    do {
+        page.clear();
+        bool ok = indexed ? QueryByMetadata(key, value, from_ts, to_ts, kPageSize, cursor, &page, &next_cursor)
+                          : ScanRange(from_ts, to_ts, kPageSize, cursor, &page, &next_cursor);
+        if (!ok) return false;
+
+        for (const auto& entry : page) {
+            if (!key.empty() && !indexed) {
+                auto it = entry.metadata().find(key);
+                if (it == entry.metadata().end() || it->second != value) continue;
+            }
+            if (!out->Add(ToEpochMicros(entry.created_at()), entry.data())) return false;
+        }
+        cursor = next_cursor;
+    } while (!cursor.empty());
+    return true;
+}
@@ -1,5 +1,17 @@
 #include "StorageManager.h"
+#include "EntryCodec.h"
+#include "StorageProfiles.h"
+#include <rocksdb/sst_file_writer.h>
+#include <rocksdb/table_properties.h>
+#include <rocksdb/transaction_log.h>
 #include <rocksdb/write_batch.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <iostream>
 #include <arpa/inet.h>
 #include "rocksdb/statistics.h"
@@ -10,22 +22,93 @@
  * 
  * @param db_path The path to the RocksDB database directory
  * @param enable_stats Whether to enable or disable rocksDB statistics
+ * @param config Storage tuning options (secondary indexes, tuning profile, options file, entry cache, TTL, cold tier)
+ * @param shared_stats Statistics shared with other instances, used instead of creating one when enable_stats is set
  */
-StorageManager::StorageManager(const std::string& db_path, bool enable_stats) {
+StorageManager::StorageManager(const std::string& db_path, bool enable_stats, StorageConfig config,
+                               std::shared_ptr<rocksdb::Statistics> shared_stats)
+    : config_(std::move(config)) {
+    StorageTuning tuning;
+    if (!BuildStorageTuning(config_, &options, &tuning)) {
+        std::cerr << "[Storage] Falling back to default RocksDB options" << std::endl;
+        options = rocksdb::Options();
+        tuning = StorageTuning();
+    }
     options.create_if_missing = true;
     options.create_missing_column_families = true;
 
     if (enable_stats) {
-        this->rocks_stats = rocksdb::CreateDBStatistics();
+        this->rocks_stats = shared_stats ? shared_stats : rocksdb::CreateDBStatistics();
         options.statistics = this->rocks_stats;
         options.statistics->set_stats_level(rocksdb::StatsLevel::kExceptDetailedTimers);
     }
 
+    // TTL filters drop expired records as compaction rewrites them, periodic compaction makes sure old files get rewritten
+    if (config_.entry_ttl || config_.default_ttl_seconds > 0 || !config_.source_ttl_seconds.empty()) {
+        ttl_policy_.reset(new TtlPolicy(config_.default_ttl_seconds, config_.source_ttl_seconds));
+        index_expiry_filter_.reset(new IndexExpiryFilter("RegistaIndexExpiryFilter", 16));
+        metadata_expiry_filter_.reset(new IndexExpiryFilter("RegistaMetadataIndexExpiryFilter", 0));
+        data_expiry_filter_.reset(new DataExpiryFilter(*ttl_policy_));
+        tuning.index_cf.compaction_filter = index_expiry_filter_.get();
+        tuning.metadata_index_cf.compaction_filter = metadata_expiry_filter_.get();
+        tuning.data_cf.compaction_filter = data_expiry_filter_.get();
+        for (auto* cf : {&tuning.index_cf, &tuning.metadata_index_cf, &tuning.data_cf}) {
+            cf->periodic_compaction_seconds = 24 * 60 * 60;
+        }
+    }
+
+    // change log: obsolete WAL files are archived instead of deleted, so GetUpdatesSince can still read them
+    if (config_.change_log) {
+        options.WAL_ttl_seconds = config_.change_log_retention_seconds;
+    }
+
+    // cold tier: data_cf levels are placed in the first path with room, so older (lower) levels spill to cold_path
+    if (!config_.cold_path.empty()) {
+        tuning.data_cf.cf_paths = {{db_path, config_.hot_tier_bytes}, {config_.cold_path, UINT64_MAX}};
+    }
+
     // column families
     std::vector<rocksdb::ColumnFamilyDescriptor> column_families;
-    column_families.push_back({rocksdb::kDefaultColumnFamilyName, rocksdb::ColumnFamilyOptions()});
-    column_families.push_back({kIndexCF, rocksdb::ColumnFamilyOptions()});
-    column_families.push_back({kDataCF, rocksdb::ColumnFamilyOptions()});
+    column_families.push_back({rocksdb::kDefaultColumnFamilyName, OptionsForColumnFamily(tuning, rocksdb::kDefaultColumnFamilyName)});
+    column_families.push_back({kIndexCF, OptionsForColumnFamily(tuning, kIndexCF)});
+    column_families.push_back({kDataCF, OptionsForColumnFamily(tuning, kDataCF)});
+
+    // every existing column family has to be opened, plus one per declared metadata index
+    std::vector<std::string> existing_cfs;
+    rocksdb::DB::ListColumnFamilies(options, db_path, &existing_cfs); // fails on a new DB, that's fine
+    std::vector<std::string> extra_cfs;
+    for (const auto& name : existing_cfs) {
+        if (name != rocksdb::kDefaultColumnFamilyName && name != kIndexCF && name != kDataCF) {
+            extra_cfs.push_back(name);
+        }
+    }
+    std::vector<std::string> new_indexes;
+    for (const auto& key : config_.indexed_metadata_keys) {
+        std::string name = kMetadataIndexCFPrefix + key;
+        if (std::find(extra_cfs.begin(), extra_cfs.end(), name) == extra_cfs.end()) {
+            extra_cfs.push_back(name);
+            new_indexes.push_back(key);
+        }
+    }
+    bool new_rollups = false;
+    if (config_.rollups && std::find(extra_cfs.begin(), extra_cfs.end(), kRollupCF) == extra_cfs.end()) {
+        extra_cfs.push_back(kRollupCF);
+        new_rollups = true;
+    }
+    // the rollup CF always gets its merge operator, even when it is only opened to be dropped. Its retention filter
+    // drops 1 min and 1 s buckets past their retention and buckets whose entries all expired
+    rollup_merge_ = std::make_shared<RollupMergeOperator>();
+    rollup_retention_us_ = {0, config_.rollup_minute_retention_seconds * 1000000ULL,
+                            config_.rollup_second_retention_seconds * 1000000ULL};
+    rollup_retention_filter_.reset(new RollupRetentionFilter(rollup_retention_us_));
+    for (const auto& name : extra_cfs) {
+        column_families.push_back({name, OptionsForColumnFamily(tuning, name)});
+        if (name == kRollupCF) {
+            column_families.back().options.merge_operator = rollup_merge_;
+            column_families.back().options.compaction_filter = rollup_retention_filter_.get();
+            column_families.back().options.periodic_compaction_seconds = 24 * 60 * 60;
+        }
+    }
 
     // vector to hold the handles RocksDB will give back
     std::vector<rocksdb::ColumnFamilyHandle*> handles;
@@ -33,6 +116,8 @@ StorageManager::StorageManager(const std::string& db_path, bool enable_stats) {
     rocksdb::Status status = rocksdb::DB::Open(options, db_path, column_families, &handles, &db);
     if (!status.ok()) {
         std::cerr << "Failed to open RocksDB: " << status.ToString() << std::endl;
+        // no usable handles (e.g. the store is locked by a running engine)
+        std::exit(EXIT_FAILURE);
     }
 
     // assign handle pointers
@@ -40,16 +125,123 @@ StorageManager::StorageManager(const std::string& db_path, bool enable_stats) {
     index_handle_   = handles[1];
     data_handle_    = handles[2];
 
-    // set global counter to last id in db
+    const std::string prefix = kMetadataIndexCFPrefix;
+    for (size_t i = 3; i < handles.size(); ++i) {
+        const std::string& name = extra_cfs[i - 3];
+        if (name == kRollupCF) {
+            if (config_.rollups) {
+                rollup_handle_ = handles[i];
+                extra_handles_.push_back(handles[i]);
+            } else {
+                // stale once writes stop maintaining them, so they cannot be turned back on without a rebuild
+                db->DropColumnFamily(handles[i]);
+                db->DestroyColumnFamilyHandle(handles[i]);
+                std::cout << "[Storage] Rollups are disabled, dropped " << kRollupCF << std::endl;
+            }
+            continue;
+        }
+        extra_handles_.push_back(handles[i]);
+        if (name.compare(0, prefix.size(), prefix) != 0) continue;
+
+        std::string key = name.substr(prefix.size());
+        const auto& declared = config_.indexed_metadata_keys;
+        if (std::find(declared.begin(), declared.end(), key) != declared.end()) {
+            metadata_index_handles_[key] = handles[i];
+        } else {
+            std::cout << "[Storage] Metadata index '" << key << "' is no longer declared and will not be maintained" << std::endl;
+        }
+    }
+
+    // backfill indexes declared on a DB that already holds data
+    for (const auto& key : new_indexes) {
+        BuildMetadataIndex(key);
+    }
+    if (new_rollups) {
+        BuildRollups();
+    }
+
+    if (config_.entry_cache_bytes > 0) {
+        entry_cache_.reset(new EntryCache(config_.entry_cache_bytes, config_.entry_cache_shards));
+    }
+
+    RecoverIdAllocator();
+
+    // FlushWAL(true) also pushes out the WAL buffer when manual_wal_flush is set by an options file
+    wal_sync_.SetSyncFunction([this]() {
+        rocksdb::Status s = db->FlushWAL(true);
+        if (!s.ok()) std::cerr << "[Storage] WAL sync failed: " << s.ToString() << std::endl;
+        return s.ok();
+    });
+}
+
+/**
+ * @brief Maps a durability level onto the options of the write itself. DURABILITY_SYNC writes are not synced here; they are committed like async ones and then wait for a shared WAL sync in AwaitDurable, so the write group leader does not fsync once per writer.
+ * With the change log on the WAL is never skipped, a DURABILITY_NONE write would be missing from the change stream.
+ * 
+ * @param durability Requested durability, DURABILITY_DEFAULT is treated as DURABILITY_ASYNC.
+ * @return rocksdb::WriteOptions Options for db->Write.
+ */
+rocksdb::WriteOptions StorageManager::WriteOptionsFor(registadb::Durability durability) const {
+    rocksdb::WriteOptions write_options;
+    write_options.disableWAL = durability == registadb::DURABILITY_NONE && !config_.change_log;
+    return write_options;
+}
+
+/**
+ * @brief Blocks a DURABILITY_SYNC writer until its committed write is covered by a WAL fsync. Must be called after the stripe locks are released, otherwise writers to the same stripes could not join the group.
+ * 
+ * @param durability Durability of the write that just committed.
+ * @return true if the write is durable under durability.
+ * @return false if the WAL sync failed.
+ */
+bool StorageManager::AwaitDurable(registadb::Durability durability) {
+    if (durability != registadb::DURABILITY_SYNC) return true;
+    return wal_sync_.WaitDurable();
+}
+
+/**
+ * @brief Restarts the id allocator after the highest id in index_cf or the persisted high-water mark, whichever is larger, and has it persist new marks to the default column family.
+ * The mark keeps ids unique across restarts even when the newest entries were deleted or expired.
+ * 
+ */
+void StorageManager::RecoverIdAllocator() {
+    uint64_t last_id = 0;
     std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(rocksdb::ReadOptions(), index_handle_));
     it->SeekToFirst();
     if (it->Valid()) {
-        uint64_t decoded_id = DecodeIndexKey(it->key().data());
-        SetStartingId(decoded_id);
-    } else {
-        SetStartingId(0);
+        last_id = DecodeIndexKey(it->key().data());
+    }
+
+    uint64_t high_water = 0;
+    std::string value;
+    rocksdb::Status s = db->Get(rocksdb::ReadOptions(), default_handle_, kIdHighWaterKey, &value);
+    if (s.ok() && value.size() == sizeof(uint64_t)) {
+        std::memcpy(&high_water, value.data(), sizeof(high_water));
+        high_water = be64toh(high_water);
+    } else if (!s.ok() && !s.IsNotFound()) {
+        std::cerr << "[Storage] Unable to read id high-water mark: " << s.ToString() << std::endl;
     }
 
+    recovered_last_id_ = last_id;
+    recovered_high_water_ = high_water;
+    GetIdAllocator().Configure(config_.id_block_size, [this](uint64_t mark) {
+        return PersistIdHighWater(mark);
+    });
+    GetIdAllocator().Reset(last_id, high_water);
+}
+
+/**
+ * @brief Writes an id allocator high-water mark to the default column family.
+ * 
+ * @param mark Every id below mark may have been handed out.
+ * @return true if the mark was written.
+ * @return false otherwise.
+ */
+bool StorageManager::PersistIdHighWater(uint64_t mark) {
+    uint64_t be = htobe64(mark);
+    rocksdb::Status s = db->Put(rocksdb::WriteOptions(), default_handle_, kIdHighWaterKey,
+                                rocksdb::Slice(reinterpret_cast<const char*>(&be), sizeof(be)));
+    return s.ok();
 }
 
 /**
@@ -57,33 +249,15 @@ StorageManager::StorageManager(const std::string& db_path, bool enable_stats) {
  * 
  */
 StorageManager::~StorageManager() {
+    for (auto* handle : extra_handles_) {
+        db->DestroyColumnFamilyHandle(handle);
+    }
     db->DestroyColumnFamilyHandle(index_handle_);
     db->DestroyColumnFamilyHandle(data_handle_);
     db->DestroyColumnFamilyHandle(default_handle_);
     delete db;
 }
 
-/**
- * @brief Encodes a composite key using timestamp and ID, with reversed timestamp for reverse sorting in RocksDB.
- * 
- * @param timestamp The timestamp to encode in the key.
- * @param id The ID to encode in the key.
- * @return std::string The encoded composite key.
- */
-std::string StorageManager::EncodeCompositeKey(uint64_t timestamp, uint64_t id) {
-    uint64_t reversed_timestamp = UINT64_MAX - timestamp; // subtract from max to appear at beginning
-
-    // convert to big-endian
-    uint64_t big_endian_ts = htobe64(reversed_timestamp);
-    uint64_t big_endian_id = htobe64(id);
-
-    // return 16 raw bytes as string
-    char buf[16];
-    std::memcpy(buf, &big_endian_ts, 8); // first 8 bytes: time
-    std::memcpy(buf + 8, &big_endian_id, 8); // last 8 bytes: id
-    return std::string(buf, 16);
-}
-
 /**
  * @brief Encodes an index key using the given ID, with reversed ID for reverse sorting in RocksDB.
  * 
@@ -102,23 +276,6 @@ std::string StorageManager::EncodeIndexKey(uint64_t id) {
     return std::string(buf, 8);
 }
 
-/**
- * @brief Decodes a composite key back into its original timestamp and ID components.
- * 
- * @param key The composite key to decode, expected to be 16 bytes long.
- * @return std::pair<uint64_t, uint64_t> The decoded timestamp and ID as a pair.
- */
-std::pair<uint64_t, uint64_t> StorageManager::DecodeCompositeKey(const char* key) {
-    uint64_t be_ts, be_id;
-    std::memcpy(&be_ts, key, 8);
-    std::memcpy(&be_id, key + 8, 8);
-
-    return {
-        UINT64_MAX - be64toh(be_ts),
-        be64toh(be_id)
-    };
-}
-
 /**
  * @brief Decodes an index key back into its original ID component.
  * 
@@ -135,24 +292,330 @@ uint64_t StorageManager::DecodeIndexKey(const char* key) {
 }
 
 /**
- * @brief Converts a google::protobuf::Timestamp to microseconds since epoch.
+ * @brief Stores an entry in RocksDB by creating a composite key for the data column family and an index entry for the ID column family, using a WriteBatch for atomicity.
  * 
- * @param ts The timestamp to convert.
- * @return uint64_t The timestamp in microseconds since epoch.
+ * @param entry The entry to store.
+ * @param durability When to return, see registadb::Durability.
+ * @param new_id The id was just handed out by GetNextId, so the write skips looking for a version to replace.
+ * @return true if the entry was successfully stored.
+ * @return false if there was an error storing the entry.
  */
-uint64_t StorageManager::ToEpochMicros(const google::protobuf::Timestamp& ts) {
-    return ts.seconds() * 1000000ULL + ts.nanos() / 1000ULL;
+bool StorageManager::StoreEntry(const registadb::Entry& entry, registadb::Durability durability, bool new_id) {
+    rocksdb::Status s;
+    {
+        std::lock_guard<std::mutex> id_lock(id_locks_[IdLockStripe(entry.id())]);
+        std::string serialized_data;
+        const registadb::Entry* ref = &entry;
+        std::vector<StoredVersion> previous;
+        ReadStoredVersions(&ref, 1, new_id, &previous);
+
+        // atomic write batch
+        rocksdb::WriteBatch batch;
+        RollupLocks rollup_locks;
+        AppendEntry(batch, entry, serialized_data, previous[0]);
+        if (rollup_handle_) AppendRollupsReplacing(batch, &rollup_locks, &ref, 1, previous);
+        s = db->Write(WriteOptionsFor(durability), &batch);
+        if (entry_cache_) entry_cache_->Invalidate(entry.id());
+    }
+    return s.ok() && AwaitDurable(durability);
 }
 
+/**
+ * @brief Stores a group of entries in a single WriteBatch, so the whole group pays for one write (and one WAL append) instead of one per entry.
+ * 
+ * @param entries Pointer to the first entry to store.
+ * @param count Number of entries to store.
+ * @param durability When to return, see registadb::Durability.
+ * @param new_ids Every id was just handed out by GetNextId, so the group skips looking for versions to replace.
+ * @return true if every entry was successfully stored.
+ * @return false if there was an error storing the batch (none of the entries are stored).
+ */
+bool StorageManager::StoreEntries(const registadb::Entry* entries, size_t count, registadb::Durability durability, bool new_ids) {
+    std::vector<const registadb::Entry*> refs(count);
+    for (size_t i = 0; i < count; ++i) {
+        refs[i] = &entries[i];
+    }
+    return StoreEntryRefs(refs.data(), count, durability, new_ids);
+}
 
 /**
- * @brief Stores an entry in RocksDB by creating a composite key for the data column family and an index entry for the ID column family, using a WriteBatch for atomicity.
+ * @brief Stores a group of entries given by pointer in a single WriteBatch, see StoreEntries.
+ * 
+ * @param entries Pointers to the entries to store.
+ * @param count Number of entries to store.
+ * @param durability When to return, see registadb::Durability.
+ * @param new_ids Every id was just handed out by GetNextId, see StoreEntries.
+ * @return true if every entry was successfully stored.
+ * @return false if there was an error storing the batch (none of the entries are stored).
+ */
+bool StorageManager::StoreEntryRefs(const registadb::Entry* const* entries, size_t count,
+                                    registadb::Durability durability, bool new_ids) {
+    if (count == 0) return true;
+
+    // lock every stripe the group touches, in stripe order so concurrent groups cannot deadlock
+    std::vector<size_t> stripes;
+    stripes.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        stripes.push_back(IdLockStripe(entries[i]->id()));
+    }
+    std::sort(stripes.begin(), stripes.end());
+    stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+    rocksdb::Status s;
+    {
+        std::vector<std::unique_lock<std::mutex>> id_locks;
+        id_locks.reserve(stripes.size());
+        for (size_t stripe : stripes) {
+            id_locks.emplace_back(id_locks_[stripe]);
+        }
+
+        // reuse one serialization buffer for the whole group
+        std::string serialized_data;
+
+        std::vector<StoredVersion> previous;
+        ReadStoredVersions(entries, count, new_ids, &previous);
+
+        rocksdb::WriteBatch batch;
+        RollupLocks rollup_locks;
+        for (size_t i = 0; i < count; ++i) {
+            AppendEntry(batch, *entries[i], serialized_data, previous[i]);
+        }
+        if (rollup_handle_) AppendRollupsReplacing(batch, &rollup_locks, entries, count, previous);
+        s = db->Write(WriteOptionsFor(durability), &batch);
+        if (entry_cache_) {
+            for (size_t i = 0; i < count; ++i) entry_cache_->Invalidate(entries[i]->id());
+        }
+    }
+    return s.ok() && AwaitDurable(durability);
+}
+
+/**
+ * @brief Loads a large group of entries by writing pre-sorted SST files and ingesting them into index_cf, data_cf and every secondary index in one atomic step, skipping the memtable and the WAL. Ids that already exist go through StoreEntries instead so their old keys are cleaned up. Entries must be fully prepared (ids and timestamps set); a later duplicate of an id wins.
+ * 
+ * @param entries The entries to load, sorted and deduplicated in place.
+ * @param work_dir Directory for the temporary SST files, on the same filesystem as the database so ingestion can move them.
+ * @param stats Receives counts for this call, may be nullptr.
+ * @return true Every entry was written.
+ * @return false Writing or ingesting failed, nothing from the SST files is visible.
+ */
+bool StorageManager::BulkLoad(std::vector<registadb::Entry>& entries, const std::string& work_dir, BulkLoadStats* stats) {
+    BulkLoadStats local;
+    if (!stats) stats = &local;
+    *stats = BulkLoadStats();
+    if (entries.empty()) return true;
+
+    // keep the last occurrence of every id
+    std::unordered_map<uint64_t, size_t> last_by_id;
+    last_by_id.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        last_by_id[static_cast<uint64_t>(entries[i].id())] = i;
+    }
+    std::vector<registadb::Entry> unique;
+    unique.reserve(last_by_id.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (last_by_id[static_cast<uint64_t>(entries[i].id())] == i) unique.push_back(std::move(entries[i]));
+    }
+    entries.swap(unique);
+
+    // ids that are already stored need their previous keys removed, which ingestion cannot do
+    const size_t n = entries.size();
+    std::vector<std::string> index_keys(n);
+    std::vector<rocksdb::Slice> index_slices(n);
+    for (size_t i = 0; i < n; ++i) {
+        index_keys[i] = EncodeIndexKey(static_cast<uint64_t>(entries[i].id()));
+        index_slices[i] = index_keys[i];
+    }
+    std::vector<rocksdb::PinnableSlice> existing(n);
+    std::vector<rocksdb::Status> statuses(n);
+    db->MultiGet(rocksdb::ReadOptions(), index_handle_, n, index_slices.data(), existing.data(), statuses.data());
+
+    std::vector<registadb::Entry> rewrites;
+    std::vector<const registadb::Entry*> ingested;
+    using KeyValues = std::vector<std::pair<std::string, std::string>>;
+    KeyValues index_kvs, data_kvs;
+    std::map<std::string, KeyValues> metadata_kvs;
+    index_kvs.reserve(n);
+    data_kvs.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        const registadb::Entry& entry = entries[i];
+        if (statuses[i].ok()) {
+            rewrites.push_back(entry);
+            continue;
+        }
+        if (!statuses[i].IsNotFound()) {
+            std::cerr << "[Storage] Bulk load index lookup failed: " << statuses[i].ToString() << std::endl;
+            return false;
+        }
+
+        uint64_t expires_at = ExpiresAt(entry);
+        std::string primary_key = EncodeCompositeKey(ToEpochMicros(entry.created_at()), static_cast<uint64_t>(entry.id()));
+        std::string index_value = primary_key;
+        TtlPolicy::AppendExpiry(&index_value, expires_at);
+        index_kvs.emplace_back(std::move(index_keys[i]), std::move(index_value));
+        for (const auto& [key, handle] : metadata_index_handles_) {
+            auto it = entry.metadata().find(key);
+            if (it == entry.metadata().end()) continue;
+            std::string index_value;
+            TtlPolicy::AppendExpiry(&index_value, expires_at);
+            metadata_kvs[key].emplace_back(EncodeMetadataIndexKey(it->second, primary_key), std::move(index_value));
+        }
+        std::string stored;
+        EncodeStoredEntry(entry, config_.columnar_lists, &stored);
+        data_kvs.emplace_back(std::move(primary_key), std::move(stored));
+        ingested.push_back(&entry);
+    }
+
+    // one SST file per column family, keys in comparator (bytewise) order
+    static std::atomic<uint64_t> load_sequence{0};
+    const std::string file_prefix = work_dir + "/bulk_" + std::to_string(TtlPolicy::NowMicros()) + "_"
+                                    + std::to_string(load_sequence.fetch_add(1)) + "_";
+    std::vector<rocksdb::IngestExternalFileArg> args;
+    std::vector<std::string> written_files;
+    auto remove_files = [&written_files]() {
+        for (const std::string& file : written_files) std::remove(file.c_str());
+    };
+    auto write_sst = [&](rocksdb::ColumnFamilyHandle* handle, const std::string& name, KeyValues& kvs) {
+        if (kvs.empty()) return true;
+        std::sort(kvs.begin(), kvs.end());
+        std::string file = file_prefix + name + ".sst";
+        rocksdb::SstFileWriter writer(rocksdb::EnvOptions(), db->GetOptions(handle), handle);
+        rocksdb::Status s = writer.Open(file);
+        written_files.push_back(file);
+        for (size_t i = 0; s.ok() && i < kvs.size(); ++i) {
+            s = writer.Put(kvs[i].first, kvs[i].second);
+        }
+        rocksdb::ExternalSstFileInfo info;
+        if (s.ok()) s = writer.Finish(&info);
+        if (!s.ok()) {
+            std::cerr << "[Storage] Unable to write SST file " << file << ": " << s.ToString() << std::endl;
+            return false;
+        }
+        rocksdb::IngestExternalFileArg arg;
+        arg.column_family = handle;
+        arg.external_files.push_back(file);
+        arg.options.move_files = true;
+        args.push_back(std::move(arg));
+        stats->sst_files++;
+        stats->sst_bytes += info.file_size;
+        return true;
+    };
+
+    bool ok = write_sst(index_handle_, kIndexCF, index_kvs) && write_sst(data_handle_, kDataCF, data_kvs);
+    for (auto& [key, kvs] : metadata_kvs) {
+        ok = ok && write_sst(metadata_index_handles_.at(key), kMetadataIndexCFPrefix + key, kvs);
+    }
+    if (!ok) {
+        remove_files();
+        return false;
+    }
+
+    if (!args.empty()) {
+        // rollups are merge operands, which SST ingestion cannot add to, so they go through a normal write. Their
+        // buckets are locked before ingestion, a write-back must not land between the entries and their rollups
+        rocksdb::WriteBatch rollup_batch;
+        RollupLocks rollup_locks;
+        if (rollup_handle_) AppendRollups(rollup_batch, &rollup_locks, ingested.data(), ingested.size());
+        rocksdb::Status s = db->IngestExternalFiles(args);
+        // with move_files the database holds hard links, the originals are no longer needed either way
+        remove_files();
+        if (!s.ok()) {
+            std::cerr << "[Storage] SST ingestion failed: " << s.ToString() << std::endl;
+            return false;
+        }
+        stats->ingested = index_kvs.size();
+
+        if (rollup_handle_) {
+            s = db->Write(rocksdb::WriteOptions(), &rollup_batch);
+            if (!s.ok()) {
+                std::cerr << "[Storage] Unable to write rollups for the bulk load: " << s.ToString() << std::endl;
+                return false;
+            }
+        }
+    }
+
+    if (!rewrites.empty()) {
+        if (!StoreEntries(rewrites.data(), rewrites.size())) return false;
+        stats->rewritten = rewrites.size();
+    }
+    if (entry_cache_) {
+        for (const registadb::Entry& entry : entries) entry_cache_->Invalidate(entry.id());
+    }
+    return true;
+}
+
+/**
+ * @brief Reads what a group of ids holds before the group is written: the data_cf key from index_cf (one MultiGet), and when metadata indexes or rollups have to take the old version back out, the stored entry too (a second MultiGet). Expired versions are returned as well, since their keys and rollup values are still there until compaction drops them. Must be called with the ids' stripe locks held.
  * 
+ * @param entries Pointers to the entries about to be written.
+ * @param count Number of entries.
+ * @param new_ids Every id was just handed out by GetNextId and cannot be stored yet, nothing is read and only repeats within the group are resolved.
+ * @param out Output resized to count, element i holds what entries[i] replaces.
+ */
+void StorageManager::ReadStoredVersions(const registadb::Entry* const* entries, size_t count, bool new_ids,
+                                        std::vector<StoredVersion>* out) {
+    out->clear();
+    out->resize(count);
+    const bool with_entries = !metadata_index_handles_.empty() || rollup_handle_ != nullptr;
+
+    // an id written earlier in the same group is replaced by that copy, not by what is stored
+    std::unordered_map<uint64_t, size_t> earlier;
+    std::vector<std::string> index_keys;
+    std::vector<size_t> positions;
+    index_keys.reserve(count);
+    positions.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t id = static_cast<uint64_t>(entries[i]->id());
+        auto [it, inserted] = earlier.emplace(id, i);
+        if (inserted) {
+            index_keys.push_back(EncodeIndexKey(id));
+            positions.push_back(i);
+            continue;
+        }
+        StoredVersion& version = (*out)[i];
+        version.primary_key = EncodeCompositeKey(ToEpochMicros(entries[it->second]->created_at()), id);
+        if (with_entries) {
+            version.entry = *entries[it->second];
+            version.has_entry = true;
+        }
+        it->second = i;
+    }
+
+    const size_t n = index_keys.size();
+    if (n == 0 || new_ids) return;
+    std::vector<rocksdb::Slice> index_slices(index_keys.begin(), index_keys.end());
+    std::vector<rocksdb::PinnableSlice> index_values(n);
+    std::vector<rocksdb::Status> statuses(n);
+    db->MultiGet(rocksdb::ReadOptions(), index_handle_, n, index_slices.data(), index_values.data(), statuses.data());
+
+    std::vector<size_t> found;
+    std::vector<rocksdb::Slice> data_slices;
+    for (size_t k = 0; k < n; ++k) {
+        if (!statuses[k].ok() || index_values[k].size() < 16) continue;
+        StoredVersion& version = (*out)[positions[k]];
+        version.primary_key.assign(index_values[k].data(), 16); // without the expiry suffix
+        found.push_back(positions[k]);
+    }
+    if (!with_entries || found.empty()) return;
+
+    for (size_t i : found) data_slices.emplace_back((*out)[i].primary_key);
+    std::vector<rocksdb::PinnableSlice> values(found.size());
+    std::vector<rocksdb::Status> data_statuses(found.size());
+    db->MultiGet(rocksdb::ReadOptions(), data_handle_, found.size(), data_slices.data(), values.data(), data_statuses.data());
+    for (size_t k = 0; k < found.size(); ++k) {
+        StoredVersion& version = (*out)[found[k]];
+        version.has_entry = data_statuses[k].ok() && DecodeStoredEntry(values[k].data(), values[k].size(), &version.entry);
+    }
+}
+
+/**
+ * @brief Appends the data and index puts for a single entry to a WriteBatch. When the id already held a version under a different created_at, its data_cf row is deleted, and the metadata index keys of the old version are replaced by the new ones.
+ * 
+ * @param batch The batch to append to.
  * @param entry The entry to store.
- * @return true if the entry was successfully stored.
- * @return false if there was an error storing the entry.
+ * @param scratch Reusable buffer for the serialized entry.
+ * @param previous What the id held before this write, see ReadStoredVersions.
  */
-bool StorageManager::StoreEntry(const registadb::Entry& entry) {
+void StorageManager::AppendEntry(rocksdb::WriteBatch& batch, const registadb::Entry& entry, std::string& scratch,
+                                 const StoredVersion& previous) {
     // prepare keys
     uint64_t entry_timestamp = ToEpochMicros(entry.created_at());
     uint64_t entry_id = static_cast<uint64_t>(entry.id());
@@ -160,22 +623,185 @@ bool StorageManager::StoreEntry(const registadb::Entry& entry) {
     std::string index_key = EncodeIndexKey(entry_id);
 
     // serialize data
-    std::string serialized_data;
-    entry.SerializeToString(&serialized_data);
+    EncodeStoredEntry(entry, config_.columnar_lists, &scratch);
 
-    // atomic write batch
-    rocksdb::WriteBatch batch;
-    batch.Put(index_handle_, index_key, primary_key);
-    batch.Put(data_handle_, primary_key, serialized_data);
+    // a new created_at moves the entry to another key, the old row would otherwise still show up in scans
+    if (!previous.primary_key.empty() && previous.primary_key != primary_key) {
+        batch.Delete(data_handle_, previous.primary_key);
+    }
+    if (!metadata_index_handles_.empty()) {
+        if (previous.has_entry) AppendMetadataIndexes(batch, previous.entry, previous.primary_key, true);
+        AppendMetadataIndexes(batch, entry, primary_key, false);
+    }
+
+    // index value is the primary key, plus the expiry when the entry has a TTL
+    std::string index_value = primary_key;
+    TtlPolicy::AppendExpiry(&index_value, ExpiresAt(entry));
+    batch.Put(index_handle_, index_key, index_value);
+    batch.Put(data_handle_, primary_key, scratch);
     // std::cout << "WRITING TO DISK -> ID: " << entry.id()
     //             << " | index_key: " << entry_id << " | timestamp: " << entry.timestamp()
     //           << " | Content: " << entry.blob().substr(0, 30) << "..." << std::endl;
-    rocksdb::Status s = db->Write(rocksdb::WriteOptions(), &batch);
-    return s.ok();
 }
 
 /**
- * @brief Retrieves an entry from RocksDB by its ID.
+ * @brief Appends puts (or deletes) for every maintained secondary index the entry has a metadata value for.
+ * 
+ * @param batch The batch to append to.
+ * @param entry The entry whose metadata is indexed.
+ * @param primary_key The entry's composite key in data_cf.
+ * @param remove true to delete the index keys, false to add them.
+ */
+void StorageManager::AppendMetadataIndexes(rocksdb::WriteBatch& batch, const registadb::Entry& entry,
+                                           const std::string& primary_key, bool remove) {
+    for (const auto& [key, handle] : metadata_index_handles_) {
+        auto it = entry.metadata().find(key);
+        if (it == entry.metadata().end()) continue;
+
+        std::string index_key = EncodeMetadataIndexKey(it->second, primary_key);
+        if (remove) {
+            batch.Delete(handle, index_key);
+        } else {
+            std::string index_value;
+            TtlPolicy::AppendExpiry(&index_value, ExpiresAt(entry));
+            batch.Put(handle, index_key, index_value);
+        }
+    }
+}
+
+/**
+ * @brief Builds a newly declared secondary index from the entries already in data_cf.
+ * 
+ * @param key The metadata key to index.
+ */
+void StorageManager::BuildMetadataIndex(const std::string& key) {
+    auto handle_it = metadata_index_handles_.find(key);
+    if (handle_it == metadata_index_handles_.end()) return;
+    rocksdb::ColumnFamilyHandle* handle = handle_it->second;
+
+    rocksdb::WriteBatch batch;
+    size_t indexed = 0;
+    registadb::Entry entry;
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(rocksdb::ReadOptions(), data_handle_));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (!DecodeStoredEntry(it->value().data(), it->value().size(), &entry)) continue;
+        auto meta = entry.metadata().find(key);
+        if (meta == entry.metadata().end()) continue;
+
+        std::string index_value;
+        TtlPolicy::AppendExpiry(&index_value, ExpiresAt(entry));
+        batch.Put(handle, EncodeMetadataIndexKey(meta->second, it->key().ToString()), index_value);
+        if (batch.Count() >= 1000) {
+            db->Write(rocksdb::WriteOptions(), &batch);
+            batch.Clear();
+        }
+        indexed++;
+    }
+    if (batch.Count() > 0) {
+        db->Write(rocksdb::WriteOptions(), &batch);
+    }
+    if (indexed > 0) {
+        std::cout << "[Storage] Built metadata index '" << key << "' over " << indexed << " existing entries" << std::endl;
+    }
+}
+
+/**
+ * @brief Appends the rollup merges for a group of entries to a WriteBatch, one per level and (source, bucket) touched. Entries of the group sharing a bucket are combined first, so a batch of readings from one source costs three merges rather than three per entry. Entries without a numeric value are skipped, entries without a source roll up under "". A retracted version is merged in negated (RollupBucket::Retract), which corrects count and sum; only a retracted value that reaches a bucket's min or max leaves it stale, until the next read recomputes and writes it back.
+ * 
+ * @param batch The batch to append to.
+ * @param locks Receives shared locks on the stripes of the buckets merged into, which the caller holds until the batch is written so no write-back (WriteBackRollupBucket) lands in between. nullptr takes none.
+ * @param added Pointers to the entries being stored.
+ * @param added_count Number of added entries.
+ * @param retracted Pointers to the versions being replaced or deleted.
+ * @param retracted_count Number of retracted versions.
+ */
+void StorageManager::AppendRollups(rocksdb::WriteBatch& batch, RollupLocks* locks, const registadb::Entry* const* added,
+                                   size_t added_count, const registadb::Entry* const* retracted, size_t retracted_count) {
+    static const std::string kNoSource;
+    std::map<std::string, RollupBucket> buckets;
+    auto append = [&](const registadb::Entry& entry, bool retract) {
+        RollupBucket bucket;
+        if (!bucket.acc.AddValue(entry.data())) return;
+        bucket.first_expiry = bucket.last_expiry = ExpiresAt(entry);
+        if (retract) bucket.Retract();
+
+        auto meta = entry.metadata().find("source");
+        const std::string& source = meta == entry.metadata().end() ? kNoSource : meta->second;
+        uint64_t created_us = ToEpochMicros(entry.created_at());
+        for (size_t level = 0; level < kRollupLevels; ++level) {
+            uint64_t start = created_us - created_us % kRollupResolutions[level];
+            buckets[EncodeRollupKey(level, source, start)].Merge(bucket);
+        }
+    };
+    for (size_t i = 0; i < retracted_count; ++i) append(*retracted[i], true);
+    for (size_t i = 0; i < added_count; ++i) append(*added[i], false);
+
+    std::string value;
+    std::vector<size_t> stripes;
+    for (const auto& [key, bucket] : buckets) {
+        EncodeRollupValue(bucket, &value);
+        batch.Merge(rollup_handle_, key, value);
+        stripes.push_back(RollupLockStripe(key));
+    }
+    if (!locks) return;
+    std::sort(stripes.begin(), stripes.end());
+    stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+    for (size_t stripe : stripes) locks->emplace_back(rollup_locks_[stripe]);
+}
+
+/**
+ * @brief Appends the rollup merges for a group of entries that replace the versions read by ReadStoredVersions.
+ * 
+ * @param batch The batch to append to.
+ * @param locks Receives the bucket locks to hold until the batch is written, see AppendRollups.
+ * @param entries Pointers to the entries being stored.
+ * @param count Number of entries.
+ * @param previous What each entry replaces, versions without a stored entry retract nothing.
+ */
+void StorageManager::AppendRollupsReplacing(rocksdb::WriteBatch& batch, RollupLocks* locks,
+                                            const registadb::Entry* const* entries, size_t count,
+                                            const std::vector<StoredVersion>& previous) {
+    std::vector<const registadb::Entry*> retracted;
+    for (const StoredVersion& version : previous) {
+        if (version.has_entry) retracted.push_back(&version.entry);
+    }
+    AppendRollups(batch, locks, entries, count, retracted.data(), retracted.size());
+}
+
+/**
+ * @brief Builds rollup_cf from the entries already in data_cf when rollups are turned on for a DB that holds data.
+ * 
+ */
+void StorageManager::BuildRollups() {
+    std::vector<registadb::Entry> group;
+    std::vector<const registadb::Entry*> refs;
+    size_t rolled_up = 0;
+    auto flush = [&]() {
+        refs.clear();
+        for (const auto& entry : group) refs.push_back(&entry);
+        rocksdb::WriteBatch batch;
+        // runs on open, before anything can read a rollup
+        AppendRollups(batch, nullptr, refs.data(), refs.size());
+        db->Write(rocksdb::WriteOptions(), &batch);
+        rolled_up += group.size();
+        group.clear();
+    };
+
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(rocksdb::ReadOptions(), data_handle_));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        registadb::Entry entry;
+        if (!DecodeStoredEntry(it->value().data(), it->value().size(), &entry) || IsExpired(entry)) continue;
+        group.push_back(std::move(entry));
+        if (group.size() >= 1000) flush();
+    }
+    if (!group.empty()) flush();
+    if (rolled_up > 0) {
+        std::cout << "[Storage] Built rollups over " << rolled_up << " existing entries" << std::endl;
+    }
+}
+
+/**
+ * @brief Retrieves an entry from RocksDB by its ID. With the entry cache enabled a hit skips both RocksDB lookups, and a miss fills the cache with what was read.
  * 
  * @param id The ID of the entry to retrieve.
  * @param out_entry The output entry to populate with the retrieved data.
@@ -184,44 +810,862 @@ bool StorageManager::StoreEntry(const registadb::Entry& entry) {
  */
 bool StorageManager::GetEntryById(int64_t id, registadb::Entry* out_entry) {
     uint64_t entry_id = static_cast<uint64_t>(id);
+    std::string serialized_data;
+    if (entry_cache_ && entry_cache_->Get(entry_id, &serialized_data)) {
+        return DecodeStoredEntry(serialized_data, out_entry) && !IsExpired(*out_entry);
+    }
+
     std::string index_key = EncodeIndexKey(entry_id);
     std::string primary_key;
 
     // look up pointer in the index
     rocksdb::Status s = db->Get(rocksdb::ReadOptions(), index_handle_, index_key, &primary_key);
-    if (!s.ok()) return false;
+
+    // expired entries read as missing until compaction drops them
+    if (s.ok() && TtlPolicy::ReadExpiry(primary_key.data(), primary_key.size(), 16) <= TtlPolicy::NowMicros()) {
+        s = rocksdb::Status::NotFound();
+    }
 
     // look up the actual data using pointer
-    std::string serialized_data;
-    s = db->Get(rocksdb::ReadOptions(), data_handle_, primary_key, &serialized_data);
-    
     if (s.ok()) {
-        return out_entry->ParseFromString(serialized_data);
+        primary_key.resize(16);
+        s = db->Get(rocksdb::ReadOptions(), data_handle_, primary_key, &serialized_data);
+    }
+    if (entry_cache_) entry_cache_->Fill(entry_id, s.ok() ? &serialized_data : nullptr);
+
+    if (s.ok()) {
+        return DecodeStoredEntry(serialized_data, out_entry);
     }
     return false;
 }
 
+/**
+ * @brief Retrieves many entries by ID in two batched phases: one MultiGet for every index key, then one MultiGet for every primary key found. RocksDB can then coalesce block reads across keys instead of paying two sequential lookups per id.
+ * 
+ * @param ids The IDs to retrieve.
+ * @param out_entries Output vector resized to ids.size(), entry i holds the result for ids[i].
+ * @param out_found Output vector resized to ids.size(), true where the entry was found.
+ */
+void StorageManager::GetEntriesByIds(const std::vector<uint64_t>& ids, std::vector<registadb::Entry>* out_entries,
+                                     std::vector<bool>* out_found) {
+    const size_t n = ids.size();
+    out_entries->clear();
+    out_entries->resize(n);
+    out_found->assign(n, false);
+    if (n == 0) return;
+
+    // phase 1: every index key
+    std::vector<std::string> index_keys(n);
+    std::vector<rocksdb::Slice> index_slices(n);
+    for (size_t i = 0; i < n; ++i) {
+        index_keys[i] = EncodeIndexKey(ids[i]);
+        index_slices[i] = index_keys[i];
+    }
+    std::vector<rocksdb::PinnableSlice> primary_keys(n);
+    std::vector<rocksdb::Status> statuses(n);
+    db->MultiGet(rocksdb::ReadOptions(), index_handle_, n, index_slices.data(),
+                 primary_keys.data(), statuses.data());
+
+    // phase 2: every primary key that was found
+    std::vector<size_t> positions;
+    std::vector<rocksdb::Slice> data_slices;
+    positions.reserve(n);
+    data_slices.reserve(n);
+    const uint64_t now = TtlPolicy::NowMicros();
+    for (size_t i = 0; i < n; ++i) {
+        if (statuses[i].ok() && primary_keys[i].size() >= 16
+            && TtlPolicy::ReadExpiry(primary_keys[i].data(), primary_keys[i].size(), 16) > now) {
+            positions.push_back(i);
+            data_slices.emplace_back(primary_keys[i].data(), 16);
+        }
+    }
+    if (positions.empty()) return;
+
+    const size_t m = positions.size();
+    std::vector<rocksdb::PinnableSlice> values(m);
+    std::vector<rocksdb::Status> data_statuses(m);
+    db->MultiGet(rocksdb::ReadOptions(), data_handle_, m, data_slices.data(),
+                 values.data(), data_statuses.data());
+
+    for (size_t j = 0; j < m; ++j) {
+        size_t i = positions[j];
+        if (data_statuses[j].ok()) {
+            (*out_found)[i] = DecodeStoredEntry(values[j].data(), values[j].size(), &(*out_entries)[i]);
+        }
+    }
+}
+
+/**
+ * @brief Updates an entry as one read-modify-write. The id's stripe lock is held from the read to the commit, so concurrent updates, overwrites and deletes of the same id are applied one after another instead of losing writes. The old version comes from the entry cache when it is warm, and the new one is written in a single WriteBatch together with its metadata index changes.
+ * 
+ * @param patch The update; patch.id() selects the entry and patch.updated_at() becomes its updated_at.
+ * @param mode How the patch is applied, see StorageBackend::ApplyUpdate.
+ * @param out_entry The entry as stored after the update.
+ * @param durability When to return, see registadb::Durability.
+ * @return registadb::OperationStatus STATUS_OK, STATUS_NOT_FOUND (missing or expired) or STATUS_INTERNAL_ERROR (write or WAL sync failed).
+ */
+registadb::OperationStatus StorageManager::UpdateEntry(const registadb::Entry& patch, registadb::UpdateMode mode,
+                                                       registadb::Entry* out_entry, registadb::Durability durability) {
+    uint64_t entry_id = patch.id();
+    {
+        std::lock_guard<std::mutex> id_lock(id_locks_[IdLockStripe(entry_id)]);
+
+        StoredVersion previous;
+        if (!GetEntryById(static_cast<int64_t>(entry_id), &previous.entry)) {
+            return registadb::STATUS_NOT_FOUND;
+        }
+        previous.has_entry = true;
+        previous.primary_key = EncodeCompositeKey(ToEpochMicros(previous.entry.created_at()), entry_id);
+
+        *out_entry = previous.entry;
+        ApplyUpdate(patch, mode, out_entry);
+
+        // created_at is kept, so the new version lands on the same data_cf key
+        std::string serialized_data;
+        rocksdb::WriteBatch batch;
+        RollupLocks rollup_locks;
+        AppendEntry(batch, *out_entry, serialized_data, previous);
+        if (rollup_handle_) {
+            const registadb::Entry* added = out_entry;
+            const registadb::Entry* retracted = &previous.entry;
+            AppendRollups(batch, &rollup_locks, &added, 1, &retracted, 1);
+        }
+        rocksdb::Status s = db->Write(WriteOptionsFor(durability), &batch);
+        if (entry_cache_) entry_cache_->Invalidate(entry_id);
+        if (!s.ok()) {
+            std::cerr << "[Storage] Update of " << entry_id << " failed: " << s.ToString() << std::endl;
+            return registadb::STATUS_INTERNAL_ERROR;
+        }
+    }
+    return AwaitDurable(durability) ? registadb::STATUS_OK : registadb::STATUS_INTERNAL_ERROR;
+}
+
 /**
  * @brief Deletes (tombstones) an entry from RocksDB by looking up the ID in the index column family to find the primary key, then deleting both the index and data entries atomically using a WriteBatch.
  * 
  * @param id The ID of the entry to delete.
+ * @param durability When to return, see registadb::Durability.
  * @return true: The entry was successfully deleted.
  * @return false: There was an error deleting the entry.
  */
-bool StorageManager::DeleteEntryById(int64_t id) {
+bool StorageManager::DeleteEntryById(int64_t id, registadb::Durability durability) {
     uint64_t entry_id = static_cast<uint64_t>(id);
-    std::string index_key = EncodeIndexKey(entry_id);
-    std::string primary_key;
+    {
+        std::lock_guard<std::mutex> id_lock(id_locks_[IdLockStripe(entry_id)]);
+        std::string index_key = EncodeIndexKey(entry_id);
+        std::string primary_key;
 
-    rocksdb::Status s = db->Get(rocksdb::ReadOptions(), index_handle_, index_key, &primary_key);
+        rocksdb::Status s = db->Get(rocksdb::ReadOptions(), index_handle_, index_key, &primary_key);
+        if (!s.ok()) return false;
 
-    if (s.ok()) {
+        primary_key.resize(16); // drop the expiry suffix
         rocksdb::WriteBatch batch;
+        RollupLocks rollup_locks;
+        if (!metadata_index_handles_.empty() || config_.change_log || rollup_handle_) {
+            std::string old_data;
+            registadb::Entry old_entry;
+            if (db->Get(rocksdb::ReadOptions(), data_handle_, primary_key, &old_data).ok()
+                && DecodeStoredEntry(old_data, &old_entry)) {
+                AppendMetadataIndexes(batch, old_entry, primary_key, true);
+                if (rollup_handle_) {
+                    const registadb::Entry* retracted = &old_entry;
+                    AppendRollups(batch, &rollup_locks, nullptr, 0, &retracted, 1);
+                }
+                auto source = old_entry.metadata().find("source");
+                if (config_.change_log && source != old_entry.metadata().end()) {
+                    batch.PutLogData(kChangeSourceTag + source->second);
+                }
+            }
+        }
         batch.Delete(index_handle_, index_key);
         batch.Delete(data_handle_, primary_key);
 
-        rocksdb::Status s = db->Write(rocksdb::WriteOptions(), &batch);
-        return s.ok();
+        s = db->Write(WriteOptionsFor(durability), &batch);
+        if (entry_cache_) entry_cache_->Invalidate(entry_id);
+        if (!s.ok()) return false;
     }
-    return false;
-}
\ No newline at end of file
+    return AwaitDurable(durability);
+}
+
+/**
+ * @brief Reads one page of entries whose creation time falls in [from_ts, to_ts], newest first. The range maps onto a contiguous run of reversed-timestamp composite keys, so the iterator is bounded on both sides and never touches keys outside the range.
+ * 
+ * @param from_ts Oldest creation time to include, in microseconds since epoch.
+ * @param to_ts Newest creation time to include, in microseconds since epoch.
+ * @param limit Maximum number of entries to return.
+ * @param cursor Composite key to resume from (next_cursor of the previous page), empty to start at to_ts.
+ * @param out_entries Output vector the page of entries is appended to.
+ * @param next_cursor Set to the composite key of the next entry, or cleared when the range is exhausted.
+ * @return true if the scan succeeded.
+ * @return false if the cursor is malformed or the iterator failed.
+ */
+bool StorageManager::ScanRange(uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                               std::vector<registadb::Entry>* out_entries, std::string* next_cursor) {
+    next_cursor->clear();
+    if (!cursor.empty() && cursor.size() != 16) return false;
+    if (from_ts > to_ts || limit == 0) return true;
+
+    // newest first: to_ts maps to the smallest key, from_ts to the largest
+    std::string lower_key = EncodeCompositeKey(to_ts, 0);
+    std::string upper_key;
+    rocksdb::Slice lower_bound(lower_key);
+    rocksdb::Slice upper_bound;
+
+    rocksdb::ReadOptions read_options;
+    read_options.iterate_lower_bound = &lower_bound;
+    if (from_ts > 0) {
+        // exclusive bound: first key of the timestamp just before from_ts
+        upper_key = EncodeCompositeKey(from_ts - 1, 0);
+        upper_bound = rocksdb::Slice(upper_key);
+        read_options.iterate_upper_bound = &upper_bound;
+    }
+
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(read_options, data_handle_));
+    it->Seek(cursor > lower_key ? cursor : lower_key);
+
+    size_t count = 0;
+    for (; it->Valid(); it->Next()) {
+        if (count == limit) {
+            *next_cursor = it->key().ToString();
+            break;
+        }
+        out_entries->emplace_back();
+        if (DecodeStoredEntry(it->value().data(), it->value().size(), &out_entries->back())
+            && !IsExpired(out_entries->back())) {
+            count++;
+        } else {
+            out_entries->pop_back();
+        }
+    }
+    return it->status().ok();
+}
+
+/**
+ * @brief Aggregates the numeric values of every entry created in [from_ts, to_ts]. With rollups on and no filter (or a filter on a non-empty source), the part of the range covered by whole rollup buckets is read from rollup_cf, so a long range costs one read per bucket; the unaligned edges and every other query read the entries themselves (AggregateEntries).
+ * Both paths give the same result: overwrites, updates and deletes retract the old version from its buckets, and a bucket that had a value retracted or holds an expired entry is recomputed from the entries.
+ * 
+ * @param from_ts Oldest creation time to include, in microseconds since epoch.
+ * @param to_ts Newest creation time to include, in microseconds since epoch.
+ * @param key Metadata key to filter on, empty for every entry.
+ * @param value Metadata value the key has to match.
+ * @param out Aggregator the matching entries are added to.
+ * @return true if the whole range was read.
+ * @return false if an iterator failed or out ran out of buckets.
+ */
+bool StorageManager::Aggregate(uint64_t from_ts, uint64_t to_ts, const std::string& key, const std::string& value,
+                               SeriesAggregator* out) {
+    if (from_ts > to_ts) return true;
+    // entries without a source roll up under "" too, so a filter on an empty source cannot use the rollups
+    if (!rollup_handle_ || (!key.empty() && (key != "source" || value.empty()))) {
+        return AggregateEntries(from_ts, to_ts, key, value, out);
+    }
+    // half-open from here on, the very last microsecond is left to the entries
+    if (to_ts == UINT64_MAX) {
+        return AggregateSpan(from_ts, UINT64_MAX, 0, key, value, out) &&
+               AggregateEntries(UINT64_MAX, UINT64_MAX, key, value, out);
+    }
+    return AggregateSpan(from_ts, to_ts + 1, 0, key, value, out);
+}
+
+/**
+ * @brief Earliest bucket start a rollup level is sure to still hold. The retention filter drops a bucket once its end is older than the retention, so the horizon keeps one coarsest bucket of slack for compactions running while a query reads.
+ * 
+ * @param level Rollup level.
+ * @return uint64_t Bucket start in microseconds, 0 when the level is kept as long as its entries.
+ */
+uint64_t StorageManager::RollupHorizon(size_t level) const {
+    const uint64_t retention = rollup_retention_us_[level];
+    if (retention == 0) return 0;
+    const uint64_t now = TtlPolicy::NowMicros();
+    return now > retention ? now - retention + kRollupResolutions[0] : 0;
+}
+
+/**
+ * @brief Aggregates [begin, end) using the rollups of level and finer: the whole buckets of level in the span are read from rollup_cf, the edges on either side go down a level, and below the finest level the entries are read. A level whose resolution does not divide the output bucket width is skipped, since its buckets would straddle two output buckets, and so is the part of the span before the level's retention horizon.
+ * 
+ * @param begin First microsecond of the span.
+ * @param end One past the last microsecond of the span.
+ * @param level Coarsest rollup level to use, kRollupLevels for none.
+ * @param key Empty, or "source" to filter on value.
+ * @param value Source to match when key is set.
+ * @param out Aggregator the span is added to.
+ * @return true if the whole span was read.
+ * @return false if an iterator failed or out ran out of buckets.
+ */
+bool StorageManager::AggregateSpan(uint64_t begin, uint64_t end, size_t level, const std::string& key,
+                                   const std::string& value, SeriesAggregator* out) {
+    if (begin >= end) return true;
+    if (level == kRollupLevels) return AggregateEntries(begin, end - 1, key, value, out);
+
+    const uint64_t horizon = RollupHorizon(level);
+    if (begin < horizon) {
+        if (end <= horizon) return AggregateSpan(begin, end, level + 1, key, value, out);
+        return AggregateSpan(begin, horizon, level + 1, key, value, out) &&
+               AggregateSpan(horizon, end, level, key, value, out);
+    }
+
+    const uint64_t resolution = kRollupResolutions[level];
+    if (out->BucketWidth() % resolution != 0 || begin > UINT64_MAX - resolution) {
+        return AggregateSpan(begin, end, level + 1, key, value, out);
+    }
+    uint64_t first = (begin + resolution - 1) / resolution * resolution;
+    uint64_t last = end - end % resolution;
+    if (first >= last) return AggregateSpan(begin, end, level + 1, key, value, out);
+
+    return AggregateSpan(begin, first, level + 1, key, value, out) &&
+           AggregateRollups(level, first, last, key, value, out) &&
+           AggregateSpan(last, end, level + 1, key, value, out);
+}
+
+/**
+ * @brief Adds the rollup buckets of one level starting in [begin, end) to out. With a source filter this is one bounded seek; without one every source of the level is visited, seeking past the buckets outside the span. A bucket that is not servable (RollupBucket::Servable) is recomputed from its source's entries instead and written back (WriteBackRollupBucket), so only the first read after a retraction or expiry pays for it.
+ * 
+ * @param level Rollup level to read.
+ * @param begin First bucket start to include, aligned to the level's resolution.
+ * @param end Bucket start to stop at, aligned to the level's resolution.
+ * @param key Empty, or "source" to read only the rollups of value.
+ * @param value Source to read when key is set.
+ * @param out Aggregator the buckets are added to.
+ * @return true if the buckets were read.
+ * @return false if an iterator failed or out ran out of buckets.
+ */
+bool StorageManager::AggregateRollups(size_t level, uint64_t begin, uint64_t end, const std::string& key,
+                                      const std::string& value, SeriesAggregator* out) {
+    std::string upper_key = key.empty() ? std::string(1, static_cast<char>(level + 1)) : EncodeRollupKey(level, value, end);
+    rocksdb::Slice upper_bound(upper_key);
+    // rollups and entries are read at one snapshot, so a recomputed bucket matches the value it replaces
+    const rocksdb::Snapshot* snapshot = db->GetSnapshot();
+    rocksdb::ReadOptions read_options;
+    read_options.iterate_upper_bound = &upper_bound;
+    read_options.snapshot = snapshot;
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(read_options, rollup_handle_));
+
+    const uint64_t now = TtlPolicy::NowMicros();
+    RollupBucket bucket;
+    rocksdb::Slice source;
+    uint64_t start = 0;
+    bool ok = true;
+    // adds the bucket under the iterator, recomputing it first when it cannot be served as stored
+    auto add_bucket = [&]() {
+        if (!DecodeRollupValue(it->value(), &bucket)) return true;
+        if (!bucket.Servable(now)) {
+            if (!RecomputeRollupBucket(level, source.ToString(), start, snapshot, &bucket)) return false;
+            WriteBackRollupBucket(it->key(), it->value(), bucket);
+        }
+        return bucket.acc.entries == 0 || out->AddAccumulated(start, bucket.acc);
+    };
+    if (!key.empty()) {
+        for (it->Seek(EncodeRollupKey(level, value, begin)); ok && it->Valid(); it->Next()) {
+            if (!DecodeRollupKey(it->key(), &source, &start)) continue;
+            ok = add_bucket();
+        }
+    } else {
+        it->Seek(std::string(1, static_cast<char>(level)));
+        while (ok && it->Valid()) {
+            if (!DecodeRollupKey(it->key(), &source, &start)) {
+                it->Next();
+            } else if (start < begin) {
+                it->Seek(EncodeRollupKey(level, source.ToString(), begin));
+            } else if (start >= end) {
+                it->Seek(RollupSourceEnd(level, source.ToString()));
+            } else {
+                ok = add_bucket();
+                it->Next();
+            }
+        }
+    }
+    ok = ok && it->status().ok();
+    it.reset();
+    db->ReleaseSnapshot(snapshot);
+    return ok;
+}
+
+/**
+ * @brief Recomputes one rollup bucket from data_cf: the accumulator of the live entries of source created in the bucket's span, and their earliest and latest expiry. Expired entries are left out, as they are on every read.
+ * 
+ * @param level Rollup level of the bucket.
+ * @param source The bucket's source, "" for entries without one.
+ * @param start Bucket start in microseconds.
+ * @param snapshot Snapshot the bucket value was read at.
+ * @param out Output for the exact bucket.
+ * @return true if the span was read.
+ * @return false if the iterator failed.
+ */
+bool StorageManager::RecomputeRollupBucket(size_t level, const std::string& source, uint64_t start,
+                                           const rocksdb::Snapshot* snapshot, RollupBucket* out) {
+    *out = RollupBucket();
+    std::string lower_key = EncodeCompositeKey(start + kRollupResolutions[level] - 1, 0);
+    std::string upper_key;
+    rocksdb::Slice lower_bound(lower_key);
+    rocksdb::Slice upper_bound;
+
+    rocksdb::ReadOptions read_options;
+    read_options.iterate_lower_bound = &lower_bound;
+    read_options.snapshot = snapshot;
+    read_options.fill_cache = false;
+    if (start > 0) {
+        upper_key = EncodeCompositeKey(start - 1, 0);
+        upper_bound = rocksdb::Slice(upper_key);
+        read_options.iterate_upper_bound = &upper_bound;
+    }
+
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(read_options, data_handle_));
+    registadb::Entry entry;
+    RollupBucket one;
+    for (it->Seek(lower_key); it->Valid(); it->Next()) {
+        if (!DecodeStoredEntry(it->value().data(), it->value().size(), &entry) || IsExpired(entry)) continue;
+        auto meta = entry.metadata().find("source");
+        if ((meta == entry.metadata().end() ? std::string() : meta->second) != source) continue;
+        one = RollupBucket();
+        if (!one.acc.AddValue(entry.data())) continue;
+        one.first_expiry = one.last_expiry = ExpiresAt(entry);
+        out->Merge(one);
+    }
+    return it->status().ok();
+}
+
+/**
+ * @brief Stores a recomputed bucket in place of the value it was computed from. The bucket's lock stripe is held exclusively from the check to the write, so no write can merge into it in between. The read never waits for it: while a writer holds the stripe, or once a write has merged into the bucket since the snapshot, the bucket is left for the next read to recompute. A bucket with no live entries is deleted.
+ * 
+ * @param key The rollup key.
+ * @param read_value The bucket value the recompute started from.
+ * @param bucket The recomputed bucket.
+ */
+void StorageManager::WriteBackRollupBucket(const rocksdb::Slice& key, const rocksdb::Slice& read_value,
+                                           const RollupBucket& bucket) {
+    std::unique_lock<std::shared_mutex> lock(rollup_locks_[RollupLockStripe(std::string_view(key.data(), key.size()))],
+                                             std::try_to_lock);
+    if (!lock.owns_lock()) return;
+    std::string current;
+    if (!db->Get(rocksdb::ReadOptions(), rollup_handle_, key, &current).ok() || read_value != current) return;
+    rocksdb::Status s;
+    if (bucket.acc.entries == 0) {
+        s = db->Delete(rocksdb::WriteOptions(), rollup_handle_, key);
+    } else {
+        std::string value;
+        EncodeRollupValue(bucket, &value);
+        s = db->Put(rocksdb::WriteOptions(), rollup_handle_, key, value);
+    }
+    if (!s.ok()) std::cerr << "[Storage] Unable to write back a recomputed rollup: " << s.ToString() << std::endl;
+}
+
+/**
+ * @brief Aggregates the numeric values of every entry created in [from_ts, to_ts] in a single bounded pass over data_cf. One Entry is reused for every record, so the pass allocates nothing per entry once it has warmed up, and the bucket comes from the key without touching created_at. A filter on an indexed key reads only the matching entries through the index (StorageBackend::Aggregate).
+ * 
+ * @param from_ts Oldest creation time to include, in microseconds since epoch.
+ * @param to_ts Newest creation time to include, in microseconds since epoch.
+ * @param key Metadata key to filter on, empty for every entry.
+ * @param value Metadata value the key has to match.
+ * @param out Aggregator the matching entries are added to.
+ * @return true if the whole range was read.
+ * @return false if the iterator failed or out ran out of buckets.
+ */
+bool StorageManager::AggregateEntries(uint64_t from_ts, uint64_t to_ts, const std::string& key,
+                                      const std::string& value, SeriesAggregator* out) {
+    if (!key.empty() && IsMetadataIndexed(key)) {
+        return StorageBackend::Aggregate(from_ts, to_ts, key, value, out);
+    }
+    if (from_ts > to_ts) return true;
+
+    std::string lower_key = EncodeCompositeKey(to_ts, 0);
+    std::string upper_key;
+    rocksdb::Slice lower_bound(lower_key);
+    rocksdb::Slice upper_bound;
+
+    rocksdb::ReadOptions read_options;
+    read_options.iterate_lower_bound = &lower_bound;
+    // a long range read should not push the hot working set out of the block cache
+    read_options.fill_cache = false;
+    read_options.adaptive_readahead = true;
+    if (from_ts > 0) {
+        upper_key = EncodeCompositeKey(from_ts - 1, 0);
+        upper_bound = rocksdb::Slice(upper_key);
+        read_options.iterate_upper_bound = &upper_bound;
+    }
+
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(read_options, data_handle_));
+    registadb::Entry entry;
+    for (it->Seek(lower_key); it->Valid(); it->Next()) {
+        if (!DecodeStoredEntry(it->value().data(), it->value().size(), &entry) || IsExpired(entry)) {
+            continue;
+        }
+        if (!key.empty()) {
+            auto meta = entry.metadata().find(key);
+            if (meta == entry.metadata().end() || meta->second != value) continue;
+        }
+        if (!out->Add(DecodeCompositeKey(it->key().data()).first, entry.data())) return false;
+    }
+    return it->status().ok();
+}
+
+/**
+ * @brief Reads one page of entries whose metadata[key] equals value and whose creation time falls in [from_ts, to_ts], newest first, using the key's secondary index. Matching primary keys are collected from a bounded index iterator and resolved with one MultiGet.
+ * 
+ * @param key The indexed metadata key.
+ * @param value The metadata value to match.
+ * @param from_ts Oldest creation time to include, in microseconds since epoch.
+ * @param to_ts Newest creation time to include, in microseconds since epoch.
+ * @param limit Maximum number of entries to return.
+ * @param cursor Composite key to resume from (next_cursor of the previous page), empty to start at to_ts.
+ * @param out_entries Output vector the page of entries is appended to.
+ * @param next_cursor Set to the composite key of the next match, or cleared when there are no more.
+ * @return true if the query succeeded.
+ * @return false if the key is not indexed, the cursor is malformed or the iterator failed.
+ */
+bool StorageManager::QueryByMetadata(const std::string& key, const std::string& value,
+                                     uint64_t from_ts, uint64_t to_ts, size_t limit, const std::string& cursor,
+                                     std::vector<registadb::Entry>* out_entries, std::string* next_cursor) {
+    next_cursor->clear();
+    auto handle_it = metadata_index_handles_.find(key);
+    if (handle_it == metadata_index_handles_.end()) return false;
+    if (!cursor.empty() && cursor.size() != 16) return false;
+    if (from_ts > to_ts || limit == 0) return true;
+
+    const std::string prefix = value + std::string(1, '\0');
+    std::string lower_key = prefix + EncodeCompositeKey(to_ts, 0);
+    // exclusive bound: just before from_ts, or the end of this value's prefix
+    std::string upper_key = from_ts > 0 ? prefix + EncodeCompositeKey(from_ts - 1, 0)
+                                        : value + std::string(1, '\1');
+    rocksdb::Slice lower_bound(lower_key);
+    rocksdb::Slice upper_bound(upper_key);
+
+    rocksdb::ReadOptions read_options;
+    read_options.iterate_lower_bound = &lower_bound;
+    read_options.iterate_upper_bound = &upper_bound;
+
+    std::string seek_key = cursor.empty() ? lower_key : std::max(lower_key, prefix + cursor);
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(read_options, handle_it->second));
+
+    std::vector<std::string> primary_keys;
+    const uint64_t now = TtlPolicy::NowMicros();
+    for (it->Seek(seek_key); it->Valid(); it->Next()) {
+        rocksdb::Slice index_key = it->key();
+        // skip longer values that only share this prefix up to an embedded zero byte
+        if (index_key.size() != prefix.size() + 16) continue;
+        if (TtlPolicy::ReadExpiry(it->value().data(), it->value().size(), 0) <= now) continue;
+
+        std::string primary_key(index_key.data() + prefix.size(), 16);
+        if (primary_keys.size() == limit) {
+            *next_cursor = primary_key;
+            break;
+        }
+        primary_keys.push_back(std::move(primary_key));
+    }
+    if (!it->status().ok()) return false;
+    if (primary_keys.empty()) return true;
+
+    const size_t n = primary_keys.size();
+    std::vector<rocksdb::Slice> slices(primary_keys.begin(), primary_keys.end());
+    std::vector<rocksdb::PinnableSlice> values(n);
+    std::vector<rocksdb::Status> statuses(n);
+    db->MultiGet(rocksdb::ReadOptions(), data_handle_, n, slices.data(), values.data(), statuses.data());
+
+    for (size_t i = 0; i < n; ++i) {
+        if (!statuses[i].ok()) continue;
+        out_entries->emplace_back();
+        registadb::Entry& entry = out_entries->back();
+        if (!DecodeStoredEntry(values[i].data(), values[i].size(), &entry)) {
+            out_entries->pop_back();
+            continue;
+        }
+        // re-check the value, a duplicate id inside one write batch can leave a stale index key behind
+        auto meta = entry.metadata().find(key);
+        if (meta == entry.metadata().end() || meta->second != value) {
+            out_entries->pop_back();
+        }
+    }
+    return true;
+}
+
+namespace {
+
+// Turns the records of one WAL write batch into change events. Every put, delete and merge consumes one sequence
+// number in batch order; log records consume none. An overwrite that moves an entry deletes its old data_cf row in the
+// same batch that puts the new one, so a delete of an id the batch also puts is dropped in Finish
+class ChangeCollector : public rocksdb::WriteBatch::Handler {
+public:
+    ChangeCollector(StorageBackend& storage, uint32_t data_cf, uint64_t since_sequence,
+                    std::vector<registadb::ChangeEvent>* out_events)
+        : storage_(storage), data_cf_(data_cf), since_(since_sequence), out_(out_events) {}
+
+    void Begin(uint64_t batch_sequence) {
+        sequence_ = batch_sequence;
+        source_.clear();
+        batch_start_ = out_->size();
+        put_ids_.clear();
+    }
+    void Finish() {
+        if (put_ids_.empty()) return;
+        out_->erase(std::remove_if(out_->begin() + batch_start_, out_->end(),
+                                   [this](const registadb::ChangeEvent& event) {
+                                       return event.type() == registadb::CHANGE_DELETE && put_ids_.count(event.id()) > 0;
+                                   }),
+                    out_->end());
+    }
+    uint64_t NextSequence() const {
+        return sequence_;
+    }
+
+    rocksdb::Status PutCF(uint32_t cf, const rocksdb::Slice& key, const rocksdb::Slice& value) override {
+        uint64_t sequence = sequence_++;
+        if (cf != data_cf_ || key.size() < 16) return rocksdb::Status::OK();
+        // recorded even before since_, the batch's delete of the old row may be the part that was not seen yet
+        put_ids_.insert(storage_.DecodeCompositeKey(key.data()).second);
+        if (sequence < since_) return rocksdb::Status::OK();
+
+        registadb::ChangeEvent event;
+        if (!DecodeStoredEntry(value.data(), value.size(), event.mutable_entry())) {
+            return rocksdb::Status::OK();
+        }
+        event.set_sequence(sequence);
+        event.set_type(registadb::CHANGE_PUT);
+        event.set_id(event.entry().id());
+        auto source = event.entry().metadata().find("source");
+        if (source != event.entry().metadata().end()) event.set_source(source->second);
+        out_->push_back(std::move(event));
+        return rocksdb::Status::OK();
+    }
+
+    rocksdb::Status DeleteCF(uint32_t cf, const rocksdb::Slice& key) override {
+        uint64_t sequence = sequence_++;
+        if (cf != data_cf_ || sequence < since_ || key.size() < 16) return rocksdb::Status::OK();
+
+        registadb::ChangeEvent event;
+        event.set_sequence(sequence);
+        event.set_type(registadb::CHANGE_DELETE);
+        event.set_id(storage_.DecodeCompositeKey(key.data()).second);
+        event.set_source(source_);
+        out_->push_back(std::move(event));
+        return rocksdb::Status::OK();
+    }
+
+    rocksdb::Status SingleDeleteCF(uint32_t, const rocksdb::Slice&) override {
+        ++sequence_;
+        return rocksdb::Status::OK();
+    }
+    rocksdb::Status MergeCF(uint32_t, const rocksdb::Slice&, const rocksdb::Slice&) override {
+        ++sequence_;
+        return rocksdb::Status::OK();
+    }
+
+    // DeleteEntryById logs the entry's source in front of its deletes
+    void LogData(const rocksdb::Slice& blob) override {
+        const std::string tag = StorageManager::kChangeSourceTag;
+        if (blob.size() >= tag.size() && std::memcmp(blob.data(), tag.data(), tag.size()) == 0) {
+            source_.assign(blob.data() + tag.size(), blob.size() - tag.size());
+        }
+    }
+
+private:
+    StorageBackend& storage_;
+    uint32_t data_cf_;
+    uint64_t since_;
+    std::vector<registadb::ChangeEvent>* out_;
+    uint64_t sequence_ = 0;
+    std::string source_;
+    size_t batch_start_ = 0;
+    std::unordered_set<uint64_t> put_ids_;
+};
+
+} // namespace
+
+/**
+ * @brief Reads committed entry puts and deletes back from the WAL, starting at since_sequence. Whole write batches are decoded until at least limit events were collected, so a group commit is never split across two reads; a read that starts inside a batch skips the records before since_sequence.
+ * Only writes that went through the WAL are in the log: bulk-loaded entries and TTL expiry produce no events.
+ * 
+ * @param shard Ignored, a single store is one shard.
+ * @param since_sequence First sequence number to return, 0 for the oldest one still retained.
+ * @param limit Minimum number of events to stop after.
+ * @param out_events Output vector the events are appended to, in sequence order.
+ * @param next_sequence Set to the sequence to resume from.
+ * @param truncated Set when the oldest retained write is newer than since_sequence, so events may be missing.
+ * @return true if the log was read (possibly with no new events).
+ * @return false if the change log is disabled or the WAL could not be read.
+ */
+bool StorageManager::GetChangesSince(uint32_t shard, uint64_t since_sequence, size_t limit,
+                                     std::vector<registadb::ChangeEvent>* out_events, uint64_t* next_sequence,
+                                     bool* truncated) {
+    *truncated = false;
+    *next_sequence = std::max<uint64_t>(since_sequence, 1);
+    if (!config_.change_log) return false;
+    if (db->GetLatestSequenceNumber() < *next_sequence) return true; // nothing new
+
+    std::unique_ptr<rocksdb::TransactionLogIterator> log;
+    rocksdb::Status s = db->GetUpdatesSince(*next_sequence, &log);
+    if (!s.ok()) {
+        std::cerr << "[Storage] Change log read from " << *next_sequence << " failed: " << s.ToString() << std::endl;
+        return false;
+    }
+
+    ChangeCollector collector(*this, data_handle_->GetID(), *next_sequence, out_events);
+    bool first = true;
+    for (; log->Valid() && out_events->size() < limit; log->Next()) {
+        rocksdb::BatchResult batch = log->GetBatch();
+        // a first batch past the requested sequence means that part of the WAL was purged (or was a bulk load, which has no WAL record)
+        if (first && batch.sequence > *next_sequence) *truncated = true;
+        first = false;
+
+        collector.Begin(batch.sequence);
+        s = batch.writeBatchPtr->Iterate(&collector);
+        if (!s.ok()) break;
+        collector.Finish();
+        *next_sequence = collector.NextSequence();
+    }
+    if (!s.ok() || !log->status().ok()) {
+        // keep what was read, the caller resumes from next_sequence
+        std::cerr << "[Storage] Change log read stopped at " << *next_sequence << ": "
+                  << (s.ok() ? log->status() : s).ToString() << std::endl;
+    }
+    return true;
+}
+
+/**
+ * @brief Computes an entry's expiry under the configured TTL policy.
+ * 
+ * @param entry The entry.
+ * @return uint64_t Expiry in microseconds since epoch, TtlPolicy::kNever when TTLs are disabled or the entry does not expire.
+ */
+uint64_t StorageManager::ExpiresAt(const registadb::Entry& entry) const {
+    return ttl_policy_ ? ttl_policy_->ExpiresAtMicros(entry) : TtlPolicy::kNever;
+}
+
+/**
+ * @brief Checks whether an entry's TTL has passed. Expired entries are hidden from reads until compaction removes them.
+ * 
+ * @param entry The entry.
+ * @return true if the entry has expired.
+ * @return false otherwise.
+ */
+bool StorageManager::IsExpired(const registadb::Entry& entry) const {
+    return ttl_policy_ && ttl_policy_->ExpiresAtMicros(entry) <= TtlPolicy::NowMicros();
+}
+
+/**
+ * @brief Collects the counts of records dropped by the TTL compaction filters.
+ * 
+ * @return ExpiryStats The counts, all zero when TTLs are disabled.
+ */
+ExpiryStats StorageManager::GetExpiryStats() const {
+    ExpiryStats stats;
+    if (!ttl_policy_) return stats;
+    stats.data_expired = data_expiry_filter_->expired();
+    stats.data_expired_bytes = data_expiry_filter_->expired_bytes();
+    stats.index_expired = index_expiry_filter_->expired();
+    stats.metadata_index_expired = metadata_expiry_filter_->expired();
+    return stats;
+}
+
+/**
+ * @brief Reads the data_cf blob file counts and sizes. Properties the RocksDB version does not know are left at 0.
+ * 
+ * @return BlobUsage The blob usage, all zero when value separation is off.
+ */
+BlobUsage StorageManager::GetBlobUsage() {
+    BlobUsage usage;
+    db->GetIntProperty(data_handle_, "rocksdb.num-blob-files", &usage.files);
+    db->GetIntProperty(data_handle_, "rocksdb.total-blob-file-size", &usage.bytes);
+    db->GetIntProperty(data_handle_, "rocksdb.live-blob-file-size", &usage.live_bytes);
+    db->GetIntProperty(data_handle_, "rocksdb.live-blob-file-garbage-size", &usage.garbage_bytes);
+    return usage;
+}
+
+/**
+ * @brief Sums the table properties of every data_cf SST file. A file counts as dictionary compressed when its recorded compression options carry a non-zero max_dict_bytes.
+ * 
+ * @return DataCompression The file, entry and byte totals, all zero when the properties cannot be read.
+ */
+DataCompression StorageManager::GetDataCompression() {
+    DataCompression usage;
+    rocksdb::TablePropertiesCollection tables;
+    rocksdb::Status s = db->GetPropertiesOfAllTables(data_handle_, &tables);
+    if (!s.ok()) {
+        std::cerr << "[Storage] Failed to read data_cf table properties: " << s.ToString() << std::endl;
+        return usage;
+    }
+    static const std::string kDictOption = "max_dict_bytes=";
+    for (const auto& table : tables) {
+        const rocksdb::TableProperties& props = *table.second;
+        usage.files++;
+        usage.entries += props.num_entries;
+        usage.raw_bytes += props.raw_key_size + props.raw_value_size;
+        usage.data_bytes += props.data_size;
+        size_t pos = props.compression_options.find(kDictOption);
+        if (props.compression_name == "ZSTD" && pos != std::string::npos
+            && std::strtoull(props.compression_options.c_str() + pos + kDictOption.size(), nullptr, 10) > 0) {
+            usage.dict_files++;
+        }
+    }
+    return usage;
+}
+
+/**
+ * @brief Reads a sample of raw data_cf values (the stored encoding, blob values resolved) by taking every n-th key, with n picked from the estimated key count so the sample spans the whole CF.
+ * 
+ * @param limit Maximum number of values to append.
+ * @param out Output for the values.
+ * @return true if the CF could be read.
+ * @return false otherwise.
+ */
+bool StorageManager::SampleStoredValues(size_t limit, std::vector<std::string>* out) {
+    if (limit == 0) return true;
+    uint64_t estimated = 0;
+    db->GetIntProperty(data_handle_, "rocksdb.estimate-num-keys", &estimated);
+    const uint64_t step = std::max<uint64_t>(estimated / limit, 1);
+
+    rocksdb::ReadOptions read_options;
+    read_options.fill_cache = false;
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(read_options, data_handle_));
+    size_t taken = 0;
+    uint64_t position = 0;
+    for (it->SeekToFirst(); it->Valid() && taken < limit; it->Next(), ++position) {
+        if (position % step != 0) continue;
+        out->push_back(it->value().ToString());
+        taken++;
+    }
+    if (!it->status().ok()) {
+        std::cerr << "[Storage] data_cf sample failed: " << it->status().ToString() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Flushes data_cf and runs a full manual compaction over it. With value separation on the compaction also relocates live blobs out of the files past the GC age cutoff.
+ * 
+ * @return true if both succeeded.
+ * @return false otherwise.
+ */
+bool StorageManager::CompactDataCF() {
+    rocksdb::Status s = db->Flush(rocksdb::FlushOptions(), data_handle_);
+    if (s.ok()) s = db->CompactRange(rocksdb::CompactRangeOptions(), data_handle_, nullptr, nullptr);
+    if (!s.ok()) std::cerr << "[Storage] data_cf compaction failed: " << s.ToString() << std::endl;
+    return s.ok();
+}
+
+/**
+ * @brief Counts data_cf SST files and bytes in the hot and cold tiers.
+ * 
+ * @return TierUsage The per tier usage. Everything is hot when no cold path is configured.
+ */
+TierUsage StorageManager::GetTierUsage() {
+    TierUsage usage;
+    auto trim = [](std::string path) {
+        while (path.size() > 1 && path.back() == '/') path.pop_back();
+        return path;
+    };
+    const std::string cold_path = trim(config_.cold_path);
+
+    std::vector<rocksdb::LiveFileMetaData> files;
+    db->GetLiveFilesMetaData(&files);
+    for (const auto& file : files) {
+        if (file.column_family_name != kDataCF) continue;
+        if (!cold_path.empty() && trim(file.db_path) == cold_path) {
+            usage.cold_files++;
+            usage.cold_bytes += file.size;
+        } else {
+            usage.hot_files++;
+            usage.hot_bytes += file.size;
+        }
+    }
+    return usage;
+}
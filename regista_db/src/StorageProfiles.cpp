@@ -0,0 +1,230 @@
+#include "StorageProfiles.h"
+#include "StorageManager.h"
+#include <iostream>
+#include <rocksdb/cache.h>
+#include <rocksdb/filter_policy.h>
+#include <rocksdb/table.h>
+#include <rocksdb/utilities/options_util.h>
+
+namespace {
+
+    constexpr size_t kMiB = 1024 * 1024;
+
+    /**
+     * @brief Sizes that differ between profiles. Everything else is shared.
+     * 
+     */
+    struct ProfileSizes {
+        size_t block_cache;
+        size_t index_memtable;
+        size_t data_memtable;
+        int data_memtables;
+        int uncompressed_levels; // data_cf levels written without compression (L0 and up)
+        bool data_bloom;
+        bool zstd_dict; // data_cf compressed levels use ZSTD with a per-file trained dictionary
+    };
+
+    /**
+     * @brief Looks up the sizes for a profile name.
+     * 
+     * @param profile The profile name.
+     * @param out Output for the profile's sizes.
+     * @return true if the profile is known.
+     * @return false otherwise.
+     */
+    bool LookupProfile(const std::string& profile, ProfileSizes* out) {
+        if (profile == "balanced") {
+            *out = {256 * kMiB, 32 * kMiB, 64 * kMiB, 3, 2, false, false};
+        } else if (profile == "write-heavy") {
+            // big memtables absorb bursts, the top levels skip compression to keep flush/compaction cheap
+            *out = {128 * kMiB, 64 * kMiB, 128 * kMiB, 4, 3, false, false};
+        } else if (profile == "read-heavy") {
+            // most of the memory budget goes to the block cache, point reads into data_cf get a filter too
+            *out = {1024 * kMiB, 16 * kMiB, 32 * kMiB, 2, 1, true, false};
+        } else if (profile == "small-entries") {
+            // balanced sizes, every level below L0 compressed with a ZSTD dictionary
+            *out = {256 * kMiB, 32 * kMiB, 64 * kMiB, 3, 1, false, true};
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Builds a block based table factory on the shared cache, optionally with a whole key bloom filter.
+     * 
+     * @param cache The shared block cache.
+     * @param bloom Whether to attach a bloom filter.
+     * @return std::shared_ptr<rocksdb::TableFactory> The table factory.
+     */
+    std::shared_ptr<rocksdb::TableFactory> MakeTableFactory(const std::shared_ptr<rocksdb::Cache>& cache, bool bloom) {
+        rocksdb::BlockBasedTableOptions table_options;
+        table_options.block_cache = cache;
+        table_options.cache_index_and_filter_blocks = true;
+        table_options.pin_l0_filter_and_index_blocks_in_cache = true;
+        if (bloom) {
+            table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10));
+            table_options.whole_key_filtering = true;
+            table_options.optimize_filters_for_memory = true;
+        }
+        return std::shared_ptr<rocksdb::TableFactory>(rocksdb::NewBlockBasedTableFactory(table_options));
+    }
+
+}
+
+/**
+ * @brief Checks whether a profile name is one of the built in tuning profiles.
+ * 
+ * @param profile The profile name.
+ * @return true if the profile is known.
+ * @return false otherwise.
+ */
+bool IsKnownStorageProfile(const std::string& profile) {
+    ProfileSizes sizes;
+    return LookupProfile(profile, &sizes);
+}
+
+/**
+ * @brief Returns the block cache size a profile uses when no size is configured.
+ * 
+ * @param profile The profile name.
+ * @return size_t The profile's block cache size in bytes, 0 if the profile is unknown.
+ */
+size_t ProfileBlockCacheBytes(const std::string& profile) {
+    ProfileSizes sizes;
+    return LookupProfile(profile, &sizes) ? sizes.block_cache : 0;
+}
+
+/**
+ * @brief Builds the DB and per column family options for the configured profile. index_cf only serves point lookups on 8-byte keys, so it gets a bloom filter and a small memtable (the metadata index CFs share its shape without the filter); data_cf holds the protobuf blobs and gets larger memtables and per-level compression (none near the top, LZ4 in the middle, ZSTD at the bottom), with values above blob_min_bytes separated into blob files when configured. The small-entries profile compresses every data_cf level below L0 with ZSTD and a dictionary RocksDB trains for each SST file from a sample of its own data blocks. All CFs share one LRU or HyperClock block cache. When an options file is configured it is loaded last, and every column family it names takes the file's options instead of the profile's.
+ * 
+ * @param config The storage config holding the profile name, options file and cache settings.
+ * @param db_options DB wide options to tune. create_if_missing and statistics are left to the caller.
+ * @param tuning Output for the per column family options.
+ * @return true if the profile and options file were valid.
+ * @return false otherwise.
+ */
+bool BuildStorageTuning(const StorageConfig& config, rocksdb::DBOptions* db_options, StorageTuning* tuning) {
+    ProfileSizes sizes;
+    if (!LookupProfile(config.profile, &sizes)) {
+        std::cerr << "[Storage] Unknown profile: " << config.profile << std::endl;
+        return false;
+    }
+    size_t cache_bytes = config.block_cache_bytes > 0 ? config.block_cache_bytes : sizes.block_cache;
+
+    if (config.hyper_clock_cache) {
+        // estimated entry charge is roughly one data block
+        rocksdb::HyperClockCacheOptions cache_options(cache_bytes, 8 * 1024);
+        tuning->block_cache = cache_options.MakeSharedCache();
+    } else {
+        tuning->block_cache = rocksdb::NewLRUCache(cache_bytes);
+    }
+
+    db_options->max_background_jobs = config.profile == "write-heavy" ? 8 : 4;
+    db_options->bytes_per_sync = 1 * kMiB;
+    if (config.profile == "write-heavy") {
+        db_options->enable_pipelined_write = true;
+    }
+
+    // default CF only holds a handful of bookkeeping keys
+    tuning->default_cf = rocksdb::ColumnFamilyOptions();
+    tuning->default_cf.write_buffer_size = 4 * kMiB;
+    tuning->default_cf.table_factory = MakeTableFactory(tuning->block_cache, false);
+
+    // index_cf: fixed 8-byte keys, point lookups only
+    rocksdb::ColumnFamilyOptions& index_cf = tuning->index_cf;
+    index_cf = rocksdb::ColumnFamilyOptions();
+    index_cf.write_buffer_size = sizes.index_memtable;
+    index_cf.max_write_buffer_number = 3;
+    index_cf.compression = rocksdb::kLZ4Compression;
+    index_cf.table_factory = MakeTableFactory(tuning->block_cache, true);
+    index_cf.memtable_prefix_bloom_size_ratio = 0.1;
+    index_cf.memtable_whole_key_filtering = true;
+    index_cf.level_compaction_dynamic_level_bytes = true;
+
+    // metadata indexes: same shape as index_cf, but only read with bounded seeks so a whole key filter would never be consulted
+    tuning->metadata_index_cf = index_cf;
+    tuning->metadata_index_cf.table_factory = MakeTableFactory(tuning->block_cache, false);
+    tuning->metadata_index_cf.memtable_prefix_bloom_size_ratio = 0;
+    tuning->metadata_index_cf.memtable_whole_key_filtering = false;
+
+    // rollup_cf: small fixed-size values, read with bounded seeks per source, merge operands folded by compaction
+    tuning->rollup_cf = tuning->metadata_index_cf;
+
+    // data_cf: large protobuf values, read by time range
+    rocksdb::ColumnFamilyOptions& data_cf = tuning->data_cf;
+    data_cf = rocksdb::ColumnFamilyOptions();
+    data_cf.write_buffer_size = sizes.data_memtable;
+    data_cf.max_write_buffer_number = sizes.data_memtables;
+    data_cf.min_write_buffer_number_to_merge = sizes.data_memtables > 2 ? 2 : 1;
+    data_cf.target_file_size_base = sizes.data_memtable;
+    data_cf.max_bytes_for_level_base = 4 * sizes.data_memtable;
+    data_cf.level_compaction_dynamic_level_bytes = true;
+    data_cf.num_levels = 7;
+    data_cf.compression_per_level.assign(data_cf.num_levels, rocksdb::kLZ4Compression);
+    for (int level = 0; level < sizes.uncompressed_levels; ++level) {
+        data_cf.compression_per_level[level] = rocksdb::kNoCompression;
+    }
+    data_cf.bottommost_compression = rocksdb::kZSTD;
+    if (sizes.zstd_dict) {
+        // small entries repeat field tags, sources and metadata keys across entries rather than within one 4 KiB
+        // block, which a dictionary shared by the whole file captures. bottommost_compression_opts stays disabled,
+        // so the bottommost level uses these options too
+        for (int level = sizes.uncompressed_levels; level < data_cf.num_levels; ++level) {
+            data_cf.compression_per_level[level] = rocksdb::kZSTD;
+        }
+        data_cf.compression_opts.max_dict_bytes = kZstdDictBytes;
+        data_cf.compression_opts.zstd_max_train_bytes = kZstdDictTrainBytes;
+        data_cf.compression_opts.use_zstd_dict_trainer = true;
+        data_cf.compression_opts.max_dict_buffer_bytes = 8 * kMiB; // blocks held back per file until the dictionary is trained
+    }
+    data_cf.table_factory = MakeTableFactory(tuning->block_cache, sizes.data_bloom);
+    data_cf.optimize_filters_for_hits = sizes.data_bloom; // data_cf is only point read through index_cf, so lookups always hit
+
+    // large bytes/json payloads go to blob files, L0+ SSTs then hold only keys and blob references
+    if (config.blob_min_bytes > 0) {
+        data_cf.enable_blob_files = true;
+        data_cf.min_blob_size = config.blob_min_bytes;
+        data_cf.blob_file_size = config.blob_file_bytes;
+        data_cf.blob_compression_type = rocksdb::kLZ4Compression;
+        data_cf.enable_blob_garbage_collection = config.blob_gc_age_cutoff > 0;
+        data_cf.blob_garbage_collection_age_cutoff = config.blob_gc_age_cutoff;
+        data_cf.blob_garbage_collection_force_threshold = config.blob_gc_force_threshold;
+        data_cf.blob_compaction_readahead_size = 2 * kMiB;
+    }
+
+    if (config.options_file.empty()) return true;
+
+    rocksdb::ConfigOptions config_options;
+    config_options.ignore_unknown_options = false;
+    config_options.env = rocksdb::Env::Default();
+    std::vector<rocksdb::ColumnFamilyDescriptor> file_cfs;
+    rocksdb::Status s = rocksdb::LoadOptionsFromFile(config_options, config.options_file, db_options, &file_cfs, &tuning->block_cache);
+    if (!s.ok()) {
+        std::cerr << "[Storage] Failed to load options file " << config.options_file << ": " << s.ToString() << std::endl;
+        return false;
+    }
+    for (auto& cf : file_cfs) {
+        tuning->overrides[cf.name] = std::move(cf.options);
+    }
+    return true;
+}
+
+/**
+ * @brief Picks the options for a column family by name. Options file entries win, then the profile's index, data, metadata index and rollup options; anything else gets the default CF options.
+ * 
+ * @param tuning The tuning built by BuildStorageTuning.
+ * @param name The column family name.
+ * @return rocksdb::ColumnFamilyOptions The options to open the column family with.
+ */
+rocksdb::ColumnFamilyOptions OptionsForColumnFamily(const StorageTuning& tuning, const std::string& name) {
+    auto it = tuning.overrides.find(name);
+    if (it != tuning.overrides.end()) return it->second;
+
+    if (name == StorageManager::kIndexCF) return tuning.index_cf;
+    if (name == StorageManager::kDataCF) return tuning.data_cf;
+    const std::string prefix = StorageManager::kMetadataIndexCFPrefix;
+    if (name.compare(0, prefix.size(), prefix) == 0) return tuning.metadata_index_cf;
+    if (name == StorageManager::kRollupCF) return tuning.rollup_cf;
+    return tuning.default_cf;
+}
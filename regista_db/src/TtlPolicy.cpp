@@ -0,0 +1,106 @@
+#include "TtlPolicy.h"
+#include "EntryCodec.h"
+#include <chrono>
+#include <cstring>
+#include <endian.h>
+
+/**
+ * @brief Construct a new Ttl Policy object.
+ * 
+ * @param default_ttl_seconds TTL for entries without their own TTL or a source TTL, 0 = forever.
+ * @param source_ttl_seconds TTLs keyed by the entry's metadata "source" value.
+ */
+TtlPolicy::TtlPolicy(uint64_t default_ttl_seconds, std::map<std::string, uint64_t> source_ttl_seconds)
+    : default_ttl_seconds_(default_ttl_seconds), source_ttl_seconds_(std::move(source_ttl_seconds)) {}
+
+/**
+ * @brief Computes when an entry expires.
+ * 
+ * @param entry The entry.
+ * @return uint64_t Expiry in microseconds since epoch, or kNever.
+ */
+uint64_t TtlPolicy::ExpiresAtMicros(const registadb::Entry& entry) const {
+    uint64_t ttl = entry.ttl_seconds();
+    if (ttl == 0 && !source_ttl_seconds_.empty()) {
+        auto source = entry.metadata().find("source");
+        if (source != entry.metadata().end()) {
+            auto it = source_ttl_seconds_.find(source->second);
+            if (it != source_ttl_seconds_.end()) ttl = it->second;
+        }
+    }
+    if (ttl == 0) ttl = default_ttl_seconds_;
+    if (ttl == 0) return kNever;
+
+    uint64_t created = entry.created_at().seconds() * 1000000ULL + entry.created_at().nanos() / 1000ULL;
+    return created + ttl * 1000000ULL;
+}
+
+/**
+ * @brief Current wall clock time.
+ * 
+ * @return uint64_t Microseconds since epoch.
+ */
+uint64_t TtlPolicy::NowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Appends an 8-byte big-endian expiry to an index value. Nothing is appended for kNever, so non-expiring records keep their original size.
+ * 
+ * @param value The index value to extend.
+ * @param expires_at Expiry in microseconds since epoch.
+ */
+void TtlPolicy::AppendExpiry(std::string* value, uint64_t expires_at) {
+    if (expires_at == kNever) return;
+    uint64_t big_endian = htobe64(expires_at);
+    value->append(reinterpret_cast<const char*>(&big_endian), 8);
+}
+
+/**
+ * @brief Reads the expiry suffix of an index value.
+ * 
+ * @param value The index value.
+ * @param size The index value size.
+ * @param fixed_size Size of the value without a suffix.
+ * @return uint64_t Expiry in microseconds since epoch, or kNever when there is no suffix.
+ */
+uint64_t TtlPolicy::ReadExpiry(const char* value, size_t size, size_t fixed_size) {
+    if (size != fixed_size + 8) return kNever;
+    uint64_t big_endian;
+    std::memcpy(&big_endian, value + fixed_size, 8);
+    return be64toh(big_endian);
+}
+
+/**
+ * @brief Removes an index record once its expiry suffix has passed.
+ * 
+ * @return true to remove the record.
+ * @return false to keep it.
+ */
+bool IndexExpiryFilter::Filter(int level, const rocksdb::Slice& key, const rocksdb::Slice& existing_value,
+                               std::string* new_value, bool* value_changed) const {
+    uint64_t expires_at = TtlPolicy::ReadExpiry(existing_value.data(), existing_value.size(), fixed_value_size_);
+    if (expires_at == TtlPolicy::kNever || expires_at > TtlPolicy::NowMicros()) return false;
+    expired_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief Removes a data_cf entry once its TTL has passed. Unparseable values are kept.
+ * 
+ * @return true to remove the entry.
+ * @return false to keep it.
+ */
+bool DataExpiryFilter::Filter(int level, const rocksdb::Slice& key, const rocksdb::Slice& existing_value,
+                              std::string* new_value, bool* value_changed) const {
+    registadb::Entry entry;
+    // only the TTL fields are needed, a columnar list is left packed
+    if (!DecodeStoredEntry(existing_value.data(), existing_value.size(), &entry, false)) return false;
+
+    uint64_t expires_at = policy_.ExpiresAtMicros(entry);
+    if (expires_at == TtlPolicy::kNever || expires_at > TtlPolicy::NowMicros()) return false;
+    expired_.fetch_add(1, std::memory_order_relaxed);
+    expired_bytes_.fetch_add(existing_value.size(), std::memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,69 @@
+#include "WalGroupSync.h"
+#include <iostream>
+
+
+/**
+ * @brief Construct a new Wal Group Sync:: Wal Group Sync object
+ *
+ * @param sync Syncs the WAL, returns false on failure. May be set later with SetSyncFunction.
+ */
+WalGroupSync::WalGroupSync(SyncFn sync) : sync_(std::move(sync)) {}
+
+/**
+ * @brief Sets the call that syncs the WAL. Must be called before the first WaitDurable.
+ *
+ * @param sync Syncs the WAL, returns false on failure.
+ */
+void WalGroupSync::SetSyncFunction(SyncFn sync) {
+    sync_ = std::move(sync);
+}
+
+/**
+ * @brief Waits until the caller's already committed write is durable. The caller takes a ticket; if no sync is running it leads one covering every ticket handed out so far, otherwise it waits for the running sync and, if that one started too early to cover it, leads or joins the next.
+ *
+ * @return true The write is covered by a successful sync.
+ * @return false A WAL sync failed (or no sync function is set).
+ */
+bool WalGroupSync::WaitDurable() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const uint64_t ticket = ++written_;
+
+    while (synced_upto_ < ticket && !failed_) {
+        if (sync_running_) {
+            synced_.wait(lock);
+            continue;
+        }
+
+        // lead a sync: everything written up to now is covered by it
+        sync_running_ = true;
+        const uint64_t target = written_;
+        lock.unlock();
+        bool ok = sync_ && sync_();
+        lock.lock();
+        sync_running_ = false;
+        syncs_++;
+        if (ok) {
+            synced_upto_ = std::max(synced_upto_, target);
+        } else {
+            failed_ = true;
+            std::cerr << "[Storage] WAL sync failed, durable writes are no longer acknowledged" << std::endl;
+        }
+        synced_.notify_all();
+    }
+    if (failed_) return false;
+    synced_writes_++;
+    return true;
+}
+
+/**
+ * @brief Returns the group sync counters.
+ *
+ * @return WalSyncStats Syncs issued and writes acknowledged as durable.
+ */
+WalSyncStats WalGroupSync::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    WalSyncStats stats;
+    stats.syncs = syncs_;
+    stats.synced_writes = synced_writes_;
+    return stats;
+}
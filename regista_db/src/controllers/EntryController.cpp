@@ -1,6 +1,14 @@
 #include "api/EntryController.h"
+#include "MetricsExporter.hpp"
 #include "RegistaServer.h"
+#include "RequestArena.h"
+#include <algorithm>
+#include <cstring>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/util/delimited_message_util.h>
 #include <google/protobuf/util/json_util.h>
+#include <google/protobuf/util/time_util.h>
 
 extern RegistaServer* g_regista_server;
 
@@ -27,6 +35,582 @@ namespace api {
         }
     }
     
+    /**
+     * @brief Encodes a binary scan cursor as lowercase hex so it can travel in a query string.
+     * 
+     * @param raw The raw cursor bytes.
+     * @return std::string The hex encoded cursor.
+     */
+    std::string encodeCursor(const std::string& raw) {
+        static const char* digits = "0123456789abcdef";
+        std::string hex;
+        hex.reserve(raw.size() * 2);
+        for (unsigned char c : raw) {
+            hex.push_back(digits[c >> 4]);
+            hex.push_back(digits[c & 0x0f]);
+        }
+        return hex;
+    }
+
+    /**
+     * @brief Decodes a hex scan cursor back into raw bytes.
+     * 
+     * @param hex The hex encoded cursor.
+     * @param raw Output for the raw cursor bytes.
+     * @return true if the cursor was valid hex.
+     * @return false otherwise.
+     */
+    bool decodeCursor(const std::string& hex, std::string* raw) {
+        if (hex.size() % 2 != 0) return false;
+        raw->clear();
+        raw->reserve(hex.size() / 2);
+        auto nibble = [](char c) -> int {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        };
+        for (size_t i = 0; i < hex.size(); i += 2) {
+            int hi = nibble(hex[i]);
+            int lo = nibble(hex[i + 1]);
+            if (hi < 0 || lo < 0) return false;
+            raw->push_back(static_cast<char>((hi << 4) | lo));
+        }
+        return true;
+    }
+
+    /**
+     * @brief Parses a time query parameter, either microseconds since epoch or an RFC 3339 timestamp.
+     * 
+     * @param value The query parameter value.
+     * @param out_micros Output for the parsed time in microseconds since epoch.
+     * @return true if the value could be parsed.
+     * @return false otherwise.
+     */
+    bool parseTimeParam(const std::string& value, uint64_t* out_micros) {
+        if (!value.empty() && std::all_of(value.begin(), value.end(), ::isdigit)) {
+            *out_micros = std::stoull(value);
+            return true;
+        }
+        google::protobuf::Timestamp ts;
+        if (!google::protobuf::util::TimeUtil::FromString(value, &ts)) return false;
+        *out_micros = ts.seconds() * 1000000ULL + ts.nanos() / 1000ULL;
+        return true;
+    }
+
+    /**
+     * @brief Parses one JSON Entry straight from a request body, without building an intermediate Json::Value. Unknown fields are ignored.
+     * 
+     * @param body The JSON text.
+     * @param entry Output for the parsed entry.
+     * @return true if the body was a valid Entry.
+     * @return false otherwise.
+     */
+    bool parseJsonEntry(std::string_view body, registadb::Entry* entry) {
+        google::protobuf::util::JsonParseOptions options;
+        options.ignore_unknown_fields = true;
+        return google::protobuf::util::JsonStringToMessage({body.data(), body.size()}, entry, options).ok();
+    }
+
+    /**
+     * @brief Resolves the durability of a REST write from the optional "durability" query parameter (none, async or sync), falling back to the server's REST durability.
+     * 
+     * @param req The incoming HTTP request.
+     * @param out Output for the durability to write with.
+     * @return true if the parameter was absent or valid.
+     * @return false if it names no durability.
+     */
+    bool requestDurability(const HttpRequestPtr& req, registadb::Durability* out) {
+        const std::string& param = req->getParameter("durability");
+        if (param.empty()) {
+            *out = g_regista_server->GetConfig().rest_durability;
+            return true;
+        }
+        return RegistaServer::ParseDurability(param, out);
+    }
+
+    /**
+     * @brief Builds the 400 response for an unknown durability parameter.
+     * 
+     * @return HttpResponsePtr The response to send.
+     */
+    HttpResponsePtr invalidDurabilityResponse() {
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(k400BadRequest);
+        resp->setBody("Invalid durability (none, async or sync)\n");
+        return resp;
+    }
+
+    static const char* const kTooManyEntries = "Too many entries for one batch";
+
+    /**
+     * @brief Parses an NDJSON body (one JSON Entry per line, blank lines skipped) for the batch create route.
+     * 
+     * @param body The NDJSON text.
+     * @param entries Output for the parsed entries, in line order.
+     * @param error Output for the reason parsing stopped.
+     * @return true if every line was a valid Entry and the batch is within RegistaServer::kMaxBatchEntries.
+     * @return false otherwise.
+     */
+    bool parseNdjsonEntries(std::string_view body, std::vector<registadb::Entry>* entries, std::string* error) {
+        size_t line_number = 0;
+        while (!body.empty()) {
+            size_t end = body.find('\n');
+            std::string_view line = body.substr(0, end);
+            body.remove_prefix(end == std::string_view::npos ? body.size() : end + 1);
+            line_number++;
+
+            while (!line.empty() && ::isspace(static_cast<unsigned char>(line.back()))) line.remove_suffix(1);
+            if (line.empty()) continue;
+
+            if (entries->size() == RegistaServer::kMaxBatchEntries) {
+                *error = kTooManyEntries;
+                return false;
+            }
+            entries->emplace_back();
+            if (!parseJsonEntry(line, &entries->back())) {
+                *error = "Invalid JSON entry on line " + std::to_string(line_number);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Parses a stream of length-delimited Entry messages (varint size prefix, as written by writeDelimitedTo in Java) for the batch create route.
+     * 
+     * @param body The binary stream.
+     * @param entries Output for the parsed entries, in stream order.
+     * @param error Output for the reason parsing stopped.
+     * @return true if the stream was well formed and within RegistaServer::kMaxBatchEntries.
+     * @return false otherwise.
+     */
+    bool parseDelimitedEntries(std::string_view body, std::vector<registadb::Entry>* entries, std::string* error) {
+        google::protobuf::io::ArrayInputStream input(body.data(), static_cast<int>(body.size()));
+        google::protobuf::io::CodedInputStream coded(&input);
+        while (true) {
+            registadb::Entry entry;
+            bool clean_eof = false;
+            if (!google::protobuf::util::ParseDelimitedFromCodedStream(&entry, &coded, &clean_eof)) {
+                if (clean_eof) return true;
+                *error = "Invalid protobuf entry at index " + std::to_string(entries->size());
+                return false;
+            }
+            if (entries->size() == RegistaServer::kMaxBatchEntries) {
+                *error = kTooManyEntries;
+                return false;
+            }
+            entries->push_back(std::move(entry));
+        }
+    }
+
+    /**
+     * @brief Parses the from, to, limit and cursor query parameters shared by the scan and metadata query routes. Outputs keep their defaults when a parameter is absent.
+     * 
+     * @param req The incoming HTTP request.
+     * @param from_ts Output for the oldest creation time to include.
+     * @param to_ts Output for the newest creation time to include.
+     * @param limit Output for the page size, clamped to RegistaServer::kMaxScanLimit.
+     * @param cursor Output for the raw cursor bytes.
+     * @return true if every present parameter was valid.
+     * @return false otherwise.
+     */
+    bool parseRangeParams(const HttpRequestPtr& req, uint64_t* from_ts, uint64_t* to_ts,
+                          uint32_t* limit, std::string* cursor) {
+        const std::string& fromParam = req->getParameter("from");
+        const std::string& toParam = req->getParameter("to");
+        const std::string& limitParam = req->getParameter("limit");
+        const std::string& cursorParam = req->getParameter("cursor");
+
+        bool valid = (fromParam.empty() || parseTimeParam(fromParam, from_ts))
+                  && (toParam.empty() || parseTimeParam(toParam, to_ts))
+                  && (cursorParam.empty() || (decodeCursor(cursorParam, cursor) && cursor->size() == 16));
+        if (valid && !limitParam.empty()) {
+            valid = std::all_of(limitParam.begin(), limitParam.end(), ::isdigit) && limitParam.size() < 10;
+            if (valid) *limit = std::min<uint32_t>(std::stoul(limitParam), RegistaServer::kMaxScanLimit);
+        }
+        return valid;
+    }
+
+    /**
+     * @brief Parses a bucket width: a number with an optional ms, s, m, h or d unit, milliseconds when there is none.
+     * 
+     * @param value The query parameter value, e.g. "500ms", "10s" or "1m".
+     * @param out_ms Output for the width in milliseconds.
+     * @return true if the value could be parsed.
+     * @return false otherwise.
+     */
+    bool parseBucketParam(const std::string& value, uint64_t* out_ms) {
+        size_t digits = 0;
+        while (digits < value.size() && ::isdigit(static_cast<unsigned char>(value[digits]))) digits++;
+        if (digits == 0 || digits > 9) return false;
+
+        const std::string unit = value.substr(digits);
+        uint64_t scale;
+        if (unit.empty() || unit == "ms") scale = 1;
+        else if (unit == "s") scale = 1000;
+        else if (unit == "m") scale = 60 * 1000;
+        else if (unit == "h") scale = 60 * 60 * 1000;
+        else if (unit == "d") scale = 24 * 60 * 60 * 1000;
+        else return false;
+
+        *out_ms = std::stoull(value.substr(0, digits)) * scale;
+        return true;
+    }
+
+    /**
+     * @brief Handles HTTP GET requests to downsample numeric entries into time buckets (min, max, sum, count and avg per bucket), computed on the server. Query parameters: from, to (as for the scan), bucket (e.g. 1m, omitted = one bucket) and optionally key and value to only include entries whose metadata[key] equals value.
+     * 
+     * @param req The incoming HTTP request containing the aggregation parameters and optional "Accept" header for response format.
+     * @param callback The callback function to send the HTTP response asynchronously.
+     */
+    void EntryController::handleAggregate(const HttpRequestPtr& req, 
+                                         std::function<void(const HttpResponsePtr&)>&& callback) {
+        if (!g_regista_server) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k500InternalServerError);
+            resp->setBody("Engine not initialized");
+            callback(resp);
+            return;
+        }
+
+        RequestTimer timer(RequestTunnel::Rest, registadb::OP_AGGREGATE);
+        uint64_t from_ts = 0;
+        uint64_t to_ts = UINT64_MAX;
+        uint32_t limit = 0;
+        std::string cursor;
+        uint64_t bucket_ms = 0;
+        const std::string& bucketParam = req->getParameter("bucket");
+        const std::string& keyParam = req->getParameter("key");
+
+        if (!parseRangeParams(req, &from_ts, &to_ts, &limit, &cursor)
+            || (!bucketParam.empty() && !parseBucketParam(bucketParam, &bucket_ms))) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k400BadRequest);
+            resp->setBody("Invalid aggregation parameters\n");
+            callback(resp);
+            return;
+        }
+
+        RequestArena arena;
+        registadb::Request& protoReq = *arena.Create<registadb::Request>();
+        protoReq.set_op(registadb::OP_AGGREGATE);
+        protoReq.mutable_aggregate()->set_bucket_width_ms(bucket_ms);
+        if (!keyParam.empty()) {
+            protoReq.mutable_metadata()->set_key(keyParam);
+            protoReq.mutable_metadata()->set_value(req->getParameter("value"));
+        }
+        registadb::ScanRequest* scan = protoReq.mutable_scan();
+        *scan->mutable_from() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(from_ts);
+        if (to_ts != UINT64_MAX) {
+            *scan->mutable_to() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(to_ts);
+        }
+
+        timer.Mark(RequestStage::Parse);
+        registadb::Response& protoResp = *arena.Create<registadb::Response>();
+        g_regista_server->ExecuteRequest(protoReq, &protoResp);
+        timer.Mark(RequestStage::Storage);
+
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(mapStatus(protoResp.status()));
+
+        if (protoResp.status() != registadb::STATUS_OK) {
+            resp->setBody(protoResp.message() + "\n");
+        } else if (req->getHeader("Accept") == "application/x-protobuf") {
+            resp->setContentTypeCode(CT_CUSTOM);
+            resp->addHeader("Content-Type", "application/x-protobuf");
+            resp->setBody(protoResp.SerializeAsString());
+        } else {
+            // a bucket whose min or sum is 0 still lists it
+            google::protobuf::util::JsonPrintOptions options;
+            options.always_print_primitive_fields = true;
+            std::string outJson = "{\"buckets\":[";
+            std::string bucketJson;
+            for (int i = 0; i < protoResp.buckets_size(); ++i) {
+                if (i > 0) outJson += ',';
+                bucketJson.clear();
+                google::protobuf::util::MessageToJsonString(protoResp.buckets(i), &bucketJson, options);
+                outJson += bucketJson;
+            }
+            outJson += "]}\n";
+            resp->setContentTypeCode(CT_APPLICATION_JSON);
+            resp->setBody(std::move(outJson));
+        }
+        timer.Mark(RequestStage::Serialize);
+        callback(resp);
+    }
+
+    /**
+     * @brief Handles HTTP GET requests to scan entries by creation time, newest first. Query parameters: from, to (micros since epoch or RFC 3339), limit and cursor (nextCursor of the previous page). JSON responses are streamed in chunks as the range is read.
+     * 
+     * @param req The incoming HTTP request containing the scan parameters and optional "Accept" header for response format.
+     * @param callback The callback function to send the HTTP response asynchronously.
+     */
+    void EntryController::handleScan(const HttpRequestPtr& req, 
+                                    std::function<void(const HttpResponsePtr&)>&& callback) {
+        if (!g_regista_server) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k500InternalServerError);
+            resp->setBody("Engine not initialized");
+            callback(resp);
+            return;
+        }
+
+        uint64_t from_ts = 0;
+        uint64_t to_ts = UINT64_MAX;
+        uint32_t limit = RegistaServer::kDefaultScanLimit;
+        std::string cursor;
+        auto timer = std::make_shared<RequestTimer>(RequestTunnel::Rest, registadb::OP_SCAN);
+
+        if (!parseRangeParams(req, &from_ts, &to_ts, &limit, &cursor)) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k400BadRequest);
+            resp->setBody("Invalid scan parameters\n");
+            callback(resp);
+            return;
+        }
+        timer->Mark(RequestStage::Parse);
+
+        if (req->getHeader("Accept") == "application/x-protobuf") {
+            RequestArena arena;
+            registadb::Request& protoReq = *arena.Create<registadb::Request>();
+            protoReq.set_op(registadb::OP_SCAN);
+            registadb::ScanRequest* scan = protoReq.mutable_scan();
+            *scan->mutable_from() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(from_ts);
+            if (to_ts != UINT64_MAX) {
+                *scan->mutable_to() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(to_ts);
+            }
+            scan->set_limit(limit);
+            scan->set_cursor(cursor);
+
+            registadb::Response& protoResp = *arena.Create<registadb::Response>();
+            g_regista_server->ExecuteRequest(protoReq, &protoResp);
+            timer->Mark(RequestStage::Storage);
+
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(mapStatus(protoResp.status()));
+            resp->setContentTypeCode(CT_CUSTOM);
+            resp->addHeader("Content-Type", "application/x-protobuf");
+            resp->setBody(protoResp.SerializeAsString());
+            timer->Mark(RequestStage::Serialize);
+            callback(resp);
+            return;
+        }
+
+        // stream {"entries":[...],"nextCursor":"..."} a page at a time instead of rendering the whole range up front
+        struct ScanStream {
+            uint64_t from_ts = 0;
+            uint64_t to_ts = 0;
+            uint32_t remaining = 0;
+            std::string cursor;
+            std::string pending;
+            size_t offset = 0;
+            bool first = true;
+            bool done = false;
+            // recorded when the stream is released, time spent waiting on the client is skipped
+            std::shared_ptr<RequestTimer> timer;
+        };
+        auto state = std::make_shared<ScanStream>();
+        state->timer = timer;
+        state->from_ts = from_ts;
+        state->to_ts = to_ts;
+        state->remaining = limit;
+        state->cursor = cursor;
+        state->pending = "{\"entries\":[";
+
+        auto resp = HttpResponse::newStreamResponse([state](char* buffer, std::size_t size) -> std::size_t {
+            if (!buffer) return 0; // connection closed
+
+            while (state->offset == state->pending.size()) {
+                if (state->done) return 0;
+                state->pending.clear();
+                state->offset = 0;
+
+                if (state->remaining == 0) {
+                    state->pending = "],\"nextCursor\":\"" + encodeCursor(state->cursor) + "\"}\n";
+                    state->done = true;
+                    break;
+                }
+
+                // one page per refill keeps memory bounded regardless of limit
+                uint32_t page = std::min<uint32_t>(state->remaining, 256);
+                std::vector<registadb::Entry> entries;
+                std::string next_cursor;
+                state->timer->Skip();
+                g_regista_server->storage_.ScanRange(state->from_ts, state->to_ts, page, state->cursor, &entries, &next_cursor);
+                state->timer->Mark(RequestStage::Storage);
+
+                std::string jsonStr;
+                for (const auto& entry : entries) {
+                    if (!state->first) state->pending += ',';
+                    state->first = false;
+                    jsonStr.clear();
+                    google::protobuf::util::MessageToJsonString(entry, &jsonStr);
+                    state->pending += jsonStr;
+                }
+                state->timer->Mark(RequestStage::Serialize);
+                state->remaining -= static_cast<uint32_t>(entries.size());
+                state->cursor = next_cursor;
+                if (next_cursor.empty()) state->remaining = 0;
+            }
+
+            size_t n = std::min(size, state->pending.size() - state->offset);
+            std::memcpy(buffer, state->pending.data() + state->offset, n);
+            state->offset += n;
+            return n;
+        }, "", CT_APPLICATION_JSON);
+        callback(resp);
+    }
+
+    /**
+     * @brief Handles HTTP GET requests for entries whose metadata[key] equals value, newest first, served from the key's secondary index. Accepts the same from, to, limit and cursor parameters as the scan route.
+     * 
+     * @param req The incoming HTTP request containing the range parameters and optional "Accept" header for response format.
+     * @param callback The callback function to send the HTTP response asynchronously.
+     * @param key The indexed metadata key, extracted from the URL path.
+     * @param value The metadata value to match, extracted from the URL path.
+     */
+    void EntryController::handleQueryByMetadata(const HttpRequestPtr& req, 
+                                               std::function<void(const HttpResponsePtr&)>&& callback, 
+                                               const std::string& key, 
+                                               const std::string& value) {
+        if (!g_regista_server) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k500InternalServerError);
+            resp->setBody("Engine not initialized");
+            callback(resp);
+            return;
+        }
+
+        RequestTimer timer(RequestTunnel::Rest, registadb::OP_QUERY_METADATA);
+        uint64_t from_ts = 0;
+        uint64_t to_ts = UINT64_MAX;
+        uint32_t limit = RegistaServer::kDefaultScanLimit;
+        std::string cursor;
+
+        if (!parseRangeParams(req, &from_ts, &to_ts, &limit, &cursor)) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k400BadRequest);
+            resp->setBody("Invalid query parameters\n");
+            callback(resp);
+            return;
+        }
+
+        RequestArena arena;
+        registadb::Request& protoReq = *arena.Create<registadb::Request>();
+        protoReq.set_op(registadb::OP_QUERY_METADATA);
+        protoReq.mutable_metadata()->set_key(key);
+        protoReq.mutable_metadata()->set_value(value);
+        registadb::ScanRequest* scan = protoReq.mutable_scan();
+        *scan->mutable_from() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(from_ts);
+        if (to_ts != UINT64_MAX) {
+            *scan->mutable_to() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(to_ts);
+        }
+        scan->set_limit(limit);
+        scan->set_cursor(cursor);
+
+        timer.Mark(RequestStage::Parse);
+        registadb::Response& protoResp = *arena.Create<registadb::Response>();
+        g_regista_server->ExecuteRequest(protoReq, &protoResp);
+        timer.Mark(RequestStage::Storage);
+
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(mapStatus(protoResp.status()));
+
+        if (protoResp.status() != registadb::STATUS_OK) {
+            resp->setBody(protoResp.message() + "\n");
+        } else if (req->getHeader("Accept") == "application/x-protobuf") {
+            resp->setContentTypeCode(CT_CUSTOM);
+            resp->addHeader("Content-Type", "application/x-protobuf");
+            resp->setBody(protoResp.SerializeAsString());
+        } else {
+            std::string outJson = "{\"entries\":[";
+            std::string entryJson;
+            for (int i = 0; i < protoResp.entries_size(); ++i) {
+                if (i > 0) outJson += ',';
+                entryJson.clear();
+                google::protobuf::util::MessageToJsonString(protoResp.entries(i), &entryJson);
+                outJson += entryJson;
+            }
+            outJson += "],\"nextCursor\":\"" + encodeCursor(protoResp.next_cursor()) + "\"}\n";
+            resp->setContentTypeCode(CT_APPLICATION_JSON);
+            resp->setBody(std::move(outJson));
+        }
+        timer.Mark(RequestStage::Serialize);
+        callback(resp);
+    }
+
+    /**
+     * @brief Handles HTTP POST requests to read many entries at once. The body is {"ids": [...]} as JSON, or a serialized Request when sent as protobuf. Results come back in request order with a per-id status.
+     * 
+     * @param req The incoming HTTP request containing the ids in the body and optional "Content-Type"/"Accept" headers to indicate format.
+     * @param callback The callback function to send the HTTP response asynchronously.
+     */
+    void EntryController::handleBatchGet(const HttpRequestPtr& req, 
+                                        std::function<void(const HttpResponsePtr&)>&& callback) {
+        if (!g_regista_server) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k500InternalServerError);
+            resp->setBody("Engine not initialized");
+            callback(resp);
+            return;
+        }
+
+        RequestTimer timer(RequestTunnel::Rest, registadb::OP_MULTI_READ);
+        RequestArena arena;
+        registadb::Request& protoReq = *arena.Create<registadb::Request>();
+        bool parsed;
+        if (req->getHeader("Content-Type") == "application/x-protobuf") {
+            parsed = protoReq.ParseFromArray(req->body().data(), static_cast<int>(req->body().size()));
+        } else {
+            google::protobuf::util::JsonParseOptions options;
+            options.ignore_unknown_fields = true;
+            parsed = google::protobuf::util::JsonStringToMessage({req->body().data(), req->body().size()}, &protoReq, options).ok();
+        }
+        if (!parsed) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k400BadRequest);
+            resp->setBody("Invalid batchGet body\n");
+            callback(resp);
+            return;
+        }
+        protoReq.set_op(registadb::OP_MULTI_READ);
+
+        timer.Mark(RequestStage::Parse);
+        registadb::Response& protoResp = *arena.Create<registadb::Response>();
+        g_regista_server->ExecuteRequest(protoReq, &protoResp);
+        timer.Mark(RequestStage::Storage);
+
+        auto resp = HttpResponse::newHttpResponse();
+        resp->setStatusCode(mapStatus(protoResp.status()));
+
+        if (protoResp.status() != registadb::STATUS_OK) {
+            resp->setBody(protoResp.message() + "\n");
+        } else if (req->getHeader("Accept") == "application/x-protobuf") {
+            resp->setContentTypeCode(CT_CUSTOM);
+            resp->addHeader("Content-Type", "application/x-protobuf");
+            resp->setBody(protoResp.SerializeAsString());
+        } else {
+            // print status on every result, STATUS_OK is the proto3 default and would be omitted
+            google::protobuf::util::JsonPrintOptions options;
+            options.always_print_primitive_fields = true;
+
+            std::string outJson = "{\"results\":[";
+            std::string resultJson;
+            for (int i = 0; i < protoResp.results_size(); ++i) {
+                if (i > 0) outJson += ',';
+                resultJson.clear();
+                google::protobuf::util::MessageToJsonString(protoResp.results(i), &resultJson, options);
+                outJson += resultJson;
+            }
+            outJson += "]}\n";
+            resp->setContentTypeCode(CT_APPLICATION_JSON);
+            resp->setBody(std::move(outJson));
+        }
+        timer.Mark(RequestStage::Serialize);
+        callback(resp);
+    }
+
     /**
      * @brief Handles HTTP GET requests to read any entry by ID.
      * 
@@ -45,11 +629,16 @@ namespace api {
             return;
         }
 
-        registadb::Request protoReq;
+        RequestTimer timer(RequestTunnel::Rest, registadb::OP_READ);
+        RequestArena arena;
+        registadb::Request& protoReq = *arena.Create<registadb::Request>();
         protoReq.set_op(registadb::OP_READ);
         protoReq.set_id(id);
 
-        registadb::Response protoResp = g_regista_server->ExecuteRequest(protoReq);
+        timer.Mark(RequestStage::Parse);
+        registadb::Response& protoResp = *arena.Create<registadb::Response>();
+        g_regista_server->ExecuteRequest(protoReq, &protoResp);
+        timer.Mark(RequestStage::Storage);
 
         auto resp = HttpResponse::newHttpResponse();
         resp->setStatusCode(mapStatus(protoResp.status()));
@@ -72,6 +661,7 @@ namespace api {
         } else {
             resp->setBody("Entry not found\n");
         }
+        timer.Mark(RequestStage::Serialize);
         callback(resp);
     }
 
@@ -90,33 +680,39 @@ namespace api {
             return;
         }
 
-        registadb::Request protoReq;
+        RequestTimer timer(RequestTunnel::Rest, registadb::OP_CREATE);
+        RequestArena arena;
+        registadb::Request& protoReq = *arena.Create<registadb::Request>();
         protoReq.set_op(registadb::OP_CREATE);
+        registadb::Durability durability;
+        if (!requestDurability(req, &durability)) {
+            callback(invalidDurabilityResponse());
+            return;
+        }
+        protoReq.set_durability(durability);
 
         auto contentType = req->getHeader("Content-Type");
 
         if (contentType == "application/x-protobuf") {
-            if (!protoReq.mutable_entry()->ParseFromString(std::string(req->body()))) {
+            if (!protoReq.mutable_entry()->ParseFromArray(req->body().data(), static_cast<int>(req->body().size()))) {
                 auto resp = HttpResponse::newHttpResponse();
                 resp->setStatusCode(k400BadRequest);
                 resp->setBody("Invalid binary protobuf body\n");
                 callback(resp);
                 return;
             }
-        } else {
-            auto jsonPtr = req->getJsonObject();
-            if (!jsonPtr) {
-                auto resp = HttpResponse::newHttpResponse();
-                resp->setStatusCode(k400BadRequest);
-                resp->setBody("Invalid JSON body\n");
-                callback(resp);
-                return;
-            }
-            std::string jsonStr = jsonPtr->toStyledString();
-            google::protobuf::util::JsonStringToMessage(jsonStr, protoReq.mutable_entry());
+        } else if (!parseJsonEntry(req->body(), protoReq.mutable_entry())) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k400BadRequest);
+            resp->setBody("Invalid JSON body\n");
+            callback(resp);
+            return;
         }
         
-        registadb::Response protoResp = g_regista_server->ExecuteRequest(protoReq);
+        timer.Mark(RequestStage::Parse);
+        registadb::Response& protoResp = *arena.Create<registadb::Response>();
+        g_regista_server->ExecuteRequest(protoReq, &protoResp);
+        timer.Mark(RequestStage::Storage);
 
         auto resp = HttpResponse::newHttpResponse();
         resp->setStatusCode(mapStatus(protoResp.status()));
@@ -139,11 +735,113 @@ namespace api {
         } else {
             resp->setBody(protoResp.message() + '\n');
         }
+        timer.Mark(RequestStage::Serialize);
         callback(resp);
     }
 
     /**
-     * @brief Handles HTTP PUT requests to update an existing entry by ID, accepting either JSON or Protobuf request bodies.
+     * @brief Handles HTTP POST requests that create many entries at once. The body is NDJSON (one Entry per line) or, with "Content-Type: application/x-protobuf", a stream of length-delimited Entry messages. The whole batch is parsed first and then written with one WriteBatch per shard it touches. Each shard's part is stored completely or not at all; with more than one shard the batch as a whole is not atomic, a failing shard leaves the other parts stored. The created entries are streamed back in chunks, in the same format as the request.
+     * 
+     * @param req The incoming HTTP request containing the entries in the body and the "Content-Type" header to indicate format.
+     * @param callback The callback function to send the HTTP response asynchronously.
+     */
+    void EntryController::handleBatchCreate(const HttpRequestPtr& req, 
+                                          std::function<void(const HttpResponsePtr&)>&& callback) {
+        if (!g_regista_server) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k500InternalServerError);
+            resp->setBody("Engine not initialized");
+            callback(resp);
+            return;
+        }
+
+        auto timer = std::make_shared<RequestTimer>(RequestTunnel::Rest, registadb::OP_CREATE);
+        registadb::Durability durability;
+        if (!requestDurability(req, &durability)) {
+            callback(invalidDurabilityResponse());
+            return;
+        }
+        const bool protobuf = req->getHeader("Content-Type") == "application/x-protobuf";
+        auto entries = std::make_shared<std::vector<registadb::Entry>>();
+        std::string error;
+        bool parsed = protobuf ? parseDelimitedEntries(req->body(), entries.get(), &error)
+                               : parseNdjsonEntries(req->body(), entries.get(), &error);
+        if (!parsed || entries->empty()) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(error == kTooManyEntries ? k413RequestEntityTooLarge : k400BadRequest);
+            resp->setBody((parsed ? std::string("Empty batch") : error) + "\n");
+            callback(resp);
+            return;
+        }
+
+        bool new_ids = true;
+        for (auto& entry : *entries) {
+            bool generated_id = false;
+            g_regista_server->PrepareEntry(entry, &generated_id);
+            new_ids = new_ids && generated_id;
+        }
+        timer->Mark(RequestStage::Parse);
+        if (!g_regista_server->storage_.StoreEntries(*entries, durability, new_ids)) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k500InternalServerError);
+            resp->setBody("Failed to store batch\n");
+            callback(resp);
+            return;
+        }
+        timer->Mark(RequestStage::Storage);
+
+        // serialize the created entries a chunk at a time as the connection drains
+        struct BatchStream {
+            std::shared_ptr<std::vector<registadb::Entry>> entries;
+            size_t next = 0;
+            std::string pending;
+            size_t offset = 0;
+            std::shared_ptr<RequestTimer> timer;
+        };
+        auto state = std::make_shared<BatchStream>();
+        state->entries = entries;
+        state->timer = timer;
+
+        auto resp = HttpResponse::newStreamResponse([state, protobuf](char* buffer, std::size_t size) -> std::size_t {
+            if (!buffer) return 0; // connection closed
+
+            if (state->offset == state->pending.size()) {
+                if (state->next == state->entries->size()) return 0;
+                state->pending.clear();
+                state->offset = 0;
+
+                size_t end = std::min(state->next + 256, state->entries->size());
+                state->timer->Skip();
+                if (protobuf) {
+                    google::protobuf::io::StringOutputStream output(&state->pending);
+                    google::protobuf::io::CodedOutputStream coded(&output);
+                    for (size_t i = state->next; i < end; ++i) {
+                        google::protobuf::util::SerializeDelimitedToCodedStream((*state->entries)[i], &coded);
+                    }
+                } else {
+                    std::string jsonStr;
+                    for (size_t i = state->next; i < end; ++i) {
+                        jsonStr.clear();
+                        google::protobuf::util::MessageToJsonString((*state->entries)[i], &jsonStr);
+                        state->pending += jsonStr;
+                        state->pending += '\n';
+                    }
+                }
+                state->timer->Mark(RequestStage::Serialize);
+                state->next = end;
+            }
+
+            size_t n = std::min(size, state->pending.size() - state->offset);
+            std::memcpy(buffer, state->pending.data() + state->offset, n);
+            state->offset += n;
+            return n;
+        }, "", CT_CUSTOM, protobuf ? "application/x-protobuf" : "application/x-ndjson");
+        resp->setStatusCode(k201Created);
+        callback(resp);
+    }
+
+    /**
+     * @brief Handles HTTP PUT (replace) and PATCH (merge metadata, replace data only when given) requests to update an existing entry by ID, accepting either JSON or Protobuf request bodies.
      * 
      * @param req The incoming HTTP request containing the updated entry data in the body and optional "Content-Type" header to indicate format.
      * @param callback The callback function to send the HTTP response asynchronously.
@@ -159,35 +857,44 @@ namespace api {
             return;
         }
 
-        registadb::Request protoReq;
+        RequestTimer timer(RequestTunnel::Rest, registadb::OP_UPDATE);
+        RequestArena arena;
+        registadb::Request& protoReq = *arena.Create<registadb::Request>();
         protoReq.set_op(registadb::OP_UPDATE);
         protoReq.set_id(id);
+        if (req->method() == Patch) {
+            protoReq.set_update_mode(registadb::UPDATE_MERGE);
+        }
+        registadb::Durability durability;
+        if (!requestDurability(req, &durability)) {
+            callback(invalidDurabilityResponse());
+            return;
+        }
+        protoReq.set_durability(durability);
 
         auto contentType = req->getHeader("Content-Type");
         if (contentType == "application/x-protobuf") {
-            if (!protoReq.mutable_entry()->ParseFromString(std::string(req->body()))) {
+            if (!protoReq.mutable_entry()->ParseFromArray(req->body().data(), static_cast<int>(req->body().size()))) {
                 auto resp = HttpResponse::newHttpResponse();
                 resp->setStatusCode(k400BadRequest);
                 resp->setBody("Invalid binary protobuf body\n");
                 callback(resp);
                 return;
             }
-        } else {
-            auto jsonPtr = req->getJsonObject();
-            if (!jsonPtr) {
-                auto resp = HttpResponse::newHttpResponse();
-                resp->setStatusCode(k400BadRequest);
-                resp->setBody("Missing JSON body for update\n");
-                callback(resp);
-                return;
-            }
-            std::string jsonStr = jsonPtr->toStyledString();
-            google::protobuf::util::JsonStringToMessage(jsonStr, protoReq.mutable_entry());
+        } else if (!parseJsonEntry(req->body(), protoReq.mutable_entry())) {
+            auto resp = HttpResponse::newHttpResponse();
+            resp->setStatusCode(k400BadRequest);
+            resp->setBody("Missing JSON body for update\n");
+            callback(resp);
+            return;
         }
 
         protoReq.mutable_entry()->set_id(id);
 
-        registadb::Response protoResp = g_regista_server->ExecuteRequest(protoReq);
+        timer.Mark(RequestStage::Parse);
+        registadb::Response& protoResp = *arena.Create<registadb::Response>();
+        g_regista_server->ExecuteRequest(protoReq, &protoResp);
+        timer.Mark(RequestStage::Storage);
 
         auto resp = HttpResponse::newHttpResponse();
         resp->setStatusCode(mapStatus(protoResp.status()));
@@ -208,6 +915,7 @@ namespace api {
         } else {
             resp->setBody(protoResp.message() + "\n");
         }
+        timer.Mark(RequestStage::Serialize);
         callback(resp);
     }
 
@@ -226,11 +934,22 @@ namespace api {
             return;
         }
 
-        registadb::Request protoReq;
+        RequestTimer timer(RequestTunnel::Rest, registadb::OP_DELETE);
+        RequestArena arena;
+        registadb::Request& protoReq = *arena.Create<registadb::Request>();
         protoReq.set_op(registadb::OP_DELETE);
         protoReq.set_id(id);
+        registadb::Durability durability;
+        if (!requestDurability(req, &durability)) {
+            callback(invalidDurabilityResponse());
+            return;
+        }
+        protoReq.set_durability(durability);
 
-        registadb::Response protoResp = g_regista_server->ExecuteRequest(protoReq);
+        timer.Mark(RequestStage::Parse);
+        registadb::Response& protoResp = *arena.Create<registadb::Response>();
+        g_regista_server->ExecuteRequest(protoReq, &protoResp);
+        timer.Mark(RequestStage::Storage);
 
         auto resp = HttpResponse::newHttpResponse();
         
@@ -240,6 +959,7 @@ namespace api {
             resp->setStatusCode(mapStatus(protoResp.status()));
             resp->setBody(protoResp.message() + "\n");
         }
+        timer.Mark(RequestStage::Serialize);
         callback(resp);
     }
 
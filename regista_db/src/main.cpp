@@ -5,8 +5,11 @@
 #include <algorithm>
 #include <pthread.h>
 #include <drogon/drogon.h>
+#include "ConfigParsing.h"
 #include "MetricsExporter.hpp"
-#include "StorageManager.h"
+#include "MemoryStorage.h"
+#include "ShardedStorage.h"
+#include "StorageProfiles.h"
 #include "RegistaServer.h"
 
 std::atomic<bool> keep_running(true);
@@ -34,43 +37,407 @@ int main(int argc, char* argv[]) {
     std::signal(SIGINT, signal_handler);
 
     std::string db_path = "../../data/registadb_store";
+    std::string engine = "rocksdb";
     bool enable_stats = false;
+    ServerConfig server_config;
+    StorageConfig storage_config;
+    std::string ingest_durability = "async";
+    std::string query_durability = "sync";
+    std::string rest_durability = "sync";
 
     // GET OPTIONS
     const char* env_path = std::getenv("REGISTADB_STORE_PATH");
     const char* env_stats = std::getenv("ENABLE_STATS");
+    const char* env_engine = std::getenv("REGISTADB_ENGINE");
+    const char* env_snapshot_path = std::getenv("MEMORY_SNAPSHOT_PATH");
+    const char* env_snapshot_interval = std::getenv("MEMORY_SNAPSHOT_INTERVAL_S");
+    const char* env_batching = std::getenv("INGEST_BATCHING");
+    const char* env_batch_size = std::getenv("INGEST_BATCH_SIZE");
+    const char* env_batch_bytes = std::getenv("INGEST_BATCH_BYTES");
+    const char* env_batch_linger = std::getenv("INGEST_BATCH_LINGER_US");
+    const char* env_ingest_workers = std::getenv("INGEST_WORKERS");
+    const char* env_ingest_cores = std::getenv("INGEST_WORKER_CORES");
+    const char* env_query_workers = std::getenv("QUERY_WORKERS");
+    const char* env_ingest_durability = std::getenv("INGEST_DURABILITY");
+    const char* env_query_durability = std::getenv("QUERY_DURABILITY");
+    const char* env_rest_durability = std::getenv("REST_DURABILITY");
+    const char* env_metadata_indexes = std::getenv("METADATA_INDEXES");
+    const char* env_profile = std::getenv("REGISTADB_PROFILE");
+    const char* env_options_file = std::getenv("REGISTADB_OPTIONS_FILE");
+    const char* env_block_cache_mb = std::getenv("BLOCK_CACHE_MB");
+    const char* env_hyper_clock = std::getenv("BLOCK_CACHE_HYPER_CLOCK");
+    const char* env_entry_cache_mb = std::getenv("ENTRY_CACHE_MB");
+    const char* env_ttl_default = std::getenv("TTL_DEFAULT_S");
+    const char* env_ttl_by_source = std::getenv("TTL_BY_SOURCE");
+    const char* env_entry_ttl = std::getenv("ENABLE_ENTRY_TTL");
+    const char* env_cold_path = std::getenv("COLD_TIER_PATH");
+    const char* env_hot_tier_gb = std::getenv("HOT_TIER_GB");
+    const char* env_blob_min_bytes = std::getenv("BLOB_MIN_BYTES");
+    const char* env_blob_file_mb = std::getenv("BLOB_FILE_MB");
+    const char* env_blob_gc_age_cutoff = std::getenv("BLOB_GC_AGE_CUTOFF");
+    const char* env_blob_gc_force_threshold = std::getenv("BLOB_GC_FORCE_THRESHOLD");
+    const char* env_id_block_size = std::getenv("ID_BLOCK_SIZE");
+    const char* env_shards = std::getenv("STORAGE_SHARDS");
+    const char* env_cdc = std::getenv("ENABLE_CDC");
+    const char* env_cdc_retention = std::getenv("CDC_RETENTION_S");
+    const char* env_rollups = std::getenv("ENABLE_ROLLUPS");
+    const char* env_rollup_1s_retention = std::getenv("ROLLUP_1S_RETENTION_S");
+    const char* env_rollup_1m_retention = std::getenv("ROLLUP_1M_RETENTION_S");
+    const char* env_columnar = std::getenv("COLUMNAR_LISTS");
     
+    // numeric values are parsed strictly, a malformed one stops startup like an unknown durability name
     if (env_path) db_path = env_path;
+    if (env_engine) engine = env_engine;
+    if (env_snapshot_path) storage_config.memory_snapshot_path = env_snapshot_path;
+    if (env_snapshot_interval
+        && !parse_option("MEMORY_SNAPSHOT_INTERVAL_S", env_snapshot_interval, &storage_config.memory_snapshot_interval_seconds)) {
+        return 1;
+    }
     if (env_stats && (std::string(env_stats) == "true" || std::string(env_stats) == "1")) {
         enable_stats = true;
     }
+    if (env_batching && (std::string(env_batching) == "true" || std::string(env_batching) == "1")) {
+        server_config.ingest_batching = true;
+    }
+    if (env_batch_size && !parse_option("INGEST_BATCH_SIZE", env_batch_size, &server_config.ingest_batch_max_entries)) return 1;
+    if (env_batch_bytes && !parse_option("INGEST_BATCH_BYTES", env_batch_bytes, &server_config.ingest_batch_max_bytes)) return 1;
+    if (env_batch_linger && !parse_option("INGEST_BATCH_LINGER_US", env_batch_linger, &server_config.ingest_batch_linger)) return 1;
+    if (env_ingest_workers && !parse_option("INGEST_WORKERS", env_ingest_workers, &server_config.ingest_workers)) return 1;
+    if (env_ingest_cores && !parse_core_list("INGEST_WORKER_CORES", env_ingest_cores, &server_config.ingest_worker_cores)) return 1;
+    if (env_query_workers && !parse_option("QUERY_WORKERS", env_query_workers, &server_config.query_workers)) return 1;
+    if (env_ingest_durability) ingest_durability = env_ingest_durability;
+    if (env_query_durability) query_durability = env_query_durability;
+    if (env_rest_durability) rest_durability = env_rest_durability;
+    if (env_metadata_indexes) storage_config.indexed_metadata_keys = parse_string_list(env_metadata_indexes);
+    if (env_profile) storage_config.profile = env_profile;
+    if (env_options_file) storage_config.options_file = env_options_file;
+    if (env_block_cache_mb && !parse_option("BLOCK_CACHE_MB", env_block_cache_mb, &storage_config.block_cache_bytes, 1024 * 1024)) return 1;
+    if (env_hyper_clock && (std::string(env_hyper_clock) == "true" || std::string(env_hyper_clock) == "1")) {
+        storage_config.hyper_clock_cache = true;
+    }
+    if (env_entry_cache_mb && !parse_option("ENTRY_CACHE_MB", env_entry_cache_mb, &storage_config.entry_cache_bytes, 1024 * 1024)) return 1;
+    if (env_ttl_default && !parse_option("TTL_DEFAULT_S", env_ttl_default, &storage_config.default_ttl_seconds)) return 1;
+    if (env_ttl_by_source && !parse_ttl_map("TTL_BY_SOURCE", env_ttl_by_source, &storage_config.source_ttl_seconds)) return 1;
+    if (env_entry_ttl && (std::string(env_entry_ttl) == "true" || std::string(env_entry_ttl) == "1")) {
+        storage_config.entry_ttl = true;
+    }
+    if (env_cold_path) storage_config.cold_path = env_cold_path;
+    if (env_hot_tier_gb && !parse_option("HOT_TIER_GB", env_hot_tier_gb, &storage_config.hot_tier_bytes, 1024 * 1024 * 1024)) return 1;
+    if (env_blob_min_bytes && !parse_option("BLOB_MIN_BYTES", env_blob_min_bytes, &storage_config.blob_min_bytes)) return 1;
+    if (env_blob_file_mb && !parse_option("BLOB_FILE_MB", env_blob_file_mb, &storage_config.blob_file_bytes, 1024 * 1024)) return 1;
+    if (env_blob_gc_age_cutoff && !parse_option("BLOB_GC_AGE_CUTOFF", env_blob_gc_age_cutoff, &storage_config.blob_gc_age_cutoff)) return 1;
+    if (env_blob_gc_force_threshold
+        && !parse_option("BLOB_GC_FORCE_THRESHOLD", env_blob_gc_force_threshold, &storage_config.blob_gc_force_threshold)) {
+        return 1;
+    }
+    if (env_id_block_size && !parse_option("ID_BLOCK_SIZE", env_id_block_size, &storage_config.id_block_size)) return 1;
+    if (env_shards && !parse_option("STORAGE_SHARDS", env_shards, &storage_config.shards)) return 1;
+    if (env_cdc && (std::string(env_cdc) == "true" || std::string(env_cdc) == "1")) {
+        storage_config.change_log = true;
+    }
+    if (env_cdc_retention && !parse_option("CDC_RETENTION_S", env_cdc_retention, &storage_config.change_log_retention_seconds)) return 1;
+    if (env_rollups && (std::string(env_rollups) == "true" || std::string(env_rollups) == "1")) {
+        storage_config.rollups = true;
+    }
+    if (env_rollup_1s_retention
+        && !parse_option("ROLLUP_1S_RETENTION_S", env_rollup_1s_retention, &storage_config.rollup_second_retention_seconds)) {
+        return 1;
+    }
+    if (env_rollup_1m_retention
+        && !parse_option("ROLLUP_1M_RETENTION_S", env_rollup_1m_retention, &storage_config.rollup_minute_retention_seconds)) {
+        return 1;
+    }
+    if (env_columnar && (std::string(env_columnar) == "true" || std::string(env_columnar) == "1")) {
+        storage_config.columnar_lists = true;
+    }
 
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
         if (arg == "--path" && i + 1 < argc) {
             db_path = argv[++i];
+        } else if (arg == "--engine" && i + 1 < argc) {
+            engine = argv[++i];
+        } else if (arg == "--snapshot-path" && i + 1 < argc) {
+            storage_config.memory_snapshot_path = argv[++i];
+        } else if (arg == "--snapshot-interval-s" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.memory_snapshot_interval_seconds)) return 1;
         } else if (arg == "--stats") {
             enable_stats = true;
         } else if (arg == "--no-stats") {
             enable_stats = false;
+        } else if (arg == "--batch") {
+            server_config.ingest_batching = true;
+        } else if (arg == "--batch-size" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &server_config.ingest_batch_max_entries)) return 1;
+        } else if (arg == "--batch-bytes" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &server_config.ingest_batch_max_bytes)) return 1;
+        } else if (arg == "--batch-linger-us" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &server_config.ingest_batch_linger)) return 1;
+        } else if (arg == "--ingest-workers" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &server_config.ingest_workers)) return 1;
+        } else if (arg == "--ingest-worker-cores" && i + 1 < argc) {
+            if (!parse_core_list(arg, argv[++i], &server_config.ingest_worker_cores)) return 1;
+        } else if (arg == "--query-workers" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &server_config.query_workers)) return 1;
+        } else if (arg == "--ingest-durability" && i + 1 < argc) {
+            ingest_durability = argv[++i];
+        } else if (arg == "--query-durability" && i + 1 < argc) {
+            query_durability = argv[++i];
+        } else if (arg == "--rest-durability" && i + 1 < argc) {
+            rest_durability = argv[++i];
+        } else if (arg == "--index-metadata" && i + 1 < argc) {
+            storage_config.indexed_metadata_keys = parse_string_list(argv[++i]);
+        } else if (arg == "--profile" && i + 1 < argc) {
+            storage_config.profile = argv[++i];
+        } else if (arg == "--options-file" && i + 1 < argc) {
+            storage_config.options_file = argv[++i];
+        } else if (arg == "--block-cache-mb" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.block_cache_bytes, 1024 * 1024)) return 1;
+        } else if (arg == "--hyper-clock-cache") {
+            storage_config.hyper_clock_cache = true;
+        } else if (arg == "--id-block-size" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.id_block_size)) return 1;
+        } else if (arg == "--shards" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.shards)) return 1;
+        } else if (arg == "--entry-cache-mb" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.entry_cache_bytes, 1024 * 1024)) return 1;
+        } else if (arg == "--ttl-default-s" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.default_ttl_seconds)) return 1;
+        } else if (arg == "--ttl-by-source" && i + 1 < argc) {
+            if (!parse_ttl_map(arg, argv[++i], &storage_config.source_ttl_seconds)) return 1;
+        } else if (arg == "--entry-ttl") {
+            storage_config.entry_ttl = true;
+        } else if (arg == "--cold-path" && i + 1 < argc) {
+            storage_config.cold_path = argv[++i];
+        } else if (arg == "--hot-tier-gb" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.hot_tier_bytes, 1024 * 1024 * 1024)) return 1;
+        } else if (arg == "--blob-min-bytes" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.blob_min_bytes)) return 1;
+        } else if (arg == "--blob-file-mb" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.blob_file_bytes, 1024 * 1024)) return 1;
+        } else if (arg == "--blob-gc-age-cutoff" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.blob_gc_age_cutoff)) return 1;
+        } else if (arg == "--blob-gc-force-threshold" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.blob_gc_force_threshold)) return 1;
+        } else if (arg == "--cdc") {
+            storage_config.change_log = true;
+        } else if (arg == "--cdc-retention-s" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.change_log_retention_seconds)) return 1;
+        } else if (arg == "--rollups") {
+            storage_config.rollups = true;
+        } else if (arg == "--rollup-1s-retention-s" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.rollup_second_retention_seconds)) return 1;
+        } else if (arg == "--rollup-1m-retention-s" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &storage_config.rollup_minute_retention_seconds)) return 1;
+        } else if (arg == "--columnar-lists") {
+            storage_config.columnar_lists = true;
         }
     }
 
-    std::cout << "RocksDB Stats: " << (enable_stats ? "ENABLED" : "DISABLED") << std::endl;
-    StorageManager storage(db_path, enable_stats);
+    storage_config.shards = std::max<size_t>(storage_config.shards, 1);
+
+    if (engine != "rocksdb" && engine != "memory") {
+        std::cerr << "[Config] Unknown storage engine '" << engine << "' (expected rocksdb or memory)" << std::endl;
+        return 1;
+    }
+    if (!IsKnownStorageProfile(storage_config.profile)) {
+        std::cerr << "[Config] Unknown storage profile '" << storage_config.profile
+                  << "' (expected balanced, write-heavy, read-heavy or small-entries)" << std::endl;
+        return 1;
+    }
+
+    const std::pair<const std::string*, registadb::Durability*> durabilities[] = {
+        {&ingest_durability, &server_config.ingest_durability},
+        {&query_durability, &server_config.query_durability},
+        {&rest_durability, &server_config.rest_durability},
+    };
+    for (const auto& [name, durability] : durabilities) {
+        if (!RegistaServer::ParseDurability(*name, durability)) {
+            std::cerr << "[Config] Unknown durability '" << *name << "' (expected none, async or sync)" << std::endl;
+            return 1;
+        }
+    }
 
+    std::cout << "Storage Engine: " << engine << std::endl;
+    if (engine == "memory") {
+        std::cout << "Memory Snapshots: ";
+        if (storage_config.memory_snapshot_path.empty()) std::cout << "DISABLED";
+        else std::cout << storage_config.memory_snapshot_path << " every " << storage_config.memory_snapshot_interval_seconds << " s";
+        std::cout << std::endl;
+    } else {
+        std::cout << "RocksDB Stats: " << (enable_stats ? "ENABLED" : "DISABLED") << std::endl;
+        if (storage_config.shards > 1) {
+            std::cout << "Shards: " << storage_config.shards << std::endl;
+        }
+        std::cout << "Storage Profile: " << storage_config.profile;
+        if (!storage_config.options_file.empty()) std::cout << " (options file: " << storage_config.options_file << ")";
+        std::cout << std::endl;
+        if (storage_config.default_ttl_seconds > 0 || !storage_config.source_ttl_seconds.empty() || storage_config.entry_ttl) {
+            std::cout << "TTL: default " << storage_config.default_ttl_seconds << " s, "
+                      << storage_config.source_ttl_seconds.size() << " source override(s)" << std::endl;
+        }
+        if (storage_config.change_log) {
+            std::cout << "Change Data Capture: ENABLED (WAL kept " << storage_config.change_log_retention_seconds << " s)" << std::endl;
+        }
+        if (storage_config.columnar_lists) {
+            std::cout << "Columnar Lists: ENABLED" << std::endl;
+        }
+        if (storage_config.rollups) {
+            std::cout << "Rollups: ENABLED (1 s / 1 min / 1 h per source, 1 s kept "
+                      << storage_config.rollup_second_retention_seconds << " s, 1 min kept "
+                      << storage_config.rollup_minute_retention_seconds << " s)" << std::endl;
+        }
+        if (storage_config.blob_min_bytes > 0) {
+            std::cout << "Blob Files: values >= " << storage_config.blob_min_bytes << " bytes (GC age cutoff "
+                      << storage_config.blob_gc_age_cutoff << ", force threshold " << storage_config.blob_gc_force_threshold
+                      << ")" << std::endl;
+        }
+        if (!storage_config.cold_path.empty()) {
+            std::cout << "Cold Tier: " << storage_config.cold_path << " (hot tier "
+                      << storage_config.hot_tier_bytes / (1024 * 1024 * 1024) << " GiB)" << std::endl;
+        }
+    }
+    if (server_config.ingest_batching) {
+        std::cout << "Ingest Batching: ENABLED (max " << server_config.ingest_batch_max_entries << " entries / "
+                  << server_config.ingest_batch_max_bytes << " bytes / "
+                  << server_config.ingest_batch_linger.count() << " us linger)" << std::endl;
+    }
+    if (engine == "rocksdb") {
+        std::cout << "Durability: ingest " << ingest_durability << ", query " << query_durability
+                  << ", rest " << rest_durability << std::endl;
+    }
+    if (server_config.ingest_workers > 0) {
+        std::cout << "Ingest Workers: " << server_config.ingest_workers << std::endl;
+    }
+    if (server_config.query_workers > 0) {
+        std::cout << "Query Workers: " << server_config.query_workers << std::endl;
+    }
+    if (!storage_config.indexed_metadata_keys.empty()) {
+        std::cout << "Metadata Indexes:";
+        for (const auto& key : storage_config.indexed_metadata_keys) std::cout << " " << key;
+        std::cout << std::endl;
+    }
+    if (engine == "rocksdb" && storage_config.entry_cache_bytes > 0) {
+        std::cout << "Entry Cache: " << storage_config.entry_cache_bytes / (1024 * 1024) << " MiB" << std::endl;
+    }
+
+    std::unique_ptr<StorageBackend> storage;
+    ShardedStorage* rocks_storage = nullptr; // RocksDB specific stats and cache, null for the memory engine
+    if (engine == "memory") {
+        storage.reset(new MemoryStorage(storage_config));
+    } else {
+        rocks_storage = new ShardedStorage(db_path, enable_stats, storage_config);
+        storage.reset(rocks_storage);
+    }
+
+    // polled gauge reading a per-shard RocksDB counter, summed over every shard
+    auto sum_shards = [rocks_storage](auto read) {
+        return [rocks_storage, read]() {
+            double total = 0;
+            for (size_t i = 0; i < rocks_storage->ShardCount(); ++i) {
+                total += static_cast<double>(read(rocks_storage->Shard(i)));
+            }
+            return total;
+        };
+    };
+
+    if (enable_stats && rocks_storage) {
+        const std::pair<const char*, uint64_t IdAllocatorStats::*> id_stats[] = {
+            {"leases", &IdAllocatorStats::leases},
+            {"collisions", &IdAllocatorStats::collisions},
+            {"high_water", &IdAllocatorStats::high_water},
+        };
+        for (const auto& [stat, field] : id_stats) {
+            RegisterPolledGauge("registadb_id_allocator", "Id allocator counters", {{"stat", stat}},
+                                [rocks_storage, field = field]() { return static_cast<double>(rocks_storage->GetIdAllocatorStats().*field); });
+        }
+    }
+
+    if (enable_stats && rocks_storage && rocks_storage->Shard(0).GetEntryCache()) {
+        const std::pair<const char*, uint64_t EntryCacheStats::*> cache_stats[] = {
+            {"hits", &EntryCacheStats::hits},
+            {"misses", &EntryCacheStats::misses},
+            {"evictions", &EntryCacheStats::evictions},
+            {"entries", &EntryCacheStats::entries},
+            {"bytes", &EntryCacheStats::bytes},
+        };
+        for (const auto& [stat, field] : cache_stats) {
+            RegisterPolledGauge("registadb_entry_cache", "Hot-entry cache counters", {{"stat", stat}},
+                                sum_shards([field = field](StorageManager& shard) { return shard.GetEntryCache()->GetStats().*field; }));
+        }
+    }
+
+    if (enable_stats && rocks_storage && rocks_storage->Shard(0).IsTtlEnabled()) {
+        const std::pair<const char*, uint64_t ExpiryStats::*> expiry_stats[] = {
+            {"data", &ExpiryStats::data_expired},
+            {"index", &ExpiryStats::index_expired},
+            {"metadata_index", &ExpiryStats::metadata_index_expired},
+        };
+        for (const auto& [cf, field] : expiry_stats) {
+            RegisterPolledGauge("registadb_ttl_expired", "Records dropped by the TTL compaction filters", {{"cf", cf}},
+                                sum_shards([field = field](StorageManager& shard) { return shard.GetExpiryStats().*field; }));
+        }
+        RegisterPolledGauge("registadb_ttl_expired_bytes", "Entry bytes dropped by the data_cf TTL filter", {},
+                            sum_shards([](StorageManager& shard) { return shard.GetExpiryStats().data_expired_bytes; }));
+    }
+    if (enable_stats && rocks_storage && !storage_config.cold_path.empty()) {
+        const std::pair<const char*, uint64_t TierUsage::*> tier_stats[] = {
+            {"hot", &TierUsage::hot_bytes},
+            {"cold", &TierUsage::cold_bytes},
+        };
+        for (const auto& [tier, field] : tier_stats) {
+            RegisterPolledGauge("registadb_tier_bytes", "data_cf SST bytes per storage tier", {{"tier", tier}},
+                                sum_shards([field = field](StorageManager& shard) { return shard.GetTierUsage().*field; }));
+        }
+        RegisterPolledGauge("registadb_tier_files", "data_cf SST files per storage tier", {{"tier", "cold"}},
+                            sum_shards([](StorageManager& shard) { return shard.GetTierUsage().cold_files; }));
+        RegisterPolledGauge("registadb_tier_files", "data_cf SST files per storage tier", {{"tier", "hot"}},
+                            sum_shards([](StorageManager& shard) { return shard.GetTierUsage().hot_files; }));
+    }
+    if (enable_stats && rocks_storage && storage_config.blob_min_bytes > 0) {
+        const std::pair<const char*, uint64_t BlobUsage::*> blob_stats[] = {
+            {"total", &BlobUsage::bytes},
+            {"live", &BlobUsage::live_bytes},
+            {"garbage", &BlobUsage::garbage_bytes},
+        };
+        for (const auto& [kind, field] : blob_stats) {
+            RegisterPolledGauge("registadb_blob_bytes", "data_cf blob file bytes", {{"kind", kind}},
+                                sum_shards([field = field](StorageManager& shard) { return shard.GetBlobUsage().*field; }));
+        }
+        RegisterPolledGauge("registadb_blob_files", "data_cf blob files", {},
+                            sum_shards([](StorageManager& shard) { return shard.GetBlobUsage().files; }));
+    }
+
+    if (enable_stats && rocks_storage) {
+        const std::pair<const char*, uint64_t WalSyncStats::*> wal_stats[] = {
+            {"syncs", &WalSyncStats::syncs},
+            {"synced_writes", &WalSyncStats::synced_writes},
+        };
+        for (const auto& [stat, field] : wal_stats) {
+            RegisterPolledGauge("registadb_wal_sync", "WAL group sync counters for DURABILITY_SYNC writes", {{"stat", stat}},
+                                sum_shards([field = field](StorageManager& shard) { return shard.GetWalSyncStats().*field; }));
+        }
+    }
+
+    // request metrics are exported for both engines, RocksDB statistics only for rocksdb
     if (enable_stats) {
-        StartMetricsBridge(storage.GetStats());
+        StartMetricsBridge(rocks_storage ? rocks_storage->GetStats() : nullptr);
         std::cout << "Monitoring server active on port 8080" << std::endl;
     }
 
-    RegistaServer server(storage, 5555, 5556);
+    // the change log only exists on the RocksDB engine
+    if (engine == "rocksdb" && storage_config.change_log) {
+        server_config.change_port = 5557;
+    }
+    RegistaServer server(*storage, 5555, 5556, server_config);
     g_regista_server = &server;
 
     unsigned int num_cores = std::thread::hardware_concurrency();
     std::cout << "System detected with " << num_cores << " cores." << std::endl;
     int drogon_thread_count = (num_cores > 1) ? (num_cores - 1) : 1;
     drogon::app().setThreadNum(drogon_thread_count);
+    // room for POST /entries:batch bodies (Drogon's default is 1 MB)
+    drogon::app().setClientMaxBodySize(64 * 1024 * 1024);
 
     std::thread zmq_thread([&server, num_cores]() {
         if (num_cores > 1) {
@@ -81,7 +448,9 @@ int main(int argc, char* argv[]) {
             std::cout << "[Affinity] ZMQ Engine pinned to Core 0" << std::endl;
         }
         std::cout << "RegistaDB Engine Started..." << std::endl;
-        std::cout << "Ingest: 5555 | Query: 5556" << std::endl;
+        std::cout << "Ingest: 5555 | Query: 5556";
+        if (server.GetConfig().change_port > 0) std::cout << " | Changes: " << server.GetConfig().change_port;
+        std::cout << std::endl;
         server.Run();
     });
 
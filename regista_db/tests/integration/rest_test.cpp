@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <filesystem>
 #include <atomic>
+#include <sstream>
 #include <thread>
 #include <cpr/cpr.h>
 #include <cpr/cpr.h>
@@ -171,4 +172,104 @@ TEST_F(RestTest, PutIdOverrideLogic) {
     auto check_999 = cpr::Get(cpr::Url{base_url + "/entries/999"});
     EXPECT_EQ(check_999.status_code, 404) 
         << "Entry 999 should not exist; the override failed if it does.";
-}
\ No newline at end of file
+}
+
+TEST_F(RestTest, PatchMergesMetadataAndKeepsData) {
+    cpr::Post(cpr::Url{base_url + "/entries"},
+              cpr::Body{R"({"id": 150, "metadata": {"source": "sensor"}, "data": {"string_value": "kept"}})"},
+              cpr::Header{{"Content-Type", "application/json"}});
+
+    auto r = cpr::Patch(cpr::Url{base_url + "/entries/150"},
+                        cpr::Body{R"({"metadata": {"location": "rack_4"}})"},
+                        cpr::Header{{"Content-Type", "application/json"}});
+
+    ASSERT_EQ(r.status_code, 200);
+    Json::Value json = parseJson(r.text);
+    EXPECT_EQ(json["metadata"]["source"].asString(), "sensor");
+    EXPECT_EQ(json["metadata"]["location"].asString(), "rack_4");
+    EXPECT_EQ(json["data"]["stringValue"].asString(), "kept");
+
+    auto missing = cpr::Patch(cpr::Url{base_url + "/entries/999998"},
+                              cpr::Body{R"({"metadata": {"location": "rack_4"}})"},
+                              cpr::Header{{"Content-Type", "application/json"}});
+    EXPECT_EQ(missing.status_code, 404);
+}
+
+TEST_F(RestTest, ScanEntriesByTimeRange) {
+    for (int id = 300; id < 305; ++id) {
+        cpr::Post(cpr::Url{base_url + "/entries"},
+                  cpr::Body{R"({"id": )" + std::to_string(id) + R"(, "data": {"int_value": 1}})"},
+                  cpr::Header{{"Content-Type", "application/json"}});
+    }
+
+    auto r = cpr::Get(cpr::Url{base_url + "/entries"},
+                      cpr::Parameters{{"from", "2020-01-01T00:00:00Z"}, {"limit", "3"}});
+
+    ASSERT_EQ(r.status_code, 200);
+    Json::Value json = parseJson(r.text);
+
+    ASSERT_TRUE(json.isMember("entries"));
+    EXPECT_EQ(json["entries"].size(), 3u);
+    // newest first
+    EXPECT_EQ(json["entries"][0]["id"].asString(), "304");
+    ASSERT_FALSE(json["nextCursor"].asString().empty());
+
+    auto next = cpr::Get(cpr::Url{base_url + "/entries"},
+                         cpr::Parameters{{"from", "2020-01-01T00:00:00Z"}, {"limit", "3"},
+                                         {"cursor", json["nextCursor"].asString()}});
+    ASSERT_EQ(next.status_code, 200);
+    Json::Value nextJson = parseJson(next.text);
+    EXPECT_EQ(nextJson["entries"][0]["id"].asString(), "301");
+}
+
+TEST_F(RestTest, BatchCreateNdjson) {
+    std::string body = R"({"id": 500, "data": {"int_value": 1}})" "\n"
+                       "\n"
+                       R"({"metadata": {"source": "batch"}, "data": {"int_value": 2}})" "\n";
+    auto r = cpr::Post(cpr::Url{base_url + "/entries:batch"},
+                       cpr::Body{body},
+                       cpr::Header{{"Content-Type", "application/x-ndjson"}});
+
+    ASSERT_EQ(r.status_code, 201);
+    std::vector<std::string> lines;
+    std::stringstream stream(r.text);
+    for (std::string line; std::getline(stream, line);) lines.push_back(line);
+    ASSERT_EQ(lines.size(), 2u);
+    EXPECT_EQ(parseJson(lines[0])["id"].asString(), "500");
+    Json::Value second = parseJson(lines[1]);
+    ASSERT_TRUE(second.isMember("id")) << "Server should assign an id";
+
+    auto check = cpr::Get(cpr::Url{base_url + "/entries/" + second["id"].asString()});
+    EXPECT_EQ(check.status_code, 200);
+
+    // one bad line rejects the whole batch
+    auto bad = cpr::Post(cpr::Url{base_url + "/entries:batch"},
+                         cpr::Body{std::string(R"({"id": 501})") + "\n{oops\n"},
+                         cpr::Header{{"Content-Type", "application/x-ndjson"}});
+    EXPECT_EQ(bad.status_code, 400);
+    EXPECT_EQ(cpr::Get(cpr::Url{base_url + "/entries/501"}).status_code, 404);
+}
+
+TEST_F(RestTest, ScanRejectsBadCursor) {
+    auto r = cpr::Get(cpr::Url{base_url + "/entries"},
+                      cpr::Parameters{{"cursor", "not-hex"}});
+    EXPECT_EQ(r.status_code, 400);
+}
+
+TEST_F(RestTest, BatchGetReturnsPerIdStatus) {
+    cpr::Post(cpr::Url{base_url + "/entries"},
+              cpr::Body{R"({"id": 400, "data": {"string_value": "batch"}})"},
+              cpr::Header{{"Content-Type", "application/json"}});
+
+    auto r = cpr::Post(cpr::Url{base_url + "/entries:batchGet"},
+                       cpr::Body{R"({"ids": [400, 999999]})"},
+                       cpr::Header{{"Content-Type", "application/json"}});
+
+    ASSERT_EQ(r.status_code, 200);
+    Json::Value json = parseJson(r.text);
+
+    ASSERT_EQ(json["results"].size(), 2u);
+    EXPECT_EQ(json["results"][0]["status"].asString(), "STATUS_OK");
+    EXPECT_EQ(json["results"][0]["entry"]["data"]["stringValue"].asString(), "batch");
+    EXPECT_EQ(json["results"][1]["status"].asString(), "STATUS_NOT_FOUND");
+}
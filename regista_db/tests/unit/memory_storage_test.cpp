@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "MemoryStorage.h"
+
+namespace fs = std::filesystem;
+
+class MemoryStorageTest : public ::testing::Test {
+protected:
+    std::string snapshot_path = "./test_memory_snapshot.bin";
+
+    void SetUp() override {
+        fs::remove(snapshot_path);
+    }
+
+    void TearDown() override {
+        fs::remove(snapshot_path);
+        fs::remove(snapshot_path + ".tmp");
+    }
+
+    static registadb::Entry MakeEntry(uint64_t id, uint64_t created_ms, const std::string& source) {
+        registadb::Entry obj;
+        obj.set_id(id);
+        obj.mutable_created_at()->set_seconds(created_ms / 1000);
+        obj.mutable_created_at()->set_nanos(static_cast<int32_t>((created_ms % 1000) * 1000000));
+        (*obj.mutable_metadata())["source"] = source;
+        obj.mutable_data()->set_int_value(static_cast<int64_t>(id));
+        return obj;
+    }
+};
+
+// Test point reads, overwrites and deletes
+TEST_F(MemoryStorageTest, CrudById) {
+    MemoryStorage storage;
+    ASSERT_TRUE(storage.StoreEntry(MakeEntry(1, 1000, "a")));
+
+    registadb::Entry retrieved;
+    ASSERT_TRUE(storage.GetEntryById(1, &retrieved));
+    EXPECT_EQ(retrieved.data().int_value(), 1);
+
+    registadb::Entry updated = MakeEntry(1, 1000, "a");
+    updated.mutable_data()->set_int_value(42);
+    ASSERT_TRUE(storage.StoreEntry(updated));
+    ASSERT_TRUE(storage.GetEntryById(1, &retrieved));
+    EXPECT_EQ(retrieved.data().int_value(), 42);
+
+    EXPECT_TRUE(storage.DeleteEntryById(1));
+    EXPECT_FALSE(storage.GetEntryById(1, &retrieved));
+    EXPECT_FALSE(storage.DeleteEntryById(1));
+}
+
+// Test that scans and metadata queries page newest first with the same cursor semantics as RocksDB
+TEST_F(MemoryStorageTest, ScanAndQueryNewestFirst) {
+    StorageConfig config;
+    config.indexed_metadata_keys = {"source"};
+    MemoryStorage storage(config);
+
+    std::vector<registadb::Entry> batch;
+    for (uint64_t i = 1; i <= 10; ++i) {
+        batch.push_back(MakeEntry(i, i, i % 2 == 0 ? "even" : "odd"));
+    }
+    ASSERT_TRUE(storage.StoreEntries(batch));
+
+    // [3ms, 8ms] -> ids 8..3
+    std::vector<registadb::Entry> page;
+    std::string cursor;
+    ASSERT_TRUE(storage.ScanRange(3000, 8000, 4, "", &page, &cursor));
+    ASSERT_EQ(page.size(), 4u);
+    EXPECT_EQ(page.front().id(), 8);
+    EXPECT_EQ(page.back().id(), 5);
+
+    std::vector<registadb::Entry> rest;
+    std::string end_cursor;
+    ASSERT_TRUE(storage.ScanRange(3000, 8000, 4, cursor, &rest, &end_cursor));
+    ASSERT_EQ(rest.size(), 2u);
+    EXPECT_EQ(rest.back().id(), 3);
+    EXPECT_TRUE(end_cursor.empty());
+
+    std::vector<registadb::Entry> evens;
+    ASSERT_TRUE(storage.QueryByMetadata("source", "even", 0, UINT64_MAX, 10, "", &evens, &cursor));
+    ASSERT_EQ(evens.size(), 5u);
+    EXPECT_EQ(evens.front().id(), 10);
+    EXPECT_EQ(evens.back().id(), 2);
+
+    EXPECT_FALSE(storage.QueryByMetadata("location", "x", 0, UINT64_MAX, 10, "", &evens, &cursor));
+}
+
+// Test that a snapshot restores entries and the id counter after a restart
+TEST_F(MemoryStorageTest, SnapshotSurvivesRestart) {
+    StorageConfig config;
+    config.memory_snapshot_path = snapshot_path;
+    config.memory_snapshot_interval_seconds = 0; // only the final snapshot on shutdown
+    {
+        MemoryStorage storage(config);
+        storage.StoreEntry(MakeEntry(7, 1000, "a"));
+        storage.StoreEntry(MakeEntry(9, 2000, "b"));
+    }
+
+    MemoryStorage restored(config);
+    registadb::Entry retrieved;
+    ASSERT_TRUE(restored.GetEntryById(9, &retrieved));
+    EXPECT_EQ(retrieved.metadata().at("source"), "b");
+    EXPECT_EQ(restored.GetNextId(), 10u);
+}
@@ -1,7 +1,15 @@
 #include <gtest/gtest.h>
 #include <filesystem>
 #include <atomic>
+#include <fstream>
+#include <iterator>
+#include <pthread.h>
+#include <sched.h>
+#include <set>
+#include <thread>
+#include <google/protobuf/util/time_util.h>
 #include "RegistaServer.h"
+#include "RequestArena.h"
 #include "StorageManager.h"
 
 namespace fs = std::filesystem;
@@ -39,6 +47,7 @@ public:
     
     // This "lifts" the protected method into public for the test
     using RegistaServer::PrepareEntry; 
+    using RegistaServer::ExecuteRequest;
 };
 
 TEST_F(ServerLogicTest, PrepareEntry) {
@@ -58,4 +67,204 @@ TEST_F(ServerLogicTest, PrepareEntry) {
     ASSERT_NE(obj.created_at().seconds(), 0);
 
     delete server;
-}
\ No newline at end of file
+}
+// Test that requests executed on a RequestArena move the entry into the response and read back intact
+TEST_F(ServerLogicTest, ExecuteRequestOnArena) {
+    RegistaServerTester server(*storage, 0, 0);
+
+    uint64_t id;
+    {
+        RequestArena arena;
+        registadb::Request* req = arena.Create<registadb::Request>();
+        req->set_op(registadb::OP_CREATE);
+        (*req->mutable_entry()->mutable_metadata())["source"] = "arena";
+        req->mutable_entry()->mutable_data()->set_string_value(std::string(100, 'x'));
+        registadb::Response* resp = arena.Create<registadb::Response>();
+        server.ExecuteRequest(*req, resp);
+        ASSERT_EQ(resp->status(), registadb::STATUS_OK);
+        id = resp->entry().id();
+        EXPECT_NE(id, 0u);
+        EXPECT_EQ(resp->entry().metadata().at("source"), "arena");
+    }
+
+    RequestArena arena;
+    registadb::Request* req = arena.Create<registadb::Request>();
+    req->set_op(registadb::OP_READ);
+    req->set_id(id);
+    registadb::Response* resp = arena.Create<registadb::Response>();
+    server.ExecuteRequest(*req, resp);
+    ASSERT_EQ(resp->status(), registadb::STATUS_OK);
+    EXPECT_EQ(resp->entry().data().string_value(), std::string(100, 'x'));
+}
+
+TEST_F(ServerLogicTest, IngestWorkerPoolStoresEntries) {
+    ServerConfig config;
+    config.ingest_workers = 2;
+    config.ingest_batching = true;
+    RegistaServer server(*storage, 15555, 15556, config);
+    std::thread server_thread([&server]() { server.Run(); });
+
+    zmq::context_t ctx(1);
+    zmq::socket_t push(ctx, zmq::socket_type::push);
+    push.connect("tcp://localhost:15555");
+
+    const int count = 100;
+    for (int i = 1; i <= count; ++i) {
+        registadb::Entry entry;
+        entry.set_id(i);
+        entry.mutable_data()->set_int_value(i);
+        push.send(zmq::buffer(entry.SerializeAsString()), zmq::send_flags::none);
+    }
+
+    // workers commit asynchronously and in any order across workers, wait for every entry to land
+    auto all_stored = [&]() {
+        registadb::Entry retrieved;
+        for (int i = 1; i <= count; ++i) {
+            if (!storage->GetEntryById(i, &retrieved)) return false;
+        }
+        return true;
+    };
+    for (int attempt = 0; attempt < 50 && !all_stored(); ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    server.Stop();
+    server_thread.join();
+    push.close();
+
+    for (int i = 1; i <= count; ++i) {
+        registadb::Entry retrieved;
+        ASSERT_TRUE(storage->GetEntryById(i, &retrieved)) << "missing entry " << i;
+        EXPECT_EQ(retrieved.data().int_value(), i);
+    }
+}
+
+// Reads the CPU count of every thread of this process whose name starts with prefix
+static std::vector<int> ThreadCpuCounts(const std::string& prefix) {
+    std::vector<int> counts;
+    for (const auto& task : fs::directory_iterator("/proc/self/task")) {
+        std::string name;
+        std::getline(std::ifstream(task.path() / "comm"), name);
+        if (name.rfind(prefix, 0) != 0) continue;
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        if (sched_getaffinity(std::stoi(task.path().filename().string()), sizeof(cpu_set_t), &cpuset) == 0) {
+            counts.push_back(CPU_COUNT(&cpuset));
+        }
+    }
+    return counts;
+}
+
+// main.cpp pins the poll loop to core 0, unpinned ingest and query workers must not inherit that mask
+TEST_F(ServerLogicTest, WorkersDoNotInheritPollLoopCore) {
+    cpu_set_t process_cpus;
+    CPU_ZERO(&process_cpus);
+    ASSERT_EQ(sched_getaffinity(0, sizeof(cpu_set_t), &process_cpus), 0);
+    if (CPU_COUNT(&process_cpus) < 2) GTEST_SKIP() << "needs at least two CPUs";
+
+    ServerConfig config;
+    config.ingest_workers = 2;
+    config.query_workers = 2;
+    RegistaServer server(*storage, 15555, 15556, config);
+    std::thread server_thread([&server]() {
+        cpu_set_t core0;
+        CPU_ZERO(&core0);
+        CPU_SET(0, &core0);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &core0);
+        server.Run();
+    });
+
+    std::vector<int> ingest_counts;
+    std::vector<int> query_counts;
+    for (int attempt = 0; attempt < 50 && (ingest_counts.size() < 2 || query_counts.size() < 2); ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ingest_counts = ThreadCpuCounts("rdb-ingest-");
+        query_counts = ThreadCpuCounts("rdb-query-");
+    }
+
+    server.Stop();
+    server_thread.join();
+
+    ASSERT_EQ(ingest_counts.size(), 2u);
+    ASSERT_EQ(query_counts.size(), 2u);
+    for (int count : ingest_counts) {
+        EXPECT_EQ(count, CPU_COUNT(&process_cpus));
+    }
+    for (int count : query_counts) {
+        EXPECT_EQ(count, CPU_COUNT(&process_cpus));
+    }
+}
+
+TEST_F(ServerLogicTest, PipelinedQueriesMatchByCorrelationId) {
+    ServerConfig config;
+    config.query_workers = 4;
+    RegistaServer server(*storage, 15557, 15558, config);
+    std::thread server_thread([&server]() { server.Run(); });
+
+    zmq::context_t ctx(1);
+    zmq::socket_t dealer(ctx, zmq::socket_type::dealer);
+    dealer.connect("tcp://localhost:15558");
+
+    // send every request before reading any reply
+    const int count = 20;
+    for (int i = 1; i <= count; ++i) {
+        registadb::Request req;
+        req.set_op(registadb::OP_CREATE);
+        req.set_correlation_id(1000 + i);
+        req.mutable_entry()->set_id(i);
+        req.mutable_entry()->mutable_data()->set_int_value(i);
+        dealer.send(zmq::message_t(), zmq::send_flags::sndmore);
+        dealer.send(zmq::buffer(req.SerializeAsString()), zmq::send_flags::none);
+    }
+
+    std::set<uint64_t> seen;
+    dealer.set(zmq::sockopt::rcvtimeo, 5000);
+    for (int i = 0; i < count; ++i) {
+        std::vector<zmq::message_t> frames;
+        ASSERT_TRUE(zmq::recv_multipart(dealer, std::back_inserter(frames)));
+        ASSERT_EQ(frames.size(), 2u);
+
+        registadb::Response resp;
+        ASSERT_TRUE(resp.ParseFromArray(frames[1].data(), frames[1].size()));
+        EXPECT_EQ(resp.status(), registadb::STATUS_OK);
+        // replies may arrive out of order, but each must carry its request's id
+        EXPECT_EQ(resp.correlation_id(), 1000 + resp.entry().id());
+        seen.insert(resp.correlation_id());
+    }
+    EXPECT_EQ(seen.size(), static_cast<size_t>(count));
+
+    server.Stop();
+    server_thread.join();
+    dealer.close();
+}
+
+// Test that OP_AGGREGATE returns per-minute buckets for the requested range and source only
+TEST_F(ServerLogicTest, AggregateReturnsDownsampledBuckets) {
+    RegistaServerTester server(*storage, 0, 0);
+
+    const int64_t base_us = 1699999980000000LL; // on a minute boundary
+    for (int i = 0; i < 180; ++i) {
+        registadb::Entry entry;
+        entry.set_id(i + 1);
+        *entry.mutable_created_at() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(base_us + i * 1000000LL);
+        (*entry.mutable_metadata())["source"] = i % 2 == 0 ? "even" : "odd";
+        entry.mutable_data()->set_int_value(i);
+        ASSERT_TRUE(storage->StoreEntry(entry));
+    }
+
+    registadb::Request req;
+    req.set_op(registadb::OP_AGGREGATE);
+    req.mutable_aggregate()->set_bucket_width_ms(60 * 1000);
+    req.mutable_metadata()->set_key("source");
+    req.mutable_metadata()->set_value("even");
+    *req.mutable_scan()->mutable_from() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(base_us);
+    *req.mutable_scan()->mutable_to() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(base_us + 119 * 1000000LL);
+
+    registadb::Response resp = server.ExecuteRequest(req);
+    ASSERT_EQ(resp.status(), registadb::STATUS_OK);
+    ASSERT_EQ(resp.buckets_size(), 2);
+    EXPECT_EQ(resp.buckets(0).count(), 30u);
+    EXPECT_DOUBLE_EQ(resp.buckets(0).min(), 0);
+    EXPECT_DOUBLE_EQ(resp.buckets(0).max(), 58);
+    EXPECT_DOUBLE_EQ(resp.buckets(1).avg(), 89);
+}
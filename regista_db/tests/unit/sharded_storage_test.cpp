@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <set>
+#include <thread>
+#include "ShardedStorage.h"
+
+namespace fs = std::filesystem;
+
+class ShardedStorageTest : public ::testing::Test {
+protected:
+    std::string test_path = "./test_sharded_sandbox";
+
+    void SetUp() override {
+        fs::remove_all(test_path);
+    }
+
+    void TearDown() override {
+        fs::remove_all(test_path);
+    }
+
+    static StorageConfig ShardedConfig(size_t shards) {
+        StorageConfig config;
+        config.shards = shards;
+        config.indexed_metadata_keys = {"source"};
+        return config;
+    }
+
+    static registadb::Entry MakeEntry(uint64_t id, uint64_t created_ms, const std::string& source) {
+        registadb::Entry obj;
+        obj.set_id(id);
+        obj.mutable_created_at()->set_seconds(created_ms / 1000);
+        obj.mutable_created_at()->set_nanos(static_cast<int32_t>((created_ms % 1000) * 1000000));
+        (*obj.mutable_metadata())["source"] = source;
+        obj.mutable_data()->set_int_value(static_cast<int64_t>(id));
+        return obj;
+    }
+};
+
+// Test that writes are routed by id hash and point and batched reads find them in their shard
+TEST_F(ShardedStorageTest, RoutesByIdAcrossShards) {
+    ShardedStorage storage(test_path, false, ShardedConfig(4));
+    ASSERT_EQ(storage.ShardCount(), 4u);
+    EXPECT_TRUE(fs::exists(fs::path(test_path) / "shard_3"));
+
+    std::vector<registadb::Entry> batch;
+    for (uint64_t id = 1; id <= 200; ++id) {
+        batch.push_back(MakeEntry(id, id, "a"));
+    }
+    ASSERT_TRUE(storage.StoreEntries(batch));
+
+    std::vector<size_t> per_shard(4, 0);
+    for (uint64_t id = 1; id <= 200; ++id) {
+        registadb::Entry retrieved;
+        ASSERT_TRUE(storage.GetEntryById(id, &retrieved));
+        EXPECT_EQ(retrieved.data().int_value(), static_cast<int64_t>(id));
+        ASSERT_TRUE(storage.Shard(storage.ShardFor(id)).GetEntryById(id, &retrieved));
+        per_shard[storage.ShardFor(id)]++;
+    }
+    for (size_t count : per_shard) {
+        EXPECT_GT(count, 20u);
+    }
+
+    std::vector<registadb::Entry> entries;
+    std::vector<bool> found;
+    storage.GetEntriesByIds({7, 999, 150, 3}, &entries, &found);
+    ASSERT_EQ(found, (std::vector<bool>{true, false, true, true}));
+    EXPECT_EQ(entries[0].id(), 7u);
+    EXPECT_EQ(entries[2].id(), 150u);
+    EXPECT_EQ(entries[3].id(), 3u);
+
+    ASSERT_TRUE(storage.DeleteEntryById(150));
+    registadb::Entry retrieved;
+    EXPECT_FALSE(storage.GetEntryById(150, &retrieved));
+}
+
+// Test that groups stored concurrently are fanned out to the shard writers and every part lands
+TEST_F(ShardedStorageTest, ConcurrentGroupsReachEveryShard) {
+    ShardedStorage storage(test_path, false, ShardedConfig(3));
+
+    const uint64_t per_thread = 200;
+    std::vector<std::thread> writers;
+    std::atomic<bool> all_ok{true};
+    for (uint64_t t = 0; t < 4; ++t) {
+        writers.emplace_back([&storage, &all_ok, t, per_thread]() {
+            std::vector<registadb::Entry> batch;
+            for (uint64_t id = t * per_thread + 1; id <= (t + 1) * per_thread; ++id) {
+                batch.push_back(MakeEntry(id, id, "a"));
+                if (batch.size() == 25) {
+                    if (!storage.StoreEntries(batch)) all_ok = false;
+                    batch.clear();
+                }
+            }
+        });
+    }
+    for (auto& writer : writers) writer.join();
+    ASSERT_TRUE(all_ok);
+
+    for (uint64_t id = 1; id <= 4 * per_thread; ++id) {
+        registadb::Entry retrieved;
+        ASSERT_TRUE(storage.Shard(storage.ShardFor(id)).GetEntryById(id, &retrieved)) << "missing entry " << id;
+    }
+}
+
+// Test that scans and metadata queries merge every shard newest first and page without gaps or repeats
+TEST_F(ShardedStorageTest, ScanMergesShardsNewestFirst) {
+    ShardedStorage storage(test_path, false, ShardedConfig(3));
+    std::vector<registadb::Entry> batch;
+    for (uint64_t id = 1; id <= 50; ++id) {
+        batch.push_back(MakeEntry(id, id * 10, id % 2 == 0 ? "even" : "odd"));
+    }
+    ASSERT_TRUE(storage.StoreEntries(batch));
+
+    std::vector<uint64_t> order;
+    std::string cursor;
+    do {
+        std::vector<registadb::Entry> page;
+        std::string next_cursor;
+        ASSERT_TRUE(storage.ScanRange(0, UINT64_MAX, 7, cursor, &page, &next_cursor));
+        ASSERT_LE(page.size(), 7u);
+        for (const auto& entry : page) order.push_back(entry.id());
+        cursor = next_cursor;
+    } while (!cursor.empty());
+
+    ASSERT_EQ(order.size(), 50u);
+    for (size_t i = 0; i < order.size(); ++i) {
+        EXPECT_EQ(order[i], 50 - i);
+    }
+
+    std::vector<registadb::Entry> page;
+    std::string next_cursor;
+    ASSERT_TRUE(storage.QueryByMetadata("source", "even", 0, UINT64_MAX, 5, "", &page, &next_cursor));
+    ASSERT_EQ(page.size(), 5u);
+    EXPECT_EQ(page.front().id(), 50u);
+    EXPECT_EQ(page.back().id(), 42u);
+    EXPECT_FALSE(next_cursor.empty());
+}
+
+// Test that generated ids stay unique across shards and restarts, and the shard count cannot change
+TEST_F(ShardedStorageTest, IdsSurviveReopenAndShardCountIsFixed) {
+    std::set<uint64_t> ids;
+    {
+        ShardedStorage storage(test_path, false, ShardedConfig(2));
+        for (int i = 0; i < 10; ++i) {
+            uint64_t id = storage.GetNextId();
+            ids.insert(id);
+            ASSERT_TRUE(storage.StoreEntry(MakeEntry(id, 1000 + i, "a")));
+        }
+    }
+    EXPECT_EQ(ShardedStorage::ReadShardCount(test_path), 2u);
+    {
+        ShardedStorage storage(test_path, false, ShardedConfig(2));
+        uint64_t id = storage.GetNextId();
+        EXPECT_GT(id, *ids.rbegin());
+    }
+
+    EXPECT_EXIT(ShardedStorage(test_path, false, ShardedConfig(4)), ::testing::ExitedWithCode(EXIT_FAILURE), "");
+}
@@ -1,9 +1,13 @@
 #include <gtest/gtest.h>
 #include <filesystem>
+#include <random>
+#include <set>
 #include <thread>
 #include <chrono>
 #include <google/protobuf/util/time_util.h>
+#include "EntryCodec.h"
 #include "StorageManager.h"
+#include "StorageProfiles.h"
 
 namespace fs = std::filesystem;
 
@@ -145,4 +149,937 @@ TEST_F(StorageTest, RapidIngestionNoCollisions) {
     }
     EXPECT_EQ(found_count, count);
     delete it;
-}
\ No newline at end of file
+}
+// Test that a group commit stores every entry and keeps the id index usable
+TEST_F(StorageTest, StoreEntriesGroupCommit) {
+    google::protobuf::Timestamp now =
+    google::protobuf::util::TimeUtil::GetCurrentTime();
+    std::vector<registadb::Entry> batch(50);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i].set_id(i + 1);
+        batch[i].mutable_created_at()->CopyFrom(now);
+        batch[i].mutable_data()->set_int_value(static_cast<int64_t>(i));
+    }
+
+    ASSERT_TRUE(storage->StoreEntries(batch));
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        registadb::Entry retrieved;
+        ASSERT_TRUE(storage->GetEntryById(i + 1, &retrieved));
+        EXPECT_EQ(retrieved.data().int_value(), static_cast<int64_t>(i));
+    }
+}
+
+// Test that a time-range scan is bounded on both ends, newest first, and pages with a cursor
+TEST_F(StorageTest, ScanRangeBoundsAndCursor) {
+    // entries 1..10 created at t = 1000, 2000, ... 10000 micros
+    for (uint64_t i = 1; i <= 10; ++i) {
+        registadb::Entry obj;
+        obj.set_id(i);
+        obj.mutable_created_at()->set_seconds(0);
+        obj.mutable_created_at()->set_nanos(static_cast<int32_t>(i * 1000 * 1000));
+        storage->StoreEntry(obj);
+    }
+
+    // [3000, 8000] -> ids 8..3, read in pages of 4
+    std::vector<registadb::Entry> page;
+    std::string cursor;
+    ASSERT_TRUE(storage->ScanRange(3000, 8000, 4, "", &page, &cursor));
+    ASSERT_EQ(page.size(), 4u);
+    EXPECT_EQ(page.front().id(), 8);
+    EXPECT_EQ(page.back().id(), 5);
+    ASSERT_FALSE(cursor.empty());
+
+    std::vector<registadb::Entry> rest;
+    std::string end_cursor;
+    ASSERT_TRUE(storage->ScanRange(3000, 8000, 4, cursor, &rest, &end_cursor));
+    ASSERT_EQ(rest.size(), 2u);
+    EXPECT_EQ(rest.front().id(), 4);
+    EXPECT_EQ(rest.back().id(), 3);
+    EXPECT_TRUE(end_cursor.empty());
+
+    // malformed cursor is rejected
+    std::vector<registadb::Entry> ignored;
+    EXPECT_FALSE(storage->ScanRange(3000, 8000, 4, "bad", &ignored, &end_cursor));
+}
+
+// Test that a batched read returns results in request order, with misses flagged
+TEST_F(StorageTest, GetEntriesByIdsKeepsRequestOrder) {
+    google::protobuf::Timestamp now =
+    google::protobuf::util::TimeUtil::GetCurrentTime();
+    for (uint64_t id : {10, 20, 30}) {
+        registadb::Entry obj;
+        obj.set_id(id);
+        obj.mutable_created_at()->CopyFrom(now);
+        obj.mutable_data()->set_int_value(static_cast<int64_t>(id));
+        storage->StoreEntry(obj);
+    }
+
+    std::vector<registadb::Entry> entries;
+    std::vector<bool> found;
+    storage->GetEntriesByIds({30, 99, 10, 20}, &entries, &found);
+
+    ASSERT_EQ(entries.size(), 4u);
+    ASSERT_EQ(found.size(), 4u);
+    EXPECT_TRUE(found[0]);
+    EXPECT_EQ(entries[0].data().int_value(), 30);
+    EXPECT_FALSE(found[1]);
+    EXPECT_TRUE(found[2]);
+    EXPECT_EQ(entries[2].data().int_value(), 10);
+    EXPECT_TRUE(found[3]);
+    EXPECT_EQ(entries[3].data().int_value(), 20);
+}
+
+// Test that a metadata index is backfilled on open and follows overwrites and deletes
+TEST_F(StorageTest, MetadataIndexFollowsWrites) {
+    auto store = [this](uint64_t id, const std::string& source) {
+        registadb::Entry obj;
+        obj.set_id(id);
+        obj.mutable_created_at()->set_nanos(static_cast<int32_t>(id * 1000 * 1000));
+        (*obj.mutable_metadata())["source"] = source;
+        storage->StoreEntry(obj);
+    };
+    store(1, "thermal");
+    store(2, "humidity");
+
+    // reopen with the index declared, existing entries are backfilled
+    delete storage;
+    StorageConfig config;
+    config.indexed_metadata_keys = {"source"};
+    storage = new StorageManagerTester(test_path, false, config);
+    ASSERT_TRUE(storage->IsMetadataIndexed("source"));
+    EXPECT_FALSE(storage->IsMetadataIndexed("location"));
+
+    store(3, "thermal");
+    store(4, "thermal");
+    store(2, "thermal");   // overwrite moves id 2 to the thermal index
+    store(4, "humidity");  // and id 4 away from it
+    storage->DeleteEntryById(3);
+
+    std::vector<registadb::Entry> page;
+    std::string cursor;
+    ASSERT_TRUE(storage->QueryByMetadata("source", "thermal", 0, UINT64_MAX, 10, "", &page, &cursor));
+    ASSERT_EQ(page.size(), 2u);
+    EXPECT_EQ(page[0].id(), 2);
+    EXPECT_EQ(page[1].id(), 1);
+    EXPECT_TRUE(cursor.empty());
+
+    // paging and time bounds
+    std::vector<registadb::Entry> first;
+    ASSERT_TRUE(storage->QueryByMetadata("source", "thermal", 0, UINT64_MAX, 1, "", &first, &cursor));
+    ASSERT_EQ(first.size(), 1u);
+    ASSERT_FALSE(cursor.empty());
+    std::vector<registadb::Entry> second;
+    std::string end_cursor;
+    ASSERT_TRUE(storage->QueryByMetadata("source", "thermal", 0, UINT64_MAX, 1, cursor, &second, &end_cursor));
+    ASSERT_EQ(second.size(), 1u);
+    EXPECT_EQ(second[0].id(), 1);
+
+    std::vector<registadb::Entry> bounded;
+    ASSERT_TRUE(storage->QueryByMetadata("source", "thermal", 1500, UINT64_MAX, 10, "", &bounded, &cursor));
+    ASSERT_EQ(bounded.size(), 1u);
+    EXPECT_EQ(bounded[0].id(), 2);
+
+    std::vector<registadb::Entry> ignored;
+    EXPECT_FALSE(storage->QueryByMetadata("location", "rack_4", 0, UINT64_MAX, 10, "", &ignored, &cursor));
+}
+
+// Test that every tuning profile opens a usable store and unknown profiles are rejected
+TEST_F(StorageTest, TuningProfilesOpenStore) {
+    for (const std::string profile : {"balanced", "write-heavy", "read-heavy", "small-entries"}) {
+        delete storage;
+        fs::remove_all(test_path);
+        StorageConfig config;
+        config.profile = profile;
+        config.hyper_clock_cache = (profile == "read-heavy");
+        storage = new StorageManagerTester(test_path, false, config);
+
+        registadb::Entry obj;
+        obj.set_id(7);
+        obj.mutable_created_at()->set_seconds(1);
+        obj.mutable_data()->set_string_value(profile);
+        ASSERT_TRUE(storage->StoreEntry(obj)) << profile;
+
+        registadb::Entry retrieved;
+        ASSERT_TRUE(storage->GetEntryById(7, &retrieved)) << profile;
+        EXPECT_EQ(retrieved.data().string_value(), profile);
+    }
+
+    StorageConfig bad;
+    bad.profile = "fastest";
+    rocksdb::DBOptions db_options;
+    StorageTuning tuning;
+    EXPECT_FALSE(IsKnownStorageProfile(bad.profile));
+    EXPECT_FALSE(BuildStorageTuning(bad, &db_options, &tuning));
+}
+
+// Test that the entry cache serves repeat reads and never returns a value older than the last write
+TEST_F(StorageTest, EntryCacheInvalidatedByWrites) {
+    delete storage;
+    StorageConfig config;
+    config.entry_cache_bytes = 1 << 20;
+    storage = new StorageManagerTester(test_path, false, config);
+    ASSERT_NE(storage->GetEntryCache(), nullptr);
+
+    registadb::Entry obj;
+    obj.set_id(5);
+    obj.mutable_created_at()->set_seconds(1);
+    obj.mutable_data()->set_int_value(1);
+    ASSERT_TRUE(storage->StoreEntry(obj));
+
+    registadb::Entry retrieved;
+    ASSERT_TRUE(storage->GetEntryById(5, &retrieved)); // miss, fills
+    ASSERT_TRUE(storage->GetEntryById(5, &retrieved)); // hit
+    EntryCacheStats stats = storage->GetEntryCache()->GetStats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.entries, 1u);
+
+    obj.mutable_data()->set_int_value(2);
+    ASSERT_TRUE(storage->StoreEntry(obj));
+    ASSERT_TRUE(storage->GetEntryById(5, &retrieved));
+    EXPECT_EQ(retrieved.data().int_value(), 2);
+
+    ASSERT_TRUE(storage->DeleteEntryById(5));
+    EXPECT_FALSE(storage->GetEntryById(5, &retrieved));
+
+    // a fill that raced with a write is dropped
+    EntryCache cache(1 << 20, 4);
+    std::string value;
+    ASSERT_FALSE(cache.Get(9, &value));
+    cache.Invalidate(9);
+    std::string stale = "stale";
+    cache.Fill(9, &stale);
+    EXPECT_FALSE(cache.Get(9, &value));
+    cache.Fill(9, nullptr);
+}
+
+// Test that expired entries are hidden from every read path once TTLs are enabled
+TEST_F(StorageTest, ExpiredEntriesAreHidden) {
+    delete storage;
+    StorageConfig config;
+    config.source_ttl_seconds = {{"short_lived", 60}};
+    config.indexed_metadata_keys = {"source"};
+    storage = new StorageManagerTester(test_path, false, config);
+    ASSERT_TRUE(storage->IsTtlEnabled());
+
+    google::protobuf::Timestamp old_time = google::protobuf::util::TimeUtil::GetCurrentTime();
+    old_time.set_seconds(old_time.seconds() - 3600);
+
+    registadb::Entry expired;
+    expired.set_id(1);
+    expired.mutable_created_at()->CopyFrom(old_time);
+    (*expired.mutable_metadata())["source"] = "short_lived";
+    registadb::Entry kept = expired;
+    kept.set_id(2);
+    (*kept.mutable_metadata())["source"] = "archive";
+    registadb::Entry own_ttl = kept;
+    own_ttl.set_id(3);
+    own_ttl.set_ttl_seconds(10);
+    ASSERT_TRUE(storage->StoreEntries(std::vector<registadb::Entry>{expired, kept, own_ttl}));
+
+    registadb::Entry retrieved;
+    EXPECT_FALSE(storage->GetEntryById(1, &retrieved));
+    EXPECT_TRUE(storage->GetEntryById(2, &retrieved));
+    EXPECT_FALSE(storage->GetEntryById(3, &retrieved));
+
+    std::vector<registadb::Entry> entries;
+    std::vector<bool> found;
+    storage->GetEntriesByIds({1, 2, 3}, &entries, &found);
+    EXPECT_FALSE(found[0]);
+    EXPECT_TRUE(found[1]);
+    EXPECT_FALSE(found[2]);
+
+    std::vector<registadb::Entry> page;
+    std::string cursor;
+    ASSERT_TRUE(storage->ScanRange(0, UINT64_MAX, 10, "", &page, &cursor));
+    ASSERT_EQ(page.size(), 1u);
+    EXPECT_EQ(page[0].id(), 2);
+
+    std::vector<registadb::Entry> matches;
+    ASSERT_TRUE(storage->QueryByMetadata("source", "short_lived", 0, UINT64_MAX, 10, "", &matches, &cursor));
+    EXPECT_TRUE(matches.empty());
+}
+
+// Test that ids are unique across threads, skip client-supplied ids and never repeat after a restart
+TEST_F(StorageTest, IdAllocatorLeasesAndPersistsHighWater) {
+    const int threads = 8;
+    const int per_thread = 5000;
+    std::vector<std::vector<uint64_t>> allocated(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (int i = 0; i < per_thread; ++i) {
+                allocated[t].push_back(storage->GetNextId());
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    std::set<uint64_t> unique;
+    uint64_t max_id = 0;
+    for (const auto& ids : allocated) {
+        for (uint64_t id : ids) {
+            unique.insert(id);
+            max_id = std::max(max_id, id);
+        }
+    }
+    EXPECT_EQ(unique.size(), static_cast<size_t>(threads * per_thread));
+
+    // a client id beyond everything leased moves generated ids past it, an upsert of a handed-out id changes nothing
+    EXPECT_FALSE(storage->ObserveId(max_id + 5000));
+    uint64_t leased = storage->GetNextId();
+    EXPECT_GT(leased, max_id + 5000);
+    uint64_t leases = storage->GetIdAllocatorStats().leases;
+    EXPECT_FALSE(storage->ObserveId(*unique.begin()));
+    EXPECT_FALSE(storage->ObserveId(leased));
+    EXPECT_EQ(storage->GetIdAllocatorStats().collisions, 0u);
+    EXPECT_EQ(storage->GetNextId(), leased + 1);
+    EXPECT_EQ(storage->GetIdAllocatorStats().leases, leases);
+
+    // an id this thread's lease has yet to hand out is a collision, the lease stops short of it
+    EXPECT_TRUE(storage->ObserveId(leased + 5));
+    EXPECT_EQ(storage->GetIdAllocatorStats().collisions, 1u);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_NE(storage->GetNextId(), leased + 5);
+    }
+
+    // nothing was stored, so only the persisted high-water mark keeps ids from repeating
+    uint64_t last = storage->GetNextId();
+    delete storage;
+    storage = new StorageManagerTester(test_path, false);
+    EXPECT_GT(storage->GetNextId(), last);
+}
+
+// Test that a bulk load ingests new ids as SST files, rewrites existing ones and keeps the secondary index in step
+TEST_F(StorageTest, BulkLoadIngestsSstFiles) {
+    delete storage;
+    StorageConfig config;
+    config.indexed_metadata_keys = {"source"};
+    storage = new StorageManagerTester(test_path, false, config);
+
+    auto make = [](uint64_t id, const std::string& source, const std::string& value) {
+        registadb::Entry obj;
+        obj.set_id(id);
+        obj.mutable_created_at()->set_nanos(static_cast<int32_t>(id * 1000 * 1000));
+        (*obj.mutable_metadata())["source"] = source;
+        obj.mutable_data()->set_string_value(value);
+        return obj;
+    };
+    ASSERT_TRUE(storage->StoreEntry(make(1, "thermal", "stored")));
+
+    // id 1 already exists and is rewritten, the second id 2 wins over the first
+    std::vector<registadb::Entry> entries = {
+        make(2, "thermal", "first"), make(3, "humidity", "new"), make(1, "humidity", "reloaded"), make(2, "thermal", "last")};
+    std::string work_dir = test_path + "/bulk_load_tmp";
+    fs::create_directories(work_dir);
+    BulkLoadStats stats;
+    ASSERT_TRUE(storage->BulkLoad(entries, work_dir, &stats));
+    EXPECT_EQ(stats.ingested, 2u);
+    EXPECT_EQ(stats.rewritten, 1u);
+    EXPECT_EQ(stats.sst_files, 3u);  // index_cf, data_cf and meta_idx_source
+    EXPECT_TRUE(fs::is_empty(work_dir));
+
+    registadb::Entry out;
+    ASSERT_TRUE(storage->GetEntryById(2, &out));
+    EXPECT_EQ(out.data().string_value(), "last");
+    ASSERT_TRUE(storage->GetEntryById(1, &out));
+    EXPECT_EQ(out.data().string_value(), "reloaded");
+
+    std::vector<registadb::Entry> page;
+    std::string cursor;
+    ASSERT_TRUE(storage->ScanRange(0, UINT64_MAX, 10, "", &page, &cursor));
+    ASSERT_EQ(page.size(), 3u);
+    EXPECT_EQ(page[0].id(), 3);
+    ASSERT_TRUE(storage->QueryByMetadata("source", "thermal", 0, UINT64_MAX, 10, "", &page, &cursor));
+    ASSERT_EQ(page.size(), 1u);
+    EXPECT_EQ(page[0].id(), 2);
+    ASSERT_TRUE(storage->QueryByMetadata("source", "humidity", 0, UINT64_MAX, 10, "", &page, &cursor));
+    EXPECT_EQ(page.size(), 2u);
+}
+
+// Test that concurrent merge updates of one entry are applied one after another without losing any
+TEST_F(StorageTest, ConcurrentMergeUpdatesLoseNothing) {
+    delete storage;
+    StorageConfig config;
+    config.indexed_metadata_keys = {"source"};
+    storage = new StorageManagerTester(test_path, false, config);
+
+    registadb::Entry entry;
+    entry.set_id(1);
+    entry.mutable_created_at()->CopyFrom(google::protobuf::util::TimeUtil::GetCurrentTime());
+    (*entry.mutable_metadata())["source"] = "old";
+    entry.mutable_data()->set_string_value("payload");
+    ASSERT_TRUE(storage->StoreEntry(entry));
+
+    const int threads = 8;
+    const int per_thread = 50;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (int i = 0; i < per_thread; ++i) {
+                registadb::Entry patch;
+                patch.set_id(1);
+                (*patch.mutable_metadata())["k" + std::to_string(t) + "_" + std::to_string(i)] = "v";
+                registadb::Entry updated;
+                EXPECT_EQ(storage->UpdateEntry(patch, registadb::UPDATE_MERGE, &updated), registadb::STATUS_OK);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    registadb::Entry patch;
+    patch.set_id(1);
+    (*patch.mutable_metadata())["source"] = "new";
+    registadb::Entry updated;
+    ASSERT_EQ(storage->UpdateEntry(patch, registadb::UPDATE_MERGE, &updated), registadb::STATUS_OK);
+
+    registadb::Entry retrieved;
+    ASSERT_TRUE(storage->GetEntryById(1, &retrieved));
+    EXPECT_EQ(retrieved.metadata_size(), threads * per_thread + 1);
+    EXPECT_EQ(retrieved.data().string_value(), "payload");
+    EXPECT_EQ(retrieved.created_at(), entry.created_at());
+
+    // the metadata index follows the update
+    std::vector<registadb::Entry> matches;
+    std::string cursor;
+    ASSERT_TRUE(storage->QueryByMetadata("source", "old", 0, UINT64_MAX, 10, "", &matches, &cursor));
+    EXPECT_TRUE(matches.empty());
+    ASSERT_TRUE(storage->QueryByMetadata("source", "new", 0, UINT64_MAX, 10, "", &matches, &cursor));
+    EXPECT_EQ(matches.size(), 1u);
+
+    EXPECT_EQ(storage->UpdateEntry(patch, registadb::UPDATE_MERGE, &updated), registadb::STATUS_OK);
+    ASSERT_TRUE(storage->DeleteEntryById(1));
+    EXPECT_EQ(storage->UpdateEntry(patch, registadb::UPDATE_MERGE, &updated), registadb::STATUS_NOT_FOUND);
+}
+
+// Test that concurrent sync writes are all stored and each one is acknowledged by a shared WAL sync
+TEST_F(StorageTest, SyncWritesShareWalSyncs) {
+    const int threads = 8;
+    const int per_thread = 25;
+    google::protobuf::Timestamp now = google::protobuf::util::TimeUtil::GetCurrentTime();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (int i = 0; i < per_thread; ++i) {
+                registadb::Entry entry;
+                entry.set_id(t * per_thread + i + 1);
+                entry.mutable_created_at()->CopyFrom(now);
+                entry.mutable_data()->set_int_value(i);
+                EXPECT_TRUE(storage->StoreEntry(entry, registadb::DURABILITY_SYNC));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    const uint64_t total = threads * per_thread;
+    for (uint64_t id = 1; id <= total; ++id) {
+        registadb::Entry retrieved;
+        EXPECT_TRUE(storage->GetEntryById(id, &retrieved));
+    }
+    WalSyncStats stats = storage->GetWalSyncStats();
+    EXPECT_EQ(stats.synced_writes, total);
+    EXPECT_GE(stats.syncs, 1u);
+    EXPECT_LE(stats.syncs, total);
+
+    // async and WAL-less writes never wait for a sync
+    registadb::Entry entry;
+    entry.set_id(total + 1);
+    entry.mutable_created_at()->CopyFrom(now);
+    ASSERT_TRUE(storage->StoreEntry(entry, registadb::DURABILITY_NONE));
+    ASSERT_TRUE(storage->DeleteEntryById(total + 1, registadb::DURABILITY_ASYNC));
+    EXPECT_EQ(storage->GetWalSyncStats().synced_writes, total);
+}
+
+// Test that committed puts and deletes are read back from the WAL in order, tagged with their source, and resumable
+TEST_F(StorageTest, ChangeLogReplaysCommittedWrites) {
+    std::vector<registadb::ChangeEvent> events;
+    uint64_t next_sequence = 0;
+    bool truncated = false;
+    EXPECT_FALSE(storage->GetChangesSince(0, 0, 100, &events, &next_sequence, &truncated));
+
+    delete storage;
+    StorageConfig config;
+    config.change_log = true;
+    storage = new StorageManagerTester(test_path, false, config);
+    const uint64_t start = storage->LatestChangeSequence(0) + 1;
+
+    google::protobuf::Timestamp now = google::protobuf::util::TimeUtil::GetCurrentTime();
+    auto make = [&](uint64_t id, const std::string& source) {
+        registadb::Entry entry;
+        entry.set_id(id);
+        entry.mutable_created_at()->CopyFrom(now);
+        (*entry.mutable_metadata())["source"] = source;
+        entry.mutable_data()->set_int_value(static_cast<int64_t>(id));
+        return entry;
+    };
+    ASSERT_TRUE(storage->StoreEntry(make(1, "thermal")));
+    ASSERT_TRUE(storage->StoreEntries(std::vector<registadb::Entry>{make(2, "humidity"), make(3, "thermal")},
+                                      registadb::DURABILITY_NONE));
+    ASSERT_TRUE(storage->DeleteEntryById(1));
+
+    ASSERT_TRUE(storage->GetChangesSince(0, start, 100, &events, &next_sequence, &truncated));
+    EXPECT_FALSE(truncated);
+    ASSERT_EQ(events.size(), 4u);
+    EXPECT_EQ(events[0].type(), registadb::CHANGE_PUT);
+    EXPECT_EQ(events[0].id(), 1u);
+    EXPECT_EQ(events[0].source(), "thermal");
+    EXPECT_EQ(events[1].entry().data().int_value(), 2);
+    EXPECT_EQ(events[2].source(), "thermal");
+    EXPECT_EQ(events[3].type(), registadb::CHANGE_DELETE);
+    EXPECT_EQ(events[3].id(), 1u);
+    EXPECT_EQ(events[3].source(), "thermal");
+    for (size_t i = 1; i < events.size(); ++i) {
+        EXPECT_GT(events[i].sequence(), events[i - 1].sequence());
+    }
+    EXPECT_EQ(next_sequence, storage->LatestChangeSequence(0) + 1);
+
+    // resuming inside the group commit skips what was already seen
+    std::vector<registadb::ChangeEvent> resumed;
+    ASSERT_TRUE(storage->GetChangesSince(0, events[1].sequence() + 1, 100, &resumed, &next_sequence, &truncated));
+    ASSERT_EQ(resumed.size(), 2u);
+    EXPECT_EQ(resumed[0].id(), 3u);
+
+    // nothing new
+    resumed.clear();
+    ASSERT_TRUE(storage->GetChangesSince(0, next_sequence, 100, &resumed, &next_sequence, &truncated));
+    EXPECT_TRUE(resumed.empty());
+
+    // an overwrite under a new created_at moves the row, which is one put and no delete
+    registadb::Entry moved = make(3, "thermal");
+    moved.mutable_created_at()->set_seconds(now.seconds() + 60);
+    ASSERT_TRUE(storage->StoreEntry(moved));
+    ASSERT_TRUE(storage->GetChangesSince(0, next_sequence, 100, &resumed, &next_sequence, &truncated));
+    ASSERT_EQ(resumed.size(), 1u);
+    EXPECT_EQ(resumed[0].type(), registadb::CHANGE_PUT);
+    EXPECT_EQ(resumed[0].id(), 3u);
+}
+
+// Test that aggregation buckets numeric values by time, filters on indexed and unindexed keys alike, and caps buckets
+TEST_F(StorageTest, AggregateBucketsNumericValues) {
+    delete storage;
+    StorageConfig config;
+    config.indexed_metadata_keys = {"source"};
+    storage = new StorageManagerTester(test_path, false, config);
+
+    const uint64_t base_us = 1699999980000000ULL; // on a minute boundary
+    auto store = [&](uint64_t id, uint64_t offset_s, const std::string& source, const registadb::EntryValue& value) {
+        registadb::Entry entry;
+        entry.set_id(id);
+        *entry.mutable_created_at() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(base_us + offset_s * 1000000);
+        (*entry.mutable_metadata())["source"] = source;
+        (*entry.mutable_metadata())["site"] = source == "a" ? "north" : "south";
+        *entry.mutable_data() = value;
+        ASSERT_TRUE(storage->StoreEntry(entry));
+    };
+    registadb::EntryValue v;
+    v.set_double_value(1.5);
+    store(1, 0, "a", v);
+    v.set_int_value(4);
+    store(2, 30, "b", v);
+    for (double d : {10.0, -2.0, 3.0, 7.0, 1.0}) v.mutable_double_list()->add_value(d);
+    store(3, 61, "a", v);
+    v.set_string_value("skipped");
+    store(4, 62, "a", v);
+
+    SeriesAggregator all(0, 60 * 1000000ULL, 100);
+    ASSERT_TRUE(storage->Aggregate(0, UINT64_MAX, "", "", &all));
+    std::vector<registadb::AggregateBucket> buckets;
+    all.Finish(&buckets);
+    ASSERT_EQ(buckets.size(), 2u);
+    EXPECT_EQ(google::protobuf::util::TimeUtil::TimestampToMicroseconds(buckets[0].start()), static_cast<int64_t>(base_us));
+    EXPECT_EQ(buckets[0].count(), 2u);
+    EXPECT_DOUBLE_EQ(buckets[0].min(), 1.5);
+    EXPECT_DOUBLE_EQ(buckets[0].max(), 4.0);
+    EXPECT_DOUBLE_EQ(buckets[0].avg(), 2.75);
+    EXPECT_EQ(buckets[1].count(), 5u);
+    EXPECT_EQ(buckets[1].entries(), 1u);
+    EXPECT_DOUBLE_EQ(buckets[1].min(), -2.0);
+    EXPECT_DOUBLE_EQ(buckets[1].max(), 10.0);
+    EXPECT_DOUBLE_EQ(buckets[1].sum(), 19.0);
+
+    // indexed key through the index, unindexed key while streaming, same result
+    for (const auto& [key, value] : {std::pair<std::string, std::string>{"source", "a"}, {"site", "north"}}) {
+        SeriesAggregator filtered(base_us, 0, 100);
+        ASSERT_TRUE(storage->Aggregate(base_us, base_us + 120 * 1000000ULL, key, value, &filtered));
+        buckets.clear();
+        filtered.Finish(&buckets);
+        ASSERT_EQ(buckets.size(), 1u);
+        EXPECT_EQ(buckets[0].count(), 6u);
+        EXPECT_EQ(buckets[0].entries(), 2u);
+    }
+
+    SeriesAggregator capped(0, 1000000ULL, 1);
+    EXPECT_FALSE(storage->Aggregate(0, UINT64_MAX, "", "", &capped));
+    EXPECT_TRUE(capped.Overflowed());
+}
+
+// Test that rollups built on enable and maintained on write give the same buckets as the raw entries, across unaligned edges
+TEST_F(StorageTest, RollupsMatchRawAggregates) {
+    const uint64_t base_us = 1699999200000000ULL; // on an hour boundary
+    auto make = [&](uint64_t id) {
+        registadb::Entry entry;
+        entry.set_id(id);
+        // about 3 hours of readings, 7.3 s apart
+        *entry.mutable_created_at() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(base_us + id * 7300000ULL);
+        (*entry.mutable_metadata())["source"] = id % 3 == 0 ? "a" : "b";
+        entry.mutable_data()->set_int_value(static_cast<int64_t>(id % 17));
+        return entry;
+    };
+    auto aggregate = [&](uint64_t width_us, const std::string& source) {
+        SeriesAggregator out(0, width_us, 10000);
+        const uint64_t from = base_us + 1234567, to = base_us + 10000 * 1000000ULL + 89;
+        EXPECT_TRUE(storage->Aggregate(from, to, source.empty() ? "" : "source", source, &out));
+        std::vector<registadb::AggregateBucket> buckets;
+        out.Finish(&buckets);
+        return buckets;
+    };
+    auto expect_same = [](const std::vector<registadb::AggregateBucket>& a, const std::vector<registadb::AggregateBucket>& b) {
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            EXPECT_EQ(a[i].start().seconds(), b[i].start().seconds());
+            EXPECT_EQ(a[i].count(), b[i].count());
+            EXPECT_DOUBLE_EQ(a[i].sum(), b[i].sum());
+            EXPECT_DOUBLE_EQ(a[i].min(), b[i].min());
+            EXPECT_DOUBLE_EQ(a[i].max(), b[i].max());
+        }
+    };
+
+    StorageConfig raw_config;
+    raw_config.entry_ttl = true;
+    StorageConfig config = raw_config;
+    config.rollups = true;
+    // keep every level, the readings are far older than the default 1 s and 1 min retention
+    config.rollup_second_retention_seconds = 0;
+    config.rollup_minute_retention_seconds = 0;
+    delete storage;
+    storage = new StorageManagerTester(test_path, false, raw_config);
+
+    for (uint64_t id = 1; id <= 1000; ++id) ASSERT_TRUE(storage->StoreEntry(make(id)));
+    auto raw_minutes = aggregate(60 * 1000000ULL, "");
+    auto raw_hours = aggregate(3600 * 1000000ULL, "a");
+    ASSERT_GT(raw_minutes.size(), 100u);
+
+    // enabling rollups on a store with data builds them from the entries
+    delete storage;
+    storage = new StorageManagerTester(test_path, false, config);
+    ASSERT_TRUE(storage->HasRollups());
+    expect_same(aggregate(60 * 1000000ULL, ""), raw_minutes);
+    expect_same(aggregate(3600 * 1000000ULL, "a"), raw_hours);
+
+    // later writes are merged in on the way, ids never stored before are written blind
+    std::vector<registadb::Entry> batch;
+    for (uint64_t id = 1001; id <= 1400; ++id) batch.push_back(make(id));
+    ASSERT_TRUE(storage->StoreEntries(batch, registadb::DURABILITY_DEFAULT, true));
+
+    // overwrites (in place, to another bucket, twice in one group), updates and deletes take the old version back out
+    registadb::Entry overwritten = make(11);
+    overwritten.mutable_data()->set_int_value(1000);
+    ASSERT_TRUE(storage->StoreEntry(overwritten));
+    registadb::Entry moved = make(10);
+    *moved.mutable_created_at() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(base_us + 1800 * 1000000ULL + 17);
+    ASSERT_TRUE(storage->StoreEntry(moved));
+    std::vector<registadb::Entry> twice = {make(1002), make(1002)};
+    twice[1].mutable_data()->set_int_value(-40);
+    ASSERT_TRUE(storage->StoreEntries(twice));
+    registadb::Entry patch;
+    patch.set_id(12);
+    patch.mutable_data()->set_int_value(-5);
+    registadb::Entry updated;
+    ASSERT_EQ(storage->UpdateEntry(patch, registadb::UPDATE_MERGE, &updated), registadb::STATUS_OK);
+    ASSERT_TRUE(storage->DeleteEntryById(13));
+    ASSERT_TRUE(storage->DeleteEntryById(16)); // max of its bucket
+
+    // an expired entry drops out of its buckets, one that has not expired yet stays in
+    std::vector<registadb::Entry> with_ttl = {make(2001), make(2002)};
+    for (auto& entry : with_ttl) {
+        *entry.mutable_created_at() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(base_us + 5000 * 1000000ULL + entry.id());
+        entry.mutable_data()->set_int_value(99);
+    }
+    with_ttl[0].set_ttl_seconds(1);
+    with_ttl[1].set_ttl_seconds(UINT32_MAX);
+    ASSERT_TRUE(storage->StoreEntries(with_ttl));
+
+    auto rolled_up = aggregate(90 * 1000000ULL, "b");
+    auto rolled_up_total = aggregate(0, "");
+    auto rolled_up_minutes = aggregate(60 * 1000000ULL, "");
+    auto rolled_up_hours = aggregate(3600 * 1000000ULL, "a");
+    // the buckets recomputed above were written back and read as stored now
+    expect_same(aggregate(60 * 1000000ULL, ""), rolled_up_minutes);
+    expect_same(aggregate(3600 * 1000000ULL, "a"), rolled_up_hours);
+
+    delete storage;
+    storage = new StorageManagerTester(test_path, false, raw_config);
+    EXPECT_FALSE(storage->HasRollups());
+    expect_same(rolled_up, aggregate(90 * 1000000ULL, "b"));
+    expect_same(rolled_up_total, aggregate(0, ""));
+    expect_same(rolled_up_minutes, aggregate(60 * 1000000ULL, ""));
+    expect_same(rolled_up_hours, aggregate(3600 * 1000000ULL, "a"));
+}
+
+// Test that a source with a NUL byte gets its own rollup buckets instead of bleeding into a shorter source's
+TEST_F(StorageTest, RollupKeysHoldAnySource) {
+    const std::string nul_source("a\0b", 3);
+    rocksdb::Slice source;
+    uint64_t start = 0;
+    ASSERT_TRUE(DecodeRollupKey(EncodeRollupKey(1, nul_source, 120000000), &source, &start));
+    EXPECT_EQ(source.ToString(), nul_source);
+    EXPECT_EQ(start, 120000000u);
+    EXPECT_LT(EncodeRollupKey(1, "a", 120000000), RollupSourceEnd(1, "a"));
+    EXPECT_LT(RollupSourceEnd(1, "a"), EncodeRollupKey(1, nul_source, 0));
+
+    delete storage;
+    StorageConfig config;
+    config.rollups = true;
+    config.rollup_second_retention_seconds = 0;
+    config.rollup_minute_retention_seconds = 0;
+    storage = new StorageManagerTester(test_path, false, config);
+
+    const uint64_t base_us = 1699999200000000ULL; // on an hour boundary
+    std::vector<registadb::Entry> batch;
+    for (uint64_t id = 1; id <= 30; ++id) {
+        registadb::Entry entry;
+        entry.set_id(id);
+        *entry.mutable_created_at() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(base_us + id * 60000000ULL);
+        (*entry.mutable_metadata())["source"] = id % 2 == 0 ? "a" : nul_source;
+        entry.mutable_data()->set_int_value(static_cast<int64_t>(id));
+        batch.push_back(entry);
+    }
+    ASSERT_TRUE(storage->StoreEntries(batch));
+
+    auto total = [&](const std::string& key, const std::string& value) {
+        SeriesAggregator out(0, 3600000000ULL, 10);
+        EXPECT_TRUE(storage->Aggregate(base_us, base_us + 3600000000ULL - 1, key, value, &out));
+        std::vector<registadb::AggregateBucket> buckets;
+        out.Finish(&buckets);
+        return buckets.empty() ? registadb::AggregateBucket() : buckets[0];
+    };
+    EXPECT_EQ(total("source", "a").count(), 15u);
+    EXPECT_DOUBLE_EQ(total("source", "a").sum(), 240);
+    EXPECT_EQ(total("source", nul_source).count(), 15u);
+    EXPECT_DOUBLE_EQ(total("source", nul_source).sum(), 225);
+    EXPECT_EQ(total("", "").count(), 30u);
+}
+
+// Test that retracting a value inside a bucket's range corrects it in place, and only retracting its min or max makes it stale
+TEST_F(StorageTest, RollupRetractionOnlyStalesExtremes) {
+    RollupBucket bucket;
+    for (double v : {1.0, 5.0, 9.0}) {
+        RollupBucket added;
+        added.acc.Add(v);
+        bucket.Merge(added);
+    }
+    auto retract = [](double v) {
+        RollupBucket operand;
+        operand.acc.Add(v);
+        operand.Retract();
+        return operand;
+    };
+    const uint64_t now = TtlPolicy::NowMicros();
+    bucket.Merge(retract(5));
+    EXPECT_TRUE(bucket.Servable(now));
+    EXPECT_EQ(bucket.acc.count, 2u);
+    EXPECT_DOUBLE_EQ(bucket.acc.sum, 10);
+
+    // the encoded value keeps the retracted range, so the merge operator reaches the same verdict
+    std::string value;
+    EncodeRollupValue(bucket, &value);
+    RollupBucket decoded;
+    ASSERT_TRUE(DecodeRollupValue(value, &decoded));
+    decoded.Merge(retract(9));
+    EXPECT_FALSE(decoded.Servable(now));
+}
+
+// Test that rollup buckets past their level's retention, or whose entries all expired, are dropped by compaction
+TEST_F(StorageTest, RollupRetentionFilterDropsOldBuckets) {
+    const uint64_t now = TtlPolicy::NowMicros();
+    const uint64_t day = 24ULL * 3600 * 1000000;
+    RollupRetentionFilter filter({0, 0, day});
+    auto decide = [&](size_t level, uint64_t start, uint64_t last_expiry) {
+        RollupBucket bucket;
+        bucket.acc.Add(1);
+        bucket.first_expiry = bucket.last_expiry = last_expiry;
+        std::string value;
+        EncodeRollupValue(bucket, &value);
+        std::string new_value, skip_until;
+        return filter.FilterV2(0, EncodeRollupKey(level, "a", start), rocksdb::CompactionFilter::ValueType::kMergeOperand,
+                               value, &new_value, &skip_until);
+    };
+    using Decision = rocksdb::CompactionFilter::Decision;
+    EXPECT_EQ(decide(2, now - 2 * day, TtlPolicy::kNever), Decision::kRemove);
+    EXPECT_EQ(decide(2, now - day / 2, TtlPolicy::kNever), Decision::kKeep);
+    EXPECT_EQ(decide(0, now - 30 * day, TtlPolicy::kNever), Decision::kKeep);
+    EXPECT_EQ(decide(0, now - 30 * day, now - 1), Decision::kRemove);
+}
+
+// Test that numeric lists stored as columns read back unchanged through every read path, also after turning columns off
+TEST_F(StorageTest, ColumnarListsReadBackUnchanged) {
+    delete storage;
+    StorageConfig config;
+    config.columnar_lists = true;
+    storage = new StorageManagerTester(test_path, false, config);
+
+    const uint64_t base_us = 1700000000000000ULL;
+    std::vector<registadb::Entry> entries(4);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i].set_id(i + 1);
+        *entries[i].mutable_created_at() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(base_us + i);
+        (*entries[i].mutable_metadata())["source"] = "array";
+    }
+    for (int i = 0; i < 300; ++i) {
+        entries[0].mutable_data()->mutable_double_list()->add_value(20.0 + (i % 37) * 0.25);        // decimals
+        entries[1].mutable_data()->mutable_double_list()->add_value((i / 10) / 3.0);                 // XOR
+        entries[2].mutable_data()->mutable_int_list()->add_value(1700000000000LL + i * 1000 - i % 3); // delta-of-delta
+    }
+    entries[3].mutable_data()->mutable_int_list()->add_value(7); // too short, stays protobuf
+    ASSERT_TRUE(storage->StoreEntries(entries));
+
+    // everything but the short list is packed
+    size_t columnar = 0;
+    auto it = storage->GetRawDataIterator();
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (it->value()[0] == kColumnarMarker) columnar++;
+    }
+    delete it;
+    EXPECT_EQ(columnar, 3u);
+
+    auto expect_all = [&]() {
+        for (const auto& entry : entries) {
+            registadb::Entry retrieved;
+            ASSERT_TRUE(storage->GetEntryById(entry.id(), &retrieved));
+            EXPECT_EQ(retrieved.SerializeAsString(), entry.SerializeAsString());
+        }
+        std::vector<registadb::Entry> page;
+        std::string next_cursor;
+        ASSERT_TRUE(storage->ScanRange(0, UINT64_MAX, 10, "", &page, &next_cursor));
+        ASSERT_EQ(page.size(), entries.size());
+        EXPECT_EQ(page.back().SerializeAsString(), entries[0].SerializeAsString());
+    };
+    expect_all();
+
+    delete storage;
+    storage = new StorageManagerTester(test_path, false);
+    expect_all();
+}
+
+// Test that a large value ahead of values needing more decimals is not scaled out of range and lost
+TEST_F(StorageTest, ColumnarMixedMagnitudesReadBackUnchanged) {
+    registadb::Entry entry;
+    entry.set_id(1);
+    auto* list = entry.mutable_data()->mutable_double_list();
+    list->add_value(5e14);
+    for (int i = 0; i < 40; ++i) list->add_value((1 + i % 3) / 10000.0);
+    EXPECT_EQ(FindDecimalScale(list->value().data(), list->value_size()), -1);
+
+    std::string stored;
+    EncodeStoredEntry(entry, true, &stored);
+    registadb::Entry decoded;
+    ASSERT_TRUE(DecodeStoredEntry(stored.data(), stored.size(), &decoded));
+    EXPECT_EQ(decoded.SerializeAsString(), entry.SerializeAsString());
+}
+
+// Test that short int columns (16-130 values, around the block boundary) round-trip and pack near the width of their second differences
+TEST_F(StorageTest, ShortIntColumnsPackTightly) {
+    std::mt19937_64 rng(3);
+    for (size_t n : {16, 17, 64, 128, 129, 130}) {
+        // millisecond timestamps about a second apart, jitter within +-3
+        std::vector<int64_t> values(n);
+        int64_t ms = 1700000000000LL;
+        for (auto& value : values) value = ms += 1000 + static_cast<int64_t>(rng() % 7) - 3;
+        std::string packed;
+        EncodeIntColumn(values.data(), n, &packed);
+        // two varints of at most 6 and 2 bytes, then 4-bit second differences
+        EXPECT_LE(packed.size(), 8 + (n + kColumnarIntBlock - 1) / kColumnarIntBlock + (n * 4 + 7) / 8) << n;
+        std::vector<int64_t> decoded(n);
+        ASSERT_TRUE(DecodeIntColumn(packed.data(), packed.size(), n, decoded.data())) << n;
+        EXPECT_EQ(decoded, values) << n;
+        EXPECT_FALSE(DecodeIntColumn(packed.data(), packed.size() - 1, n, decoded.data())) << n;
+    }
+
+    // differences that wrap around
+    std::vector<int64_t> extremes = {INT64_MAX, INT64_MIN, 0, -1, INT64_MAX, 1, INT64_MIN, INT64_MIN};
+    std::string packed;
+    EncodeIntColumn(extremes.data(), extremes.size(), &packed);
+    std::vector<int64_t> decoded(extremes.size());
+    ASSERT_TRUE(DecodeIntColumn(packed.data(), packed.size(), extremes.size(), decoded.data()));
+    EXPECT_EQ(decoded, extremes);
+}
+
+// Test that large values are separated into blob files and still read back, before and after compaction
+TEST_F(StorageTest, LargeValuesGoToBlobFiles) {
+    delete storage;
+    StorageConfig config;
+    config.blob_min_bytes = 1024;
+    storage = new StorageManagerTester(test_path, false, config);
+
+    std::mt19937_64 rng(7);
+    auto random_bytes = [&rng]() {
+        std::string bytes(64 * 1024, '\0');
+        for (char& b : bytes) b = static_cast<char>(rng());
+        return bytes;
+    };
+    registadb::Entry large;
+    large.set_id(1);
+    large.mutable_data()->set_bytes_value(random_bytes());
+    registadb::Entry small;
+    small.set_id(2);
+    small.mutable_data()->set_double_value(21.5);
+    ASSERT_TRUE(storage->StoreEntry(large));
+    ASSERT_TRUE(storage->StoreEntry(small));
+    ASSERT_TRUE(storage->CompactDataCF());
+
+    BlobUsage usage = storage->GetBlobUsage();
+    EXPECT_GE(usage.files, 1u);
+    EXPECT_GE(usage.bytes, 64u * 1024); // random bytes do not compress
+    registadb::Entry retrieved;
+    ASSERT_TRUE(storage->GetEntryById(1, &retrieved));
+    EXPECT_EQ(retrieved.data().bytes_value(), large.data().bytes_value());
+    ASSERT_TRUE(storage->GetEntryById(2, &retrieved));
+    EXPECT_DOUBLE_EQ(retrieved.data().double_value(), 21.5);
+
+    // the overwritten blob becomes garbage, the new one is read
+    large.mutable_data()->set_bytes_value(random_bytes());
+    ASSERT_TRUE(storage->StoreEntry(large));
+    ASSERT_TRUE(storage->CompactDataCF());
+    ASSERT_TRUE(storage->GetEntryById(1, &retrieved));
+    EXPECT_EQ(retrieved.data().bytes_value(), large.data().bytes_value());
+}
+
+// Test that the small-entries profile writes dictionary compressed data_cf files and a sample reads back stored values
+TEST_F(StorageTest, SmallEntriesProfileTrainsDictionary) {
+    delete storage;
+    StorageConfig config;
+    config.profile = "small-entries";
+    storage = new StorageManagerTester(test_path, false, config);
+
+    std::vector<registadb::Entry> batch;
+    for (int64_t id = 1; id <= 5000; ++id) {
+        registadb::Entry obj;
+        obj.set_id(id);
+        obj.mutable_created_at()->set_seconds(1700000000 + id);
+        (*obj.mutable_metadata())["source"] = "sensor-" + std::to_string(id % 8);
+        obj.mutable_data()->set_double_value(20.0 + static_cast<double>(id % 100) / 10.0);
+        batch.push_back(obj);
+    }
+    ASSERT_TRUE(storage->StoreEntries(batch));
+    ASSERT_TRUE(storage->CompactDataCF());
+
+    DataCompression usage = storage->GetDataCompression();
+    EXPECT_GE(usage.files, 1u);
+    EXPECT_EQ(usage.dict_files, usage.files);
+    EXPECT_EQ(usage.entries, 5000u);
+    EXPECT_LT(usage.data_bytes, usage.raw_bytes);
+
+    std::vector<std::string> values;
+    ASSERT_TRUE(storage->SampleStoredValues(100, &values));
+    ASSERT_FALSE(values.empty());
+    EXPECT_LE(values.size(), 100u);
+    registadb::Entry decoded;
+    EXPECT_TRUE(DecodeStoredEntry(values.front(), &decoded));
+    EXPECT_EQ(decoded.metadata().at("source").compare(0, 7, "sensor-"), 0);
+}
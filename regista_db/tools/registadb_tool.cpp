@@ -0,0 +1,535 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <zdict.h>
+#include <zstd.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
+#include <google/protobuf/util/json_util.h>
+#include <google/protobuf/util/time_util.h>
+#include "ConfigParsing.h"
+#include "ShardedStorage.h"
+#include "StorageProfiles.h"
+#include "playbook.pb.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Everything the commands accept; storage options must match the engine that owns the store
+struct ToolOptions {
+    std::string command;
+    std::string db_path = "/app/data/regista_store";
+    std::string file = "-";
+    std::string format = "protobuf";
+    size_t chunk = 100000;
+    uint64_t from_ts = 0;
+    uint64_t to_ts = UINT64_MAX;
+    size_t sample = 20000;
+    bool compact = false;
+    StorageConfig storage_config;
+};
+
+/**
+ * @brief Prints the command line usage.
+ */
+void print_usage() {
+    std::cerr << "Usage:\n"
+              << "  registadb_tool bulk-load --path DIR [--input FILE|-] [--format protobuf|ndjson] [--chunk N]\n"
+              << "                           [--index-metadata k1,k2] [--ttl-default-s N] [--ttl-by-source s=N,...] [--entry-ttl]\n"
+              << "                           [--rollups] [--rollup-1s-retention-s N] [--rollup-1m-retention-s N] [--columnar-lists]\n"
+              << "  registadb_tool export --path DIR [--output FILE|-] [--format protobuf|ndjson] [--from T] [--to T]\n"
+              << "  registadb_tool compression-report --path DIR [--sample N] [--profile NAME] [--compact]\n"
+              << "Pass --rollups when the engine runs with them, a store opened without drops its rollups.\n"
+              << "--shards N only for a new store, an existing one is opened with the count it was created with.\n"
+              << "compression-report --compact rewrites data_cf under --profile (e.g. small-entries) and reports it again.\n"
+              << "T is microseconds since epoch or RFC 3339. protobuf is length-delimited Entry messages.\n"
+              << "The engine must be stopped; storage flags default to the same env vars the engine reads." << std::endl;
+}
+
+/**
+ * @brief Parses a time argument, either microseconds since epoch or an RFC 3339 timestamp.
+ *
+ * @param value The argument value.
+ * @param out_micros Output for the parsed time in microseconds since epoch.
+ * @return true if the value could be parsed.
+ * @return false otherwise.
+ */
+bool parse_time(const std::string& value, uint64_t* out_micros) {
+    if (!value.empty() && std::all_of(value.begin(), value.end(), ::isdigit)) {
+        return parse_option("time", value, out_micros);
+    }
+    google::protobuf::Timestamp ts;
+    if (!google::protobuf::util::TimeUtil::FromString(value, &ts)) return false;
+    *out_micros = ts.seconds() * 1000000ULL + ts.nanos() / 1000ULL;
+    return true;
+}
+
+/**
+ * @brief Fills the options from env vars, then the command line.
+ *
+ * @param argc Argument count.
+ * @param argv Arguments, argv[1] is the command.
+ * @param opts Output options.
+ * @return true if the arguments are valid.
+ * @return false otherwise.
+ */
+bool parse_options(int argc, char* argv[], ToolOptions* opts) {
+    if (argc < 2) return false;
+    opts->command = argv[1];
+
+    const char* env_path = std::getenv("REGISTADB_STORE_PATH");
+    const char* env_profile = std::getenv("REGISTADB_PROFILE");
+    const char* env_metadata_indexes = std::getenv("METADATA_INDEXES");
+    const char* env_ttl_default = std::getenv("TTL_DEFAULT_S");
+    const char* env_ttl_by_source = std::getenv("TTL_BY_SOURCE");
+    const char* env_entry_ttl = std::getenv("ENABLE_ENTRY_TTL");
+    const char* env_shards = std::getenv("STORAGE_SHARDS");
+    const char* env_rollups = std::getenv("ENABLE_ROLLUPS");
+    const char* env_rollup_1s_retention = std::getenv("ROLLUP_1S_RETENTION_S");
+    const char* env_rollup_1m_retention = std::getenv("ROLLUP_1M_RETENTION_S");
+    const char* env_columnar = std::getenv("COLUMNAR_LISTS");
+    if (env_path) opts->db_path = env_path;
+    if (env_profile) opts->storage_config.profile = env_profile;
+    if (env_shards && !parse_option("STORAGE_SHARDS", env_shards, &opts->storage_config.shards)) return false;
+    if (env_metadata_indexes) opts->storage_config.indexed_metadata_keys = parse_string_list(env_metadata_indexes);
+    if (env_ttl_default && !parse_option("TTL_DEFAULT_S", env_ttl_default, &opts->storage_config.default_ttl_seconds)) return false;
+    if (env_ttl_by_source && !parse_ttl_map("TTL_BY_SOURCE", env_ttl_by_source, &opts->storage_config.source_ttl_seconds)) {
+        return false;
+    }
+    if (env_entry_ttl && (std::string(env_entry_ttl) == "true" || std::string(env_entry_ttl) == "1")) {
+        opts->storage_config.entry_ttl = true;
+    }
+    if (env_rollups && (std::string(env_rollups) == "true" || std::string(env_rollups) == "1")) {
+        opts->storage_config.rollups = true;
+    }
+    if (env_rollup_1s_retention
+        && !parse_option("ROLLUP_1S_RETENTION_S", env_rollup_1s_retention, &opts->storage_config.rollup_second_retention_seconds)) {
+        return false;
+    }
+    if (env_rollup_1m_retention
+        && !parse_option("ROLLUP_1M_RETENTION_S", env_rollup_1m_retention, &opts->storage_config.rollup_minute_retention_seconds)) {
+        return false;
+    }
+    if (env_columnar && (std::string(env_columnar) == "true" || std::string(env_columnar) == "1")) {
+        opts->storage_config.columnar_lists = true;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--path" && i + 1 < argc) {
+            opts->db_path = argv[++i];
+        } else if ((arg == "--input" || arg == "--output") && i + 1 < argc) {
+            opts->file = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc) {
+            opts->format = argv[++i];
+        } else if (arg == "--chunk" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &opts->chunk)) return false;
+            opts->chunk = std::max<size_t>(opts->chunk, 1);
+        } else if (arg == "--from" && i + 1 < argc) {
+            if (!parse_time(argv[++i], &opts->from_ts)) return false;
+        } else if (arg == "--to" && i + 1 < argc) {
+            if (!parse_time(argv[++i], &opts->to_ts)) return false;
+        } else if (arg == "--index-metadata" && i + 1 < argc) {
+            opts->storage_config.indexed_metadata_keys = parse_string_list(argv[++i]);
+        } else if (arg == "--ttl-default-s" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &opts->storage_config.default_ttl_seconds)) return false;
+        } else if (arg == "--ttl-by-source" && i + 1 < argc) {
+            if (!parse_ttl_map(arg, argv[++i], &opts->storage_config.source_ttl_seconds)) return false;
+        } else if (arg == "--entry-ttl") {
+            opts->storage_config.entry_ttl = true;
+        } else if (arg == "--rollups") {
+            opts->storage_config.rollups = true;
+        } else if (arg == "--rollup-1s-retention-s" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &opts->storage_config.rollup_second_retention_seconds)) return false;
+        } else if (arg == "--rollup-1m-retention-s" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &opts->storage_config.rollup_minute_retention_seconds)) return false;
+        } else if (arg == "--columnar-lists") {
+            opts->storage_config.columnar_lists = true;
+        } else if (arg == "--profile" && i + 1 < argc) {
+            opts->storage_config.profile = argv[++i];
+        } else if (arg == "--sample" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &opts->sample)) return false;
+            opts->sample = std::max<size_t>(opts->sample, 2);
+        } else if (arg == "--compact") {
+            opts->compact = true;
+        } else if (arg == "--shards" && i + 1 < argc) {
+            if (!parse_option(arg, argv[++i], &opts->storage_config.shards)) return false;
+        } else {
+            std::cerr << "Unknown argument '" << arg << "'" << std::endl;
+            return false;
+        }
+    }
+    opts->storage_config.shards = std::max<size_t>(opts->storage_config.shards, 1);
+    if (!IsKnownStorageProfile(opts->storage_config.profile)) {
+        std::cerr << "Unknown storage profile '" << opts->storage_config.profile << "'" << std::endl;
+        return false;
+    }
+    // an existing sharded store decides its own shard count
+    if (ShardedStorage::ReadShardCount(opts->db_path) > 1) {
+        opts->storage_config.shards = ShardedStorage::ReadShardCount(opts->db_path);
+    }
+    return opts->format == "protobuf" || opts->format == "ndjson";
+}
+
+/**
+ * @brief Gives an entry from a dump the fields the engine would have set: an id when it has none, created_at when missing and updated_at defaulting to created_at. Existing timestamps are kept so an export can be restored as is.
+ *
+ * @param storage The storage whose id allocator hands out missing ids.
+ * @param entry The entry to prepare.
+ */
+void prepare_entry(ShardedStorage& storage, registadb::Entry& entry) {
+    if (entry.id() == 0) {
+        entry.set_id(storage.GetNextId());
+    } else {
+        storage.ObserveId(entry.id());
+    }
+    if (!entry.has_created_at()) {
+        uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        *entry.mutable_created_at() = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(micros);
+    }
+    if (!entry.has_updated_at()) {
+        *entry.mutable_updated_at() = entry.created_at();
+    }
+}
+
+/**
+ * @brief Loads one chunk and reports progress.
+ *
+ * @param storage The target storage.
+ * @param chunk The prepared entries, cleared afterwards.
+ * @param work_dir Directory for the temporary SST files.
+ * @param total Running totals, updated with this chunk.
+ * @return true if the chunk was loaded.
+ * @return false otherwise.
+ */
+bool load_chunk(ShardedStorage& storage, std::vector<registadb::Entry>& chunk, const std::string& work_dir,
+                BulkLoadStats* total) {
+    BulkLoadStats stats;
+    if (!storage.BulkLoad(chunk, work_dir, &stats)) return false;
+    total->ingested += stats.ingested;
+    total->rewritten += stats.rewritten;
+    total->sst_files += stats.sst_files;
+    total->sst_bytes += stats.sst_bytes;
+    std::cerr << "[Tool] Loaded " << (total->ingested + total->rewritten) << " entries ("
+              << total->sst_files << " SST files, " << total->sst_bytes << " bytes)" << std::endl;
+    chunk.clear();
+    return true;
+}
+
+/**
+ * @brief Reads a protobuf or NDJSON dump and loads it in chunks through SST ingestion.
+ *
+ * @param opts The tool options.
+ * @return int Exit status code.
+ */
+int bulk_load(const ToolOptions& opts) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (opts.file != "-") {
+        file.open(opts.file, std::ios::binary);
+        if (!file) {
+            std::cerr << "Unable to open " << opts.file << std::endl;
+            return 1;
+        }
+        in = &file;
+    }
+
+    // the SST files are moved into the store, so they are written next to it
+    const std::string work_dir = opts.db_path + "/bulk_load_tmp";
+    ShardedStorage storage(opts.db_path, false, opts.storage_config);
+    std::error_code ec;
+    fs::create_directories(work_dir, ec);
+    if (ec) {
+        std::cerr << "Unable to create " << work_dir << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    std::vector<registadb::Entry> chunk;
+    chunk.reserve(opts.chunk);
+    BulkLoadStats total;
+    uint64_t records_read = 0;
+    bool ok = true;
+
+    if (opts.format == "ndjson") {
+        google::protobuf::util::JsonParseOptions json_options;
+        json_options.ignore_unknown_fields = true;
+        std::string line;
+        while (ok && std::getline(*in, line)) {
+            records_read++;
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            registadb::Entry entry;
+            if (!google::protobuf::util::JsonStringToMessage(line, &entry, json_options).ok()) {
+                std::cerr << "Invalid JSON entry on line " << records_read << std::endl;
+                ok = false;
+                break;
+            }
+            prepare_entry(storage, entry);
+            chunk.push_back(std::move(entry));
+            if (chunk.size() >= opts.chunk) ok = load_chunk(storage, chunk, work_dir, &total);
+        }
+    } else {
+        google::protobuf::io::IstreamInputStream stream(in);
+        bool clean_eof = false;
+        while (ok) {
+            registadb::Entry entry;
+            if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(&entry, &stream, &clean_eof)) {
+                if (!clean_eof) {
+                    std::cerr << "Truncated or invalid message after " << records_read << " entries" << std::endl;
+                    ok = false;
+                }
+                break;
+            }
+            records_read++;
+            prepare_entry(storage, entry);
+            chunk.push_back(std::move(entry));
+            if (chunk.size() >= opts.chunk) ok = load_chunk(storage, chunk, work_dir, &total);
+        }
+    }
+    if (ok && !chunk.empty()) ok = load_chunk(storage, chunk, work_dir, &total);
+
+    fs::remove_all(work_dir, ec);
+    if (!ok) return 1;
+    std::cerr << "[Tool] Done: " << total.ingested << " ingested, " << total.rewritten << " rewritten" << std::endl;
+    return 0;
+}
+
+/**
+ * @brief Streams every entry created in [from, to] out as length-delimited protobuf or NDJSON, newest first, one scan page at a time.
+ *
+ * @param opts The tool options.
+ * @return int Exit status code.
+ */
+int export_range(const ToolOptions& opts) {
+    std::ofstream file;
+    std::ostream* out = &std::cout;
+    if (opts.file != "-") {
+        file.open(opts.file, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Unable to open " << opts.file << std::endl;
+            return 1;
+        }
+        out = &file;
+    }
+
+    ShardedStorage storage(opts.db_path, false, opts.storage_config);
+    google::protobuf::util::JsonPrintOptions json_options;
+    json_options.preserve_proto_field_names = true;
+
+    static constexpr size_t kPageSize = 1000;
+    std::vector<registadb::Entry> page;
+    std::string cursor;
+    std::string next_cursor;
+    std::string json;
+    uint64_t exported = 0;
+    {
+        // protobuf goes through a buffered zero-copy stream, NDJSON lines are written directly
+        std::unique_ptr<google::protobuf::io::OstreamOutputStream> stream;
+        if (opts.format == "protobuf") stream.reset(new google::protobuf::io::OstreamOutputStream(out));
+        do {
+            if (!storage.ScanRange(opts.from_ts, opts.to_ts, kPageSize, cursor, &page, &next_cursor)) {
+                std::cerr << "Scan failed after " << exported << " entries" << std::endl;
+                return 1;
+            }
+            for (const registadb::Entry& entry : page) {
+                if (stream) {
+                    if (!google::protobuf::util::SerializeDelimitedToZeroCopyStream(entry, stream.get())) {
+                        std::cerr << "Write failed after " << exported << " entries" << std::endl;
+                        return 1;
+                    }
+                } else {
+                    json.clear();
+                    google::protobuf::util::MessageToJsonString(entry, &json, json_options);
+                    *out << json << '\n';
+                }
+                exported++;
+            }
+            cursor.swap(next_cursor);
+        } while (!cursor.empty());
+    }
+    out->flush();
+    std::cerr << "[Tool] Exported " << exported << " entries" << std::endl;
+    return out->good() ? 0 : 1;
+}
+
+/**
+ * @brief Sums the data_cf table properties of every shard.
+ *
+ * @param storage The opened storage.
+ * @return DataCompression The totals.
+ */
+DataCompression data_compression(ShardedStorage& storage) {
+    DataCompression total;
+    for (size_t i = 0; i < storage.ShardCount(); ++i) {
+        DataCompression shard = storage.Shard(i).GetDataCompression();
+        total.files += shard.files;
+        total.dict_files += shard.dict_files;
+        total.entries += shard.entries;
+        total.raw_bytes += shard.raw_bytes;
+        total.data_bytes += shard.data_bytes;
+    }
+    return total;
+}
+
+/**
+ * @brief Prints one on-disk line of the report.
+ *
+ * @param label What the line describes.
+ * @param usage The data_cf totals.
+ */
+void print_data_compression(const std::string& label, const DataCompression& usage) {
+    std::cout << label << ": " << usage.files << " SST files (" << usage.dict_files << " with a ZSTD dictionary), "
+              << usage.entries << " entries, " << usage.raw_bytes << " -> " << usage.data_bytes << " bytes";
+    if (usage.data_bytes > 0) {
+        std::cout << " (" << static_cast<double>(usage.raw_bytes) / static_cast<double>(usage.data_bytes) << "x)";
+    }
+    std::cout << std::endl;
+}
+
+/**
+ * @brief Concatenates values into blocks of about kBlockBytes, the unit RocksDB compresses.
+ *
+ * @param values The sampled values.
+ * @param first Index of the first value to use.
+ * @param stride Distance between used values.
+ * @param max_bytes Stop once this many bytes are packed.
+ * @param out Output for the blocks.
+ */
+void pack_blocks(const std::vector<std::string>& values, size_t first, size_t stride, size_t max_bytes,
+                 std::vector<std::string>* out) {
+    static constexpr size_t kBlockBytes = 4096; // BlockBasedTableOptions::block_size default
+    std::string block;
+    size_t packed = 0;
+    for (size_t i = first; i < values.size() && packed < max_bytes; i += stride) {
+        block += values[i];
+        packed += values[i].size();
+        if (block.size() >= kBlockBytes) {
+            out->push_back(std::move(block));
+            block.clear();
+        }
+    }
+    if (!block.empty()) out->push_back(std::move(block));
+}
+
+/**
+ * @brief Estimates the data_cf compression ratio on sampled values, without and with a dictionary. Like RocksDB, the values are compressed one block at a time and the dictionary is trained by ZDICT from whole blocks, up to kZstdDictTrainBytes of them. Even values train the dictionary, odd values are measured, so the estimate does not reward a dictionary for memorising its own test data.
+ *
+ * @param values The sampled values.
+ * @return true if the estimate was printed.
+ * @return false if compression failed.
+ */
+bool estimate_compression(const std::vector<std::string>& values) {
+    std::vector<std::string> train_blocks;
+    std::vector<std::string> test_blocks;
+    pack_blocks(values, 0, 2, kZstdDictTrainBytes, &train_blocks);
+    pack_blocks(values, 1, 2, SIZE_MAX, &test_blocks);
+
+    std::string samples;
+    std::vector<size_t> sample_sizes;
+    for (const std::string& block : train_blocks) {
+        samples += block;
+        sample_sizes.push_back(block.size());
+    }
+    std::string dict(kZstdDictBytes, '\0');
+    size_t dict_size = ZDICT_trainFromBuffer(&dict[0], dict.size(), samples.data(), sample_sizes.data(),
+                                             static_cast<unsigned>(sample_sizes.size()));
+    const bool trained = !ZDICT_isError(dict_size);
+    if (!trained) {
+        std::cout << "dictionary training failed: " << ZDICT_getErrorName(dict_size) << std::endl;
+        dict_size = 0;
+    }
+
+    std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    std::unique_ptr<ZSTD_CDict, size_t (*)(ZSTD_CDict*)> cdict(
+        trained ? ZSTD_createCDict(dict.data(), dict_size, ZSTD_CLEVEL_DEFAULT) : nullptr, ZSTD_freeCDict);
+    uint64_t raw = 0;
+    uint64_t plain = 0;
+    uint64_t with_dict = 0;
+    std::string buffer;
+    for (const std::string& block : test_blocks) {
+        buffer.resize(ZSTD_compressBound(block.size()));
+        size_t n = ZSTD_compressCCtx(cctx.get(), &buffer[0], buffer.size(), block.data(), block.size(), ZSTD_CLEVEL_DEFAULT);
+        if (ZSTD_isError(n)) {
+            std::cerr << "ZSTD compression failed: " << ZSTD_getErrorName(n) << std::endl;
+            return false;
+        }
+        raw += block.size();
+        plain += n;
+        if (cdict) {
+            n = ZSTD_compress_usingCDict(cctx.get(), &buffer[0], buffer.size(), block.data(), block.size(), cdict.get());
+            if (ZSTD_isError(n)) {
+                std::cerr << "ZSTD dictionary compression failed: " << ZSTD_getErrorName(n) << std::endl;
+                return false;
+            }
+            with_dict += n;
+        }
+    }
+
+    std::cout << "sample: " << values.size() << " values, " << train_blocks.size() << " blocks trained a "
+              << dict_size << " byte dictionary, " << test_blocks.size() << " blocks (" << raw << " bytes) measured" << std::endl;
+    if (raw == 0 || plain == 0) return true;
+    std::cout << "  zstd:              " << raw << " -> " << plain << " bytes ("
+              << static_cast<double>(raw) / static_cast<double>(plain) << "x)" << std::endl;
+    if (with_dict > 0) {
+        std::cout << "  zstd + dictionary: " << raw << " -> " << with_dict << " bytes ("
+                  << static_cast<double>(raw) / static_cast<double>(with_dict) << "x)" << std::endl;
+    }
+    return true;
+}
+
+/**
+ * @brief Reports how well data_cf compresses: the on-disk ratio from the SST table properties, then an estimate with plain ZSTD and with a trained ZSTD dictionary on a sample of stored values. With --compact, data_cf is then rewritten under the selected profile and the on-disk ratio reported again.
+ *
+ * @param opts The tool options.
+ * @return int Exit status code.
+ */
+int compression_report(const ToolOptions& opts) {
+    ShardedStorage storage(opts.db_path, false, opts.storage_config);
+    print_data_compression("data_cf on disk", data_compression(storage));
+
+    std::vector<std::string> values;
+    const size_t per_shard = std::max<size_t>(opts.sample / storage.ShardCount(), 1);
+    for (size_t i = 0; i < storage.ShardCount(); ++i) {
+        if (!storage.Shard(i).SampleStoredValues(per_shard, &values)) return 1;
+    }
+    if (values.size() < 2) {
+        std::cout << "sample: data_cf holds too few values to estimate" << std::endl;
+    } else if (!estimate_compression(values)) {
+        return 1;
+    }
+
+    if (!opts.compact) return 0;
+    std::cerr << "[Tool] Compacting data_cf with profile " << opts.storage_config.profile << std::endl;
+    for (size_t i = 0; i < storage.ShardCount(); ++i) {
+        if (!storage.Shard(i).CompactDataCF()) return 1;
+    }
+    print_data_compression("data_cf after compaction (" + opts.storage_config.profile + ")", data_compression(storage));
+    return 0;
+}
+
+}
+
+/**
+ * @brief Entry point for registadb_tool: offline bulk load, export and compression report against a stopped engine's RocksDB store.
+ *
+ * @return int Exit status code.
+ */
+int main(int argc, char* argv[]) {
+    ToolOptions opts;
+    if (!parse_options(argc, argv, &opts)) {
+        print_usage();
+        return 2;
+    }
+    if (opts.command == "bulk-load") return bulk_load(opts);
+    if (opts.command == "export") return export_range(opts);
+    if (opts.command == "compression-report") return compression_report(opts);
+    print_usage();
+    return 2;
+}